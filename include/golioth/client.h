@@ -27,6 +27,12 @@
 /// @brief Opaque Golioth client
 struct golioth_client;
 
+/// @brief Opaque path handle
+///
+/// A path which has been prepared once, so that requests to it don't need to parse
+/// the path again. See @ref golioth_stream_path_create and @ref golioth_lightdb_path_create.
+struct golioth_path;
+
 /// Golioth client events
 enum golioth_client_event
 {
@@ -43,6 +49,21 @@ enum golioth_content_type
     GOLIOTH_CONTENT_TYPE_CBOR,
 };
 
+/// How a request is delivered to the server
+enum golioth_delivery_mode
+{
+    /// Confirmable request. Retransmitted until the server responds, and the callback is
+    /// called with the response or a timeout.
+    GOLIOTH_DELIVERY_CONFIRMABLE,
+    /// Non-confirmable request. Sent once and never retransmitted. The client doesn't wait
+    /// for a response, and the callback is called with GOLIOTH_OK as soon as the request
+    /// has been sent. Any response from the server is ignored.
+    GOLIOTH_DELIVERY_NON_CONFIRMABLE,
+    /// Same as GOLIOTH_DELIVERY_NON_CONFIRMABLE, but also asks the server not to respond at
+    /// all (RFC 7967 No-Response option), which saves the downlink traffic.
+    GOLIOTH_DELIVERY_NO_RESPONSE,
+};
+
 /// Response status and CoAP class/code
 struct golioth_response
 {
@@ -52,6 +73,9 @@ struct golioth_response
     ///      GOLIOTH_ERR_TIMEOUT (no response received from server)
     ///      GOLIOTH_OK (2.XX)
     ///      GOLIOTH_ERR_FAIL (anything other than 2.XX)
+    ///      GOLIOTH_ERR_COALESCED (set was replaced by a newer set to the same path
+    ///                             before it was sent, see
+    ///                             CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS)
     enum golioth_status status;
     /// the 2 in 2.XX
     uint8_t status_class;
@@ -59,6 +83,107 @@ struct golioth_response
     uint8_t status_code;
 };
 
+/// Round-trip time estimates of a client, see @ref golioth_client_get_rtt
+struct golioth_client_rtt
+{
+    /// Smoothed round-trip time, in milliseconds. 0 until the first sample.
+    uint32_t srtt_ms;
+    /// Round-trip time variation, in milliseconds
+    uint32_t rttvar_ms;
+    /// Current retransmission timeout, in milliseconds
+    uint32_t rto_ms;
+    /// Number of round-trip time samples the estimates are based on
+    uint32_t num_samples;
+};
+
+/// Number of buckets in a @ref golioth_latency_histogram
+#define GOLIOTH_LATENCY_HISTOGRAM_NUM_BUCKETS 16
+
+/// Histogram of latencies, in milliseconds
+///
+/// Bucket 0 counts latencies below 1 ms, and bucket i counts latencies from 2^(i-1) ms up to,
+/// but not including, 2^i ms. The last bucket also counts all longer latencies.
+struct golioth_latency_histogram
+{
+    /// Number of samples in each bucket
+    uint32_t buckets[GOLIOTH_LATENCY_HISTOGRAM_NUM_BUCKETS];
+    /// Total number of samples
+    uint32_t count;
+    /// Sum of all samples, in milliseconds
+    uint64_t sum_ms;
+    /// Longest sample, in milliseconds
+    uint32_t max_ms;
+};
+
+/// Request types, as counted in @ref golioth_client_stats
+enum golioth_client_stats_request_type
+{
+    /// Empty requests, used as keepalives
+    GOLIOTH_CLIENT_STATS_REQUEST_EMPTY,
+    GOLIOTH_CLIENT_STATS_REQUEST_GET,
+    /// Blockwise GET, e.g. of OTA artifacts. Each block is counted as a request.
+    GOLIOTH_CLIENT_STATS_REQUEST_GET_BLOCK,
+    GOLIOTH_CLIENT_STATS_REQUEST_POST,
+    /// Blockwise POST. Each block is counted as a request.
+    GOLIOTH_CLIENT_STATS_REQUEST_POST_BLOCK,
+    GOLIOTH_CLIENT_STATS_REQUEST_DELETE,
+    /// Observations. Only the response to the request is counted, not the notifications.
+    GOLIOTH_CLIENT_STATS_REQUEST_OBSERVE,
+    GOLIOTH_CLIENT_STATS_NUM_REQUEST_TYPES,
+};
+
+/// Latencies of one request type, see @ref golioth_client_stats
+struct golioth_client_request_stats
+{
+    /// Time from queueing the request to sending it
+    struct golioth_latency_histogram queue_latency;
+    /// Time from sending the request to receiving its response
+    struct golioth_latency_histogram response_latency;
+};
+
+/// Requests that failed without a response, by reason, see @ref golioth_client_stats
+struct golioth_client_drop_stats
+{
+    /// The request queue was full, so the request was not queued
+    uint32_t queue_full;
+    /// The request timed out while still in the request queue
+    uint32_t ageout;
+    /// The CoAP layer gave up on delivering the request, e.g. because of a DTLS error.
+    /// Always 0 on Zephyr.
+    uint32_t nack;
+    /// No response arrived in time, or the session ended before it did
+    uint32_t timeout;
+    /// The response arrived, but the callback was not called: an observation notification
+    /// found the callback executor queue full, or there was no memory to queue a callback.
+    /// Always 0 with CONFIG_GOLIOTH_CALLBACK_EXECUTOR disabled.
+    uint32_t callback;
+};
+
+/// Runtime statistics of a client, see @ref golioth_client_get_stats
+///
+/// All counters start at 0 when the client is created, and are never reset.
+struct golioth_client_stats
+{
+    /// Latencies, indexed by @ref golioth_client_stats_request_type
+    struct golioth_client_request_stats requests[GOLIOTH_CLIENT_STATS_NUM_REQUEST_TYPES];
+    /// Highest number of requests that were in the request queue at once
+    uint32_t queue_high_water_mark;
+    /// Requests that failed without a response
+    struct golioth_client_drop_stats drops;
+    /// Retransmissions of confirmable messages
+    uint32_t retransmits;
+    /// Completed DTLS handshakes
+    uint32_t handshakes;
+    /// Sessions started after the first one
+    uint32_t reconnects;
+    /// Bytes received. On Zephyr, all CoAP message bytes. On ports using libcoap, which
+    /// doesn't expose message sizes, only the payload bytes of responses and notifications.
+    uint64_t bytes_in;
+    /// Bytes sent. On Zephyr, all CoAP message bytes, including retransmissions. On ports
+    /// using libcoap, only the payload bytes of requests.
+    uint64_t bytes_out;
+};
+
 /// Authentication type
 enum golioth_auth_type
 {
@@ -120,6 +245,13 @@ struct golioth_credential
 struct golioth_client_config
 {
     struct golioth_credential credentials;
+    /// Optional warm cache from @ref golioth_client_save_warm_cache, or NULL.
+    ///
+    /// Only read by @ref golioth_client_create. A cache that is not valid for this
+    /// firmware or server is ignored.
+    const uint8_t *warm_cache;
+    /// Length of warm_cache, in bytes
+    size_t warm_cache_len;
 };
 
 /// Callback function type for client events
@@ -137,6 +269,11 @@ typedef void (*golioth_client_event_cb_fn)(struct golioth_client *client,
 /// The callback function should check response->status to determine which case it is (response
 /// received or timeout).
 ///
+/// With CONFIG_GOLIOTH_CALLBACK_EXECUTOR, observation notifications are dropped while the
+/// callback thread is too far behind to queue them, so an observe callback may miss values,
+/// and should not assume it sees every change. Other callbacks are only dropped when out of
+/// memory. Dropped callbacks are counted in the drops of @ref golioth_client_get_stats.
+///
 /// @param client The client handle from the original request.
 /// @param response Response status and class/code
 /// @param path The path from the original request
@@ -162,7 +299,7 @@ typedef void (*golioth_get_block_cb_fn)(struct golioth_client *client,
 /// Will be called when a response is received or on timeout (i.e. response never received).
 /// The callback function should check response->status to determine which case it is (response
 /// received or timeout). If response->status is GOLIOTH_OK, then the set or delete request
-/// was successful.
+/// was successful. Only dropped when out of memory, see @ref golioth_get_cb_fn.
 ///
 /// @param client The client handle from the original request.
 /// @param response Response status and class/code
@@ -173,6 +310,40 @@ typedef void (*golioth_set_cb_fn)(struct golioth_client *client,
                                   const char *path,
                                   void *arg);
 
+/// Callback function type for releasing a borrowed request payload
+///
+/// Called exactly once, when the SDK no longer needs a payload that was borrowed from the
+/// application, either because the request has been sent or because it failed. After this
+/// callback returns, the application may reuse or free the payload.
+///
+/// @param payload The payload from the original request
+/// @param payload_size The size of payload, in bytes
+/// @param arg User argument, copied from the original request. Can be NULL.
+typedef void (*golioth_payload_release_fn)(const uint8_t *payload,
+                                           size_t payload_size,
+                                           void *arg);
+
+/// Callback function type for reading the payload of a blockwise upload
+///
+/// Called from the Golioth client thread for each block, in order, just before the block is
+/// sent. The payload doesn't need to be kept in memory, as each block is read when needed.
+///
+/// @param client The client handle from the original request.
+/// @param offset Offset of the block in the payload, in bytes
+/// @param block_buffer Buffer to fill with the block
+/// @param block_size Size of block_buffer on entry. Set to the number of bytes written, which
+///                   must be the full block size for all but the last block.
+/// @param is_last Set to true if this is the last block of the payload
+/// @param arg User argument, copied from the original request. Can be NULL.
+///
+/// @return GOLIOTH_OK - block read, or any other status to abort the upload
+typedef enum golioth_status (*golioth_read_block_cb_fn)(struct golioth_client *client,
+                                                        size_t offset,
+                                                        uint8_t *block_buffer,
+                                                        size_t *block_size,
+                                                        bool *is_last,
+                                                        void *arg);
+
 /// Create a Golioth client
 ///
 /// Dynamically creates a client and returns an opaque handle to the client.
@@ -276,6 +447,61 @@ uint32_t golioth_client_num_items_in_request_queue(struct golioth_client *client
 /// @param percent Percent packet loss (0 is no packets lost, 100 is all packets lost)
 void golioth_client_set_packet_loss_percent(uint8_t percent);
 
+/// Get the current round-trip time estimates of the client
+///
+/// The client measures the round-trip time of its requests, and uses the estimates for
+/// the retransmission and response timeouts, and thereby to decide when the server is no
+/// longer reachable.
+///
+/// @param client The client handle
+/// @param rtt Filled with the current estimates
+///
+/// @return GOLIOTH_OK - rtt filled in
+/// @return GOLIOTH_ERR_NULL - invalid client handle or rtt
+enum golioth_status golioth_client_get_rtt(struct golioth_client *client,
+                                           struct golioth_client_rtt *rtt);
+
+/// Get the runtime statistics of the client
+///
+/// The counters are updated as requests are queued, sent and answered, with no more than
+/// a few additions each, so they are always enabled. The statistics are copied without
+/// stopping the client, so counters updated at the same time may be slightly out of step.
+///
+/// @param client The client handle
+/// @param stats Filled with the current statistics
+///
+/// @return GOLIOTH_OK - stats filled in
+/// @return GOLIOTH_ERR_NULL - invalid client handle or stats
+enum golioth_status golioth_client_get_stats(struct golioth_client *client,
+                                             struct golioth_client_stats *stats);
+
+/// Buffer size needed for @ref golioth_client_save_warm_cache, in bytes
+#define GOLIOTH_CLIENT_WARM_CACHE_SIZE 64
+
+/// Save the resolved server address and round-trip time estimates of the client
+///
+/// This is a warm cache, not a session: pass it to @ref golioth_client_create in
+/// @ref golioth_client_config after a restart to connect to the same server address without a
+/// DNS lookup, and with retransmission timeouts tuned to the link from the first request. The
+/// restored address is treated like a freshly resolved one, and kept for
+/// CONFIG_GOLIOTH_DNS_CACHE_TTL_S. If it doesn't work, the client resolves the server address
+/// as usual.
+///
+/// Nothing else carries over. The client does a full DTLS handshake when it connects, and the
+/// application registers its observations again.
+///
+/// @param client The client handle
+/// @param buf Buffer to write the cache to
+/// @param len Size of buf on input, at least @ref GOLIOTH_CLIENT_WARM_CACHE_SIZE. Set to
+///            the length of the cache on output.
+///
+/// @return GOLIOTH_OK - cache written to buf
+/// @return GOLIOTH_ERR_NULL - invalid client handle, buf or len
+/// @return GOLIOTH_ERR_MEM_ALLOC - buf is too small
+enum golioth_status golioth_client_save_warm_cache(struct golioth_client *client,
+                                                   uint8_t *buf,
+                                                   size_t *len);
+
 /// Return the thread handle of the client thread.
 ///
 /// @param client The client handle
@@ -283,4 +509,21 @@ void golioth_client_set_packet_loss_percent(uint8_t percent);
 /// @return The thread handle of the client thread
 golioth_sys_thread_t golioth_client_get_thread(struct golioth_client *client);
 
+/// Destroy a path handle
+///
+/// The path must not be destroyed while there are requests for it waiting in the
+/// request queue.
+///
+/// @param path The path handle to destroy. Can be NULL.
+void golioth_path_destroy(struct golioth_path *path);
+
+/// Set how requests to a path handle are delivered
+///
+/// Path handles are created with GOLIOTH_DELIVERY_CONFIRMABLE. Only affects requests that
+/// are queued after the call.
+///
+/// @param path The path handle
+/// @param mode The delivery mode for requests to the path
+void golioth_path_set_delivery_mode(struct golioth_path *path, enum golioth_delivery_mode mode);
+
 /// @}
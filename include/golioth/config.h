@@ -21,6 +21,10 @@
 #define CONFIG_GOLIOTH_COAP_HOST_URI "coaps://coap.golioth.io"
 #endif
 
+#ifndef CONFIG_GOLIOTH_DNS_CACHE_TTL_S
+#define CONFIG_GOLIOTH_DNS_CACHE_TTL_S 300
+#endif
+
 #ifndef CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S
 #define CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S 10
 #endif
@@ -33,6 +37,18 @@
 #define CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS 10
 #endif
 
+#ifndef CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_BUFFER_SIZE
+#define CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_BUFFER_SIZE 2048
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS
+#define CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_SYNC_COMPLETION_POOL_SIZE
+#define CONFIG_GOLIOTH_COAP_SYNC_COMPLETION_POOL_SIZE 4
+#endif
+
 #ifndef CONFIG_GOLIOTH_COAP_THREAD_PRIORITY
 #define CONFIG_GOLIOTH_COAP_THREAD_PRIORITY 5
 #endif
@@ -41,10 +57,65 @@
 #define CONFIG_GOLIOTH_COAP_THREAD_STACK_SIZE 6144
 #endif
 
+// Linux only: run all clients on CONFIG_GOLIOTH_SHARED_EVENT_LOOP_NUM_THREADS shared
+// threads, instead of a thread and a keepalive timer per client.
+//
+// Callbacks of a client run on its event loop thread, and hold up all the other clients on
+// that thread while they run, so they must not block. Enable CONFIG_GOLIOTH_CALLBACK_EXECUTOR
+// to run response callbacks on their own threads; client event callbacks, and the callbacks
+// of request classes set to run inline, still run on the event loop.
+#ifndef CONFIG_GOLIOTH_SHARED_EVENT_LOOP
+#define CONFIG_GOLIOTH_SHARED_EVENT_LOOP 0
+#endif
+
+#ifndef CONFIG_GOLIOTH_SHARED_EVENT_LOOP_NUM_THREADS
+#define CONFIG_GOLIOTH_SHARED_EVENT_LOOP_NUM_THREADS 1
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR 0
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS 1
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE 8
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_THREAD_PRIORITY
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_THREAD_PRIORITY 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_THREAD_STACK_SIZE
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_THREAD_STACK_SIZE 4096
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_RPC
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_RPC 0
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_OTA
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_OTA 0
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_TELEMETRY
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_TELEMETRY 0
+#endif
+
+#ifndef CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_LOG
+#define CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_LOG 0
+#endif
+
 #ifndef CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S
 #define CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S 9
 #endif
 
+#ifndef CONFIG_GOLIOTH_USE_CONNECTION_ID
+#define CONFIG_GOLIOTH_USE_CONNECTION_ID 0
+#endif
+
 #ifndef CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS
 #define CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS 8
 #endif
@@ -81,10 +152,38 @@
 #define CONFIG_GOLIOTH_COAP_MAX_PATH_LEN 39
 #endif
 
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE 64
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS 8
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE 256
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE 1024
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS 2
+#endif
+
 #ifndef CONFIG_GOLIOTH_MAX_NUM_SETTINGS
 #define CONFIG_GOLIOTH_MAX_NUM_SETTINGS 16
 #endif
 
+#ifndef CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS
+#define CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS 0
+#endif
+
 #ifndef CONFIG_GOLIOTH_RPC_MAX_NUM_METHODS
 #define CONFIG_GOLIOTH_RPC_MAX_NUM_METHODS 8
 #endif
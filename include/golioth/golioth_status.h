@@ -21,7 +21,8 @@
     STATUS(GOLIOTH_ERR_NOT_ALLOWED)         \
     STATUS(GOLIOTH_ERR_INVALID_STATE)       \
     STATUS(GOLIOTH_ERR_NO_MORE_DATA)        \
-    STATUS(GOLIOTH_ERR_NACK)
+    STATUS(GOLIOTH_ERR_NACK) /* 15 */       \
+    STATUS(GOLIOTH_ERR_COALESCED)
 
 #define GENERATE_GOLIOTH_STATUS_ENUM(code) code,
 enum golioth_status
@@ -162,6 +162,59 @@ enum golioth_status golioth_lightdb_set_sync(struct golioth_client *client,
                                              size_t buf_len,
                                              int32_t timeout_s);
 
+/// Create a path handle for a path in LightDB state
+///
+/// Requests made with a path handle skip parsing the path, which saves time for paths
+/// that are used over and over. The path is split into segments on '/'.
+///
+/// @param path The path in LightDB state (e.g. "my_integer")
+///
+/// @return The path handle, to be destroyed with @ref golioth_path_destroy, or NULL if
+///         out of memory or path is invalid
+struct golioth_path *golioth_lightdb_path_create(const char *path);
+
+/// Set an object in LightDB state at a path handle asynchronously
+///
+/// Same as @ref golioth_lightdb_set_async, but the path is given as a path handle.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path handle from @ref golioth_lightdb_path_create
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @return GOLIOTH_OK - request enqueued
+/// @return GOLIOTH_ERR_NULL - invalid client or path handle
+/// @return GOLIOTH_ERR_INVALID_STATE - client is not running, currently stopped
+/// @return GOLIOTH_ERR_MEM_ALLOC - memory allocation error
+/// @return GOLIOTH_ERR_QUEUE_FULL - request queue is full, this request is dropped
+enum golioth_status golioth_lightdb_set_handle_async(struct golioth_client *client,
+                                                     const struct golioth_path *path,
+                                                     enum golioth_content_type content_type,
+                                                     const uint8_t *buf,
+                                                     size_t buf_len,
+                                                     golioth_set_cb_fn callback,
+                                                     void *callback_arg);
+
+/// Set an object in LightDB state at a path handle synchronously
+///
+/// Same as @ref golioth_lightdb_set_sync, but the path is given as a path handle.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path handle from @ref golioth_lightdb_path_create
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param timeout_s The timeout, in seconds, for receiving a server response
+enum golioth_status golioth_lightdb_set_handle_sync(struct golioth_client *client,
+                                                    const struct golioth_path *path,
+                                                    enum golioth_content_type content_type,
+                                                    const uint8_t *buf,
+                                                    size_t buf_len,
+                                                    int32_t timeout_s);
+
 /// Get data in LightDB state at a particular path asynchronously.
 ///
 /// This function will enqueue a request and return immediately without
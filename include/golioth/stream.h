@@ -141,6 +141,72 @@ enum golioth_status golioth_stream_set_async(struct golioth_client *client,
                                              golioth_set_cb_fn callback,
                                              void *callback_arg);
 
+/// Set an object in LightDB stream at a particular path asynchronously, with a delivery mode
+///
+/// Same as @ref golioth_stream_set_async, but the request is delivered according to
+/// delivery_mode. With GOLIOTH_DELIVERY_NON_CONFIRMABLE or GOLIOTH_DELIVERY_NO_RESPONSE, the
+/// object is sent once without waiting for a response, which suits frequent telemetry where
+/// an occasional lost sample is acceptable. The callback is then called as soon as the
+/// request has been sent, and GOLIOTH_OK only means that it left the device.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in LightDB stream to set (e.g. "my_obj")
+/// @param delivery_mode How the request is delivered
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param callback Callback to call on response received, timeout or, for non-confirmable
+///        delivery, once sent. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @return GOLIOTH_OK - request enqueued
+/// @return GOLIOTH_ERR_NULL - invalid client handle
+/// @return GOLIOTH_ERR_INVALID_STATE - client is not running, currently stopped
+/// @return GOLIOTH_ERR_MEM_ALLOC - memory allocation error
+/// @return GOLIOTH_ERR_QUEUE_FULL - request queue is full, this request is dropped
+enum golioth_status golioth_stream_set_delivery_async(struct golioth_client *client,
+                                                      const char *path,
+                                                      enum golioth_delivery_mode delivery_mode,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *buf,
+                                                      size_t buf_len,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg);
+
+/// Set an object in LightDB stream at a particular path asynchronously, without copying buf
+///
+/// Same as @ref golioth_stream_set_async, but buf is borrowed instead of copied. The SDK sends
+/// directly from buf, so buf must not be modified or freed until release is called. release is
+/// called exactly once, from the Golioth client thread, after the request has been sent or has
+/// failed.
+///
+/// If this function does not return GOLIOTH_OK, release is not called and the caller keeps
+/// ownership of buf.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in LightDB stream to set (e.g. "my_obj")
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param release Callback to hand buf back to the application. Must not be NULL.
+/// @param release_arg Release callback argument. Can be NULL.
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @return GOLIOTH_OK - request enqueued
+/// @return GOLIOTH_ERR_NULL - invalid client handle or release callback
+/// @return GOLIOTH_ERR_INVALID_STATE - client is not running, currently stopped
+/// @return GOLIOTH_ERR_QUEUE_FULL - request queue is full, this request is dropped
+enum golioth_status golioth_stream_set_borrowed_async(struct golioth_client *client,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *buf,
+                                                      size_t buf_len,
+                                                      golioth_payload_release_fn release,
+                                                      void *release_arg,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg);
+
 /// Set an object in LightDB stream at a particular path synchronously
 ///
 /// Similar to @ref golioth_stream_set_int_sync, but content_type must be specified
@@ -158,4 +224,215 @@ enum golioth_status golioth_stream_set_sync(struct golioth_client *client,
                                             size_t buf_len,
                                             int32_t timeout_s);
 
+/// Upload an object to LightDB stream at a particular path in blocks, asynchronously
+///
+/// For objects that are too large to keep in memory at once, such as a core dump. The
+/// object is sent in 1024 byte blocks, each read from read_block just before it is sent,
+/// so only one block is held in memory at a time.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in LightDB stream to set (e.g. "my_obj")
+/// @param content_type The serialization format of the object
+/// @param read_block Callback to read each block of the object. Must not be NULL.
+/// @param read_block_arg Read callback argument. Can be NULL.
+/// @param callback Callback to call when the upload has finished or failed. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @return GOLIOTH_OK - request enqueued
+/// @return GOLIOTH_ERR_NULL - invalid client handle or read callback
+/// @return GOLIOTH_ERR_INVALID_STATE - client is not running, currently stopped
+/// @return GOLIOTH_ERR_MEM_ALLOC - memory allocation error
+/// @return GOLIOTH_ERR_QUEUE_FULL - request queue is full, this request is dropped
+enum golioth_status golioth_stream_set_blockwise_async(struct golioth_client *client,
+                                                       const char *path,
+                                                       enum golioth_content_type content_type,
+                                                       golioth_read_block_cb_fn read_block,
+                                                       void *read_block_arg,
+                                                       golioth_set_cb_fn callback,
+                                                       void *callback_arg);
+
+/// Upload an object to LightDB stream at a particular path in blocks, synchronously
+///
+/// Same as @ref golioth_stream_set_blockwise_async, but blocks until the upload has
+/// finished. timeout_s covers the whole upload, not each block.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in LightDB stream to set (e.g. "my_obj")
+/// @param content_type The serialization format of the object
+/// @param read_block Callback to read each block of the object. Must not be NULL.
+/// @param read_block_arg Read callback argument. Can be NULL.
+/// @param timeout_s The timeout, in seconds, for the whole upload
+enum golioth_status golioth_stream_set_blockwise_sync(struct golioth_client *client,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      golioth_read_block_cb_fn read_block,
+                                                      void *read_block_arg,
+                                                      int32_t timeout_s);
+
+/// Create a path handle for a path in LightDB stream
+///
+/// Requests made with a path handle skip parsing the path, which saves time for paths
+/// that are used over and over. The path is split into segments on '/'.
+///
+/// @param path The path in LightDB stream (e.g. "my_obj")
+///
+/// @return The path handle, to be destroyed with @ref golioth_path_destroy, or NULL if
+///         out of memory or path is invalid
+struct golioth_path *golioth_stream_path_create(const char *path);
+
+/// Set an object in LightDB stream at a path handle asynchronously
+///
+/// Same as @ref golioth_stream_set_async, but the path is given as a path handle. The request
+/// is delivered according to the delivery mode of the path handle, see
+/// @ref golioth_path_set_delivery_mode.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path handle from @ref golioth_stream_path_create
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @return GOLIOTH_OK - request enqueued
+/// @return GOLIOTH_ERR_NULL - invalid client or path handle
+/// @return GOLIOTH_ERR_INVALID_STATE - client is not running, currently stopped
+/// @return GOLIOTH_ERR_MEM_ALLOC - memory allocation error
+/// @return GOLIOTH_ERR_QUEUE_FULL - request queue is full, this request is dropped
+enum golioth_status golioth_stream_set_handle_async(struct golioth_client *client,
+                                                    const struct golioth_path *path,
+                                                    enum golioth_content_type content_type,
+                                                    const uint8_t *buf,
+                                                    size_t buf_len,
+                                                    golioth_set_cb_fn callback,
+                                                    void *callback_arg);
+
+/// Set an object in LightDB stream at a path handle synchronously
+///
+/// Same as @ref golioth_stream_set_sync, but the path is given as a path handle.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path handle from @ref golioth_stream_path_create
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param timeout_s The timeout, in seconds, for receiving a server response
+enum golioth_status golioth_stream_set_handle_sync(struct golioth_client *client,
+                                                   const struct golioth_path *path,
+                                                   enum golioth_content_type content_type,
+                                                   const uint8_t *buf,
+                                                   size_t buf_len,
+                                                   int32_t timeout_s);
+
+/// Timestamp for records in a stream batch that are stamped by the server when received
+#define GOLIOTH_STREAM_BATCH_NO_TIMESTAMP 0
+
+/// Stream batch handle
+struct golioth_stream_batch;
+
+/// When a stream batch is sent, and who is told about it
+struct golioth_stream_batch_config
+{
+    /// Max size of the encoded batch, in bytes. The batch is sent when the next record
+    /// doesn't fit.
+    size_t max_size;
+    /// Number of records after which the batch is sent. 0 for no limit.
+    size_t max_records;
+    /// Age of the oldest record after which the batch is sent. Checked when a record is
+    /// added. 0 for no limit.
+    int32_t max_age_ms;
+    /// Callback to call on response received or timeout for each sent batch. Can be NULL.
+    golioth_set_cb_fn callback;
+    /// Callback argument, passed directly when callback invoked. Can be NULL.
+    void *callback_arg;
+};
+
+/// Create a batch of LightDB stream records
+///
+/// A batch collects path/value records, each with an optional timestamp, in a single CBOR
+/// array, and sends them to LightDB stream in one request. This saves a round trip and the
+/// per-request overhead for every record but the first.
+///
+/// The batch is sent when it is full, when it has config->max_records records, when its
+/// oldest record is older than config->max_age_ms, or when @ref golioth_stream_batch_flush
+/// is called. The age limit is only checked when a record is added, so call
+/// @ref golioth_stream_batch_flush to send records that would otherwise wait too long.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param config Batch configuration. Copied, so it doesn't have to outlive the call.
+///
+/// @return The batch handle, or NULL if out of memory or config is invalid
+struct golioth_stream_batch *golioth_stream_batch_create(
+    struct golioth_client *client,
+    const struct golioth_stream_batch_config *config);
+
+/// Destroy a stream batch. Records that have not been sent are dropped.
+///
+/// @param batch The batch handle from @ref golioth_stream_batch_create. Can be NULL.
+void golioth_stream_batch_destroy(struct golioth_stream_batch *batch);
+
+/// Add an integer record to a stream batch
+///
+/// If adding the record sends the batch, the request is enqueued in the same way as
+/// @ref golioth_stream_set_async. If the request can't be enqueued, the records in the batch
+/// are dropped.
+///
+/// @param batch The batch handle from @ref golioth_stream_batch_create
+/// @param path The path in LightDB stream to set (e.g. "sensor/temp")
+/// @param timestamp_ms Unix time of the record in milliseconds, or
+///                     GOLIOTH_STREAM_BATCH_NO_TIMESTAMP
+/// @param value The value to set at path
+///
+/// @return GOLIOTH_OK - record added
+/// @return GOLIOTH_ERR_NULL - invalid batch handle or path
+/// @return GOLIOTH_ERR_INVALID_FORMAT - path is empty or nested too deep
+/// @return GOLIOTH_ERR_SERIALIZE - record doesn't fit in an empty batch
+/// @return GOLIOTH_ERR_MEM_ALLOC - memory allocation error
+/// @return GOLIOTH_ERR_INVALID_STATE - client is not running, batch dropped
+/// @return GOLIOTH_ERR_QUEUE_FULL - request queue is full, batch dropped
+enum golioth_status golioth_stream_batch_add_int(struct golioth_stream_batch *batch,
+                                                 const char *path,
+                                                 uint64_t timestamp_ms,
+                                                 int32_t value);
+
+/// Add a bool record to a stream batch
+///
+/// Same as @ref golioth_stream_batch_add_int, but for type bool
+enum golioth_status golioth_stream_batch_add_bool(struct golioth_stream_batch *batch,
+                                                  const char *path,
+                                                  uint64_t timestamp_ms,
+                                                  bool value);
+
+/// Add a float record to a stream batch
+///
+/// Same as @ref golioth_stream_batch_add_int, but for type float
+enum golioth_status golioth_stream_batch_add_float(struct golioth_stream_batch *batch,
+                                                   const char *path,
+                                                   uint64_t timestamp_ms,
+                                                   float value);
+
+/// Add a string record to a stream batch
+///
+/// Same as @ref golioth_stream_batch_add_int, but for type string. The string is copied.
+enum golioth_status golioth_stream_batch_add_string(struct golioth_stream_batch *batch,
+                                                    const char *path,
+                                                    uint64_t timestamp_ms,
+                                                    const char *str,
+                                                    size_t str_len);
+
+/// Send the records in a stream batch now
+///
+/// @param batch The batch handle from @ref golioth_stream_batch_create
+///
+/// @return GOLIOTH_OK - request enqueued, or batch was empty
+/// @return GOLIOTH_ERR_NULL - invalid batch handle
+/// @return GOLIOTH_ERR_INVALID_STATE - client is not running, batch dropped
+/// @return GOLIOTH_ERR_QUEUE_FULL - request queue is full, batch dropped
+enum golioth_status golioth_stream_batch_flush(struct golioth_stream_batch *batch);
+
+/// Number of records in a stream batch that have not been sent yet
+///
+/// @param batch The batch handle from @ref golioth_stream_batch_create
+size_t golioth_stream_batch_num_records(struct golioth_stream_batch *batch);
+
 /// @}
@@ -5,14 +5,16 @@
  */
 #include <golioth/golioth_sys.h>
 #include <unistd.h>
-#include <signal.h>
+#include <string.h>
 #include <time.h>
 #include <semaphore.h>
 #include <pthread.h>
 #include <errno.h>
 #include <assert.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 #define TAG "golioth_sys_linux"
 
@@ -115,65 +117,154 @@ int golioth_sys_sem_get_fd(golioth_sys_sem_t sem) {
  * Software Timers
  *------------------------------------------------*/
 
-// Wrap timer_t to also capture user's config
-typedef struct {
-    timer_t timer;
+// Timers are timerfds, waited on by a single timer thread with epoll. Callbacks run in that
+// thread, not in a signal handler, so they may block and take locks like on the other ports.
+
+// Wrap the timerfd to also capture user's config
+typedef struct wrapped_timer {
+    struct wrapped_timer* next;
+    int fd;
     struct golioth_timer_config config;
+    // Set while the timer thread runs the callback
+    bool running;
+    // Destroyed from its own callback, so freed by the timer thread once the callback returns
+    bool destroyed;
 } wrapped_timer_t;
 
-static void on_timer(int sig, siginfo_t* si, void* uc) {
-    wrapped_timer_t* wt = (wrapped_timer_t*)si->si_value.sival_ptr;
-    if (wt->config.fn) {
-        wt->config.fn(wt, wt->config.user_arg);
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static bool timer_thread_started;
+static pthread_t timer_thread_id;
+static int timer_epoll_fd = -1;
+// Protects the timer list and the running and destroyed flags. Not held while callbacks
+// run, so callbacks may create, reset or destroy timers, and take other locks.
+static pthread_mutex_t timer_lock;
+// Signaled when a callback returns, for golioth_sys_timer_destroy()
+static pthread_cond_t timer_done;
+static wrapped_timer_t* timers;
+
+static wrapped_timer_t* find_timer(int fd) {
+    for (wrapped_timer_t* wt = timers; wt; wt = wt->next) {
+        if (wt->fd == fd) {
+            return wt;
+        }
     }
+    return NULL;
 }
 
-golioth_sys_timer_t golioth_sys_timer_create(const struct golioth_timer_config *config) {
-    static bool initialized = false;
-    const int signo = SIGRTMIN;
-
-    if (!initialized) {
-        // Install the signal handler
-        struct sigaction sa = {
-                .sa_flags = SA_SIGINFO,
-                .sa_sigaction = on_timer,
-        };
-        sigemptyset(&sa.sa_mask);
-        if (sigaction(signo, &sa, NULL) < 0) {
-            GLTH_LOGE(TAG, "sigaction errno: %d", errno);
-            return NULL;
+static void* timer_thread(void* arg) {
+    while (true) {
+        struct epoll_event events[8];
+        int n = epoll_wait(timer_epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                GLTH_LOGE(TAG, "timer epoll_wait errno: %d", errno);
+            }
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            pthread_mutex_lock(&timer_lock);
+
+            // Looked up by fd, as the timer may have been destroyed since epoll_wait returned
+            wrapped_timer_t* wt = find_timer(events[i].data.fd);
+            uint64_t expirations;
+
+            // Fails with EAGAIN if the timer was reset since epoll_wait returned
+            if (!wt || read(wt->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                pthread_mutex_unlock(&timer_lock);
+                continue;
+            }
+
+            wt->running = true;
+            pthread_mutex_unlock(&timer_lock);
+
+            if (wt->config.fn) {
+                wt->config.fn(wt, wt->config.user_arg);
+            }
+
+            pthread_mutex_lock(&timer_lock);
+            wt->running = false;
+            bool destroyed = wt->destroyed;
+            pthread_cond_broadcast(&timer_done);
+            pthread_mutex_unlock(&timer_lock);
+
+            if (destroyed) {
+                golioth_sys_free(wt);
+            }
         }
+    }
+
+    return NULL;
+}
+
+static void timer_thread_start(void) {
+    pthread_mutex_init(&timer_lock, NULL);
+    pthread_cond_init(&timer_done, NULL);
+
+    timer_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (timer_epoll_fd < 0) {
+        GLTH_LOGE(TAG, "timer epoll_create1 errno: %d", errno);
+        return;
+    }
+
+    if (pthread_create(&timer_thread_id, NULL, timer_thread, NULL) != 0) {
+        GLTH_LOGE(TAG, "timer pthread_create errno: %d", errno);
+        return;
+    }
+    pthread_detach(timer_thread_id);
+
+    timer_thread_started = true;
+}
+
+static bool timer_settime_ms(wrapped_timer_t* wt, uint32_t expiration_ms) {
+    struct timespec spec = {
+            .tv_sec = expiration_ms / 1000,
+            .tv_nsec = (expiration_ms % 1000) * 1000000,
+    };
+
+    struct itimerspec ispec = {
+            .it_interval = spec,
+            .it_value = spec,
+    };
 
-        initialized = true;
+    return (0 == timerfd_settime(wt->fd, 0, &ispec, NULL));
+}
+
+golioth_sys_timer_t golioth_sys_timer_create(const struct golioth_timer_config *config) {
+    pthread_once(&timer_once, timer_thread_start);
+    if (!timer_thread_started) {
+        return NULL;
     }
 
     // Note: config.name is unused
     wrapped_timer_t* wt = (wrapped_timer_t*)golioth_sys_malloc(sizeof(wrapped_timer_t));
+    if (!wt) {
+        return NULL;
+    }
     memcpy(&wt->config, config, sizeof(wt->config));
-    int err = timer_create(
-            CLOCK_REALTIME,
-            &(struct sigevent){
-                    .sigev_notify = SIGEV_SIGNAL,
-                    .sigev_signo = signo,
-                    .sigev_value.sival_ptr = wt,
-            },
-            &wt->timer);
-    if (err) {
+    wt->running = false;
+    wt->destroyed = false;
+
+    // Created disarmed
+    wt->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (wt->fd < 0) {
         goto error;
     }
 
-    struct itimerspec spec = {
-            .it_interval =
-                    {
-                            .tv_sec = config->expiration_ms / 1000,
-                            .tv_nsec = (config->expiration_ms % 1000) * 1000000,
-                    },
+    struct epoll_event event = {
+            .events = EPOLLIN,
+            .data.fd = wt->fd,
     };
 
-    err = timer_settime(wt->timer, 0, &spec, NULL);
-    if (err) {
+    pthread_mutex_lock(&timer_lock);
+    if (epoll_ctl(timer_epoll_fd, EPOLL_CTL_ADD, wt->fd, &event) < 0) {
+        pthread_mutex_unlock(&timer_lock);
+        close(wt->fd);
         goto error;
     }
+    wt->next = timers;
+    timers = wt;
+    pthread_mutex_unlock(&timer_lock);
 
     return (golioth_sys_timer_t)wt;
 
@@ -186,18 +277,7 @@ error:
 bool golioth_sys_timer_start(golioth_sys_timer_t timer) {
     wrapped_timer_t* wt = (wrapped_timer_t*)timer;
 
-    struct timespec spec = {
-            .tv_sec = wt->config.expiration_ms / 1000,
-            .tv_nsec = (wt->config.expiration_ms % 1000) * 1000000,
-    };
-
-    struct itimerspec ispec = {
-            .it_interval = spec,
-            .it_value = spec,
-    };
-
-    int err = timer_settime(wt->timer, 0, &ispec, NULL);
-    if (err) {
+    if (!timer_settime_ms(wt, wt->config.expiration_ms)) {
         GLTH_LOGE(TAG, "timer_start errno: %d", errno);
         return false;
     }
@@ -206,26 +286,8 @@ bool golioth_sys_timer_start(golioth_sys_timer_t timer) {
 }
 
 bool golioth_sys_timer_reset(golioth_sys_timer_t timer) {
-    wrapped_timer_t* wt = (wrapped_timer_t*)timer;
-
-    struct timespec spec = {
-            .tv_sec = wt->config.expiration_ms / 1000,
-            .tv_nsec = (wt->config.expiration_ms % 1000) * 1000000,
-    };
-
-    struct itimerspec ispec = {
-            .it_interval = spec,
-            // disarm by setting it_value to zero
-    };
-
-
-    int err = timer_settime(wt->timer, 0, &ispec, NULL);
-    if (err) {
-        GLTH_LOGE(TAG, "timer_reset disarm errno: %d", errno);
-        return false;
-    }
-
-    return golioth_sys_timer_start(wt);
+    // Setting the timerfd restarts the period and discards pending expirations
+    return golioth_sys_timer_start(timer);
 }
 
 void golioth_sys_timer_destroy(golioth_sys_timer_t timer) {
@@ -233,7 +295,31 @@ void golioth_sys_timer_destroy(golioth_sys_timer_t timer) {
     if (!wt) {
         return;
     }
-    timer_delete(wt->timer);
+
+    pthread_mutex_lock(&timer_lock);
+    for (wrapped_timer_t** p = &timers; *p; p = &(*p)->next) {
+        if (*p == wt) {
+            *p = wt->next;
+            break;
+        }
+    }
+    epoll_ctl(timer_epoll_fd, EPOLL_CTL_DEL, wt->fd, NULL);
+    close(wt->fd);
+
+    if (wt->running && pthread_equal(pthread_self(), timer_thread_id)) {
+        // Destroyed from its own callback, which is still using it
+        wt->destroyed = true;
+        pthread_mutex_unlock(&timer_lock);
+        return;
+    }
+
+    // Wait for the callback, if it's running, so it's not called after this returns.
+    // Only waits for the callback of this timer, and timer_lock is released while waiting.
+    while (wt->running) {
+        pthread_cond_wait(&timer_done, &timer_lock);
+    }
+    pthread_mutex_unlock(&timer_lock);
+
     golioth_sys_free(wt);
 }
 
@@ -0,0 +1,567 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "callback_executor.h"
+#include <assert.h>
+#include <string.h>
+#include <golioth/golioth_debug.h>
+#include "payload_pool.h"
+
+LOG_TAG_DEFINE(golioth_callback_executor);
+
+/// A queued callback. The path and payload are stored right after it, in the same
+/// payload pool buffer, or heap buffer for a callback that can't be dropped.
+struct golioth_callback_work
+{
+    // Next in the overflow list of the worker
+    struct golioth_callback_work *next;
+    bool from_heap;
+    golioth_coap_request_type_t type;
+    struct golioth_client *client;
+    struct golioth_response response;
+    union
+    {
+        golioth_get_cb_fn get;
+        golioth_get_block_cb_fn get_block;
+        golioth_set_cb_fn set;
+    } callback;
+    void *arg;
+    bool is_last;
+    const char *path;
+    const uint8_t *payload;
+    size_t payload_size;
+};
+
+// Queued by golioth_callback_executor_flush(), never run or freed
+static struct golioth_callback_work flush_request;
+
+// Queued after adding to the overflow list, to wake up a worker waiting for its queue
+static struct golioth_callback_work overflow_wakeup;
+
+// The executor shared by all clients, and the number of references to it
+static struct golioth_callback_executor *_shared_executor;
+static size_t _shared_executor_refs;
+// Protects _shared_executor and _shared_executor_refs. Created by
+// golioth_callback_executor_init().
+static golioth_sys_sem_t _shared_executor_lock;
+
+static void run_work(const struct golioth_callback_work *work)
+{
+    switch (work->type)
+    {
+        case GOLIOTH_COAP_REQUEST_GET:
+        case GOLIOTH_COAP_REQUEST_OBSERVE:
+            work->callback.get(work->client,
+                               &work->response,
+                               work->path,
+                               work->payload,
+                               work->payload_size,
+                               work->arg);
+            break;
+        case GOLIOTH_COAP_REQUEST_GET_BLOCK:
+            work->callback.get_block(work->client,
+                                     &work->response,
+                                     work->path,
+                                     work->payload,
+                                     work->payload_size,
+                                     work->is_last,
+                                     work->arg);
+            break;
+        case GOLIOTH_COAP_REQUEST_POST:
+        case GOLIOTH_COAP_REQUEST_POST_BLOCK:
+        case GOLIOTH_COAP_REQUEST_DELETE:
+            work->callback.set(work->client, &work->response, work->path, work->arg);
+            break;
+        default:
+            break;
+    }
+}
+
+static void free_work(struct golioth_callback_work *work)
+{
+    if (work->from_heap)
+    {
+        golioth_sys_free(work);
+    }
+    else
+    {
+        golioth_payload_pool_free(work);
+    }
+}
+
+static void run_and_free_work(struct golioth_callback_work *work)
+{
+    run_work(work);
+    free_work(work);
+}
+
+// Fill in the callback and its argument from req. Returns false if req has no callback.
+static bool get_callback(struct golioth_callback_work *work, const golioth_coap_request_msg_t *req)
+{
+    switch (req->type)
+    {
+        case GOLIOTH_COAP_REQUEST_GET:
+            work->callback.get = req->get.callback;
+            work->arg = req->get.arg;
+            return (req->get.callback != NULL);
+        case GOLIOTH_COAP_REQUEST_GET_BLOCK:
+            work->callback.get_block = req->get_block.callback;
+            work->arg = req->get_block.arg;
+            return (req->get_block.callback != NULL);
+        case GOLIOTH_COAP_REQUEST_POST:
+            work->callback.set = req->post.callback;
+            work->arg = req->post.arg;
+            return (req->post.callback != NULL);
+        case GOLIOTH_COAP_REQUEST_POST_BLOCK:
+            work->callback.set = req->post_block.callback;
+            work->arg = req->post_block.arg;
+            return (req->post_block.callback != NULL);
+        case GOLIOTH_COAP_REQUEST_DELETE:
+            work->callback.set = req->delete.callback;
+            work->arg = req->delete.arg;
+            return (req->delete.callback != NULL);
+        case GOLIOTH_COAP_REQUEST_OBSERVE:
+            work->callback.get = req->observe.callback;
+            work->arg = req->observe.arg;
+            return (req->observe.callback != NULL);
+        default:
+            return false;
+    }
+}
+
+bool golioth_callback_executor_offloads(golioth_coap_request_class_t request_class)
+{
+    switch (request_class)
+    {
+        case GOLIOTH_COAP_REQUEST_CLASS_RPC:
+            return !CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_RPC;
+        case GOLIOTH_COAP_REQUEST_CLASS_OTA:
+            return !CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_OTA;
+        case GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY:
+            return !CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_TELEMETRY;
+        case GOLIOTH_COAP_REQUEST_CLASS_LOG:
+            return !CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_LOG;
+        default:
+            // Client housekeeping is cheap, and its ordering with the client state matters
+            return false;
+    }
+}
+
+static void overflow_push(struct golioth_callback_worker *worker,
+                          struct golioth_callback_work *work)
+{
+    golioth_sys_sem_take(worker->overflow_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    work->next = NULL;
+    if (worker->overflow_tail)
+    {
+        worker->overflow_tail->next = work;
+    }
+    else
+    {
+        worker->overflow_head = work;
+    }
+    worker->overflow_tail = work;
+    atomic_fetch_add(&worker->overflow_len, 1);
+
+    golioth_sys_sem_give(worker->overflow_lock);
+
+    // The worker may have emptied its queue since it was found full. If the queue is full
+    // again, the worker gets to the overflow list once it is through with it.
+    struct golioth_callback_work *wakeup = &overflow_wakeup;
+    golioth_mbox_try_send(worker->queue, &wakeup);
+}
+
+static struct golioth_callback_work *overflow_pop(struct golioth_callback_worker *worker)
+{
+    if (atomic_load(&worker->overflow_len) == 0)
+    {
+        return NULL;
+    }
+
+    golioth_sys_sem_take(worker->overflow_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    struct golioth_callback_work *work = worker->overflow_head;
+    if (work)
+    {
+        worker->overflow_head = work->next;
+        if (!worker->overflow_head)
+        {
+            worker->overflow_tail = NULL;
+        }
+        atomic_fetch_sub(&worker->overflow_len, 1);
+    }
+
+    golioth_sys_sem_give(worker->overflow_lock);
+
+    return work;
+}
+
+// Copy the callback into a payload pool buffer and queue it. A callback that must not be
+// dropped is copied to the heap if the pool is out of buffers, and goes to the overflow list
+// if the queue is full. Returns false if the callback was dropped.
+static bool queue_work(struct golioth_callback_worker *worker,
+                       const struct golioth_callback_work *work,
+                       const char *path,
+                       const uint8_t *payload,
+                       size_t payload_size,
+                       bool must_deliver)
+{
+    // Queueing while the overflow list is not empty would overtake the callbacks in it
+    if (!must_deliver && atomic_load(&worker->overflow_len) > 0)
+    {
+        return false;
+    }
+
+    size_t path_len = strlen(path);
+    size_t size = sizeof(struct golioth_callback_work) + payload_size + path_len + 1;
+    bool from_heap = false;
+    struct golioth_callback_work *queued = golioth_payload_pool_alloc(size);
+    if (!queued && must_deliver)
+    {
+        queued = golioth_sys_malloc(size);
+        from_heap = true;
+    }
+    if (!queued)
+    {
+        return false;
+    }
+
+    *queued = *work;
+    queued->from_heap = from_heap;
+
+    uint8_t *payload_copy = (uint8_t *) (queued + 1);
+    if (payload_size > 0)
+    {
+        memcpy(payload_copy, payload, payload_size);
+    }
+    queued->payload = payload ? payload_copy : NULL;
+    queued->payload_size = payload_size;
+
+    char *path_copy = (char *) &payload_copy[payload_size];
+    memcpy(path_copy, path, path_len + 1);
+    queued->path = path_copy;
+
+    if (atomic_load(&worker->overflow_len) == 0 && golioth_mbox_try_send(worker->queue, &queued))
+    {
+        return true;
+    }
+
+    if (!must_deliver)
+    {
+        free_work(queued);
+        return false;
+    }
+
+    overflow_push(worker, queued);
+
+    return true;
+}
+
+// Get the next callback of a worker: from its queue, which only holds callbacks queued
+// before the ones in the overflow list, then from the overflow list. Returns false on
+// timeout.
+static bool next_work(struct golioth_callback_worker *worker,
+                      struct golioth_callback_work **work,
+                      int32_t timeout_ms)
+{
+    do
+    {
+        if (!golioth_mbox_recv(worker->queue, work, 0))
+        {
+            *work = overflow_pop(worker);
+            if (*work)
+            {
+                return true;
+            }
+
+            if (!golioth_mbox_recv(worker->queue, work, timeout_ms))
+            {
+                return false;
+            }
+        }
+    } while (*work == &overflow_wakeup);
+
+    return true;
+}
+
+// Queue a flush or stop request behind all callbacks of the worker, waiting for room
+static void queue_control(struct golioth_callback_worker *worker,
+                          struct golioth_callback_work *request)
+{
+    while (atomic_load(&worker->overflow_len) > 0
+           || !golioth_mbox_try_send(worker->queue, &request))
+    {
+        golioth_sys_msleep(10);
+    }
+}
+
+bool golioth_callback_executor_call(struct golioth_callback_executor *executor,
+                                    struct golioth_client *client,
+                                    const golioth_coap_request_msg_t *req,
+                                    const struct golioth_response *response,
+                                    const uint8_t *payload,
+                                    size_t payload_size,
+                                    bool is_last)
+{
+    struct golioth_callback_work work = {
+        .type = req->type,
+        .client = client,
+        .response = *response,
+        .is_last = is_last,
+        .path = req->path,
+        .payload = payload,
+        .payload_size = payload_size,
+    };
+
+    if (!get_callback(&work, req))
+    {
+        return true;
+    }
+
+    if (executor && !req->request_complete
+        && golioth_callback_executor_offloads(req->request_class))
+    {
+        // Completions come once per request, notifications at the pace of the server
+        bool must_deliver = (req->type != GOLIOTH_COAP_REQUEST_OBSERVE);
+        size_t index = req->request_class % CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS;
+        if (queue_work(&executor->workers[index],
+                       &work,
+                       req->path,
+                       payload,
+                       payload_size,
+                       must_deliver))
+        {
+            return true;
+        }
+
+        // Calling it here would overtake the callbacks already queued for the class
+        GLTH_LOGW(TAG,
+                  "%s, dropping callback for path %s",
+                  must_deliver ? "Out of memory" : "Callback queue full",
+                  req->path);
+        return false;
+    }
+
+    run_work(&work);
+
+    return true;
+}
+
+bool golioth_callback_executor_run_one(struct golioth_callback_worker *worker,
+                                       int32_t timeout_ms)
+{
+    struct golioth_callback_work *work;
+    do
+    {
+        if (!next_work(worker, &work, timeout_ms) || !work)
+        {
+            return false;
+        }
+
+        if (work == &flush_request)
+        {
+            golioth_sys_sem_give(worker->executor->flushed_sem);
+        }
+    } while (work == &flush_request);
+
+    run_and_free_work(work);
+
+    return true;
+}
+
+static void worker_thread(void *arg)
+{
+    struct golioth_callback_worker *worker = arg;
+
+    while (true)
+    {
+        struct golioth_callback_work *work;
+        if (!next_work(worker, &work, GOLIOTH_SYS_WAIT_FOREVER))
+        {
+            continue;
+        }
+
+        if (!work)
+        {
+            break;
+        }
+
+        if (work == &flush_request)
+        {
+            golioth_sys_sem_give(worker->executor->flushed_sem);
+            continue;
+        }
+
+        run_and_free_work(work);
+    }
+
+    golioth_sys_sem_give(worker->executor->stopped_sem);
+
+    // Threads are not allowed to return on all ports. Wait here to be destroyed.
+    while (true)
+    {
+        golioth_sys_msleep(1000);
+    }
+}
+
+struct golioth_callback_executor *golioth_callback_executor_create(void)
+{
+    struct golioth_callback_executor *executor = golioth_sys_malloc(sizeof(*executor));
+    if (!executor)
+    {
+        return NULL;
+    }
+    memset(executor, 0, sizeof(*executor));
+
+    executor->stopped_sem = golioth_sys_sem_create(CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS, 0);
+    executor->flushed_sem = golioth_sys_sem_create(CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS, 0);
+    if (!executor->stopped_sem || !executor->flushed_sem)
+    {
+        golioth_callback_executor_destroy(executor);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS; i++)
+    {
+        struct golioth_callback_worker *worker = &executor->workers[i];
+
+        worker->executor = executor;
+        worker->overflow_lock = golioth_sys_sem_create(1, 1);
+        worker->queue = golioth_mbox_create(CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE,
+                                            sizeof(struct golioth_callback_work *));
+        if (!worker->overflow_lock || !worker->queue)
+        {
+            GLTH_LOGE(TAG, "Failed to create callback queue");
+            golioth_callback_executor_destroy(executor);
+            return NULL;
+        }
+
+        struct golioth_thread_config thread_cfg = {
+            .name = "golioth_cb",
+            .fn = worker_thread,
+            .user_arg = worker,
+            .stack_size = CONFIG_GOLIOTH_CALLBACK_EXECUTOR_THREAD_STACK_SIZE,
+            .prio = CONFIG_GOLIOTH_CALLBACK_EXECUTOR_THREAD_PRIORITY,
+        };
+
+        worker->thread = golioth_sys_thread_create(&thread_cfg);
+        if (!worker->thread)
+        {
+            GLTH_LOGE(TAG, "Failed to create callback thread");
+            golioth_callback_executor_destroy(executor);
+            return NULL;
+        }
+    }
+
+    return executor;
+}
+
+void golioth_callback_executor_destroy(struct golioth_callback_executor *executor)
+{
+    if (!executor)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS; i++)
+    {
+        struct golioth_callback_worker *worker = &executor->workers[i];
+
+        if (worker->thread)
+        {
+            // The worker runs the callbacks queued before the stop request, making room
+            // for it if the queue is full
+            queue_control(worker, NULL);
+
+            golioth_sys_sem_take(executor->stopped_sem, GOLIOTH_SYS_WAIT_FOREVER);
+            golioth_sys_thread_destroy(worker->thread);
+        }
+
+        if (worker->queue)
+        {
+            golioth_mbox_destroy(worker->queue);
+        }
+        if (worker->overflow_lock)
+        {
+            golioth_sys_sem_destroy(worker->overflow_lock);
+        }
+    }
+
+    if (executor->stopped_sem)
+    {
+        golioth_sys_sem_destroy(executor->stopped_sem);
+    }
+    if (executor->flushed_sem)
+    {
+        golioth_sys_sem_destroy(executor->flushed_sem);
+    }
+    golioth_sys_free(executor);
+}
+
+void golioth_callback_executor_flush(struct golioth_callback_executor *executor)
+{
+    for (size_t i = 0; i < CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS; i++)
+    {
+        struct golioth_callback_worker *worker = &executor->workers[i];
+
+        // Queued behind the callbacks to wait for, making room for it if the queue is full
+        queue_control(worker, &flush_request);
+    }
+
+    for (size_t i = 0; i < CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS; i++)
+    {
+        golioth_sys_sem_take(executor->flushed_sem, GOLIOTH_SYS_WAIT_FOREVER);
+    }
+}
+
+void golioth_callback_executor_init(void)
+{
+    _shared_executor_lock = golioth_sys_sem_create(1, 1);
+}
+
+struct golioth_callback_executor *golioth_callback_executor_get(void)
+{
+    golioth_sys_sem_take(_shared_executor_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    if (!_shared_executor)
+    {
+        _shared_executor = golioth_callback_executor_create();
+    }
+    if (_shared_executor)
+    {
+        _shared_executor_refs++;
+    }
+    struct golioth_callback_executor *executor = _shared_executor;
+
+    golioth_sys_sem_give(_shared_executor_lock);
+
+    return executor;
+}
+
+void golioth_callback_executor_put(struct golioth_callback_executor *executor)
+{
+    if (!executor)
+    {
+        return;
+    }
+
+    golioth_sys_sem_take(_shared_executor_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    assert(executor == _shared_executor && _shared_executor_refs > 0);
+
+    if (--_shared_executor_refs == 0)
+    {
+        // Runs the queued callbacks before stopping
+        golioth_callback_executor_destroy(executor);
+        _shared_executor = NULL;
+    }
+    else
+    {
+        golioth_callback_executor_flush(executor);
+    }
+
+    golioth_sys_sem_give(_shared_executor_lock);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <golioth/client.h>
+#include <golioth/config.h>
+#include <golioth/golioth_sys.h>
+#include "coap_client.h"
+#include "mbox.h"
+
+/// Executor for response and observation callbacks.
+///
+/// Without an executor, callbacks run on the CoAP thread, so a slow callback
+/// (an RPC handler writing to flash, a settings callback talking to a sensor)
+/// holds up all network I/O, retransmissions and keepalives.
+///
+/// The executor has CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS worker
+/// threads, each with its own bounded queue. Callbacks of requests in an
+/// offloaded class (all but those turned off with
+/// CONFIG_GOLIOTH_CALLBACK_EXECUTOR_INLINE_*) are
+/// queued to a worker, together with copies of the response, path and
+/// payload in a payload pool buffer. Each request class always goes to the
+/// same worker, so callbacks within a class run in order.
+///
+/// One executor is shared by all clients, see golioth_callback_executor_get(),
+/// so the number of threads doesn't grow with the number of clients.
+///
+/// Callbacks of synchronous requests always run on the CoAP thread, as the
+/// requesting thread waits for them to finish.
+///
+/// Callbacks that complete a request (and the block callbacks of a download)
+/// are never dropped. If a worker queue is full, or there is no payload pool
+/// buffer for the copies, they wait in the worker's overflow list, in a heap
+/// buffer if need be, and the worker runs them after the queue. Waiting for
+/// room on the CoAP thread instead could deadlock with a callback that makes a
+/// request, and running them there would overtake the callbacks already queued
+/// for their class. The overflow list is bounded by the requests the
+/// application has made, as each request completes once.
+///
+/// Observation notifications are dropped if the queue is full, or while the
+/// overflow list is not empty, as the server sends them at its own pace.
+
+struct golioth_callback_work;
+
+struct golioth_callback_worker
+{
+    struct golioth_callback_executor *executor;
+    // Pointers to struct golioth_callback_work, NULL asks the worker to stop
+    golioth_mbox_t queue;
+    // Callbacks that didn't fit in the queue, run after it. Protected by overflow_lock.
+    struct golioth_callback_work *overflow_head;
+    struct golioth_callback_work *overflow_tail;
+    // Length of the overflow list, read without the lock to skip it when empty
+    atomic_size_t overflow_len;
+    golioth_sys_sem_t overflow_lock;
+    golioth_sys_thread_t thread;
+};
+
+struct golioth_callback_executor
+{
+    struct golioth_callback_worker workers[CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS];
+    // Given by each worker when it stops
+    golioth_sys_sem_t stopped_sem;
+    // Given by each worker when it gets to a flush request
+    golioth_sys_sem_t flushed_sem;
+};
+
+/// Create an executor and start its worker threads. Returns NULL if out of resources.
+struct golioth_callback_executor *golioth_callback_executor_create(void);
+
+/// Stop the worker threads, after they have run the callbacks that are already queued,
+/// and free the executor. executor can be NULL.
+void golioth_callback_executor_destroy(struct golioth_callback_executor *executor);
+
+/// Wait until the worker threads have run the callbacks that are already queued
+void golioth_callback_executor_flush(struct golioth_callback_executor *executor);
+
+/// Initialize the state of the shared executor. Must be called once, before the first
+/// golioth_callback_executor_get().
+void golioth_callback_executor_init(void);
+
+/// Get a reference to the executor shared by all clients, creating it and starting its
+/// worker threads if there is none yet. Returns NULL if out of resources.
+struct golioth_callback_executor *golioth_callback_executor_get(void);
+
+/// Drop a reference to the shared executor, once the caller queues no more callbacks.
+///
+/// Waits until the callbacks queued so far have run, so none of them runs after this
+/// returns. Dropping the last reference stops the worker threads and frees the executor.
+/// executor can be NULL.
+void golioth_callback_executor_put(struct golioth_callback_executor *executor);
+
+/// Whether callbacks of asynchronous requests in request_class are offloaded
+bool golioth_callback_executor_offloads(golioth_coap_request_class_t request_class);
+
+/// Call the callback of req, if it has one, with response and the payload of the response
+/// (for GET, GET_BLOCK and OBSERVE requests) and is_last (for GET_BLOCK requests).
+///
+/// The callback is queued to a worker thread if executor is not NULL, the request is
+/// asynchronous and its class is offloaded. Otherwise, it is called before this returns.
+///
+/// Returns false if the callback was dropped: an observation notification that couldn't be
+/// queued, or a callback that couldn't be copied, as even the heap was out of memory.
+bool golioth_callback_executor_call(struct golioth_callback_executor *executor,
+                                    struct golioth_client *client,
+                                    const golioth_coap_request_msg_t *req,
+                                    const struct golioth_response *response,
+                                    const uint8_t *payload,
+                                    size_t payload_size,
+                                    bool is_last);
+
+/// Run the next callback queued to a worker, from its queue or then its overflow list,
+/// waiting up to timeout_ms for one. Returns false on timeout, or if the worker was asked to
+/// stop. Flush requests are answered without counting as a callback. This is the loop body
+/// of the worker threads.
+bool golioth_callback_executor_run_one(struct golioth_callback_worker *worker,
+                                       int32_t timeout_ms);
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "client_stats.h"
+
+void golioth_latency_histogram_add(struct golioth_latency_histogram *hist, uint64_t latency_ms)
+{
+    uint32_t ms = (latency_ms > UINT32_MAX) ? UINT32_MAX : (uint32_t) latency_ms;
+
+    // Bucket i holds [2^(i-1), 2^i), which is the bit length of ms
+    size_t bucket = 0;
+    while (bucket < GOLIOTH_LATENCY_HISTOGRAM_NUM_BUCKETS - 1 && (ms >> bucket) != 0)
+    {
+        bucket++;
+    }
+
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum_ms += ms;
+    if (ms > hist->max_ms)
+    {
+        hist->max_ms = ms;
+    }
+}
+
+static struct golioth_client_request_stats *request_stats(struct golioth_client_stats *stats,
+                                                          golioth_coap_request_type_t type)
+{
+    switch (type)
+    {
+        case GOLIOTH_COAP_REQUEST_EMPTY:
+            return &stats->requests[GOLIOTH_CLIENT_STATS_REQUEST_EMPTY];
+        case GOLIOTH_COAP_REQUEST_GET:
+            return &stats->requests[GOLIOTH_CLIENT_STATS_REQUEST_GET];
+        case GOLIOTH_COAP_REQUEST_GET_BLOCK:
+            return &stats->requests[GOLIOTH_CLIENT_STATS_REQUEST_GET_BLOCK];
+        case GOLIOTH_COAP_REQUEST_POST:
+            return &stats->requests[GOLIOTH_CLIENT_STATS_REQUEST_POST];
+        case GOLIOTH_COAP_REQUEST_POST_BLOCK:
+            return &stats->requests[GOLIOTH_CLIENT_STATS_REQUEST_POST_BLOCK];
+        case GOLIOTH_COAP_REQUEST_DELETE:
+            return &stats->requests[GOLIOTH_CLIENT_STATS_REQUEST_DELETE];
+        case GOLIOTH_COAP_REQUEST_OBSERVE:
+            return &stats->requests[GOLIOTH_CLIENT_STATS_REQUEST_OBSERVE];
+        default:
+            return NULL;
+    }
+}
+
+void golioth_client_stats_request_sent(struct golioth_client_stats *stats,
+                                       const golioth_coap_request_msg_t *req,
+                                       uint64_t now_ms)
+{
+    struct golioth_client_request_stats *rs = request_stats(stats, req->type);
+    if (rs && now_ms >= req->enqueued_ms)
+    {
+        golioth_latency_histogram_add(&rs->queue_latency, now_ms - req->enqueued_ms);
+    }
+}
+
+void golioth_client_stats_response_received(struct golioth_client_stats *stats,
+                                            golioth_coap_request_type_t type,
+                                            uint64_t sent_ms,
+                                            uint64_t now_ms)
+{
+    struct golioth_client_request_stats *rs = request_stats(stats, type);
+    if (rs && now_ms >= sent_ms)
+    {
+        golioth_latency_histogram_add(&rs->response_latency, now_ms - sent_ms);
+    }
+}
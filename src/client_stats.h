@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <golioth/client.h>
+#include "coap_client.h"
+
+/*
+ * Runtime statistics of a client, see golioth_client_get_stats().
+ *
+ * Not thread safe. Each client has one struct golioth_client_stats, which is only updated by
+ * the thread running the client. The request queue counters, which are updated by the
+ * threads queueing requests, are kept as atomics in the client instead.
+ */
+
+/// Add a sample to a latency histogram
+void golioth_latency_histogram_add(struct golioth_latency_histogram *hist, uint64_t latency_ms);
+
+/// Record that req, taken from the request queue, was sent at now_ms
+void golioth_client_stats_request_sent(struct golioth_client_stats *stats,
+                                       const golioth_coap_request_msg_t *req,
+                                       uint64_t now_ms);
+
+/// Record that the response to a request of type type, sent at sent_ms, arrived at now_ms
+void golioth_client_stats_response_received(struct golioth_client_stats *stats,
+                                            golioth_coap_request_type_t type,
+                                            uint64_t sent_ms,
+                                            uint64_t now_ms);
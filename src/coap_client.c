@@ -7,6 +7,11 @@
 #include <assert.h>
 #include <string.h>
 #include <golioth/golioth_debug.h>
+#include "callback_executor.h"
+#include "golioth_util.h"
+#include "path_handle.h"
+#include "payload_pool.h"
+#include "warm_cache.h"
 
 #ifdef __ZEPHYR__
 #include "coap_client_zephyr.h"
@@ -16,20 +21,353 @@
 
 LOG_TAG_DEFINE(golioth_coap_client);
 
+// Size of the part of golioth_coap_request_msg_t that is passed through the request queue
+#define REQUEST_MSG_QUEUED_SIZE offsetof(golioth_coap_request_msg_t, path)
+
+struct request_class_config
+{
+    // Share of the CoAP thread when all classes have requests queued, relative to the others
+    uint8_t weight;
+    // Percentage of the request queue (items and buffer) set aside for the class
+    uint8_t queue_share;
+};
+
+static const struct request_class_config request_classes[GOLIOTH_COAP_REQUEST_CLASS_COUNT] = {
+    [GOLIOTH_COAP_REQUEST_CLASS_CONTROL] = {.weight = 8, .queue_share = 15},
+    [GOLIOTH_COAP_REQUEST_CLASS_RPC] = {.weight = 4, .queue_share = 15},
+    [GOLIOTH_COAP_REQUEST_CLASS_OTA] = {.weight = 2, .queue_share = 15},
+    [GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY] = {.weight = 2, .queue_share = 35},
+    [GOLIOTH_COAP_REQUEST_CLASS_LOG] = {.weight = 1, .queue_share = 20},
+};
+
+static size_t request_class_buffer_size(golioth_coap_request_class_t request_class)
+{
+    return CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_BUFFER_SIZE
+        * request_classes[request_class].queue_share / 100;
+}
+
+static size_t request_class_max_num_items(golioth_coap_request_class_t request_class)
+{
+    size_t share = request_classes[request_class].queue_share;
+    return max((CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS * share + 99) / 100, 1);
+}
+
+// Payloads up to this size are stored in the request queue, right after the request
+static size_t request_queue_inline_payload_max(golioth_coap_request_class_t request_class)
+{
+    return request_class_buffer_size(request_class) / 4;
+}
+
+#if CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS > 0
+
+struct coalesced_callback
+{
+    golioth_set_cb_fn callback;
+    void *arg;
+    struct coalesced_callback *next;
+};
+
+// A set request in the request queue, which later sets to the same path are merged into
+struct golioth_coalesce_slot
+{
+    bool in_use;
+    struct golioth_client *client;
+    const char *path_prefix;
+    char path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+    enum golioth_content_type content_type;
+    const uint8_t *payload;
+    size_t payload_size;
+    golioth_payload_release_fn release;
+    void *release_arg;
+    golioth_set_cb_fn callback;
+    void *callback_arg;
+    // Callbacks of the sets that were replaced, oldest first
+    struct coalesced_callback *replaced;
+    struct coalesced_callback *replaced_tail;
+};
+
+static struct golioth_coalesce_slot
+    _coalesce_slots[CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS];
+
+// Protects _coalesce_slots. Created by golioth_coap_request_queue_init().
+static golioth_sys_sem_t _coalesce_lock;
+
+static struct golioth_coalesce_slot *coalesce_slot_find(struct golioth_client *client,
+                                                        const char *path_prefix,
+                                                        const char *path)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(_coalesce_slots); i++)
+    {
+        struct golioth_coalesce_slot *slot = &_coalesce_slots[i];
+        if (slot->in_use && slot->client == client && slot->path_prefix == path_prefix
+            && strcmp(slot->path, path) == 0)
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static struct golioth_coalesce_slot *coalesce_slot_alloc(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(_coalesce_slots); i++)
+    {
+        if (!_coalesce_slots[i].in_use)
+        {
+            return &_coalesce_slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Move the latest payload and callback of a coalesced set into the request, and tell the
+// replaced sets that they were coalesced. Their callbacks go through the callback executor,
+// like the response callbacks of the request.
+static void coalesce_slot_take(golioth_coap_request_msg_t *req)
+{
+    struct golioth_coalesce_slot *slot = req->post.coalesce;
+
+    golioth_sys_sem_take(_coalesce_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    struct golioth_client *client = slot->client;
+    struct coalesced_callback *replaced = slot->replaced;
+    golioth_set_cb_fn callback = slot->callback;
+    void *callback_arg = slot->callback_arg;
+
+    req->post.content_type = slot->content_type;
+    req->post.payload = slot->payload;
+    req->post.payload_size = slot->payload_size;
+    req->post.release = slot->release;
+    req->post.release_arg = slot->release_arg;
+    req->post.coalesce = NULL;
+
+    memset(slot, 0, sizeof(*slot));
+
+    golioth_sys_sem_give(_coalesce_lock);
+
+    struct golioth_response response = {
+        .status = GOLIOTH_ERR_COALESCED,
+    };
+
+    while (replaced)
+    {
+        struct coalesced_callback *next = replaced->next;
+        req->post.callback = replaced->callback;
+        req->post.arg = replaced->arg;
+        if (!golioth_callback_executor_call(client->callback_executor,
+                                            client,
+                                            req,
+                                            &response,
+                                            NULL,
+                                            0,
+                                            false))
+        {
+            client->stats.drops.callback++;
+        }
+        golioth_payload_pool_free(replaced);
+        replaced = next;
+    }
+
+    req->post.callback = callback;
+    req->post.arg = callback_arg;
+}
+
+#endif  // CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS > 0
+
+void golioth_coap_request_queue_init(void)
+{
+#if CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS > 0
+    _coalesce_lock = golioth_sys_sem_create(1, 1);
+#endif
+}
+
+golioth_mbox_t golioth_coap_request_queue_create(void)
+{
+    struct golioth_mbox_lane_config lanes[GOLIOTH_COAP_REQUEST_CLASS_COUNT];
+
+    for (size_t i = 0; i < GOLIOTH_COAP_REQUEST_CLASS_COUNT; i++)
+    {
+        lanes[i] = (struct golioth_mbox_lane_config){
+            .max_num_items = request_class_max_num_items(i),
+            .buffer_size = request_class_buffer_size(i),
+            .weight = request_classes[i].weight,
+        };
+    }
+
+    return golioth_mbox_create_varlen(CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS,
+                                      lanes,
+                                      ARRAY_SIZE(lanes));
+}
+
 static void purge_request_mbox(golioth_mbox_t request_mbox)
 {
-    golioth_coap_request_msg_t request_msg = {};
-    size_t num_messages = golioth_mbox_num_messages(request_mbox);
+    golioth_coap_request_msg_t request_msg;
+
+    while (golioth_coap_request_queue_recv(request_mbox, &request_msg, 0))
+    {
+        golioth_coap_request_msg_release_payload(&request_msg);
+        golioth_completion_signal(request_msg.request_complete, RESPONSE_TIMEOUT_EVENT_BIT);
+        golioth_coap_request_queue_release(request_mbox);
+    }
+}
+
+// Raise the queue high-water mark to num_items, unless it is higher already
+static void update_queue_high_water_mark(struct golioth_client *client, uint32_t num_items)
+{
+    uint_fast32_t mark = atomic_load_explicit(&client->queue_high_water_mark,
+                                              memory_order_relaxed);
+
+    while (num_items > mark
+           && !atomic_compare_exchange_weak_explicit(&client->queue_high_water_mark,
+                                                     &mark,
+                                                     num_items,
+                                                     memory_order_relaxed,
+                                                     memory_order_relaxed))
+    {
+    }
+}
+
+static bool request_queue_send(struct golioth_client *client,
+                               golioth_coap_request_msg_t *req,
+                               const uint8_t *inline_payload,
+                               size_t inline_payload_size)
+{
+    req->enqueued_ms = golioth_sys_now_ms();
+
+    struct golioth_mbox_part parts[] = {
+        {req, REQUEST_MSG_QUEUED_SIZE},
+        {req->path, strlen(req->path) + 1},
+        {inline_payload, inline_payload_size},
+    };
+
+    if (!golioth_mbox_try_send_parts(client->request_queue,
+                                     req->request_class,
+                                     parts,
+                                     ARRAY_SIZE(parts)))
+    {
+        atomic_fetch_add_explicit(&client->num_queue_full, 1, memory_order_relaxed);
+        return false;
+    }
 
-    for (size_t i = 0; i < num_messages; i++)
+    update_queue_high_water_mark(client, golioth_mbox_num_messages(client->request_queue));
+
+    return true;
+}
+
+// Queue a request and, if is_synchronous, wait for the CoAP thread to complete it
+static enum golioth_status request_queue_send_and_wait(struct golioth_client *client,
+                                                       golioth_coap_request_msg_t *req,
+                                                       const uint8_t *inline_payload,
+                                                       size_t inline_payload_size,
+                                                       bool is_synchronous,
+                                                       int32_t timeout_s)
+{
+    if (is_synchronous)
     {
-        assert(golioth_mbox_recv(request_mbox, &request_msg, 0));
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_POST)
+        // Returned to the pool by the coap thread, or when waiting below
+        req->request_complete = golioth_completion_acquire();
+        if (!req->request_complete)
         {
-            // free dynamically allocated user payload copy
-            golioth_sys_free(request_msg.post.payload);
+            return GOLIOTH_ERR_MEM_ALLOC;
         }
     }
+
+    if (!request_queue_send(client, req, inline_payload, inline_payload_size))
+    {
+        if (is_synchronous)
+        {
+            golioth_completion_release(req->request_complete);
+        }
+        return GOLIOTH_ERR_QUEUE_FULL;
+    }
+
+    if (!is_synchronous)
+    {
+        return GOLIOTH_OK;
+    }
+
+    int32_t tmo_ms = timeout_s * 1000;
+    if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
+    {
+        tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
+    }
+
+    uint32_t bits = golioth_completion_wait(req->request_complete, tmo_ms);
+    if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
+    {
+        return GOLIOTH_ERR_TIMEOUT;
+    }
+    if (bits & RESPONSE_ERROR_EVENT_BIT)
+    {
+        return GOLIOTH_ERR_FAIL;
+    }
+
+    return GOLIOTH_OK;
+}
+
+// Inline payloads are freed together with the queued request
+static void release_inline_payload(const uint8_t *payload, size_t payload_size, void *arg) {}
+
+bool golioth_coap_request_queue_recv(golioth_mbox_t request_queue,
+                                     golioth_coap_request_msg_t *req,
+                                     int32_t timeout_ms)
+{
+    size_t len;
+    const uint8_t *msg = golioth_mbox_peek(request_queue, &len, timeout_ms);
+    if (!msg)
+    {
+        return false;
+    }
+
+    memset(req, 0, sizeof(*req));
+    memcpy(req, msg, REQUEST_MSG_QUEUED_SIZE);
+
+    const char *path = (const char *) &msg[REQUEST_MSG_QUEUED_SIZE];
+    size_t path_size = strlen(path) + 1;
+    assert(path_size <= sizeof(req->path));
+    memcpy(req->path, path, path_size);
+
+    size_t inline_payload_size = len - REQUEST_MSG_QUEUED_SIZE - path_size;
+    if (inline_payload_size > 0)
+    {
+        assert(req->type == GOLIOTH_COAP_REQUEST_POST);
+        req->post.payload = &msg[REQUEST_MSG_QUEUED_SIZE + path_size];
+        req->post.release = release_inline_payload;
+    }
+
+#if CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS > 0
+    if (req->type == GOLIOTH_COAP_REQUEST_POST && req->post.coalesce)
+    {
+        coalesce_slot_take(req);
+    }
+#endif
+
+    return true;
+}
+
+void golioth_coap_request_queue_release(golioth_mbox_t request_queue)
+{
+    golioth_mbox_release(request_queue);
+}
+
+void golioth_coap_request_msg_release_payload(golioth_coap_request_msg_t *req)
+{
+    if (req->type != GOLIOTH_COAP_REQUEST_POST)
+    {
+        return;
+    }
+
+    if (req->post.release)
+    {
+        req->post.release(req->post.payload, req->post.payload_size, req->post.release_arg);
+    }
+    else
+    {
+        golioth_payload_pool_free((void *) req->post.payload);
+    }
+    req->post.payload = NULL;
 }
 
 enum golioth_status golioth_client_start(struct golioth_client *client)
@@ -39,6 +377,10 @@ enum golioth_status golioth_client_start(struct golioth_client *client)
         return GOLIOTH_ERR_NULL;
     }
     golioth_sys_sem_give(client->run_sem);
+#ifndef __ZEPHYR__
+    atomic_store(&client->run_requested, true);
+    golioth_coap_client_wake(client);
+#endif
     return GOLIOTH_OK;
 }
 
@@ -51,11 +393,16 @@ enum golioth_status golioth_client_stop(struct golioth_client *client)
 
     GLTH_LOGI(TAG, "Attempting to stop client");
     golioth_sys_sem_take(client->run_sem, GOLIOTH_SYS_WAIT_FOREVER);
+#ifndef __ZEPHYR__
+    atomic_store(&client->run_requested, false);
+    golioth_coap_client_wake(client);
+#endif
 
-    // Wait for client to be fully stopped
+    // Wait for client to be fully stopped. stopped_sem may still hold a give from an earlier
+    // stop, so check again after each wake up.
     while (golioth_client_is_running(client))
     {
-        golioth_sys_msleep(100);
+        golioth_sys_sem_take(client->stopped_sem, GOLIOTH_SYS_WAIT_FOREVER);
     }
 
     return GOLIOTH_OK;
@@ -71,19 +418,35 @@ void golioth_client_destroy(struct golioth_client *client)
     {
         golioth_sys_timer_destroy(client->keepalive_timer);
     }
+#ifndef __ZEPHYR__
+    golioth_coap_client_leave_event_loop(client);
+#endif
     if (client->coap_thread_handle)
     {
         golioth_sys_thread_destroy(client->coap_thread_handle);
     }
+#ifndef __ZEPHYR__
+    golioth_coap_client_cancel_resolve(client);
+#endif
     if (client->request_queue)
     {
+        // Queues the callbacks of coalesced sets
         purge_request_mbox(client->request_queue);
         golioth_mbox_destroy(client->request_queue);
     }
+    // After the CoAP thread and the purge, which queue callbacks
+    golioth_callback_executor_put(client->callback_executor);
     if (client->run_sem)
     {
         golioth_sys_sem_destroy(client->run_sem);
     }
+    if (client->stopped_sem)
+    {
+        golioth_sys_sem_destroy(client->stopped_sem);
+    }
+#ifndef __ZEPHYR__
+    golioth_coap_client_free_observations(client);
+#endif
     golioth_sys_free(client);
 }
 
@@ -119,53 +482,150 @@ enum golioth_status golioth_coap_client_empty(struct golioth_client *client,
 
     golioth_coap_request_msg_t request_msg = {
         .type = GOLIOTH_COAP_REQUEST_EMPTY,
+        .request_class = GOLIOTH_COAP_REQUEST_CLASS_CONTROL,
         .ageout_ms = ageout_ms,
     };
 
-    if (is_synchronous)
+    enum golioth_status status = request_queue_send_and_wait(client,
+                                                             &request_msg,
+                                                             NULL,
+                                                             0,
+                                                             is_synchronous,
+                                                             timeout_s);
+    if (status == GOLIOTH_ERR_QUEUE_FULL)
     {
-        // Created here, deleted by coap thread (or here if fail to enqueue
-        request_msg.request_complete_event = golioth_event_group_create();
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
+        GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
     }
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    return status;
+}
+
+// If payload_inline is set, the payload is copied into the request queue, and release is ignored
+static enum golioth_status coap_client_post(struct golioth_client *client,
+                                            golioth_coap_request_class_t request_class,
+                                            const char *path_prefix,
+                                            const char *path,
+                                            const struct golioth_path *path_handle,
+                                            enum golioth_delivery_mode delivery_mode,
+                                            enum golioth_content_type content_type,
+                                            const uint8_t *payload,
+                                            size_t payload_size,
+                                            bool payload_inline,
+                                            golioth_payload_release_fn release,
+                                            void *release_arg,
+                                            golioth_set_cb_fn callback,
+                                            void *callback_arg,
+                                            bool is_synchronous,
+                                            int32_t timeout_s)
+{
+    uint64_t ageout_ms = GOLIOTH_SYS_WAIT_FOREVER;
+    if (timeout_s != GOLIOTH_SYS_WAIT_FOREVER)
     {
-        GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
-        if (is_synchronous)
-        {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
-        }
-        return GOLIOTH_ERR_QUEUE_FULL;
+        ageout_ms = golioth_sys_now_ms() + (1000 * timeout_s);
     }
 
-    if (is_synchronous)
+    golioth_coap_request_msg_t request_msg = {
+        .type = GOLIOTH_COAP_REQUEST_POST,
+        .request_class = request_class,
+        .path_prefix = path_prefix,
+        .path_handle = path_handle,
+        .post =
+            {
+                .content_type = content_type,
+                .payload = payload_inline ? NULL : payload,
+                .payload_size = payload_size,
+                .release = release,
+                .release_arg = release_arg,
+                .callback = callback,
+                .arg = callback_arg,
+                .delivery_mode = delivery_mode,
+            },
+        .ageout_ms = ageout_ms,
+    };
+    if (!path_handle)
     {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
+        strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
+    }
 
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
+    enum golioth_status status = request_queue_send_and_wait(client,
+                                                             &request_msg,
+                                                             payload_inline ? payload : NULL,
+                                                             payload_inline ? payload_size : 0,
+                                                             is_synchronous,
+                                                             timeout_s);
+    if (status == GOLIOTH_ERR_QUEUE_FULL)
+    {
+        /* NOTE: Logging a message here when cloud logging is enabled can cause
+         *       a loop where the logging thread attempts to enqueue a message,
+         *       the mbox is full, so coap_client writes a log, which the
+         *       logging thread attempts to send to the cloud, and so on.
+         */
+    }
+
+    return status;
+}
 
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
+static enum golioth_status coap_client_set_copy(struct golioth_client *client,
+                                                golioth_coap_request_class_t request_class,
+                                                const char *path_prefix,
+                                                const char *path,
+                                                const struct golioth_path *path_handle,
+                                                enum golioth_delivery_mode delivery_mode,
+                                                enum golioth_content_type content_type,
+                                                const uint8_t *payload,
+                                                size_t payload_size,
+                                                golioth_set_cb_fn callback,
+                                                void *callback_arg,
+                                                bool is_synchronous,
+                                                int32_t timeout_s)
+{
+    uint8_t *request_payload = NULL;
+
+    // We will copy the payload to avoid payload lifetime and thread-safety issues.
+    //
+    // Small payloads are copied into the request queue. Larger ones are copied
+    // to memory which will be free'd by the CoAP thread after handling the request,
+    // or in this function if we fail to enqueue the request.
+    bool payload_inline = (payload_size <= request_queue_inline_payload_max(request_class));
+
+    if (!payload_inline)
+    {
+        request_payload = (uint8_t *) golioth_payload_pool_alloc(payload_size);
+        if (!request_payload)
         {
-            return GOLIOTH_ERR_TIMEOUT;
+            GLTH_LOGE(TAG, "Payload alloc failure");
+            return GOLIOTH_ERR_MEM_ALLOC;
         }
+        memcpy(request_payload, payload, payload_size);
     }
-    return GOLIOTH_OK;
+
+    enum golioth_status status = coap_client_post(client,
+                                                  request_class,
+                                                  path_prefix,
+                                                  path,
+                                                  path_handle,
+                                                  delivery_mode,
+                                                  content_type,
+                                                  payload_inline ? payload : request_payload,
+                                                  payload_size,
+                                                  payload_inline,
+                                                  NULL,
+                                                  NULL,
+                                                  callback,
+                                                  callback_arg,
+                                                  is_synchronous,
+                                                  timeout_s);
+    if (status == GOLIOTH_ERR_QUEUE_FULL || status == GOLIOTH_ERR_MEM_ALLOC)
+    {
+        // The request was not queued
+        golioth_payload_pool_free(request_payload);
+    }
+
+    return status;
 }
 
 enum golioth_status golioth_coap_client_set(struct golioth_client *client,
+                                            golioth_coap_request_class_t request_class,
                                             const char *path_prefix,
                                             const char *path,
                                             enum golioth_content_type content_type,
@@ -175,13 +635,120 @@ enum golioth_status golioth_coap_client_set(struct golioth_client *client,
                                             void *callback_arg,
                                             bool is_synchronous,
                                             int32_t timeout_s)
+{
+    return golioth_coap_client_set_delivery(client,
+                                            request_class,
+                                            path_prefix,
+                                            path,
+                                            GOLIOTH_DELIVERY_CONFIRMABLE,
+                                            content_type,
+                                            payload,
+                                            payload_size,
+                                            callback,
+                                            callback_arg,
+                                            is_synchronous,
+                                            timeout_s);
+}
+
+enum golioth_status golioth_coap_client_set_delivery(struct golioth_client *client,
+                                                     golioth_coap_request_class_t request_class,
+                                                     const char *path_prefix,
+                                                     const char *path,
+                                                     enum golioth_delivery_mode delivery_mode,
+                                                     enum golioth_content_type content_type,
+                                                     const uint8_t *payload,
+                                                     size_t payload_size,
+                                                     golioth_set_cb_fn callback,
+                                                     void *callback_arg,
+                                                     bool is_synchronous,
+                                                     int32_t timeout_s)
 {
     if (!client)
     {
         return GOLIOTH_ERR_NULL;
     }
 
-    uint8_t *request_payload = NULL;
+    if (!client->is_running)
+    {
+        GLTH_LOGW(TAG, "Client not running, dropping request for path %s", path);
+        return GOLIOTH_ERR_INVALID_STATE;
+    }
+
+    return coap_client_set_copy(client,
+                                request_class,
+                                path_prefix,
+                                path,
+                                NULL,
+                                delivery_mode,
+                                content_type,
+                                payload,
+                                payload_size,
+                                callback,
+                                callback_arg,
+                                is_synchronous,
+                                timeout_s);
+}
+
+enum golioth_status golioth_coap_client_set_handle(struct golioth_client *client,
+                                                   golioth_coap_request_class_t request_class,
+                                                   const struct golioth_path *path,
+                                                   enum golioth_content_type content_type,
+                                                   const uint8_t *payload,
+                                                   size_t payload_size,
+                                                   golioth_set_cb_fn callback,
+                                                   void *callback_arg,
+                                                   bool is_synchronous,
+                                                   int32_t timeout_s)
+{
+    if (!client || !path)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    if (!client->is_running)
+    {
+        GLTH_LOGW(TAG, "Client not running, dropping request for path %s", path->str);
+        return GOLIOTH_ERR_INVALID_STATE;
+    }
+
+    return coap_client_set_copy(client,
+                                request_class,
+                                NULL,
+                                NULL,
+                                path,
+                                path->delivery_mode,
+                                content_type,
+                                payload,
+                                payload_size,
+                                callback,
+                                callback_arg,
+                                is_synchronous,
+                                timeout_s);
+}
+
+enum golioth_status golioth_coap_client_set_borrowed(struct golioth_client *client,
+                                                     golioth_coap_request_class_t request_class,
+                                                     const char *path_prefix,
+                                                     const char *path,
+                                                     enum golioth_content_type content_type,
+                                                     const uint8_t *payload,
+                                                     size_t payload_size,
+                                                     golioth_payload_release_fn release,
+                                                     void *release_arg,
+                                                     golioth_set_cb_fn callback,
+                                                     void *callback_arg,
+                                                     bool is_synchronous,
+                                                     int32_t timeout_s)
+{
+    if (!client)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    if (!release)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
 
     if (!client->is_running)
     {
@@ -189,21 +756,201 @@ enum golioth_status golioth_coap_client_set(struct golioth_client *client,
         return GOLIOTH_ERR_INVALID_STATE;
     }
 
-    if (payload_size > 0)
+    return coap_client_post(client,
+                            request_class,
+                            path_prefix,
+                            path,
+                            NULL,
+                            GOLIOTH_DELIVERY_CONFIRMABLE,
+                            content_type,
+                            payload,
+                            payload_size,
+                            false,
+                            release,
+                            release_arg,
+                            callback,
+                            callback_arg,
+                            is_synchronous,
+                            timeout_s);
+}
+
+enum golioth_status golioth_coap_client_set_coalesced(struct golioth_client *client,
+                                                      golioth_coap_request_class_t request_class,
+                                                      const char *path_prefix,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *payload,
+                                                      size_t payload_size,
+                                                      golioth_payload_release_fn release,
+                                                      void *release_arg,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg)
+{
+#if CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS > 0
+    if (!client || !release)
     {
-        // We will allocate memory and copy the payload
-        // to avoid payload lifetime and thread-safety issues.
-        //
-        // This memory will be free'd by the CoAP thread after handling the request,
-        // or in this function if we fail to enqueue the request.
-        request_payload = (uint8_t *) golioth_sys_malloc(payload_size);
-        if (!request_payload)
+        return GOLIOTH_ERR_NULL;
+    }
+
+    if (!client->is_running)
+    {
+        GLTH_LOGW(TAG, "Client not running, dropping request for path %s", path);
+        return GOLIOTH_ERR_INVALID_STATE;
+    }
+
+    golioth_sys_sem_take(_coalesce_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    struct golioth_coalesce_slot *slot = coalesce_slot_find(client, path_prefix, path);
+    if (slot)
+    {
+        struct coalesced_callback *replaced = NULL;
+        if (slot->callback)
         {
-            GLTH_LOGE(TAG, "Payload alloc failure");
-            return GOLIOTH_ERR_MEM_ALLOC;
+            replaced = golioth_payload_pool_alloc(sizeof(*replaced));
+            if (!replaced)
+            {
+                // Can't keep track of the replaced callback, so queue this one separately
+                golioth_sys_sem_give(_coalesce_lock);
+                goto not_coalesced;
+            }
+
+            *replaced = (struct coalesced_callback){
+                .callback = slot->callback,
+                .arg = slot->callback_arg,
+            };
+            if (slot->replaced_tail)
+            {
+                slot->replaced_tail->next = replaced;
+            }
+            else
+            {
+                slot->replaced = replaced;
+            }
+            slot->replaced_tail = replaced;
         }
-        memset(request_payload, 0, payload_size);
-        memcpy(request_payload, payload, payload_size);
+
+        slot->release(slot->payload, slot->payload_size, slot->release_arg);
+
+        slot->content_type = content_type;
+        slot->payload = payload;
+        slot->payload_size = payload_size;
+        slot->release = release;
+        slot->release_arg = release_arg;
+        slot->callback = callback;
+        slot->callback_arg = callback_arg;
+
+        golioth_sys_sem_give(_coalesce_lock);
+        return GOLIOTH_OK;
+    }
+
+    slot = coalesce_slot_alloc();
+    if (slot && strlen(path) < sizeof(slot->path))
+    {
+        *slot = (struct golioth_coalesce_slot){
+            .in_use = true,
+            .client = client,
+            .path_prefix = path_prefix,
+            .content_type = content_type,
+            .payload = payload,
+            .payload_size = payload_size,
+            .release = release,
+            .release_arg = release_arg,
+            .callback = callback,
+            .callback_arg = callback_arg,
+        };
+        strcpy(slot->path, path);
+
+        golioth_coap_request_msg_t request_msg = {
+            .type = GOLIOTH_COAP_REQUEST_POST,
+            .request_class = request_class,
+            .path_prefix = path_prefix,
+            .post =
+                {
+                    .coalesce = slot,
+                },
+            .ageout_ms = GOLIOTH_SYS_WAIT_FOREVER,
+        };
+        strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
+
+        // The slot lock is held until the request is queued, so a set to the same path
+        // can't be merged into a request that failed to queue.
+        enum golioth_status status = request_queue_send_and_wait(client,
+                                                                 &request_msg,
+                                                                 NULL,
+                                                                 0,
+                                                                 false,
+                                                                 GOLIOTH_SYS_WAIT_FOREVER);
+        if (status != GOLIOTH_OK)
+        {
+            memset(slot, 0, sizeof(*slot));
+        }
+
+        golioth_sys_sem_give(_coalesce_lock);
+        return status;
+    }
+
+    // No free slot, queue as a regular set
+    golioth_sys_sem_give(_coalesce_lock);
+
+not_coalesced:
+#endif  // CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS > 0
+
+    return golioth_coap_client_set_borrowed(client,
+                                            request_class,
+                                            path_prefix,
+                                            path,
+                                            content_type,
+                                            payload,
+                                            payload_size,
+                                            release,
+                                            release_arg,
+                                            callback,
+                                            callback_arg,
+                                            false,
+                                            GOLIOTH_SYS_WAIT_FOREVER);
+}
+
+// Block size exponent (SZX) of a CoAP block option, or -1 if block_size is not a valid size
+static int block_size_to_szx(size_t block_size)
+{
+    for (int szx = 0; szx <= 6; szx++)
+    {
+        if (block_size == (16U << szx))
+        {
+            return szx;
+        }
+    }
+
+    return -1;
+}
+
+enum golioth_status golioth_coap_client_post_block(struct golioth_client *client,
+                                                   golioth_coap_request_class_t request_class,
+                                                   const char *path_prefix,
+                                                   const char *path,
+                                                   enum golioth_content_type content_type,
+                                                   size_t block_size,
+                                                   golioth_read_block_cb_fn read_block,
+                                                   void *read_block_arg,
+                                                   golioth_set_cb_fn callback,
+                                                   void *callback_arg,
+                                                   bool is_synchronous,
+                                                   int32_t timeout_s)
+{
+    if (!client || !read_block)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    if (block_size_to_szx(block_size) < 0)
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    if (!client->is_running)
+    {
+        GLTH_LOGW(TAG, "Client not running, dropping request for path %s", path);
+        return GOLIOTH_ERR_INVALID_STATE;
     }
 
     uint64_t ageout_ms = GOLIOTH_SYS_WAIT_FOREVER;
@@ -213,13 +960,15 @@ enum golioth_status golioth_coap_client_set(struct golioth_client *client,
     }
 
     golioth_coap_request_msg_t request_msg = {
-        .type = GOLIOTH_COAP_REQUEST_POST,
+        .type = GOLIOTH_COAP_REQUEST_POST_BLOCK,
+        .request_class = request_class,
         .path_prefix = path_prefix,
-        .post =
+        .post_block =
             {
                 .content_type = content_type,
-                .payload = request_payload,
-                .payload_size = payload_size,
+                .block_size = block_size,
+                .read_block = read_block,
+                .read_block_arg = read_block_arg,
                 .callback = callback,
                 .arg = callback_arg,
             },
@@ -227,58 +976,80 @@ enum golioth_status golioth_coap_client_set(struct golioth_client *client,
     };
     strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
 
-    if (is_synchronous)
+    enum golioth_status status = request_queue_send_and_wait(client,
+                                                             &request_msg,
+                                                             NULL,
+                                                             0,
+                                                             is_synchronous,
+                                                             timeout_s);
+    if (status == GOLIOTH_ERR_QUEUE_FULL)
     {
-        // Created here, deleted by coap thread (or here if fail to enqueue
-        request_msg.request_complete_event = golioth_event_group_create();
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
+        GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
     }
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    return status;
+}
+
+enum golioth_status golioth_coap_post_block_read(golioth_coap_request_msg_t *req,
+                                                 uint8_t *block_buffer,
+                                                 size_t *block_len)
+{
+    golioth_coap_post_block_params_t *params = &req->post_block;
+    size_t len = params->block_size;
+    bool is_last = false;
+
+    enum golioth_status status = params->read_block(req->client,
+                                                    params->block_index * params->block_size,
+                                                    block_buffer,
+                                                    &len,
+                                                    &is_last,
+                                                    params->read_block_arg);
+    if (status != GOLIOTH_OK)
     {
-        /* NOTE: Logging a message here when cloud logging is enabled can cause
-         *       a loop where the logging thread attempts to enqueue a message,
-         *       the mbox is full, so coap_client writes a log, which the
-         *       logging thread attempts to send to the cloud, and so on.
-         */
-        if (payload_size > 0)
-        {
-            golioth_sys_free(request_payload);
-        }
-        if (is_synchronous)
-        {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
-        }
-        return GOLIOTH_ERR_QUEUE_FULL;
+        GLTH_LOGW(TAG, "Upload to %s aborted by reader: %d", req->path, status);
+        return status;
     }
 
-    if (is_synchronous)
+    if (len > params->block_size || (!is_last && len < params->block_size))
     {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
+        GLTH_LOGE(TAG, "Invalid block length %" PRIu32, (uint32_t) len);
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
 
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
+    params->is_last = is_last;
+    *block_len = len;
 
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
-        {
-            return GOLIOTH_ERR_TIMEOUT;
-        }
-    }
     return GOLIOTH_OK;
 }
 
+uint32_t golioth_coap_post_block_option(const golioth_coap_request_msg_t *req)
+{
+    const golioth_coap_post_block_params_t *params = &req->post_block;
+    bool more = !params->is_last;
+
+    return (params->block_index << 4) | (more << 3) | block_size_to_szx(params->block_size);
+}
+
+void golioth_coap_post_block_next(golioth_coap_request_msg_t *req, int szx)
+{
+    golioth_coap_post_block_params_t *params = &req->post_block;
+    size_t offset = (params->block_index + 1) * params->block_size;
+
+    // The server has taken the whole block, so the upload goes on from the same offset
+    if (szx >= 0 && szx <= 6 && (16U << szx) < params->block_size)
+    {
+        GLTH_LOGD(TAG,
+                  "Server asked for %" PRIu32 " byte blocks, was %" PRIu32,
+                  (uint32_t) (16U << szx),
+                  (uint32_t) params->block_size);
+        params->block_size = 16U << szx;
+    }
+
+    params->block_index = offset / params->block_size;
+}
+
 enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
+                                               golioth_coap_request_class_t request_class,
                                                const char *path_prefix,
                                                const char *path,
                                                golioth_set_cb_fn callback,
@@ -305,6 +1076,7 @@ enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
 
     golioth_coap_request_msg_t request_msg = {
         .type = GOLIOTH_COAP_REQUEST_DELETE,
+        .request_class = request_class,
         .path_prefix = path_prefix,
         .delete =
             {
@@ -315,56 +1087,29 @@ enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
     };
     strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
 
-    if (is_synchronous)
-    {
-        // Created here, deleted by coap thread (or here if fail to enqueue
-        request_msg.request_complete_event = golioth_event_group_create();
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
-    }
-
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = request_queue_send_and_wait(client,
+                                                             &request_msg,
+                                                             NULL,
+                                                             0,
+                                                             is_synchronous,
+                                                             timeout_s);
+    if (status == GOLIOTH_ERR_QUEUE_FULL)
     {
         GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
-        if (is_synchronous)
-        {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
-        }
-        return GOLIOTH_ERR_QUEUE_FULL;
     }
 
-    if (is_synchronous)
-    {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
-
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
-
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
-        {
-            return GOLIOTH_ERR_TIMEOUT;
-        }
-    }
-    return GOLIOTH_OK;
+    return status;
 }
 
-static enum golioth_status golioth_coap_client_get_internal(struct golioth_client *client,
-                                                            const char *path_prefix,
-                                                            const char *path,
-                                                            golioth_coap_request_type_t type,
-                                                            void *request_params,
-                                                            bool is_synchronous,
-                                                            int32_t timeout_s)
+static enum golioth_status golioth_coap_client_get_internal(
+    struct golioth_client *client,
+    golioth_coap_request_class_t request_class,
+    const char *path_prefix,
+    const char *path,
+    golioth_coap_request_type_t type,
+    void *request_params,
+    bool is_synchronous,
+    int32_t timeout_s)
 {
     if (!client)
     {
@@ -385,14 +1130,9 @@ static enum golioth_status golioth_coap_client_get_internal(struct golioth_clien
 
     golioth_coap_request_msg_t request_msg = {};
     request_msg.type = type;
+    request_msg.request_class = request_class;
     request_msg.path_prefix = path_prefix;
     strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
-    if (is_synchronous)
-    {
-        // Created here, deleted by coap thread (or here if fail to enqueue
-        request_msg.request_complete_event = golioth_event_group_create();
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
-    }
     request_msg.ageout_ms = ageout_ms;
     if (type == GOLIOTH_COAP_REQUEST_GET_BLOCK)
     {
@@ -404,43 +1144,22 @@ static enum golioth_status golioth_coap_client_get_internal(struct golioth_clien
         request_msg.get = *(golioth_coap_get_params_t *) request_params;
     }
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = request_queue_send_and_wait(client,
+                                                             &request_msg,
+                                                             NULL,
+                                                             0,
+                                                             is_synchronous,
+                                                             timeout_s);
+    if (status == GOLIOTH_ERR_QUEUE_FULL)
     {
         GLTH_LOGE(TAG, "Failed to enqueue request, queue full");
-        if (is_synchronous)
-        {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
-        }
-        return GOLIOTH_ERR_QUEUE_FULL;
     }
 
-    if (is_synchronous)
-    {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
-
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
-
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
-        {
-            return GOLIOTH_ERR_TIMEOUT;
-        }
-    }
-    return GOLIOTH_OK;
+    return status;
 }
 
 enum golioth_status golioth_coap_client_get(struct golioth_client *client,
+                                            golioth_coap_request_class_t request_class,
                                             const char *path_prefix,
                                             const char *path,
                                             enum golioth_content_type content_type,
@@ -455,6 +1174,7 @@ enum golioth_status golioth_coap_client_get(struct golioth_client *client,
         .arg = arg,
     };
     return golioth_coap_client_get_internal(client,
+                                            request_class,
                                             path_prefix,
                                             path,
                                             GOLIOTH_COAP_REQUEST_GET,
@@ -464,6 +1184,7 @@ enum golioth_status golioth_coap_client_get(struct golioth_client *client,
 }
 
 enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
+                                                  golioth_coap_request_class_t request_class,
                                                   const char *path_prefix,
                                                   const char *path,
                                                   enum golioth_content_type content_type,
@@ -482,6 +1203,7 @@ enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
         .arg = arg,
     };
     return golioth_coap_client_get_internal(client,
+                                            request_class,
                                             path_prefix,
                                             path,
                                             GOLIOTH_COAP_REQUEST_GET_BLOCK,
@@ -491,6 +1213,7 @@ enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
 }
 
 enum golioth_status golioth_coap_client_observe_async(struct golioth_client *client,
+                                                      golioth_coap_request_class_t request_class,
                                                       const char *path_prefix,
                                                       const char *path,
                                                       enum golioth_content_type content_type,
@@ -510,6 +1233,7 @@ enum golioth_status golioth_coap_client_observe_async(struct golioth_client *cli
 
     golioth_coap_request_msg_t request_msg = {
         .type = GOLIOTH_COAP_REQUEST_OBSERVE,
+        .request_class = request_class,
         .path_prefix = path_prefix,
         .ageout_ms = GOLIOTH_SYS_WAIT_FOREVER,
         .observe =
@@ -521,7 +1245,7 @@ enum golioth_status golioth_coap_client_observe_async(struct golioth_client *cli
     };
     strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
+    bool sent = request_queue_send(client, &request_msg, NULL, 0);
     if (!sent)
     {
         GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
@@ -552,6 +1276,93 @@ uint32_t golioth_client_num_items_in_request_queue(struct golioth_client *client
     return golioth_mbox_num_messages(client->request_queue);
 }
 
+enum golioth_status golioth_client_get_rtt(struct golioth_client *client,
+                                           struct golioth_client_rtt *rtt)
+{
+    if (!client || !rtt)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    // Updated by the CoAP thread without a lock, so the values are a best-effort snapshot
+    golioth_rtt_estimator_get(&client->rtt, rtt);
+    return GOLIOTH_OK;
+}
+
+enum golioth_status golioth_client_get_stats(struct golioth_client *client,
+                                             struct golioth_client_stats *stats)
+{
+    if (!client || !stats)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    // Like golioth_client_get_rtt(), a best-effort copy of state owned by the CoAP thread
+    *stats = client->stats;
+    stats->queue_high_water_mark =
+        atomic_load_explicit(&client->queue_high_water_mark, memory_order_relaxed);
+    stats->drops.queue_full = atomic_load_explicit(&client->num_queue_full, memory_order_relaxed);
+    stats->reconnects = (client->num_sessions > 0) ? client->num_sessions - 1 : 0;
+
+    return GOLIOTH_OK;
+}
+
+enum golioth_status golioth_client_save_warm_cache(struct golioth_client *client,
+                                                   uint8_t *buf,
+                                                   size_t *len)
+{
+    if (!client)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    // Like golioth_client_get_rtt(), a best-effort copy of state owned by the CoAP thread
+    struct golioth_warm_cache cache = {0};
+    const struct golioth_dns_addr *addr = golioth_dns_cache_current(&client->dns);
+    if (addr)
+    {
+        cache.addr = *addr;
+    }
+    cache.rtt = client->rtt;
+
+    return golioth_warm_cache_encode(&cache, buf, len);
+}
+
+void golioth_coap_client_restore_warm_cache(struct golioth_client *client,
+                                            const struct golioth_client_config *config)
+{
+    // Only valid during golioth_client_create()
+    client->config.warm_cache = NULL;
+    client->config.warm_cache_len = 0;
+
+    if (!config->warm_cache)
+    {
+        return;
+    }
+
+    struct golioth_warm_cache cache;
+    enum golioth_status status = golioth_warm_cache_decode(&cache,
+                                                           config->warm_cache,
+                                                           config->warm_cache_len,
+                                                           golioth_sys_now_ms());
+    if (status != GOLIOTH_OK)
+    {
+        GLTH_LOGW(TAG, "Ignoring invalid warm cache");
+        return;
+    }
+
+    // The initial RTO is a property of this build, not of the saved session
+    cache.rtt.initial_rto_ms = client->rtt.initial_rto_ms;
+    client->rtt = cache.rtt;
+
+    // Connect to the saved address like to a freshly resolved one. If that fails, the client
+    // resolves the server again.
+    if (cache.addr.addr_len > 0)
+    {
+        golioth_dns_cache_store(&client->dns, &cache.addr, 1, golioth_sys_now_ms());
+    }
+}
+
 golioth_sys_thread_t golioth_client_get_thread(struct golioth_client *client)
 {
     return client->coap_thread_handle;
@@ -8,22 +8,39 @@
 #include <golioth/client.h>
 #include <golioth/config.h>
 #include <golioth/golioth_sys.h>
-#include "event_group.h"
+#include "completion.h"
+#include "mbox.h"
 
 /// Event group bits for request_complete_event
 #define RESPONSE_RECEIVED_EVENT_BIT (1 << 0)
 #define RESPONSE_TIMEOUT_EVENT_BIT (1 << 1)
+/// The request failed for another reason, e.g. the server rejected an upload
+#define RESPONSE_ERROR_EVENT_BIT (1 << 2)
+
+/// RFC 7967 No-Response option, and its value for suppressing all responses (2.xx, 4.xx, 5.xx)
+#define GOLIOTH_COAP_OPTION_NO_RESPONSE 258
+#define GOLIOTH_COAP_NO_RESPONSE_SUPPRESS_ALL 26
 
 typedef struct
 {
     enum golioth_content_type content_type;
-    // CoAP payload assumed to be dynamically allocated before enqueue
-    // and freed after dequeue.
-    uint8_t *payload;
+    // CoAP payload. Either dynamically allocated before enqueue and freed
+    // after dequeue, or borrowed from the user and handed back via release.
+    const uint8_t *payload;
     // Size of payload, in bytes
     size_t payload_size;
+    // If non-NULL, payload is borrowed and must be handed back with this
+    // instead of being freed.
+    golioth_payload_release_fn release;
+    void *release_arg;
     golioth_set_cb_fn callback;
     void *arg;
+    // For anything but GOLIOTH_DELIVERY_CONFIRMABLE, the request is sent as non-confirmable
+    // and callback is called as soon as it has been sent.
+    enum golioth_delivery_mode delivery_mode;
+    // If set, the fields above are filled in from this coalescing slot when the request
+    // is received from the request queue, see golioth_coap_client_set_coalesced().
+    struct golioth_coalesce_slot *coalesce;
 } golioth_coap_post_params_t;
 
 typedef struct
@@ -42,6 +59,23 @@ typedef struct
     void *arg;
 } golioth_coap_get_block_params_t;
 
+typedef struct
+{
+    enum golioth_content_type content_type;
+    // Index of the block being sent
+    size_t block_index;
+    // Power of two between 16 and 1024
+    size_t block_size;
+    // Whether the block being sent is the last one
+    bool is_last;
+    // Set by the CoAP thread when the upload has failed, so a synchronous upload fails too
+    bool failed;
+    golioth_read_block_cb_fn read_block;
+    void *read_block_arg;
+    golioth_set_cb_fn callback;
+    void *arg;
+} golioth_coap_post_block_params_t;
+
 typedef struct
 {
     golioth_set_cb_fn callback;
@@ -61,27 +95,48 @@ typedef enum
     GOLIOTH_COAP_REQUEST_GET,
     GOLIOTH_COAP_REQUEST_GET_BLOCK,
     GOLIOTH_COAP_REQUEST_POST,
-    // TODO - support for POST_BLOCK
+    GOLIOTH_COAP_REQUEST_POST_BLOCK,
     GOLIOTH_COAP_REQUEST_DELETE,
     GOLIOTH_COAP_REQUEST_OBSERVE,
 } golioth_coap_request_type_t;
 
+/// Scheduling class of a request.
+///
+/// Each class is queued separately, with its own depth limit, and the CoAP thread
+/// takes requests from the classes in weighted round-robin order, so that e.g. a
+/// burst of cloud logs cannot hold back an RPC response or a firmware download.
+typedef enum
+{
+    // Keepalives and other client housekeeping
+    GOLIOTH_COAP_REQUEST_CLASS_CONTROL,
+    // RPC and settings, where the cloud is waiting for the device
+    GOLIOTH_COAP_REQUEST_CLASS_RPC,
+    // Firmware update
+    GOLIOTH_COAP_REQUEST_CLASS_OTA,
+    // LightDB State and Stream
+    GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+    // Cloud logs
+    GOLIOTH_COAP_REQUEST_CLASS_LOG,
+    GOLIOTH_COAP_REQUEST_CLASS_COUNT,
+} golioth_coap_request_class_t;
+
 typedef struct
 {
-    struct golioth_client *client;
+    // Only the fields up to path are passed through the request queue, see
+    // golioth_coap_request_queue_recv().
 
-    // The CoAP path string (everything after coaps://coap.golioth.io/).
+    golioth_coap_request_type_t type;
+    golioth_coap_request_class_t request_class;
     // Assumption: path_prefix is a string literal (i.e. we don't need to strcpy).
     const char *path_prefix;
-    char path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
-    uint8_t token[8];
-    size_t token_len;
-    golioth_coap_request_type_t type;
+    // If set, the path of the request, instead of path_prefix and path
+    const struct golioth_path *path_handle;
     union
     {
         golioth_coap_get_params_t get;
         golioth_coap_get_block_params_t get_block;
         golioth_coap_post_params_t post;
+        golioth_coap_post_block_params_t post_block;
         golioth_coap_delete_params_t delete;
         golioth_coap_observe_params_t observe;
     };
@@ -89,25 +144,31 @@ typedef struct
     /// This is checked when reqeusts are pulled out of the queue and when responses are received.
     /// Primarily intended to be used for synchronous requests, to avoid blocking forever.
     uint64_t ageout_ms;
-    bool got_response;
-    bool got_nack;
 
-    /// (sync request only) Notification from coap thread to user sync function that
-    /// request is completed.
-    /// Created in user sync function, deleted by coap thread.
-    ///
-    /// Bit 0: response received
-    /// Bit 1: timeout
-    golioth_event_group_t request_complete_event;
+    /// Time (since boot) in milliseconds when the request was queued, for the statistics
+    uint64_t enqueued_ms;
 
-    /// (sync request only) Notification from user sync function to coap thread, acknowledge it
-    /// received request_complete_event.
-    ///
-    /// Created in user sync function, deleted by coap thread.
+    /// (sync request only) Signaled by the coap thread when the request is completed,
+    /// with RESPONSE_RECEIVED_EVENT_BIT, RESPONSE_TIMEOUT_EVENT_BIT or
+    /// RESPONSE_ERROR_EVENT_BIT.
     ///
-    /// Used by the coap thread to know when it's safe
-    /// to delete request_complete_event and this semaphore.
-    golioth_sys_sem_t request_complete_ack_sem;
+    /// Acquired in user sync function, returned to the pool by whichever side is done
+    /// with it last. The coap thread never waits for the user thread.
+    struct golioth_completion *request_complete;
+
+    // The CoAP path string (everything after coaps://coap.golioth.io/ and path_prefix).
+    // Only the used part of the string is queued.
+    char path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+
+    // Fields below are only used by the CoAP thread
+
+    struct golioth_client *client;
+    uint8_t token[8];
+    size_t token_len;
+    bool got_response;
+    bool got_nack;
+    // Time (since boot) in milliseconds when the request was sent, for the statistics
+    uint64_t sent_ms;
 } golioth_coap_request_msg_t;
 
 typedef struct
@@ -121,6 +182,7 @@ enum golioth_status golioth_coap_client_empty(struct golioth_client *client,
                                               int32_t timeout_s);
 
 enum golioth_status golioth_coap_client_set(struct golioth_client *client,
+                                            golioth_coap_request_class_t request_class,
                                             const char *path_prefix,
                                             const char *path,
                                             enum golioth_content_type content_type,
@@ -131,7 +193,107 @@ enum golioth_status golioth_coap_client_set(struct golioth_client *client,
                                             bool is_synchronous,
                                             int32_t timeout_s);
 
+/// Same as golioth_coap_client_set(), but delivered according to delivery_mode instead of
+/// always as a confirmable request.
+enum golioth_status golioth_coap_client_set_delivery(struct golioth_client *client,
+                                                     golioth_coap_request_class_t request_class,
+                                                     const char *path_prefix,
+                                                     const char *path,
+                                                     enum golioth_delivery_mode delivery_mode,
+                                                     enum golioth_content_type content_type,
+                                                     const uint8_t *payload,
+                                                     size_t payload_size,
+                                                     golioth_set_cb_fn callback,
+                                                     void *callback_arg,
+                                                     bool is_synchronous,
+                                                     int32_t timeout_s);
+
+/// Same as golioth_coap_client_set(), but sends straight from the caller's payload buffer
+/// instead of a copy.
+///
+/// On success, release is called (from the CoAP thread) once payload is no longer needed.
+/// On failure, release is not called and the caller keeps ownership of payload.
+enum golioth_status golioth_coap_client_set_borrowed(struct golioth_client *client,
+                                                     golioth_coap_request_class_t request_class,
+                                                     const char *path_prefix,
+                                                     const char *path,
+                                                     enum golioth_content_type content_type,
+                                                     const uint8_t *payload,
+                                                     size_t payload_size,
+                                                     golioth_payload_release_fn release,
+                                                     void *release_arg,
+                                                     golioth_set_cb_fn callback,
+                                                     void *callback_arg,
+                                                     bool is_synchronous,
+                                                     int32_t timeout_s);
+
+/// Same as golioth_coap_client_set_borrowed(), but always asynchronous, and merged with a
+/// set to the same path that is still in the request queue, if there is one. The queued set
+/// then sends this payload instead, and its callback is called with GOLIOTH_ERR_COALESCED
+/// from the CoAP thread.
+///
+/// Sets are only merged if CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS is non-zero.
+enum golioth_status golioth_coap_client_set_coalesced(struct golioth_client *client,
+                                                      golioth_coap_request_class_t request_class,
+                                                      const char *path_prefix,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *payload,
+                                                      size_t payload_size,
+                                                      golioth_payload_release_fn release,
+                                                      void *release_arg,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg);
+
+/// Same as golioth_coap_client_set(), but with the path given as a path handle. The request
+/// is delivered according to the delivery mode of the path handle.
+enum golioth_status golioth_coap_client_set_handle(struct golioth_client *client,
+                                                   golioth_coap_request_class_t request_class,
+                                                   const struct golioth_path *path,
+                                                   enum golioth_content_type content_type,
+                                                   const uint8_t *payload,
+                                                   size_t payload_size,
+                                                   golioth_set_cb_fn callback,
+                                                   void *callback_arg,
+                                                   bool is_synchronous,
+                                                   int32_t timeout_s);
+
+/// Upload a payload to path_prefix/path with a blockwise (Block1) POST, reading one block at a
+/// time from read_block, so the payload never has to be in memory at once.
+///
+/// The blocks are sent one after the other by the CoAP thread, as one request. callback is
+/// called once, when the last block has been acknowledged or the upload has failed. If
+/// is_synchronous, timeout_s covers the whole upload.
+enum golioth_status golioth_coap_client_post_block(struct golioth_client *client,
+                                                   golioth_coap_request_class_t request_class,
+                                                   const char *path_prefix,
+                                                   const char *path,
+                                                   enum golioth_content_type content_type,
+                                                   size_t block_size,
+                                                   golioth_read_block_cb_fn read_block,
+                                                   void *read_block_arg,
+                                                   golioth_set_cb_fn callback,
+                                                   void *callback_arg,
+                                                   bool is_synchronous,
+                                                   int32_t timeout_s);
+
+/// Read the current block of a POST_BLOCK request into block_buffer, which must hold
+/// req->post_block.block_size bytes. Sets *block_len to the block length and updates
+/// req->post_block.is_last.
+enum golioth_status golioth_coap_post_block_read(golioth_coap_request_msg_t *req,
+                                                 uint8_t *block_buffer,
+                                                 size_t *block_len);
+
+/// Value of the Block1 option for the current block of a POST_BLOCK request
+uint32_t golioth_coap_post_block_option(const golioth_coap_request_msg_t *req);
+
+/// Move a POST_BLOCK request on to its next block, after the server answered the current one
+/// with 2.31 Continue. szx is the block size exponent of the Block1 option in the response, or
+/// -1 if there was none. A server asking for smaller blocks gets them from the next block on.
+void golioth_coap_post_block_next(golioth_coap_request_msg_t *req, int szx);
+
 enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
+                                               golioth_coap_request_class_t request_class,
                                                const char *path_prefix,
                                                const char *path,
                                                golioth_set_cb_fn callback,
@@ -140,6 +302,7 @@ enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
                                                int32_t timeout_s);
 
 enum golioth_status golioth_coap_client_get(struct golioth_client *client,
+                                            golioth_coap_request_class_t request_class,
                                             const char *path_prefix,
                                             const char *path,
                                             enum golioth_content_type content_type,
@@ -149,6 +312,7 @@ enum golioth_status golioth_coap_client_get(struct golioth_client *client,
                                             int32_t timeout_s);
 
 enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
+                                                  golioth_coap_request_class_t request_class,
                                                   const char *path_prefix,
                                                   const char *path,
                                                   enum golioth_content_type content_type,
@@ -160,12 +324,44 @@ enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
                                                   int32_t timeout_s);
 
 enum golioth_status golioth_coap_client_observe_async(struct golioth_client *client,
+                                                      golioth_coap_request_class_t request_class,
                                                       const char *path_prefix,
                                                       const char *path,
                                                       enum golioth_content_type content_type,
                                                       golioth_get_cb_fn callback,
                                                       void *callback_arg);
 
+/// Free or hand back the payload of a POST request, once it's no longer needed.
+/// Does nothing for other request types.
+void golioth_coap_request_msg_release_payload(golioth_coap_request_msg_t *req);
+
+/// Initialize the state shared by all client request queues.
+///
+/// Must be called once, before the first golioth_coap_request_queue_create().
+void golioth_coap_request_queue_init(void);
+
+/// Create a client request queue, with one lane per request class
+golioth_mbox_t golioth_coap_request_queue_create(void);
+
+/// Receive a request from a client request queue, waiting up to timeout_ms.
+///
+/// Requests are stored in the queue in serialized form, with small payloads inline. If the
+/// request has an inline payload, req->post.payload points into the queue and is only valid
+/// until golioth_coap_request_queue_release() is called, so each successful call must be
+/// followed by golioth_coap_request_queue_release() once the request has been sent.
+bool golioth_coap_request_queue_recv(golioth_mbox_t request_queue,
+                                     golioth_coap_request_msg_t *req,
+                                     int32_t timeout_ms);
+
+/// Remove the request returned by golioth_coap_request_queue_recv() from the queue
+void golioth_coap_request_queue_release(golioth_mbox_t request_queue);
+
+/// Restore the server address and RTT estimates from config->warm_cache, if set.
+/// Called by golioth_client_create(), after the RTT estimator and DNS cache have been
+/// initialized.
+void golioth_coap_client_restore_warm_cache(struct golioth_client *client,
+                                            const struct golioth_client_config *config);
+
 /// Getters, for internal SDK code to access data within the
 /// coap client struct.
 golioth_sys_thread_t golioth_coap_client_get_thread(struct golioth_client *client);
@@ -8,54 +8,108 @@
 #include <netdb.h>      // struct addrinfo
 #include <sys/param.h>  // MIN
 #include <time.h>
+#if defined(__linux__)
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 #include <coap3/coap.h>
 #include <golioth/golioth_debug.h>
 #include <golioth/golioth_sys.h>
+#include "callback_executor.h"
+#include "client_stats.h"
 #include "coap_client.h"
+#include "deadline_heap.h"
 #include "golioth_util.h"
 #include "mbox.h"
+#include "path_handle.h"
+#include "payload_pool.h"
 #include "coap_client_libcoap.h"
 
 LOG_TAG_DEFINE(golioth_coap_client_libcoap);
 
+// DTLS Connection ID support was added to the libcoap API in 4.3.4
+#if CONFIG_GOLIOTH_USE_CONNECTION_ID && defined(LIBCOAP_VERSION) && LIBCOAP_VERSION >= 4003004ULL
+#define GOLIOTH_LIBCOAP_USE_CID 1
+#else
+#define GOLIOTH_LIBCOAP_USE_CID 0
+#endif
+
+#if defined(__linux__)
+// Clients may be created from several threads at once, e.g. when sharing event loops
+static pthread_once_t _init_once = PTHREAD_ONCE_INIT;
+#else
 static bool _initialized;
+#endif
 
-static bool token_matches_request(const golioth_coap_request_msg_t *req, const coap_pdu_t *pdu)
+static golioth_coap_pending_req_t *find_pending_req(struct golioth_client *client,
+                                                    const coap_pdu_t *pdu)
 {
-    coap_bin_const_t rcvd_token = coap_pdu_get_token(pdu);
-    bool len_matches = (rcvd_token.length == req->token_len);
-    return (len_matches && (0 == memcmp(rcvd_token.s, req->token, req->token_len)));
+    coap_bin_const_t token = coap_pdu_get_token(pdu);
+    return golioth_token_table_find(&client->reqs_by_token, token.s, token.length);
 }
 
-static void notify_observers(const coap_pdu_t *received,
-                             struct golioth_client *client,
-                             const uint8_t *data,
-                             size_t data_len,
-                             const struct golioth_response *response)
+static void call_callback(struct golioth_client *client,
+                          const golioth_coap_request_msg_t *req,
+                          const struct golioth_response *response,
+                          const uint8_t *payload,
+                          size_t payload_size,
+                          bool is_last)
 {
-    // scan observations, check for token match
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
+    if (!golioth_callback_executor_call(client->callback_executor,
+                                        client,
+                                        req,
+                                        response,
+                                        payload,
+                                        payload_size,
+                                        is_last))
     {
-        const golioth_coap_observe_info_t *obs_info = &client->observations[i];
-        golioth_get_cb_fn callback = obs_info->req.observe.callback;
+        client->stats.drops.callback++;
+    }
+}
 
-        if (!obs_info->in_use || !callback)
-        {
-            continue;
-        }
+static enum golioth_status golioth_coap_post_block(golioth_coap_request_msg_t *req,
+                                                   coap_session_t *session);
 
-        coap_bin_const_t rcvd_token = coap_pdu_get_token(received);
-        bool len_matches = (rcvd_token.length == obs_info->req.token_len);
-        if (len_matches
-            && (0 == memcmp(rcvd_token.s, obs_info->req.token, obs_info->req.token_len)))
-        {
-            callback(client,
-                     response,
-                     obs_info->req.path,
-                     data,
-                     data_len,
-                     obs_info->req.observe.arg);
-        }
+/// Set the retransmission timeout of the session from the RTT estimate, before sending a request
+static void apply_rto(struct golioth_client *client,
+                      coap_session_t *session,
+                      golioth_coap_pending_req_t *pending)
+{
+    pending->rto_ms = golioth_rtt_estimator_rto_ms(&client->rtt, golioth_sys_now_ms());
+
+    coap_fixed_point_t ack_timeout = {
+        .integer_part = pending->rto_ms / 1000,
+        .fractional_part = pending->rto_ms % 1000,
+    };
+    coap_session_set_ack_timeout(session, ack_timeout);
+}
+
+/// How long libcoap keeps retransmitting a request sent with rto_ms as the ACK timeout. The
+/// first timeout is randomized by up to ACK_RANDOM_FACTOR (1.5), and doubled for each of the
+/// COAP_DEFAULT_MAX_RETRANSMIT retransmissions.
+static uint64_t transmit_wait_ms(uint32_t rto_ms)
+{
+    return (uint64_t) rto_ms * ((2 << COAP_DEFAULT_MAX_RETRANSMIT) - 1) * 3 / 2;
+}
+
+/// Start waiting for the response to a request that has just been sent.
+///
+/// The request is given up on when libcoap has stopped retransmitting it, or after
+/// CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S, whichever comes first.
+static void start_response_timer(struct golioth_client *client,
+                                 golioth_coap_pending_req_t *pending)
+{
+    golioth_coap_request_msg_t *req = &pending->req;
+
+    pending->sent_ms = golioth_sys_now_ms();
+    pending->deadline_ms = pending->sent_ms
+        + min(transmit_wait_ms(pending->rto_ms), CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S * 1000);
+    if (req->ageout_ms != GOLIOTH_SYS_WAIT_FOREVER)
+    {
+        pending->deadline_ms = min(pending->deadline_ms, req->ageout_ms);
     }
 }
 
@@ -90,9 +144,14 @@ static coap_response_t coap_response_handler(coap_session_t *session,
     const uint8_t *data = NULL;
     size_t data_len = 0;
     coap_get_data(received, &data_len, &data);
+    client->stats.bytes_in += data_len;
 
     // Get the original/pending request info
-    golioth_coap_request_msg_t *req = client->pending_req;
+    golioth_coap_pending_req_t *pending = find_pending_req(client, received);
+    golioth_coap_request_msg_t *req =
+        (pending && pending->awaiting_response) ? &pending->req : NULL;
+
+    client->last_rx_ms = golioth_sys_now_ms();
 
     if (req)
     {
@@ -131,32 +190,73 @@ static coap_response_t coap_response_handler(coap_session_t *session,
         GLTH_LOGD(TAG, "%d.%02d (unsolicited), len %" PRIu32, class, code, (uint32_t) data_len);
     }
 
-    if (req && token_matches_request(req, received))
+    if (req)
     {
-        req->got_response = true;
+        // Requests that were retransmitted can't tell which transmission was answered, so
+        // their samples are only weak evidence of the RTT
+        uint32_t rtt_ms = (uint32_t) (client->last_rx_ms - pending->sent_ms);
+        golioth_rtt_estimator_update(&client->rtt,
+                                     rtt_ms,
+                                     rtt_ms >= pending->rto_ms,
+                                     client->last_rx_ms);
+        golioth_client_stats_response_received(&client->stats,
+                                               req->type,
+                                               pending->sent_ms,
+                                               client->last_rx_ms);
 
         if (CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S > 0)
         {
-            if (!golioth_sys_timer_reset(client->keepalive_timer))
+            if (client->event_loop)
+            {
+                client->keepalive_due_ms =
+                    client->last_rx_ms + 1000 * (uint64_t) CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S;
+            }
+            else if (!golioth_sys_timer_reset(client->keepalive_timer))
             {
                 GLTH_LOGW(TAG, "Failed to reset keepalive timer");
             }
         }
 
+        if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK && class == 2
+            && !req->post_block.is_last && rcvd_code != COAP_RESPONSE_CODE(231))
+        {
+            // Any other success before the last block means the server didn't take the rest
+            GLTH_LOGW(TAG, "%d.%02d before the last block, upload incomplete", class, code);
+            response.status = GOLIOTH_ERR_FAIL;
+        }
+        else if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK && !req->post_block.is_last
+                 && rcvd_code == COAP_RESPONSE_CODE(231)
+                 && golioth_sys_now_ms() <= req->ageout_ms)
+        {
+            // The next block is sent with the same token, so the request stays in flight
+            // until the last block is acknowledged
+            coap_opt_iterator_t opt_iter;
+            coap_opt_t *block1 = coap_check_option(received, COAP_OPTION_BLOCK1, &opt_iter);
+            golioth_coap_post_block_next(req, block1 ? (int) COAP_OPT_BLOCK_SZX(block1) : -1);
+            apply_rto(client, session, pending);
+            response.status = golioth_coap_post_block(req, session);
+            if (response.status == GOLIOTH_OK)
+            {
+                start_response_timer(client, pending);
+                return COAP_RESPONSE_OK;
+            }
+        }
+
+        req->got_response = true;
+        if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
+        {
+            req->post_block.failed = (response.status != GOLIOTH_OK);
+        }
+
         if (golioth_sys_now_ms() > req->ageout_ms)
         {
             GLTH_LOGW(TAG, "Ignoring response from old request, type %d", req->type);
         }
         else
         {
-            if (req->type == GOLIOTH_COAP_REQUEST_GET)
-            {
-                if (req->get.callback)
-                {
-                    req->get.callback(client, &response, req->path, data, data_len, req->get.arg);
-                }
-            }
-            else if (req->type == GOLIOTH_COAP_REQUEST_GET_BLOCK)
+            bool is_last = true;
+
+            if (req->type == GOLIOTH_COAP_REQUEST_GET_BLOCK)
             {
                 coap_opt_iterator_t opt_iter;
                 coap_opt_t *block_opt = coap_check_option(received, COAP_OPTION_BLOCK2, &opt_iter);
@@ -165,7 +265,7 @@ static coap_response_t coap_response_handler(coap_session_t *session,
                 // option in the response. So block_opt may be NULL here.
 
                 uint32_t opt_block_index = block_opt ? coap_opt_block_num(block_opt) : 0;
-                bool is_last = block_opt ? (COAP_OPT_BLOCK_MORE(block_opt) == 0) : true;
+                is_last = block_opt ? (COAP_OPT_BLOCK_MORE(block_opt) == 0) : true;
 
                 GLTH_LOGD(TAG,
                           "Request block index = %" PRIu32 ", response block index = %" PRIu32
@@ -177,49 +277,41 @@ static coap_response_t coap_response_handler(coap_session_t *session,
                                         data,
                                         min(32, data_len),
                                         GOLIOTH_DEBUG_LOG_LEVEL_DEBUG);
-
-                if (req->get_block.callback)
-                {
-                    req->get_block.callback(client,
-                                            &response,
-                                            req->path,
-                                            data,
-                                            data_len,
-                                            is_last,
-                                            req->get_block.arg);
-                }
-            }
-            else if (req->type == GOLIOTH_COAP_REQUEST_POST)
-            {
-                if (req->post.callback)
-                {
-                    req->post.callback(client, &response, req->path, req->post.arg);
-                }
             }
-            else if (req->type == GOLIOTH_COAP_REQUEST_DELETE)
+
+            // Observation callbacks are called below, for every notification
+            if (req->type != GOLIOTH_COAP_REQUEST_OBSERVE)
             {
-                if (req->delete.callback)
-                {
-                    req->delete.callback(client, &response, req->path, req->delete.arg);
-                }
+                call_callback(client, req, &response, data, data_len, is_last);
             }
         }
     }
 
-    notify_observers(received, client, data, data_len, &response);
+    if (pending && pending->req.type == GOLIOTH_COAP_REQUEST_OBSERVE)
+    {
+        call_callback(client, &pending->req, &response, data, data_len, true);
+    }
 
     return COAP_RESPONSE_OK;
 }
 
 static int event_handler(coap_session_t *session, const coap_event_t event)
 {
+    coap_context_t *context = coap_session_get_context(session);
+    struct golioth_client *client = coap_get_app_data(context);
+
     if (event == COAP_EVENT_MSG_RETRANSMITTED)
     {
         GLTH_LOGW(TAG, "CoAP message retransmitted");
+        client->stats.retransmits++;
     }
     else
     {
         GLTH_LOGD(TAG, "event: 0x%04X", event);
+        if (event == COAP_EVENT_DTLS_CONNECTED)
+        {
+            client->stats.handshakes++;
+        }
     }
     return 0;
 }
@@ -231,7 +323,6 @@ static void nack_handler(coap_session_t *session,
 {
     coap_context_t *context = coap_session_get_context(session);
     struct golioth_client *client = coap_get_app_data(context);
-    golioth_coap_request_msg_t *req = client->pending_req;
 
     switch (reason)
     {
@@ -248,9 +339,28 @@ static void nack_handler(coap_session_t *session,
             GLTH_LOGE(TAG, "Received nack reason: %d", reason);
     }
 
-    if (req)
+    // A failed DTLS session takes all requests down with it
+    if (reason == COAP_NACK_TLS_FAILED)
+    {
+        client->session_failed = true;
+    }
+
+    if (sent)
+    {
+        golioth_coap_pending_req_t *pending = find_pending_req(client, sent);
+        if (pending)
+        {
+            pending->req.got_nack = true;
+        }
+        return;
+    }
+
+    // Without the sent PDU we can't tell which request failed, so fail all of them, and the
+    // session
+    client->session_failed = true;
+    for (size_t i = 0; i < client->num_inflight_reqs; i++)
     {
-        req->got_nack = true;
+        client->inflight_reqs[i]->req.got_nack = true;
     }
 }
 
@@ -276,9 +386,11 @@ static void coap_log_handler(coap_log_t level, const char *message)
 }
 #endif /* GOLIOTH_OVERRIDE_LIBCOAP_LOG_HANDLER */
 
-// DNS lookup of host_uri
-static enum golioth_status get_coap_dst_address(const coap_uri_t *host_uri,
-                                                coap_address_t *dst_addr)
+// Blocking DNS lookup of host_uri, storing up to max_addrs of the returned addresses in addrs
+static enum golioth_status resolve_host(const coap_uri_t *host_uri,
+                                        struct golioth_dns_addr *addrs,
+                                        size_t max_addrs,
+                                        size_t *num_addrs)
 {
     struct addrinfo hints = {
         .ai_socktype = SOCK_DGRAM,
@@ -298,27 +410,309 @@ static enum golioth_status get_coap_dst_address(const coap_uri_t *host_uri,
         return GOLIOTH_ERR_DNS_LOOKUP;
     }
 
-    coap_address_init(dst_addr);
+    *num_addrs = 0;
 
-    switch (ainfo->ai_family)
+    for (struct addrinfo *ai = ainfo; ai && *num_addrs < max_addrs; ai = ai->ai_next)
     {
-        case AF_INET:
-            memcpy(&dst_addr->addr.sin, ainfo->ai_addr, sizeof(dst_addr->addr.sin));
-            dst_addr->addr.sin.sin_port = htons(host_uri->port);
-            dst_addr->size = sizeof(dst_addr->addr.sin);
-            break;
-        case AF_INET6:
-            memcpy(&dst_addr->addr.sin6, ainfo->ai_addr, sizeof(dst_addr->addr.sin6));
-            dst_addr->addr.sin6.sin6_port = htons(host_uri->port);
-            dst_addr->size = sizeof(dst_addr->addr.sin6);
-            break;
-        default:
-            GLTH_LOGE(TAG, "DNS lookup response failed");
-            freeaddrinfo(ainfo);
-            return GOLIOTH_ERR_DNS_LOOKUP;
+        struct golioth_dns_addr *addr = &addrs[*num_addrs];
+
+        switch (ai->ai_family)
+        {
+            case AF_INET:
+            {
+                const struct sockaddr_in *sin = (const struct sockaddr_in *) ai->ai_addr;
+                addr->addr_len = sizeof(sin->sin_addr);
+                memcpy(addr->addr, &sin->sin_addr, addr->addr_len);
+                (*num_addrs)++;
+                break;
+            }
+            case AF_INET6:
+            {
+                const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *) ai->ai_addr;
+                addr->addr_len = sizeof(sin6->sin6_addr);
+                memcpy(addr->addr, &sin6->sin6_addr, addr->addr_len);
+                (*num_addrs)++;
+                break;
+            }
+            default:
+                break;
+        }
     }
     freeaddrinfo(ainfo);
 
+    if (*num_addrs == 0)
+    {
+        GLTH_LOGE(TAG, "DNS lookup response failed");
+        return GOLIOTH_ERR_DNS_LOOKUP;
+    }
+
+    return GOLIOTH_OK;
+}
+
+// DNS lookup of host_uri, storing all returned addresses in the client's DNS cache
+static enum golioth_status dns_lookup(struct golioth_client *client, const coap_uri_t *host_uri)
+{
+    struct golioth_dns_addr addrs[GOLIOTH_DNS_CACHE_MAX_ADDRS * 2] = {};
+    size_t num_addrs = 0;
+
+    GOLIOTH_STATUS_RETURN_IF_ERROR(resolve_host(host_uri, addrs, ARRAY_SIZE(addrs), &num_addrs));
+
+    golioth_dns_cache_store(&client->dns, addrs, num_addrs, golioth_sys_now_ms());
+
+    return GOLIOTH_OK;
+}
+
+#if defined(__linux__)
+
+#if CONFIG_GOLIOTH_SHARED_EVENT_LOOP
+static void event_loop_wake(struct golioth_client *client);
+#endif
+
+/// Looks up the server in the background, for all clients, so that a slow DNS server doesn't
+/// hold up the thread running a client while it has an address to connect to.
+///
+/// A client whose cached addresses are stale queues itself, and keeps connecting to the stale
+/// addresses (stale-while-revalidate). The resolver thread copies the result into the client,
+/// and the client stores it in its DNS cache the next time it needs an address. A client on
+/// a shared event loop also waits for the resolver when it has no address at all, instead of
+/// blocking its loop, and is woken when the result is in.
+static struct
+{
+    golioth_sys_thread_t thread;
+    // Protects everything here, and the resolve fields of the clients
+    pthread_mutex_t lock;
+    // Signalled when a client is queued
+    pthread_cond_t queued;
+    struct golioth_client *head;
+    struct golioth_client **tail;
+    // Client being looked up, or NULL. Cleared when the client goes away, to drop the result.
+    struct golioth_client *current;
+} _resolver = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .queued = PTHREAD_COND_INITIALIZER,
+    .tail = &_resolver.head,
+};
+static pthread_once_t _resolver_once = PTHREAD_ONCE_INIT;
+
+static void resolver_thread(void *arg)
+{
+    while (1)
+    {
+        pthread_mutex_lock(&_resolver.lock);
+        while (!_resolver.head)
+        {
+            pthread_cond_wait(&_resolver.queued, &_resolver.lock);
+        }
+
+        struct golioth_client *client = _resolver.head;
+        _resolver.head = client->resolve_next;
+        if (!_resolver.head)
+        {
+            _resolver.tail = &_resolver.head;
+        }
+        _resolver.current = client;
+        pthread_mutex_unlock(&_resolver.lock);
+
+        struct golioth_dns_addr addrs[ARRAY_SIZE(client->resolved_addrs)] = {};
+        size_t num_addrs = 0;
+        coap_uri_t host_uri = {};
+        enum golioth_status status = GOLIOTH_ERR_INVALID_FORMAT;
+        if (coap_split_uri((const uint8_t *) CONFIG_GOLIOTH_COAP_HOST_URI,
+                           strlen(CONFIG_GOLIOTH_COAP_HOST_URI),
+                           &host_uri)
+            >= 0)
+        {
+            status = resolve_host(&host_uri, addrs, ARRAY_SIZE(addrs), &num_addrs);
+        }
+
+        pthread_mutex_lock(&_resolver.lock);
+        if (_resolver.current == client)
+        {
+            memcpy(client->resolved_addrs, addrs, sizeof(addrs));
+            client->num_resolved_addrs = num_addrs;
+            client->resolve_status = status;
+            client->resolved_ms = golioth_sys_now_ms();
+            client->resolve_requested = false;
+            client->resolve_done = true;
+#if CONFIG_GOLIOTH_SHARED_EVENT_LOOP
+            event_loop_wake(client);
+#endif
+        }
+        _resolver.current = NULL;
+        pthread_mutex_unlock(&_resolver.lock);
+    }
+}
+
+static void resolver_init(void)
+{
+    struct golioth_thread_config resolver_cfg = {
+        .name = "coap_resolver",
+        .fn = resolver_thread,
+        .user_arg = NULL,
+        .stack_size = CONFIG_GOLIOTH_COAP_THREAD_STACK_SIZE,
+        .prio = CONFIG_GOLIOTH_COAP_THREAD_PRIORITY,
+    };
+
+    _resolver.thread = golioth_sys_thread_create(&resolver_cfg);
+    if (!_resolver.thread)
+    {
+        GLTH_LOGE(TAG, "Failed to create resolver thread");
+    }
+}
+
+// Start the resolver thread, if it isn't running yet. Returns false if it can't be started.
+static bool resolver_start(void)
+{
+    pthread_once(&_resolver_once, resolver_init);
+    return (_resolver.thread != NULL);
+}
+
+// Have the resolver look up the server for the client, unless it already is. Returns false
+// if there is no resolver thread.
+static bool resolver_request(struct golioth_client *client)
+{
+    if (!resolver_start())
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&_resolver.lock);
+
+    if (!client->resolve_requested && !client->resolve_done)
+    {
+        client->resolve_requested = true;
+        client->resolve_next = NULL;
+        *_resolver.tail = client;
+        _resolver.tail = &client->resolve_next;
+        pthread_cond_signal(&_resolver.queued);
+    }
+
+    pthread_mutex_unlock(&_resolver.lock);
+
+    return true;
+}
+
+// Store the result of a lookup by the resolver in the client's DNS cache, if there is one.
+// Returns true if there was, whether the lookup succeeded or not.
+static bool resolver_collect(struct golioth_client *client)
+{
+    pthread_mutex_lock(&_resolver.lock);
+
+    bool done = client->resolve_done;
+    bool failed = done && (client->resolve_status != GOLIOTH_OK);
+    if (done)
+    {
+        client->resolve_done = false;
+        if (!failed)
+        {
+            golioth_dns_cache_store(&client->dns,
+                                    client->resolved_addrs,
+                                    client->num_resolved_addrs,
+                                    client->resolved_ms);
+        }
+    }
+
+    pthread_mutex_unlock(&_resolver.lock);
+
+    if (failed && golioth_dns_cache_current(&client->dns))
+    {
+        GLTH_LOGW(TAG, "Using previously resolved address");
+    }
+
+    return done;
+}
+
+// Make sure the resolver doesn't touch a client that is going away
+static void resolver_cancel(struct golioth_client *client)
+{
+    pthread_mutex_lock(&_resolver.lock);
+
+    for (struct golioth_client **next = &_resolver.head; *next; next = &(*next)->resolve_next)
+    {
+        if (*next == client)
+        {
+            *next = client->resolve_next;
+            if (!*next)
+            {
+                _resolver.tail = next;
+            }
+            break;
+        }
+    }
+
+    if (_resolver.current == client)
+    {
+        _resolver.current = NULL;
+    }
+
+    pthread_mutex_unlock(&_resolver.lock);
+}
+#else
+static bool resolver_request(struct golioth_client *client)
+{
+    return false;
+}
+
+static bool resolver_collect(struct golioth_client *client)
+{
+    return false;
+}
+#endif  // defined(__linux__)
+
+// Destination address of host_uri, from the DNS cache. Stale addresses are used while the
+// resolver refreshes them in the background. Only a client with its own thread and no address
+// at all, or without a resolver thread, waits for a lookup here: the shared event loop has
+// the resolver fill the cache before starting a session.
+static enum golioth_status get_coap_dst_address(struct golioth_client *client,
+                                                const coap_uri_t *host_uri,
+                                                coap_address_t *dst_addr)
+{
+    resolver_collect(client);
+
+    if (!golioth_dns_cache_is_fresh(&client->dns, golioth_sys_now_ms()))
+    {
+        bool have_addr = (golioth_dns_cache_current(&client->dns) != NULL);
+        if (have_addr && resolver_request(client))
+        {
+            GLTH_LOGD(TAG, "Refreshing server address in the background");
+        }
+        else if (!client->event_loop)
+        {
+            enum golioth_status status = dns_lookup(client, host_uri);
+            if (status != GOLIOTH_OK)
+            {
+                if (!have_addr)
+                {
+                    return status;
+                }
+                GLTH_LOGW(TAG, "Using previously resolved address");
+            }
+        }
+    }
+
+    const struct golioth_dns_addr *addr = golioth_dns_cache_current(&client->dns);
+    if (!addr)
+    {
+        return GOLIOTH_ERR_DNS_LOOKUP;
+    }
+
+    coap_address_init(dst_addr);
+
+    if (addr->addr_len == sizeof(dst_addr->addr.sin.sin_addr))
+    {
+        dst_addr->addr.sin.sin_family = AF_INET;
+        memcpy(&dst_addr->addr.sin.sin_addr, addr->addr, addr->addr_len);
+        dst_addr->addr.sin.sin_port = htons(host_uri->port);
+        dst_addr->size = sizeof(dst_addr->addr.sin);
+    }
+    else
+    {
+        dst_addr->addr.sin6.sin6_family = AF_INET6;
+        memcpy(&dst_addr->addr.sin6.sin6_addr, addr->addr, addr->addr_len);
+        dst_addr->addr.sin6.sin6_port = htons(host_uri->port);
+        dst_addr->size = sizeof(dst_addr->addr.sin6);
+    }
+
     return GOLIOTH_OK;
 }
 
@@ -330,8 +724,26 @@ static void golioth_coap_add_token(coap_pdu_t *req_pdu,
     coap_add_token(req_pdu, req->token_len, req->token);
 }
 
-static void golioth_coap_add_path(coap_pdu_t *request, const char *path_prefix, const char *path)
+static void golioth_coap_add_path(coap_pdu_t *request, const golioth_coap_request_msg_t *req)
 {
+    const struct golioth_path *path_handle = req->path_handle;
+
+    if (path_handle)
+    {
+        // Already split into segments
+        for (size_t i = 0; i < path_handle->num_segments; i++)
+        {
+            coap_add_option(request,
+                            COAP_OPTION_URI_PATH,
+                            path_handle->segment_lens[i],
+                            path_handle->segments[i]);
+        }
+        return;
+    }
+
+    const char *path_prefix = req->path_prefix;
+    const char *path = req->path;
+
     if (!path_prefix)
     {
         path_prefix = "";
@@ -439,7 +851,7 @@ static void golioth_coap_get(golioth_coap_request_msg_t *req, coap_session_t *se
     }
 
     golioth_coap_add_token(req_pdu, req, session);
-    golioth_coap_add_path(req_pdu, req->path_prefix, req->path);
+    golioth_coap_add_path(req_pdu, req);
     golioth_coap_add_accept(req_pdu, req->get.content_type);
     coap_send(session, req_pdu);
 }
@@ -455,7 +867,13 @@ static void golioth_coap_get_block(golioth_coap_request_msg_t *req,
         return;
     }
 
-    if (req->get_block.block_index == 0)
+    // Blocks of the same transfer share a token, which must not be reused while a
+    // previous block request is still waiting for a response.
+    const void *block_token_owner = golioth_token_table_find(&client->reqs_by_token,
+                                                             client->block_token,
+                                                             client->block_token_len);
+
+    if (req->get_block.block_index == 0 || block_token_owner)
     {
         // Save this token for further blocks
         golioth_coap_add_token(req_pdu, req, session);
@@ -472,64 +890,111 @@ static void golioth_coap_get_block(golioth_coap_request_msg_t *req,
         req->token_len = client->block_token_len;
     }
 
-    golioth_coap_add_path(req_pdu, req->path_prefix, req->path);
+    golioth_coap_add_path(req_pdu, req);
     golioth_coap_add_block2(req_pdu, req->get_block.block_index, req->get_block.block_size);
     coap_send(session, req_pdu);
 }
 
-static void golioth_coap_post(golioth_coap_request_msg_t *req, coap_session_t *session)
+static enum golioth_status golioth_coap_post(golioth_coap_request_msg_t *req,
+                                             coap_session_t *session)
 {
-    coap_pdu_t *req_pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_POST, session);
+    bool confirmable = (req->post.delivery_mode == GOLIOTH_DELIVERY_CONFIRMABLE);
+    coap_pdu_t *req_pdu = coap_new_pdu(confirmable ? COAP_MESSAGE_CON : COAP_MESSAGE_NON,
+                                       COAP_REQUEST_CODE_POST,
+                                       session);
     if (!req_pdu)
     {
         GLTH_LOGE(TAG, "coap_new_pdu() post failed");
-        return;
+        return GOLIOTH_ERR_MEM_ALLOC;
     }
 
     golioth_coap_add_token(req_pdu, req, session);
-    golioth_coap_add_path(req_pdu, req->path_prefix, req->path);
+    golioth_coap_add_path(req_pdu, req);
     golioth_coap_add_content_type(req_pdu, req->post.content_type);
+    if (req->post.delivery_mode == GOLIOTH_DELIVERY_NO_RESPONSE)
+    {
+        unsigned char buf[1];
+        coap_add_option(req_pdu,
+                        GOLIOTH_COAP_OPTION_NO_RESPONSE,
+                        coap_encode_var_safe(buf,
+                                             sizeof(buf),
+                                             GOLIOTH_COAP_NO_RESPONSE_SUPPRESS_ALL),
+                        buf);
+    }
     coap_add_data(req_pdu, req->post.payload_size, (unsigned char *) req->post.payload);
-    coap_send(session, req_pdu);
+    req->client->stats.bytes_out += req->post.payload_size;
+
+    return (coap_send(session, req_pdu) == COAP_INVALID_MID) ? GOLIOTH_ERR_FAIL : GOLIOTH_OK;
 }
 
-static void golioth_coap_delete(golioth_coap_request_msg_t *req, coap_session_t *session)
+static enum golioth_status golioth_coap_post_block(golioth_coap_request_msg_t *req,
+                                                   coap_session_t *session)
 {
-    coap_pdu_t *req_pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_DELETE, session);
+    uint8_t *block = golioth_payload_pool_alloc(req->post_block.block_size);
+    if (!block)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+
+    size_t block_len = 0;
+    enum golioth_status status = golioth_coap_post_block_read(req, block, &block_len);
+    if (status != GOLIOTH_OK)
+    {
+        goto free_block;
+    }
+
+    coap_pdu_t *req_pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_POST, session);
     if (!req_pdu)
     {
-        GLTH_LOGE(TAG, "coap_new_pdu() delete failed");
-        return;
+        GLTH_LOGE(TAG, "coap_new_pdu() post block failed");
+        status = GOLIOTH_ERR_MEM_ALLOC;
+        goto free_block;
     }
 
-    golioth_coap_add_token(req_pdu, req, session);
-    golioth_coap_add_path(req_pdu, req->path_prefix, req->path);
-    coap_send(session, req_pdu);
-}
+    // All blocks of an upload share the token of the first block
+    if (req->post_block.block_index == 0)
+    {
+        golioth_coap_add_token(req_pdu, req, session);
+    }
+    else
+    {
+        coap_add_token(req_pdu, req->token_len, req->token);
+    }
 
-static void add_observation(golioth_coap_request_msg_t *req, struct golioth_client *client)
-{
-    // scan for available (not used) observation slot
-    golioth_coap_observe_info_t *obs_info = NULL;
-    bool found_slot = false;
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
+    golioth_coap_add_path(req_pdu, req);
+    golioth_coap_add_content_type(req_pdu, req->post_block.content_type);
+
+    unsigned char buf[4];
+    coap_add_option(req_pdu,
+                    COAP_OPTION_BLOCK1,
+                    coap_encode_var_safe(buf, sizeof(buf), golioth_coap_post_block_option(req)),
+                    buf);
+    coap_add_data(req_pdu, block_len, block);
+    if (coap_send(session, req_pdu) == COAP_INVALID_MID)
     {
-        obs_info = &client->observations[i];
-        if (!obs_info->in_use)
-        {
-            found_slot = true;
-            break;
-        }
+        GLTH_LOGE(TAG, "coap_send() post block failed");
+        status = GOLIOTH_ERR_FAIL;
+        goto free_block;
     }
+    req->client->stats.bytes_out += block_len;
+
+free_block:
+    golioth_payload_pool_free(block);
+    return status;
+}
 
-    if (!found_slot)
+static void golioth_coap_delete(golioth_coap_request_msg_t *req, coap_session_t *session)
+{
+    coap_pdu_t *req_pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_DELETE, session);
+    if (!req_pdu)
     {
-        GLTH_LOGE(TAG, "Unable to observe path %s, no slots available", req->path);
+        GLTH_LOGE(TAG, "coap_new_pdu() delete failed");
         return;
     }
 
-    obs_info->in_use = true;
-    memcpy(&obs_info->req, req, sizeof(obs_info->req));
+    golioth_coap_add_token(req_pdu, req, session);
+    golioth_coap_add_path(req_pdu, req);
+    coap_send(session, req_pdu);
 }
 
 static void golioth_coap_observe(golioth_coap_request_msg_t *req,
@@ -552,7 +1017,7 @@ static void golioth_coap_observe(golioth_coap_request_msg_t *req,
                     coap_encode_var_safe(optbuf, sizeof(optbuf), COAP_OBSERVE_ESTABLISH),
                     optbuf);
 
-    golioth_coap_add_path(req_pdu, req->path_prefix, req->path);
+    golioth_coap_add_path(req_pdu, req);
     golioth_coap_add_accept(req_pdu, req->observe.content_type);
 
     coap_send(session, req_pdu);
@@ -560,23 +1025,41 @@ static void golioth_coap_observe(golioth_coap_request_msg_t *req,
 
 static void reestablish_observations(struct golioth_client *client, coap_session_t *session)
 {
-    golioth_coap_observe_info_t *obs_info = NULL;
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
+    for (golioth_coap_observation_t *obs = client->observations; obs; obs = obs->next)
     {
-        obs_info = &client->observations[i];
-        if (obs_info->in_use)
-        {
-            golioth_coap_observe(&obs_info->req, client, session);
-        }
+        golioth_coap_request_msg_t *req = &obs->pending.req;
+
+        // Tokens are only valid within a session, so a new token will be used
+        golioth_token_table_remove(&client->reqs_by_token, req->token, req->token_len);
+        golioth_coap_observe(req, client, session);
+        golioth_token_table_insert(&client->reqs_by_token,
+                                   req->token,
+                                   req->token_len,
+                                   &obs->pending);
     }
 }
 
-static enum golioth_status create_context(struct golioth_client *client, coap_context_t **context)
+void golioth_coap_client_free_observations(struct golioth_client *client)
 {
-    *context = coap_new_context(NULL);
-    if (!*context)
+    golioth_coap_observation_t *obs = client->observations;
+    while (obs)
     {
-        GLTH_LOGE(TAG, "Failed to create CoAP context");
+        golioth_coap_observation_t *next = obs->next;
+        golioth_sys_free(obs);
+        obs = next;
+    }
+    client->observations = NULL;
+    client->num_observations = 0;
+
+    golioth_token_table_deinit(&client->reqs_by_token);
+}
+
+static enum golioth_status create_context(struct golioth_client *client, coap_context_t **context)
+{
+    *context = coap_new_context(NULL);
+    if (!*context)
+    {
+        GLTH_LOGE(TAG, "Failed to create CoAP context");
         return GOLIOTH_ERR_MEM_ALLOC;
     }
 
@@ -625,13 +1108,24 @@ static enum golioth_status create_session(struct golioth_client *client,
 
     // Get destination address of host
     coap_address_t dst_addr = {};
-    GOLIOTH_STATUS_RETURN_IF_ERROR(get_coap_dst_address(&host_uri, &dst_addr));
+    GOLIOTH_STATUS_RETURN_IF_ERROR(get_coap_dst_address(client, &host_uri, &dst_addr));
 
     GLTH_LOGI(TAG, "Start CoAP session with host: %s", CONFIG_GOLIOTH_COAP_HOST_URI);
 
     char client_sni[256] = {};
     memcpy(client_sni, host_uri.host.s, MIN(host_uri.host.length, sizeof(client_sni) - 1));
 
+    client->use_cid = false;
+#if GOLIOTH_LIBCOAP_USE_CID
+    client->use_cid = coap_dtls_cid_is_supported();
+    if (!client->use_cid)
+    {
+        GLTH_LOGW(TAG, "DTLS Connection ID not supported by the TLS library");
+    }
+#elif CONFIG_GOLIOTH_USE_CONNECTION_ID
+    GLTH_LOGW(TAG, "DTLS Connection ID needs libcoap 4.3.4 or later");
+#endif
+
     enum golioth_auth_type auth_type = client->config.credentials.auth_type;
 
     if (auth_type == GOLIOTH_TLS_AUTH_TYPE_PSK)
@@ -648,6 +1142,9 @@ static enum golioth_status create_session(struct golioth_client *client,
             .psk_info.key.s = (const uint8_t *) psk_creds.psk,
             .psk_info.key.length = psk_creds.psk_len,
         };
+#if GOLIOTH_LIBCOAP_USE_CID
+        dtls_psk.use_cid = client->use_cid;
+#endif
         *session =
             coap_new_client_session_psk2(context, NULL, &dst_addr, COAP_PROTO_DTLS, &dtls_psk);
     }
@@ -686,6 +1183,9 @@ static enum golioth_status create_session(struct golioth_client *client,
                         },
                 },
         };
+#if GOLIOTH_LIBCOAP_USE_CID
+        dtls_pki.use_cid = client->use_cid;
+#endif
         *session =
             coap_new_client_session_pki(context, NULL, &dst_addr, COAP_PROTO_DTLS, &dtls_pki);
     }
@@ -704,235 +1204,374 @@ static enum golioth_status create_session(struct golioth_client *client,
     return GOLIOTH_OK;
 }
 
-static enum golioth_status coap_io_loop_once(struct golioth_client *client,
-                                             coap_context_t *context,
-                                             coap_session_t *session)
+// How often to check the request queue while waiting for responses, on ports
+// where the request queue can't be polled together with the CoAP socket.
+#define PENDING_REQ_QUEUE_POLL_MS 100
+
+static void call_request_callback_with_status(struct golioth_client *client,
+                                              const golioth_coap_request_msg_t *req,
+                                              enum golioth_status status)
 {
-    golioth_coap_request_msg_t request_msg = {};
-    int mbox_fd = golioth_sys_sem_get_fd(client->request_queue->fill_count_sem);
+    struct golioth_response response = {};
+    response.status = status;
 
-    if (mbox_fd >= 0)
+    // Observations are only ended by the client, without a callback
+    if (req->type != GOLIOTH_COAP_REQUEST_OBSERVE)
     {
-        fd_set readfds;
+        call_callback(client, req, &response, NULL, 0, false);
+    }
+}
 
-        FD_ZERO(&readfds);
-        FD_SET(mbox_fd, &readfds);
+static void notify_request_complete(golioth_coap_request_msg_t *req)
+{
+    uint32_t bits = req->got_response ? RESPONSE_RECEIVED_EVENT_BIT : RESPONSE_TIMEOUT_EVENT_BIT;
+    if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK && req->post_block.failed)
+    {
+        bits = RESPONSE_ERROR_EVENT_BIT;
+    }
+
+    golioth_completion_signal(req->request_complete, bits);
+}
+
+static void release_pending_req(struct golioth_client *client, golioth_coap_pending_req_t *pending)
+{
+    golioth_coap_request_msg_t *req = &pending->req;
+
+    if (req->type == GOLIOTH_COAP_REQUEST_OBSERVE)
+    {
+        // Observations stay in the table to receive notifications
+        return;
+    }
+
+    golioth_token_table_remove(&client->reqs_by_token, req->token, req->token_len);
+    pending->in_use = false;
+}
+
+/// Remove a request from the in-flight list and notify whoever is waiting for it
+static void complete_inflight_req(struct golioth_client *client, size_t index)
+{
+    golioth_coap_pending_req_t *pending = client->inflight_reqs[index];
+
+    client->inflight_reqs[index] = client->inflight_reqs[--client->num_inflight_reqs];
+    pending->awaiting_response = false;
+
+    notify_request_complete(&pending->req);
+    release_pending_req(client, pending);
+}
+
+/// Fail all requests that are still waiting for a response, e.g. when the session ends
+static void fail_inflight_reqs(struct golioth_client *client)
+{
+    while (client->num_inflight_reqs > 0)
+    {
+        golioth_coap_pending_req_t *pending = client->inflight_reqs[0];
+        client->stats.drops.timeout++;
+        call_request_callback_with_status(client, &pending->req, GOLIOTH_ERR_TIMEOUT);
+        complete_inflight_req(client, 0);
+    }
+}
+
+/// Milliseconds until the earliest in-flight request deadline, or -1 if nothing is in flight
+static int32_t time_till_next_deadline_ms(struct golioth_client *client)
+{
+    if (client->num_inflight_reqs == 0)
+    {
+        return -1;
+    }
+
+    uint64_t now_ms = golioth_sys_now_ms();
+    uint64_t next_deadline_ms = UINT64_MAX;
+    for (size_t i = 0; i < client->num_inflight_reqs; i++)
+    {
+        next_deadline_ms = min(next_deadline_ms, client->inflight_reqs[i]->deadline_ms);
+    }
+
+    if (next_deadline_ms <= now_ms)
+    {
+        return 0;
+    }
+    return (int32_t) min(next_deadline_ms - now_ms, INT32_MAX);
+}
 
-        coap_io_process_with_fds(context, COAP_IO_WAIT, mbox_fd + 1, &readfds, NULL, NULL);
+static uint32_t to_coap_io_timeout(int32_t timeout_ms)
+{
+    if (timeout_ms < 0)
+    {
+        return COAP_IO_WAIT;
+    }
+    if (timeout_ms == 0)
+    {
+        return COAP_IO_NO_WAIT;
+    }
+    return timeout_ms;
+}
+
+static golioth_coap_pending_req_t *alloc_pending_req(struct golioth_client *client,
+                                                     const golioth_coap_request_msg_t *request_msg)
+{
+    golioth_coap_pending_req_t *pending = NULL;
 
-        if (!FD_ISSET(mbox_fd, &readfds))
+    if (request_msg->type == GOLIOTH_COAP_REQUEST_OBSERVE)
+    {
+        if (client->num_observations >= CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS)
         {
-            return GOLIOTH_OK;
+            GLTH_LOGE(TAG, "Unable to observe path %s, no slots available", request_msg->path);
+            return NULL;
         }
 
-        bool got_request_msg = golioth_mbox_recv(client->request_queue, &request_msg, 0);
-        if (!got_request_msg)
+        golioth_coap_observation_t *obs = golioth_sys_malloc(sizeof(golioth_coap_observation_t));
+        if (!obs)
         {
-            GLTH_LOGE(TAG, "Failed to get request_message from mbox");
-            return GOLIOTH_ERR_IO;
+            GLTH_LOGE(TAG, "Unable to observe path %s, out of memory", request_msg->path);
+            return NULL;
         }
+        memset(obs, 0, sizeof(*obs));
+
+        obs->next = client->observations;
+        client->observations = obs;
+        client->num_observations++;
+
+        pending = &obs->pending;
     }
     else
     {
-        // Wait for request message, with timeout
-        bool got_request_msg = golioth_mbox_recv(client->request_queue,
-                                                 &request_msg,
-                                                 CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
-        if (!got_request_msg)
+        for (size_t i = 0; i < CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS; i++)
         {
-            // No requests, so process other pending IO (e.g. observations)
-            GLTH_LOGV(TAG, "Idle io process start");
-            coap_io_process(context, COAP_IO_NO_WAIT);
-            GLTH_LOGV(TAG, "Idle io process end");
-            return GOLIOTH_OK;
+            if (!client->pending_reqs[i].in_use)
+            {
+                pending = &client->pending_reqs[i];
+                break;
+            }
         }
+        // The caller only dequeues requests when there's room in the in-flight window
+        assert(pending);
     }
 
+    pending->in_use = true;
+    pending->req = *request_msg;
+    pending->req.client = client;
+    pending->req.got_response = false;
+    pending->req.got_nack = false;
+
+    return pending;
+}
+
+static void handle_request_msg(struct golioth_client *client,
+                               coap_session_t *session,
+                               golioth_coap_request_msg_t *request_msg)
+{
     // Make sure the request isn't too old
-    if (golioth_sys_now_ms() > request_msg.ageout_ms)
+    if (golioth_sys_now_ms() > request_msg->ageout_ms)
     {
         GLTH_LOGW(TAG,
                   "Ignoring request that has aged out, type %d, path %s",
-                  request_msg.type,
-                  (request_msg.path ? request_msg.path : "N/A"));
+                  request_msg->type,
+                  (request_msg->path ? request_msg->path : "N/A"));
 
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_POST && request_msg.post.payload_size > 0)
-        {
-            golioth_sys_free(request_msg.post.payload);
-        }
+        client->stats.drops.ageout++;
+        golioth_coap_request_msg_release_payload(request_msg);
+        golioth_completion_signal(request_msg->request_complete, RESPONSE_TIMEOUT_EVENT_BIT);
+        return;
+    }
 
-        if (request_msg.request_complete_event)
-        {
-            assert(request_msg.request_complete_ack_sem);
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
-        }
-        return GOLIOTH_OK;
+    if (request_msg->type > GOLIOTH_COAP_REQUEST_OBSERVE)
+    {
+        GLTH_LOGW(TAG, "Unknown request_msg type: %u", request_msg->type);
+        golioth_coap_request_msg_release_payload(request_msg);
+        golioth_completion_signal(request_msg->request_complete, RESPONSE_TIMEOUT_EVENT_BIT);
+        return;
     }
 
+    // Make room for the token up front, so the request can always be tracked once sent
+    golioth_coap_pending_req_t *pending = NULL;
+    if (GOLIOTH_OK
+        == golioth_token_table_reserve(&client->reqs_by_token,
+                                       golioth_token_table_count(&client->reqs_by_token) + 1))
+    {
+        pending = alloc_pending_req(client, request_msg);
+    }
+
+    if (!pending)
+    {
+        golioth_coap_request_msg_release_payload(request_msg);
+        call_request_callback_with_status(client, request_msg, GOLIOTH_ERR_MEM_ALLOC);
+        notify_request_complete(request_msg);
+        return;
+    }
+
+    golioth_coap_request_msg_t *req = &pending->req;
+
+    apply_rto(client, session, pending);
+
     // Handle message and send request to server
-    bool request_is_valid = true;
-    switch (request_msg.type)
+    switch (req->type)
     {
         case GOLIOTH_COAP_REQUEST_EMPTY:
             GLTH_LOGD(TAG, "Handle EMPTY");
-            golioth_coap_empty(&request_msg, session);
+            golioth_coap_empty(req, session);
             break;
         case GOLIOTH_COAP_REQUEST_GET:
-            GLTH_LOGD(TAG, "Handle GET %s", request_msg.path);
-            golioth_coap_get(&request_msg, session);
+            GLTH_LOGD(TAG, "Handle GET %s", req->path);
+            golioth_coap_get(req, session);
             break;
         case GOLIOTH_COAP_REQUEST_GET_BLOCK:
-            GLTH_LOGD(TAG, "Handle GET_BLOCK %s", request_msg.path);
-            golioth_coap_get_block(&request_msg, client, session);
+            GLTH_LOGD(TAG, "Handle GET_BLOCK %s", req->path);
+            golioth_coap_get_block(req, client, session);
             break;
         case GOLIOTH_COAP_REQUEST_POST:
-            GLTH_LOGD(TAG, "Handle POST %s", request_msg.path);
-            golioth_coap_post(&request_msg, session);
-            assert(request_msg.post.payload);
-            golioth_sys_free(request_msg.post.payload);
+        {
+            GLTH_LOGD(TAG, "Handle POST %s", req->path_handle ? req->path_handle->str : req->path);
+            enum golioth_status status = golioth_coap_post(req, session);
+            // libcoap has copied the payload into the PDU
+            golioth_coap_request_msg_release_payload(req);
+            if (req->post.delivery_mode != GOLIOTH_DELIVERY_CONFIRMABLE)
+            {
+                if (status == GOLIOTH_OK)
+                {
+                    golioth_client_stats_request_sent(&client->stats, req, golioth_sys_now_ms());
+                }
+                // There is no response to wait for, so the request is complete once sent
+                req->got_response = (status == GOLIOTH_OK);
+                call_request_callback_with_status(client, req, status);
+                notify_request_complete(req);
+                pending->in_use = false;
+                return;
+            }
+            break;
+        }
+        case GOLIOTH_COAP_REQUEST_POST_BLOCK:
+        {
+            GLTH_LOGD(TAG, "Handle POST_BLOCK %s", req->path);
+            enum golioth_status status = golioth_coap_post_block(req, session);
+            if (status != GOLIOTH_OK)
+            {
+                // Nothing was sent, so there is no response to wait for
+                req->post_block.failed = true;
+                call_request_callback_with_status(client, req, status);
+                notify_request_complete(req);
+                pending->in_use = false;
+                return;
+            }
             break;
+        }
         case GOLIOTH_COAP_REQUEST_DELETE:
-            GLTH_LOGD(TAG, "Handle DELETE %s", request_msg.path);
-            golioth_coap_delete(&request_msg, session);
+            GLTH_LOGD(TAG, "Handle DELETE %s", req->path);
+            golioth_coap_delete(req, session);
             break;
         case GOLIOTH_COAP_REQUEST_OBSERVE:
-            GLTH_LOGD(TAG, "Handle OBSERVE %s", request_msg.path);
-            golioth_coap_observe(&request_msg, client, session);
-            add_observation(&request_msg, client);
+            GLTH_LOGD(TAG, "Handle OBSERVE %s", req->path);
+            golioth_coap_observe(req, client, session);
             break;
-        default:
-            GLTH_LOGW(TAG, "Unknown request_msg type: %u", request_msg.type);
-            request_is_valid = false;
-            break;
-    }
-
-    if (!request_is_valid)
-    {
-        return GOLIOTH_OK;
     }
 
     // If we get here, then a confirmable request has been sent to the server,
-    // and we should wait for a response.
-    client->pending_req = &request_msg;
-    request_msg.got_response = false;
-    int32_t time_spent_waiting_ms = 0;
-    int32_t timeout_ms = CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S * 1000;
+    // and we should track it until a response arrives.
+    golioth_token_table_insert(&client->reqs_by_token, req->token, req->token_len, pending);
 
-    if (request_msg.ageout_ms != GOLIOTH_SYS_WAIT_FOREVER)
-    {
-        int32_t time_till_ageout_ms = (int32_t) (request_msg.ageout_ms - golioth_sys_now_ms());
-        timeout_ms = min(timeout_ms, time_till_ageout_ms);
-    }
+    pending->awaiting_response = true;
+    start_response_timer(client, pending);
+    golioth_client_stats_request_sent(&client->stats, req, pending->sent_ms);
+    client->inflight_reqs[client->num_inflight_reqs++] = pending;
+}
 
-    bool io_error = false;
-    while (time_spent_waiting_ms < timeout_ms)
+static enum golioth_status process_inflight_reqs(struct golioth_client *client,
+                                                 coap_session_t *session)
+{
+    enum golioth_status status = GOLIOTH_OK;
+    bool got_response = false;
+    uint64_t now_ms = golioth_sys_now_ms();
+
+    size_t i = 0;
+    while (i < client->num_inflight_reqs)
     {
-        int32_t remaining_ms = timeout_ms - time_spent_waiting_ms;
-        int32_t wait_ms = min(1000, remaining_ms);
-        int32_t num_ms = coap_io_process(context, wait_ms);
-        if (num_ms < 0)
+        golioth_coap_pending_req_t *pending = client->inflight_reqs[i];
+        golioth_coap_request_msg_t *req = &pending->req;
+
+        if (req->got_response)
         {
-            io_error = true;
-            break;
+            GLTH_LOGD(TAG,
+                      "Received response in %" PRIu32 " ms",
+                      (uint32_t) (now_ms - pending->sent_ms));
+            got_response = true;
         }
-        else
+        else if (req->got_nack)
         {
-            time_spent_waiting_ms += num_ms;
-            if (request_msg.got_response)
-            {
-                GLTH_LOGD(TAG, "Received response in %" PRId32 " ms", time_spent_waiting_ms);
-                break;
-            }
-            else if (request_msg.got_nack)
-            {
-                GLTH_LOGE(TAG, "Got NACKed request");
-                break;
-            }
-            else
-            {
-                // During normal operation, there will be other kinds of IO to process,
-                // in which case we will get here.
-                // Since we haven't received the response yet, just keep waiting.
-            }
+            // Only fails this request, unless the NACK handler found the session broken
+            GLTH_LOGE(TAG,
+                      "Got NACKed request (req type: %d, path: %s%s)",
+                      req->type,
+                      req->path_prefix ? req->path_prefix : "",
+                      req->path);
+            client->stats.drops.nack++;
+            call_request_callback_with_status(client, req, GOLIOTH_ERR_NACK);
         }
-    }
-    client->pending_req = NULL;
+        else if (now_ms >= pending->deadline_ms)
+        {
+            GLTH_LOGE(TAG,
+                      "Timeout: no response after %" PRIu32
+                      " ms (req type: %d, path: %s%s, %u in flight)",
+                      (uint32_t) (now_ms - pending->sent_ms),
+                      req->type,
+                      req->path_prefix ? req->path_prefix : "",
+                      req->path,
+                      (unsigned int) client->num_inflight_reqs);
 
-    if (request_msg.request_complete_event)
-    {
-        assert(request_msg.request_complete_ack_sem);
+            client->stats.drops.timeout++;
+            call_request_callback_with_status(client, req, GOLIOTH_ERR_TIMEOUT);
 
-        if (request_msg.got_response)
-        {
-            golioth_event_group_set_bits(request_msg.request_complete_event,
-                                         RESPONSE_RECEIVED_EVENT_BIT);
+            // A timeout only fails this request. If the server has been silent for the whole
+            // time the request was waiting, the session may be dead: give up on it if it
+            // never connected, or if an EMPTY request (keepalive or probe) got no answer
+            // either. Otherwise, probe the server with an EMPTY request.
+            if (client->last_rx_ms < pending->sent_ms)
+            {
+                if (!client->session_connected || req->type == GOLIOTH_COAP_REQUEST_EMPTY)
+                {
+                    status = GOLIOTH_ERR_TIMEOUT;
+                }
+                else if (!client->probe_queued)
+                {
+                    client->probe_queued =
+                        (golioth_coap_client_empty(client, false, GOLIOTH_SYS_WAIT_FOREVER)
+                         == GOLIOTH_OK);
+                }
+            }
         }
         else
         {
-            golioth_event_group_set_bits(request_msg.request_complete_event,
-                                         RESPONSE_TIMEOUT_EVENT_BIT);
+            i++;
+            continue;
         }
 
-        // Wait for user thread to receive the event.
-        golioth_sys_sem_take(request_msg.request_complete_ack_sem, GOLIOTH_SYS_WAIT_FOREVER);
-
-        // Now it's safe to delete the event and semaphore.
-        golioth_event_group_destroy(request_msg.request_complete_event);
-        golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
-    }
+        if (req->type == GOLIOTH_COAP_REQUEST_EMPTY)
+        {
+            client->probe_queued = false;
+        }
 
-    if (io_error)
-    {
-        GLTH_LOGE(TAG, "Error in coap_io_process");
-        return GOLIOTH_ERR_IO;
+        // Moves the last in-flight request to index i
+        complete_inflight_req(client, i);
     }
 
-    if (request_msg.got_nack)
+    if (client->session_failed)
     {
+        GLTH_LOGE(TAG, "Session failed");
         return GOLIOTH_ERR_NACK;
     }
 
-    if (time_spent_waiting_ms >= timeout_ms)
+    if (status == GOLIOTH_ERR_TIMEOUT)
     {
         GLTH_LOGE(TAG, "Timeout: never got a response from the server");
 
-        if (coap_session_get_state(session) == COAP_SESSION_STATE_HANDSHAKE)
+        if (!client->session_connected)
         {
-            // TODO - customize error message based on PSK vs cert usage
-            GLTH_LOGE(TAG, "DTLS handshake failed. Maybe your PSK-ID or PSK is incorrect?");
+            // Try the next address of the server on the next session
+            golioth_dns_cache_failed(&client->dns);
         }
 
-        // Call user's callback with GOLIOTH_ERR_TIMEOUT
-        // TODO - simplify, put callback directly in request which removes if/else branches
-        struct golioth_response response = {};
-        response.status = GOLIOTH_ERR_TIMEOUT;
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_GET && request_msg.get.callback)
-        {
-            request_msg.get
-                .callback(client, &response, request_msg.path, NULL, 0, request_msg.get.arg);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_GET_BLOCK
-                 && request_msg.get_block.callback)
-        {
-            request_msg.get_block.callback(client,
-                                           &response,
-                                           request_msg.path,
-                                           NULL,
-                                           0,
-                                           false,
-                                           request_msg.get_block.arg);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_POST && request_msg.post.callback)
-        {
-            request_msg.post.callback(client, &response, request_msg.path, request_msg.post.arg);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_DELETE && request_msg.delete.callback)
+        if (coap_session_get_state(session) == COAP_SESSION_STATE_HANDSHAKE)
         {
-            request_msg.delete.callback(client,
-                                        &response,
-                                        request_msg.path,
-                                        request_msg.delete.arg);
+            // TODO - customize error message based on PSK vs cert usage
+            GLTH_LOGE(TAG, "DTLS handshake failed. Maybe your PSK-ID or PSK is incorrect?");
         }
 
         golioth_sys_client_disconnected(client);
@@ -943,13 +1582,14 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client,
                                    client->event_callback_arg);
         }
         client->session_connected = false;
-        return GOLIOTH_ERR_TIMEOUT;
+        return status;
     }
 
-    if (!client->session_connected)
+    if (got_response && !client->session_connected)
     {
         // Transitioned from not connected to connected
         GLTH_LOGI(TAG, "Golioth CoAP client connected");
+        golioth_dns_cache_connected(&client->dns);
         golioth_sys_client_connected(client);
         if (client->event_callback)
         {
@@ -957,147 +1597,994 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client,
                                    GOLIOTH_CLIENT_EVENT_CONNECTED,
                                    client->event_callback_arg);
         }
+        client->session_connected = true;
     }
 
-    client->session_connected = true;
     return GOLIOTH_OK;
 }
 
-static void on_keepalive(golioth_sys_timer_t timer, void *arg)
+#if defined(__linux__)
+// When libcoap is built with epoll support, coap_io_process_with_fds() ignores the extra fds,
+// so the client waits on its own epoll set instead: libcoap's epoll fd, which also becomes
+// readable when libcoap's retransmission timer expires, and the request queue.
+static void open_io_epoll(struct golioth_client *client, coap_context_t *context)
 {
-    struct golioth_client *client = arg;
-    if (client->is_running && golioth_client_num_items_in_request_queue(client) == 0
-        && !client->pending_req)
+    int coap_fd = coap_context_get_coap_fd(context);
+    int mbox_fd = golioth_mbox_wait_fd(client->request_queue);
+
+    client->io_epoll_fd = -1;
+    client->io_epoll_mbox_armed = false;
+
+    if (coap_fd < 0 || mbox_fd < 0)
     {
-        golioth_coap_client_empty(client, false, GOLIOTH_SYS_WAIT_FOREVER);
+        return;
     }
-}
 
-bool golioth_client_is_running(struct golioth_client *client)
-{
-    if (!client)
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
     {
-        return false;
+        GLTH_LOGW(TAG, "epoll_create1 failed, errno: %d", errno);
+        return;
     }
-    return client->is_running;
+
+    struct epoll_event coap_event = {.events = EPOLLIN, .data.fd = coap_fd};
+    struct epoll_event mbox_event = {.events = 0, .data.fd = mbox_fd};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, coap_fd, &coap_event) < 0
+        || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, mbox_fd, &mbox_event) < 0)
+    {
+        GLTH_LOGW(TAG, "epoll_ctl failed, errno: %d", errno);
+        close(epoll_fd);
+        return;
+    }
+
+    client->io_epoll_fd = epoll_fd;
 }
 
-// Note: libcoap is not thread safe, so all rx/tx I/O for the session must be
-// done in this thread.
-static void golioth_coap_client_thread(void *arg)
+static void close_io_epoll(struct golioth_client *client)
 {
-    struct golioth_client *client = arg;
-    assert(client);
-
-    while (1)
+    if (client->io_epoll_fd >= 0)
     {
-        coap_context_t *coap_context = NULL;
-        coap_session_t *coap_session = NULL;
+        close(client->io_epoll_fd);
+        client->io_epoll_fd = -1;
+    }
+}
 
-        client->end_session = false;
-        client->session_connected = false;
+// Wait up to timeout_ms (forever if negative) for CoAP I/O, or for a request if can_send.
+// Returns the result of coap_io_process(), and sets *mbox_ready if a request is queued.
+static int io_epoll_wait(struct golioth_client *client,
+                         coap_context_t *context,
+                         bool can_send,
+                         int32_t timeout_ms,
+                         bool *mbox_ready)
+{
+    int mbox_fd = golioth_mbox_wait_fd(client->request_queue);
+    struct epoll_event events[2];
 
-        client->is_running = false;
-        GLTH_LOGD(TAG, "Waiting for the \"run\" signal");
-        golioth_sys_sem_take(client->run_sem, GOLIOTH_SYS_WAIT_FOREVER);
-        golioth_sys_sem_give(client->run_sem);
-        GLTH_LOGD(TAG, "Received \"run\" signal");
-        client->is_running = true;
+    *mbox_ready = false;
 
-        if (create_context(client, &coap_context) != GOLIOTH_OK)
+    // Level triggered, so only wait for the request queue while there's room for requests
+    if (can_send != client->io_epoll_mbox_armed)
+    {
+        struct epoll_event mbox_event = {
+            .events = can_send ? EPOLLIN : 0,
+            .data.fd = mbox_fd,
+        };
+        if (epoll_ctl(client->io_epoll_fd, EPOLL_CTL_MOD, mbox_fd, &mbox_event) < 0)
         {
-            goto cleanup;
+            GLTH_LOGE(TAG, "epoll_ctl failed, errno: %d", errno);
+            return -1;
         }
+        client->io_epoll_mbox_armed = can_send;
+    }
 
-        if (create_session(client, coap_context, &coap_session) != GOLIOTH_OK)
+    int num_events = epoll_wait(client->io_epoll_fd, events, ARRAY_SIZE(events), timeout_ms);
+    if (num_events < 0 && errno != EINTR)
+    {
+        GLTH_LOGE(TAG, "epoll_wait failed, errno: %d", errno);
+        return -1;
+    }
+
+    for (int i = 0; i < num_events; i++)
+    {
+        if (events[i].data.fd == mbox_fd)
         {
-            goto cleanup;
+            *mbox_ready = true;
         }
+    }
 
-        // Seed the session token generator
-        uint8_t seed_token[8];
-        size_t seed_token_len;
-        uint32_t randint = golioth_sys_rand();
-        seed_token_len = coap_encode_var_safe8(seed_token, sizeof(seed_token), randint);
-        coap_session_init_token(coap_session, seed_token_len, seed_token);
+    // Let libcoap handle whatever woke us up on its side, without blocking
+    return coap_io_process(context, COAP_IO_NO_WAIT);
+}
+#else
+static void open_io_epoll(struct golioth_client *client, coap_context_t *context)
+{
+    client->io_epoll_fd = -1;
+}
 
-        // Enqueue an asynchronous EMPTY request immediately.
-        //
-        // This is done so we can determine quickly whether we are connected
-        // to the cloud or not (libcoap does not tell us when it's connected
-        // for some reason, so this is a workaround for that).
-        if (golioth_client_num_items_in_request_queue(client) == 0)
-        {
-            golioth_coap_client_empty(client, false, GOLIOTH_SYS_WAIT_FOREVER);
-        }
+static void close_io_epoll(struct golioth_client *client) {}
 
-        // If we are re-connecting and had prior observations, set
-        // them up again now (tokens will be updated).
-        reestablish_observations(client, coap_session);
+static int io_epoll_wait(struct golioth_client *client,
+                         coap_context_t *context,
+                         bool can_send,
+                         int32_t timeout_ms,
+                         bool *mbox_ready)
+{
+    *mbox_ready = false;
+    return -1;
+}
+#endif
 
-        GLTH_LOGI(TAG, "Entering CoAP I/O loop");
-        int iteration = 0;
-        while (!client->end_session)
-        {
-            // Check if we should still run (non-blocking)
-            if (!golioth_sys_sem_take(client->run_sem, 0))
-            {
-                GLTH_LOGI(TAG, "Stopping");
-                break;
-            }
-            golioth_sys_sem_give(client->run_sem);
+// Handle request_msg, which was just received from the request queue, then the rest of a
+// burst while the in-flight window has room, instead of taking another trip through the loop
+// for each request
+static void handle_request_burst(struct golioth_client *client,
+                                 coap_session_t *session,
+                                 golioth_coap_request_msg_t *request_msg)
+{
+    handle_request_msg(client, session, request_msg);
+    golioth_coap_request_queue_release(client->request_queue);
 
-            if (coap_io_loop_once(client, coap_context, coap_session) != GOLIOTH_OK)
-            {
-                client->end_session = true;
-            }
-            iteration++;
-        }
+    int num_handled = 1;
+    while (num_handled < CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS
+           && client->num_inflight_reqs < CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS
+           && golioth_coap_request_queue_recv(client->request_queue, request_msg, 0))
+    {
+        handle_request_msg(client, session, request_msg);
+        golioth_coap_request_queue_release(client->request_queue);
+        num_handled++;
+    }
+}
+
+static enum golioth_status coap_io_loop_once(struct golioth_client *client,
+                                             coap_context_t *context,
+                                             coap_session_t *session)
+{
+    golioth_coap_request_msg_t request_msg = {};
+    bool got_request_msg = false;
+    bool can_send = (client->num_inflight_reqs < CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS);
+    int32_t timeout_ms = time_till_next_deadline_ms(client);
+    int io_result = 0;
+    int mbox_fd = golioth_mbox_wait_fd(client->request_queue);
 
-    cleanup:
-        GLTH_LOGI(TAG, "Ending session");
+    if (client->io_epoll_fd >= 0)
+    {
+        bool mbox_ready;
 
-        if (client->event_callback && client->session_connected)
+        io_result = io_epoll_wait(client, context, can_send, timeout_ms, &mbox_ready);
+        if (io_result >= 0 && mbox_ready)
         {
-            client->event_callback(client,
-                                   GOLIOTH_CLIENT_EVENT_DISCONNECTED,
-                                   client->event_callback_arg);
+            got_request_msg =
+                golioth_coap_request_queue_recv(client->request_queue, &request_msg, 0);
         }
-        client->session_connected = false;
+    }
+    else if (mbox_fd >= 0)
+    {
+        fd_set readfds;
 
-        if (coap_session)
+        FD_ZERO(&readfds);
+        if (can_send)
         {
-            coap_session_release(coap_session);
+            FD_SET(mbox_fd, &readfds);
         }
-        if (coap_context)
+
+        io_result = coap_io_process_with_fds(context,
+                                             to_coap_io_timeout(timeout_ms),
+                                             mbox_fd + 1,
+                                             &readfds,
+                                             NULL,
+                                             NULL);
+
+        if (can_send && FD_ISSET(mbox_fd, &readfds))
         {
-            coap_free_context(coap_context);
+            // May still come up empty, if the message that woke us up is queued behind one
+            // that is still being written
+            got_request_msg =
+                golioth_coap_request_queue_recv(client->request_queue, &request_msg, 0);
         }
-
-        // Small delay before starting a new session
-        golioth_sys_msleep(1000);
     }
-}
-
-struct golioth_client *golioth_client_create(const struct golioth_client_config *config)
-{
-    if (!_initialized)
+    else if (client->num_inflight_reqs == 0)
     {
-        // Initialize libcoap prior to any coap_* function calls.
-        coap_startup();
-
-#if GOLIOTH_OVERRIDE_LIBCOAP_LOG_HANDLER
-        // Connect logs from libcoap to the ESP logger
-        coap_set_log_handler(coap_log_handler);
-        coap_set_log_level(COAP_LOG_INFO);
+        // Wait for request message, with timeout
+        got_request_msg =
+            golioth_coap_request_queue_recv(client->request_queue,
+                                            &request_msg,
+                                            CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
+        if (!got_request_msg)
+        {
+            // No requests, so process other pending IO (e.g. observations)
+            GLTH_LOGV(TAG, "Idle io process start");
+            io_result = coap_io_process(context, COAP_IO_NO_WAIT);
+            GLTH_LOGV(TAG, "Idle io process end");
+        }
+    }
+    else
+    {
+        // Waiting for responses. Pick up new requests in between, if there's room for them.
+        if (can_send)
+        {
+            got_request_msg =
+                golioth_coap_request_queue_recv(client->request_queue, &request_msg, 0);
+            timeout_ms = min(timeout_ms, PENDING_REQ_QUEUE_POLL_MS);
+        }
+        if (!got_request_msg)
+        {
+            io_result = coap_io_process(context, to_coap_io_timeout(timeout_ms));
+        }
+    }
+
+    if (io_result < 0)
+    {
+        GLTH_LOGE(TAG, "Error in coap_io_process");
+        return GOLIOTH_ERR_IO;
+    }
+
+    if (got_request_msg)
+    {
+        handle_request_burst(client, session, &request_msg);
+    }
+
+    return process_inflight_reqs(client, session);
+}
+
+static void on_keepalive(golioth_sys_timer_t timer, void *arg)
+{
+    struct golioth_client *client = arg;
+    if (client->is_running && golioth_client_num_items_in_request_queue(client) == 0
+        && client->num_inflight_reqs == 0)
+    {
+        golioth_coap_client_empty(client, false, GOLIOTH_SYS_WAIT_FOREVER);
+    }
+}
+
+bool golioth_client_is_running(struct golioth_client *client)
+{
+    if (!client)
+    {
+        return false;
+    }
+    return client->is_running;
+}
+
+// Start a new session. On failure, stop_session() cleans up what was started.
+static enum golioth_status start_session(struct golioth_client *client)
+{
+    client->end_session = false;
+    client->session_connected = false;
+    client->session_failed = false;
+    client->probe_queued = false;
+
+    GOLIOTH_STATUS_RETURN_IF_ERROR(create_context(client, &client->coap_context));
+    GOLIOTH_STATUS_RETURN_IF_ERROR(
+        create_session(client, client->coap_context, &client->coap_session));
+    client->num_sessions++;
+
+    // Seed the session token generator
+    uint8_t seed_token[8];
+    size_t seed_token_len;
+    uint32_t randint = golioth_sys_rand();
+    seed_token_len = coap_encode_var_safe8(seed_token, sizeof(seed_token), randint);
+    coap_session_init_token(client->coap_session, seed_token_len, seed_token);
+
+    // Allow as many confirmable requests in flight as we are willing to track
+    coap_session_set_nstart(client->coap_session, CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS);
+
+    // Enqueue an asynchronous EMPTY request immediately.
+    //
+    // This is done so we can determine quickly whether we are connected
+    // to the cloud or not (libcoap does not tell us when it's connected
+    // for some reason, so this is a workaround for that).
+    if (golioth_client_num_items_in_request_queue(client) == 0)
+    {
+        golioth_coap_client_empty(client, false, GOLIOTH_SYS_WAIT_FOREVER);
+    }
+
+    // If we are re-connecting and had prior observations, set
+    // them up again now (tokens will be updated).
+    reestablish_observations(client, client->coap_session);
+
+    return GOLIOTH_OK;
+}
+
+static void stop_session(struct golioth_client *client)
+{
+    GLTH_LOGI(TAG, "Ending session");
+
+    if (client->event_callback && client->session_connected)
+    {
+        client->event_callback(client,
+                               GOLIOTH_CLIENT_EVENT_DISCONNECTED,
+                               client->event_callback_arg);
+    }
+    client->session_connected = false;
+
+    close_io_epoll(client);
+
+    if (client->coap_session)
+    {
+        coap_session_release(client->coap_session);
+        client->coap_session = NULL;
+    }
+    if (client->coap_context)
+    {
+        coap_free_context(client->coap_context);
+        client->coap_context = NULL;
+    }
+
+    // Anything still waiting for a response won't get one on this session
+    fail_inflight_reqs(client);
+}
+
+// Note: libcoap is not thread safe, so all rx/tx I/O for the session must be
+// done in this thread.
+static void golioth_coap_client_thread(void *arg)
+{
+    struct golioth_client *client = arg;
+    assert(client);
+
+    while (1)
+    {
+        client->is_running = false;
+        golioth_sys_sem_give(client->stopped_sem);
+        GLTH_LOGD(TAG, "Waiting for the \"run\" signal");
+        golioth_sys_sem_take(client->run_sem, GOLIOTH_SYS_WAIT_FOREVER);
+        golioth_sys_sem_give(client->run_sem);
+        GLTH_LOGD(TAG, "Received \"run\" signal");
+        client->is_running = true;
+
+        if (start_session(client) == GOLIOTH_OK)
+        {
+            open_io_epoll(client, client->coap_context);
+
+            GLTH_LOGI(TAG, "Entering CoAP I/O loop");
+            while (!client->end_session)
+            {
+                // Check if we should still run (non-blocking)
+                if (!golioth_sys_sem_take(client->run_sem, 0))
+                {
+                    GLTH_LOGI(TAG, "Stopping");
+                    break;
+                }
+                golioth_sys_sem_give(client->run_sem);
+
+                if (coap_io_loop_once(client, client->coap_context, client->coap_session)
+                    != GOLIOTH_OK)
+                {
+                    client->end_session = true;
+                }
+            }
+        }
+
+        stop_session(client);
+
+        // Small delay before starting a new session
+        golioth_sys_msleep(1000);
+    }
+}
+
+#if CONFIG_GOLIOTH_SHARED_EVENT_LOOP
+
+#if !defined(__linux__)
+#error "CONFIG_GOLIOTH_SHARED_EVENT_LOOP is only supported on Linux"
+#endif
+
+/// A thread running the sessions of many clients.
+///
+/// The thread waits for the fds of all its clients on a single epoll set: the libcoap fd, the
+/// request queue fd, and a wake fd that is written when the client is started, stopped or
+/// removed. It only services the clients whose fds are ready, and the clients whose next
+/// deadline (request timeout, keepalive or session retry) has passed, which it finds in a
+/// min-heap. Each client is always run by the same event loop, so libcoap only ever sees one
+/// thread per context.
+///
+/// Clients are only ever removed by the event loop thread itself, after handling a batch of
+/// epoll events, so that no event refers to a client that is gone.
+///
+/// Nothing that may block for long runs on the thread: server lookups are done by the
+/// resolver thread, and callbacks are documented to not block (see config.h).
+struct golioth_event_loop
+{
+    golioth_sys_thread_t thread;
+    int epoll_fd;
+    // Protects deadlines and the event_loop field of the clients. Never held while a client
+    // is serviced.
+    pthread_mutex_t lock;
+    // Signalled when the thread has let go of a client
+    pthread_cond_t client_removed;
+    // When each client needs servicing next, if not only when one of its fds is ready
+    struct golioth_deadline_heap deadlines;
+    atomic_size_t num_clients;
+    // Incremented for each batch of epoll events, to service each client once per batch
+    uint64_t pass;
+};
+
+// The wake fd of a client is told apart from its other fds by setting the lowest bit of the
+// client pointer in its epoll events
+#define EVENT_LOOP_WAKE_TAG ((uintptr_t) 1)
+
+static struct golioth_event_loop _event_loops[CONFIG_GOLIOTH_SHARED_EVENT_LOOP_NUM_THREADS];
+static pthread_once_t _event_loops_once = PTHREAD_ONCE_INIT;
+static bool _event_loops_started;
+
+static void event_loop_wake(struct golioth_client *client)
+{
+    uint64_t one = 1;
+    if (write(client->event_loop_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        GLTH_LOGW(TAG, "Failed to wake event loop, errno: %d", errno);
+    }
+}
+
+static void event_loop_set_mbox_armed(struct golioth_event_loop *loop,
+                                      struct golioth_client *client,
+                                      bool armed)
+{
+    if (armed == client->io_epoll_mbox_armed)
+    {
+        return;
+    }
+
+    struct epoll_event mbox_event = {
+        .events = armed ? EPOLLIN : 0,
+        .data.ptr = client,
+    };
+    int mbox_fd = golioth_mbox_wait_fd(client->request_queue);
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, mbox_fd, &mbox_event) < 0)
+    {
+        GLTH_LOGE(TAG, "epoll_ctl failed, errno: %d", errno);
+        return;
+    }
+    client->io_epoll_mbox_armed = armed;
+}
+
+static enum golioth_status event_loop_start_session(struct golioth_event_loop *loop,
+                                                    struct golioth_client *client)
+{
+    GOLIOTH_STATUS_RETURN_IF_ERROR(start_session(client));
+
+    // libcoap's epoll fd also becomes readable when its retransmission timer expires
+    int coap_fd = coap_context_get_coap_fd(client->coap_context);
+    if (coap_fd < 0)
+    {
+        GLTH_LOGE(TAG, "Shared event loop needs libcoap built with epoll support");
+        return GOLIOTH_ERR_NOT_IMPLEMENTED;
+    }
+
+    struct epoll_event coap_event = {.events = EPOLLIN, .data.ptr = client};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, coap_fd, &coap_event) < 0)
+    {
+        GLTH_LOGE(TAG, "epoll_ctl failed, errno: %d", errno);
+        return GOLIOTH_ERR_IO;
+    }
+
+    client->keepalive_due_ms =
+        golioth_sys_now_ms() + 1000 * (uint64_t) CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S;
+
+    // Send the requests queued by start_session()
+    client->io_pending = true;
+
+    return GOLIOTH_OK;
+}
+
+static void event_loop_stop_session(struct golioth_event_loop *loop, struct golioth_client *client)
+{
+    if (client->coap_context)
+    {
+        int coap_fd = coap_context_get_coap_fd(client->coap_context);
+        if (coap_fd >= 0)
+        {
+            // Fails if the session never got this far, which is fine
+            epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, coap_fd, NULL);
+        }
+    }
+
+    stop_session(client);
+
+    // Small delay before starting a new session
+    client->next_session_ms = golioth_sys_now_ms() + 1000;
+}
+
+// Start, service or stop the session of a client, as needed. Returns the number of
+// milliseconds until the client needs servicing again, or -1 if it only needs it when one
+// of its fds becomes ready.
+static int32_t event_loop_service(struct golioth_event_loop *loop,
+                                  struct golioth_client *client,
+                                  uint64_t now_ms)
+{
+    bool run = atomic_load(&client->run_requested);
+
+    if (client->coap_session)
+    {
+        if (!run)
+        {
+            GLTH_LOGI(TAG, "Stopping");
+            client->end_session = true;
+        }
+        else
+        {
+            if (CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S > 0 && now_ms >= client->keepalive_due_ms)
+            {
+                client->keepalive_due_ms =
+                    now_ms + 1000 * (uint64_t) CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S;
+                on_keepalive(NULL, client);
+                client->io_pending = true;
+            }
+
+            if (client->io_pending || time_till_next_deadline_ms(client) == 0)
+            {
+                client->io_pending = false;
+
+                if (coap_io_process(client->coap_context, COAP_IO_NO_WAIT) < 0)
+                {
+                    GLTH_LOGE(TAG, "Error in coap_io_process");
+                    client->end_session = true;
+                }
+                else
+                {
+                    golioth_coap_request_msg_t request_msg = {};
+                    if (client->num_inflight_reqs < CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS
+                        && golioth_coap_request_queue_recv(client->request_queue, &request_msg, 0))
+                    {
+                        handle_request_burst(client, client->coap_session, &request_msg);
+                    }
+
+                    if (process_inflight_reqs(client, client->coap_session) != GOLIOTH_OK)
+                    {
+                        client->end_session = true;
+                    }
+                }
+            }
+        }
+
+        if (client->end_session)
+        {
+            event_loop_stop_session(loop, client);
+        }
+    }
+
+    if (!client->coap_session)
+    {
+        client->is_running = run;
+        if (!run)
+        {
+            golioth_sys_sem_give(client->stopped_sem);
+            event_loop_set_mbox_armed(loop, client, false);
+            return -1;
+        }
+
+        now_ms = golioth_sys_now_ms();
+        if (now_ms < client->next_session_ms)
+        {
+            event_loop_set_mbox_armed(loop, client, false);
+            return (int32_t) (client->next_session_ms - now_ms);
+        }
+
+        // Without an address, wait for the resolver, which wakes the client when it's done.
+        // A stale address is used while it's refreshed.
+        if (!resolver_collect(client) && !golioth_dns_cache_current(&client->dns))
+        {
+            resolver_request(client);
+            event_loop_set_mbox_armed(loop, client, false);
+            return -1;
+        }
+
+        if (event_loop_start_session(loop, client) != GOLIOTH_OK)
+        {
+            event_loop_stop_session(loop, client);
+            event_loop_set_mbox_armed(loop, client, false);
+            return 1000;
+        }
+
+        // Service the new session right away
+        return 0;
+    }
+
+    // Level triggered, so only wait for the request queue while there's room for requests
+    bool can_send = (client->num_inflight_reqs < CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS);
+    if (can_send)
+    {
+        golioth_mbox_wait_fd(client->request_queue);
+    }
+    event_loop_set_mbox_armed(loop, client, can_send);
+
+    int32_t timeout_ms = time_till_next_deadline_ms(client);
+    if (CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S > 0)
+    {
+        now_ms = golioth_sys_now_ms();
+        int32_t keepalive_ms = (client->keepalive_due_ms > now_ms)
+            ? (int32_t) (client->keepalive_due_ms - now_ms)
+            : 0;
+        if (timeout_ms < 0 || keepalive_ms < timeout_ms)
+        {
+            timeout_ms = keepalive_ms;
+        }
+    }
+
+    return timeout_ms;
+}
+
+// Update when the client needs servicing next, from the timeout returned by
+// event_loop_service()
+static void event_loop_schedule(struct golioth_event_loop *loop,
+                                struct golioth_client *client,
+                                int32_t timeout_ms)
+{
+    pthread_mutex_lock(&loop->lock);
+    if (timeout_ms < 0)
+    {
+        golioth_deadline_heap_remove(&loop->deadlines, &client->event_loop_deadline);
+    }
+    else
+    {
+        golioth_deadline_heap_set(&loop->deadlines,
+                                  &client->event_loop_deadline,
+                                  golioth_sys_now_ms() + timeout_ms);
+    }
+    pthread_mutex_unlock(&loop->lock);
+}
+
+// Service a client, unless it's leaving, in which case it's put on the leaving list instead
+static void event_loop_run(struct golioth_event_loop *loop,
+                           struct golioth_client *client,
+                           uint64_t now_ms,
+                           struct golioth_client **leaving)
+{
+    if (!atomic_load(&client->leaving_event_loop))
+    {
+        event_loop_schedule(loop, client, event_loop_service(loop, client, now_ms));
+        return;
+    }
+
+    // Not due anymore, so it can only be seen again through its fds in this batch
+    event_loop_schedule(loop, client, -1);
+    client->event_loop_next = *leaving;
+    *leaving = client;
+}
+
+// Let go of a client that is leaving
+static void event_loop_remove(struct golioth_event_loop *loop, struct golioth_client *client)
+{
+    if (client->coap_session || client->coap_context)
+    {
+        event_loop_stop_session(loop, client);
+    }
+
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, golioth_mbox_wait_fd(client->request_queue), NULL);
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, client->event_loop_wake_fd, NULL);
+
+    client->is_running = false;
+    golioth_sys_sem_give(client->stopped_sem);
+
+    pthread_mutex_lock(&loop->lock);
+    client->event_loop = NULL;
+    atomic_fetch_sub(&loop->num_clients, 1);
+    pthread_cond_broadcast(&loop->client_removed);
+    pthread_mutex_unlock(&loop->lock);
+}
+
+// Milliseconds until the earliest deadline of the clients, or -1 if none has a deadline
+static int event_loop_timeout_ms(struct golioth_event_loop *loop)
+{
+    pthread_mutex_lock(&loop->lock);
+    struct golioth_deadline_heap_entry *next = golioth_deadline_heap_peek(&loop->deadlines);
+    uint64_t deadline_ms = next ? next->deadline_ms : 0;
+    pthread_mutex_unlock(&loop->lock);
+
+    if (!next)
+    {
+        return -1;
+    }
+
+    uint64_t now_ms = golioth_sys_now_ms();
+    return (deadline_ms > now_ms) ? (int) MIN(deadline_ms - now_ms, INT32_MAX) : 0;
+}
+
+// Take the clients whose deadline has passed out of the heap, and return them as a list
+static struct golioth_client *event_loop_take_due(struct golioth_event_loop *loop,
+                                                  uint64_t now_ms)
+{
+    struct golioth_client *due = NULL;
+
+    pthread_mutex_lock(&loop->lock);
+    struct golioth_deadline_heap_entry *next;
+    while ((next = golioth_deadline_heap_peek(&loop->deadlines)) && next->deadline_ms <= now_ms)
+    {
+        golioth_deadline_heap_remove(&loop->deadlines, next);
+
+        struct golioth_client *client =
+            CONTAINER_OF(next, struct golioth_client, event_loop_deadline);
+        client->event_loop_next = due;
+        due = client;
+    }
+    pthread_mutex_unlock(&loop->lock);
+
+    return due;
+}
+
+static void event_loop_thread(void *arg)
+{
+    struct golioth_event_loop *loop = arg;
+    struct epoll_event events[16];
+
+    while (1)
+    {
+        int num_events =
+            epoll_wait(loop->epoll_fd, events, ARRAY_SIZE(events), event_loop_timeout_ms(loop));
+        if (num_events < 0)
+        {
+            if (errno != EINTR)
+            {
+                GLTH_LOGE(TAG, "epoll_wait failed, errno: %d", errno);
+                golioth_sys_msleep(100);
+            }
+            continue;
+        }
+
+        for (int i = 0; i < num_events; i++)
+        {
+            uintptr_t data = (uintptr_t) events[i].data.ptr;
+            struct golioth_client *client = (struct golioth_client *) (data & ~EVENT_LOOP_WAKE_TAG);
+            if (data & EVENT_LOOP_WAKE_TAG)
+            {
+                uint64_t count;
+                if (read(client->event_loop_wake_fd, &count, sizeof(count)) < 0
+                    && errno != EAGAIN)
+                {
+                    GLTH_LOGW(TAG, "Failed to read wake fd, errno: %d", errno);
+                }
+            }
+            else
+            {
+                client->io_pending = true;
+            }
+        }
+
+        loop->pass++;
+        struct golioth_client *leaving = NULL;
+        uint64_t now_ms = golioth_sys_now_ms();
+
+        // Clients whose fds are ready, each once even if several of its fds are
+        for (int i = 0; i < num_events; i++)
+        {
+            uintptr_t data = (uintptr_t) events[i].data.ptr;
+            struct golioth_client *client = (struct golioth_client *) (data & ~EVENT_LOOP_WAKE_TAG);
+            if (client->event_loop_pass != loop->pass)
+            {
+                client->event_loop_pass = loop->pass;
+                event_loop_run(loop, client, now_ms, &leaving);
+            }
+        }
+
+        // Clients whose deadline has passed
+        now_ms = golioth_sys_now_ms();
+        struct golioth_client *due = event_loop_take_due(loop, now_ms);
+        while (due)
+        {
+            struct golioth_client *client = due;
+            due = client->event_loop_next;
+            event_loop_run(loop, client, now_ms, &leaving);
+        }
+
+        while (leaving)
+        {
+            struct golioth_client *client = leaving;
+            leaving = client->event_loop_next;
+            event_loop_remove(loop, client);
+        }
+    }
+}
+
+static bool event_loop_init(struct golioth_event_loop *loop)
+{
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0)
+    {
+        GLTH_LOGE(TAG, "Failed to create event loop epoll fd, errno: %d", errno);
+        return false;
+    }
+
+    pthread_mutex_init(&loop->lock, NULL);
+    pthread_cond_init(&loop->client_removed, NULL);
+    golioth_deadline_heap_init(&loop->deadlines);
+    atomic_init(&loop->num_clients, 0);
+
+    struct golioth_thread_config thread_cfg = {
+        .name = "coap_event_loop",
+        .fn = event_loop_thread,
+        .user_arg = loop,
+        .stack_size = CONFIG_GOLIOTH_COAP_THREAD_STACK_SIZE,
+        .prio = CONFIG_GOLIOTH_COAP_THREAD_PRIORITY,
+    };
+
+    loop->thread = golioth_sys_thread_create(&thread_cfg);
+    return (loop->thread != NULL);
+}
+
+static void event_loops_init(void)
+{
+    if (!resolver_start())
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(_event_loops); i++)
+    {
+        if (!event_loop_init(&_event_loops[i]))
+        {
+            return;
+        }
+    }
+
+    _event_loops_started = true;
+}
+
+// Hand the client to the event loop with the fewest clients
+static enum golioth_status event_loop_add(struct golioth_client *client)
+{
+    pthread_once(&_event_loops_once, event_loops_init);
+    if (!_event_loops_started)
+    {
+        return GOLIOTH_ERR_FAIL;
+    }
+
+    struct golioth_event_loop *loop = &_event_loops[0];
+    for (size_t i = 1; i < ARRAY_SIZE(_event_loops); i++)
+    {
+        if (atomic_load(&_event_loops[i].num_clients) < atomic_load(&loop->num_clients))
+        {
+            loop = &_event_loops[i];
+        }
+    }
+
+    int mbox_fd = golioth_mbox_wait_fd(client->request_queue);
+    if (mbox_fd < 0)
+    {
+        GLTH_LOGE(TAG, "Shared event loop needs a request queue fd");
+        return GOLIOTH_ERR_NOT_IMPLEMENTED;
+    }
+
+    client->event_loop_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (client->event_loop_wake_fd < 0)
+    {
+        GLTH_LOGE(TAG, "Failed to create wake fd, errno: %d", errno);
+        return GOLIOTH_ERR_IO;
+    }
+
+    client->io_epoll_mbox_armed = false;
+    golioth_deadline_heap_entry_init(&client->event_loop_deadline);
+
+    pthread_mutex_lock(&loop->lock);
+
+    // Make sure the thread can always schedule the client, without allocating memory
+    enum golioth_status status =
+        golioth_deadline_heap_reserve(&loop->deadlines, atomic_load(&loop->num_clients) + 1);
+    if (status != GOLIOTH_OK)
+    {
+        pthread_mutex_unlock(&loop->lock);
+        goto close_wake_fd;
+    }
+
+    struct epoll_event mbox_event = {.events = 0, .data.ptr = client};
+    struct epoll_event wake_event = {
+        .events = EPOLLIN,
+        .data.ptr = (void *) ((uintptr_t) client | EVENT_LOOP_WAKE_TAG),
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, mbox_fd, &mbox_event) < 0)
+    {
+        pthread_mutex_unlock(&loop->lock);
+        GLTH_LOGE(TAG, "epoll_ctl failed, errno: %d", errno);
+        status = GOLIOTH_ERR_IO;
+        goto close_wake_fd;
+    }
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, client->event_loop_wake_fd, &wake_event) < 0)
+    {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, mbox_fd, NULL);
+        pthread_mutex_unlock(&loop->lock);
+        GLTH_LOGE(TAG, "epoll_ctl failed, errno: %d", errno);
+        status = GOLIOTH_ERR_IO;
+        goto close_wake_fd;
+    }
+
+    client->event_loop = loop;
+    atomic_fetch_add(&loop->num_clients, 1);
+
+    pthread_mutex_unlock(&loop->lock);
+
+    // Have the thread start the session
+    event_loop_wake(client);
+
+    return GOLIOTH_OK;
+
+close_wake_fd:
+    close(client->event_loop_wake_fd);
+    client->event_loop_wake_fd = -1;
+    return status;
+}
+
+void golioth_coap_client_wake(struct golioth_client *client)
+{
+    if (client->event_loop)
+    {
+        event_loop_wake(client);
+    }
+}
+
+void golioth_coap_client_leave_event_loop(struct golioth_client *client)
+{
+    struct golioth_event_loop *loop = client->event_loop;
+    if (!loop)
+    {
+        return;
+    }
+
+    atomic_store(&client->leaving_event_loop, true);
+    event_loop_wake(client);
+
+    // Wait for the event loop to let go of the client
+    pthread_mutex_lock(&loop->lock);
+    while (client->event_loop)
+    {
+        pthread_cond_wait(&loop->client_removed, &loop->lock);
+    }
+    pthread_mutex_unlock(&loop->lock);
+
+    // The resolver wakes the client through its wake fd
+    resolver_cancel(client);
+
+    close(client->event_loop_wake_fd);
+    client->event_loop_wake_fd = -1;
+}
+#else
+static enum golioth_status event_loop_add(struct golioth_client *client)
+{
+    return GOLIOTH_ERR_NOT_IMPLEMENTED;
+}
+
+void golioth_coap_client_wake(struct golioth_client *client) {}
+
+void golioth_coap_client_leave_event_loop(struct golioth_client *client) {}
+#endif  // CONFIG_GOLIOTH_SHARED_EVENT_LOOP
+
+void golioth_coap_client_cancel_resolve(struct golioth_client *client)
+{
+#if defined(__linux__)
+    resolver_cancel(client);
+#endif
+}
+
+static void client_lib_init(void)
+{
+    // Initialize libcoap prior to any coap_* function calls.
+    coap_startup();
+
+#if GOLIOTH_OVERRIDE_LIBCOAP_LOG_HANDLER
+    // Connect logs from libcoap to the ESP logger
+    coap_set_log_handler(coap_log_handler);
+    coap_set_log_level(COAP_LOG_INFO);
 #endif /* GOLIOTH_OVERRIDE_LIBCOAP_LOG_HANDLER */
 
-        // Seed the random number generator. Used for token generation.
-        time_t t;
-        golioth_sys_srand(time(&t));
+    // Seed the random number generator. Used for token generation.
+    time_t t;
+    golioth_sys_srand(time(&t));
+
+    golioth_payload_pool_init();
+    golioth_completion_pool_init();
+    golioth_coap_request_queue_init();
+#if CONFIG_GOLIOTH_CALLBACK_EXECUTOR
+    golioth_callback_executor_init();
+#endif
+}
 
+struct golioth_client *golioth_client_create(const struct golioth_client_config *config)
+{
+#if defined(__linux__)
+    pthread_once(&_init_once, client_lib_init);
+#else
+    if (!_initialized)
+    {
+        client_lib_init();
         _initialized = true;
     }
+#endif
 
     struct golioth_client *new_client = golioth_sys_malloc(sizeof(struct golioth_client));
     if (!new_client)
@@ -1108,6 +2595,21 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
     memset(new_client, 0, sizeof(struct golioth_client));
 
     new_client->config = *config;
+    golioth_rtt_estimator_init(&new_client->rtt, GOLIOTH_RTT_INITIAL_RTO_MS);
+    golioth_dns_cache_init(&new_client->dns);
+    new_client->io_epoll_fd = -1;
+    new_client->event_loop_wake_fd = -1;
+    golioth_coap_client_restore_warm_cache(new_client, config);
+
+    enum golioth_status status =
+        golioth_token_table_init(&new_client->reqs_by_token,
+                                 CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS
+                                     + CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS);
+    if (status != GOLIOTH_OK)
+    {
+        GLTH_LOGE(TAG, "Failed to allocate request table");
+        goto error;
+    }
 
     new_client->run_sem = golioth_sys_sem_create(1, 0);
     if (!new_client->run_sem)
@@ -1116,50 +2618,78 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
         goto error;
     }
     golioth_sys_sem_give(new_client->run_sem);
+    atomic_init(&new_client->run_requested, true);
 
-    new_client->request_queue = golioth_mbox_create(CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS,
-                                                    sizeof(golioth_coap_request_msg_t));
-    if (!new_client->request_queue)
+    new_client->stopped_sem = golioth_sys_sem_create(1, 0);
+    if (!new_client->stopped_sem)
     {
-        GLTH_LOGE(TAG, "Failed to create request queue");
+        GLTH_LOGE(TAG, "Failed to create stopped semaphore");
         goto error;
     }
 
-    struct golioth_thread_config thread_cfg = {
-        .name = "coap_client",
-        .fn = golioth_coap_client_thread,
-        .user_arg = new_client,
-        .stack_size = CONFIG_GOLIOTH_COAP_THREAD_STACK_SIZE,
-        .prio = CONFIG_GOLIOTH_COAP_THREAD_PRIORITY,
-    };
-
-    new_client->coap_thread_handle = golioth_sys_thread_create(&thread_cfg);
-    if (!new_client->coap_thread_handle)
+    new_client->request_queue = golioth_coap_request_queue_create();
+    if (!new_client->request_queue)
     {
-        GLTH_LOGE(TAG, "Failed to create client thread");
+        GLTH_LOGE(TAG, "Failed to create request queue");
         goto error;
     }
 
-    struct golioth_timer_config keepalive_timer_cfg = {
-        .name = "keepalive",
-        .expiration_ms = max(1000, 1000 * CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S),
-        .fn = on_keepalive,
-        .user_arg = new_client};
-
-    new_client->keepalive_timer = golioth_sys_timer_create(&keepalive_timer_cfg);
-    if (!new_client->keepalive_timer)
+#if CONFIG_GOLIOTH_CALLBACK_EXECUTOR
+    new_client->callback_executor = golioth_callback_executor_get();
+    if (!new_client->callback_executor)
     {
-        GLTH_LOGE(TAG, "Failed to create keepalive timer");
+        GLTH_LOGE(TAG, "Failed to create callback executor");
         goto error;
     }
+#endif
 
-    if (CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S > 0)
+    if (CONFIG_GOLIOTH_SHARED_EVENT_LOOP)
+    {
+        // The event loop takes care of keepalives too
+        if (event_loop_add(new_client) != GOLIOTH_OK)
+        {
+            GLTH_LOGE(TAG, "Failed to add client to event loop");
+            goto error;
+        }
+    }
+    else
     {
-        if (!golioth_sys_timer_start(new_client->keepalive_timer))
+        struct golioth_thread_config thread_cfg = {
+            .name = "coap_client",
+            .fn = golioth_coap_client_thread,
+            .user_arg = new_client,
+            .stack_size = CONFIG_GOLIOTH_COAP_THREAD_STACK_SIZE,
+            .prio = CONFIG_GOLIOTH_COAP_THREAD_PRIORITY,
+        };
+
+        new_client->coap_thread_handle = golioth_sys_thread_create(&thread_cfg);
+        if (!new_client->coap_thread_handle)
         {
-            GLTH_LOGE(TAG, "Failed to start keepalive timer");
+            GLTH_LOGE(TAG, "Failed to create client thread");
             goto error;
         }
+
+        struct golioth_timer_config keepalive_timer_cfg = {
+            .name = "keepalive",
+            .expiration_ms = max(1000, 1000 * CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S),
+            .fn = on_keepalive,
+            .user_arg = new_client};
+
+        new_client->keepalive_timer = golioth_sys_timer_create(&keepalive_timer_cfg);
+        if (!new_client->keepalive_timer)
+        {
+            GLTH_LOGE(TAG, "Failed to create keepalive timer");
+            goto error;
+        }
+
+        if (CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S > 0)
+        {
+            if (!golioth_sys_timer_start(new_client->keepalive_timer))
+            {
+                GLTH_LOGE(TAG, "Failed to start keepalive timer");
+                goto error;
+            }
+        }
     }
 
     new_client->is_running = true;
@@ -1185,3 +2715,4 @@ void golioth_client_set_packet_loss_percent(uint8_t percent)
     GLTH_LOGI(TAG, "Setting packet loss to %s", buf);
     coap_debug_set_packet_loss(buf);
 }
+
@@ -1,23 +1,136 @@
 #pragma once
 
 #include "coap_client.h"
+#include "deadline_heap.h"
+#include "dns_cache.h"
 #include "mbox.h"
+#include "rtt_estimator.h"
+#include "token_table.h"
+
+typedef struct
+{
+    bool in_use;
+    /// Set while the request is waiting for its (first) response
+    bool awaiting_response;
+    /// Time (since boot) in milliseconds when the request was sent
+    uint64_t sent_ms;
+    /// Retransmission timeout the request was sent with, in milliseconds
+    uint32_t rto_ms;
+    /// Time (since boot) in milliseconds after which the request is considered stalled
+    uint64_t deadline_ms;
+    golioth_coap_request_msg_t req;
+} golioth_coap_pending_req_t;
+
+typedef struct golioth_coap_observation
+{
+    struct golioth_coap_observation *next;
+    golioth_coap_pending_req_t pending;
+} golioth_coap_observation_t;
+
+struct golioth_event_loop;
 
 struct golioth_client
 {
     golioth_mbox_t request_queue;
     golioth_sys_thread_t coap_thread_handle;
+    // Runs callbacks of asynchronous requests, NULL if they run on the CoAP thread
+    struct golioth_callback_executor *callback_executor;
     golioth_sys_sem_t run_sem;
+    // Given by the thread running the client each time it stops, for golioth_client_stop()
+    golioth_sys_sem_t stopped_sem;
+    // Set by golioth_client_start() and golioth_client_stop(), for the shared event loop,
+    // which can't block on run_sem
+    atomic_bool run_requested;
     golioth_sys_timer_t keepalive_timer;
     bool is_running;
     bool end_session;
     bool session_connected;
+    // Set by the NACK handler when libcoap reports a failure of the whole session (DTLS
+    // failure, or a NACK not tied to a request), rather than of one request
+    bool session_failed;
+    // Whether an EMPTY request is queued to find out if the server is still there, after a
+    // request timed out without hearing from the server
+    bool probe_queued;
     struct golioth_client_config config;
-    golioth_coap_request_msg_t *pending_req;
-    golioth_coap_observe_info_t observations[CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS];
+    // In-flight requests and active observations, keyed by token
+    struct golioth_token_table reqs_by_token;
+    // Storage for in-flight requests (observations are allocated when added)
+    golioth_coap_pending_req_t pending_reqs[CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS];
+    // Requests waiting for a response, in no particular order
+    golioth_coap_pending_req_t *inflight_reqs[CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS];
+    size_t num_inflight_reqs;
+    // Observations, re-established on every new session
+    golioth_coap_observation_t *observations;
+    size_t num_observations;
+    // Current session, only touched by the thread running the client
+    struct coap_context_t *coap_context;
+    struct coap_session_t *coap_session;
+    // Shared event loop running the client, NULL if it has its own thread. See
+    // CONFIG_GOLIOTH_SHARED_EVENT_LOOP.
+    struct golioth_event_loop *event_loop;
+    // Written to have the event loop service the client
+    int event_loop_wake_fd;
+    // When the event loop needs to service the client next, if not only when its fds are ready
+    struct golioth_deadline_heap_entry event_loop_deadline;
+    // Last batch of epoll events in which the event loop serviced the client
+    uint64_t event_loop_pass;
+    // Next client in a list only used by the event loop thread
+    struct golioth_client *event_loop_next;
+    // Set to ask the event loop to let go of the client
+    atomic_bool leaving_event_loop;
+    // Server lookup by the resolver thread, protected by the resolver's lock
+    bool resolve_requested;
+    bool resolve_done;
+    struct golioth_client *resolve_next;
+    enum golioth_status resolve_status;
+    struct golioth_dns_addr resolved_addrs[GOLIOTH_DNS_CACHE_MAX_ADDRS * 2];
+    size_t num_resolved_addrs;
+    uint64_t resolved_ms;
+    // Set by the event loop when one of the client's fds is ready
+    bool io_pending;
+    // Time (since boot) in milliseconds when the event loop may start the next session
+    uint64_t next_session_ms;
+    // Time (since boot) in milliseconds when the event loop sends a keepalive
+    uint64_t keepalive_due_ms;
+    // Waits for CoAP I/O and the request queue together, or -1 if not supported (only Linux,
+    // with libcoap built with epoll support)
+    int io_epoll_fd;
+    // Whether io_epoll_fd currently waits for the request queue
+    bool io_epoll_mbox_armed;
+    // Time (since boot) in milliseconds of the last response received from the server
+    uint64_t last_rx_ms;
+    // Round-trip time estimates, for retransmission and response timeouts
+    struct golioth_rtt_estimator rtt;
+    // Resolved server addresses
+    struct golioth_dns_cache dns;
+    // Whether the current session asked the server for a DTLS Connection ID
+    bool use_cid;
+    // Runtime statistics, see golioth_client_get_stats()
+    struct golioth_client_stats stats;
+    // Request queue statistics, updated by the threads queueing requests
+    atomic_uint_fast32_t num_queue_full;
+    atomic_uint_fast32_t queue_high_water_mark;
+    // Number of sessions started, for counting reconnects
+    uint32_t num_sessions;
     // token to use for block GETs (must use same token for all blocks)
     uint8_t block_token[8];
     size_t block_token_len;
     golioth_client_event_cb_fn event_callback;
     void *event_callback_arg;
 };
+
+/// Free the observations and request lookup table, called by golioth_client_destroy()
+void golioth_coap_client_free_observations(struct golioth_client *client);
+
+/// Wake up the thread running the client, to have it look at the run state again. Called
+/// by golioth_client_start() and golioth_client_stop().
+void golioth_coap_client_wake(struct golioth_client *client);
+
+/// Detach the client from its shared event loop, if it has one, ending its session. Called
+/// by golioth_client_destroy(), before the request queue is destroyed.
+void golioth_coap_client_leave_event_loop(struct golioth_client *client);
+
+/// Drop the client from the queue of the resolver thread, and drop the result of a lookup it
+/// is doing for the client. Called by golioth_client_destroy(), once the thread running the
+/// client is gone.
+void golioth_coap_client_cancel_resolve(struct golioth_client *client);
@@ -6,9 +6,13 @@
 #include <assert.h>
 #include <golioth/golioth_debug.h>
 #include <golioth/golioth_sys.h>
+#include "callback_executor.h"
+#include "client_stats.h"
 #include "coap_client.h"
 #include "golioth_util.h"
 #include "mbox.h"
+#include "path_handle.h"
+#include "payload_pool.h"
 
 #include "coap_client_zephyr.h"
 #include "pathv.h"
@@ -139,6 +143,8 @@ static int golioth_send(struct golioth_client *client, uint8_t *data, size_t len
         return -EIO;
     }
 
+    client->stats.bytes_out += sent;
+
     return 0;
 }
 
@@ -165,6 +171,28 @@ static int golioth_send_coap_empty(struct golioth_client *client)
     return golioth_send(client, packet.data, packet.offset, 0);
 }
 
+static int golioth_coap_post_block(golioth_coap_request_msg_t *req);
+static enum golioth_status golioth_err_to_status(int err);
+
+static void call_callback(struct golioth_client *client,
+                          const golioth_coap_request_msg_t *req,
+                          const struct golioth_response *response,
+                          const uint8_t *payload,
+                          size_t payload_size,
+                          bool is_last)
+{
+    if (!golioth_callback_executor_call(client->callback_executor,
+                                        client,
+                                        req,
+                                        response,
+                                        payload,
+                                        payload_size,
+                                        is_last))
+    {
+        client->stats.drops.callback++;
+    }
+}
+
 static int golioth_coap_cb(struct golioth_req_rsp *rsp)
 {
     golioth_coap_request_msg_t *req = rsp->user_data;
@@ -174,80 +202,74 @@ static int golioth_coap_cb(struct golioth_req_rsp *rsp)
     };
     int err = 0;
 
+    if (rsp->err == -ETIMEDOUT || rsp->err == -ESHUTDOWN)
+    {
+        /* No response, or the session ended before one arrived */
+        client->stats.drops.timeout++;
+    }
+    else if (!req->got_response)
+    {
+        /* Only the first response, not the notifications of an observation */
+        req->got_response = true;
+        golioth_client_stats_response_received(&client->stats,
+                                               req->type,
+                                               req->sent_ms,
+                                               golioth_sys_now_ms());
+    }
+
     if (rsp->err)
     {
-        if (req->request_complete_event)
+        if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
         {
-            golioth_event_group_set_bits(req->request_complete_event, RESPONSE_RECEIVED_EVENT_BIT);
-
-            // Wait for user thread to receive the event.
-            golioth_sys_sem_take(req->request_complete_ack_sem, GOLIOTH_SYS_WAIT_FOREVER);
-
-            // Now it's safe to delete the event and semaphore.
-            golioth_event_group_destroy(req->request_complete_event);
-            golioth_sys_sem_destroy(req->request_complete_ack_sem);
+            /* The server rejected a block, or stopped answering, so the upload failed */
+            response.status = golioth_err_to_status(rsp->err);
+            call_callback(client, req, &response, NULL, 0, false);
+            golioth_completion_signal(req->request_complete,
+                                      (rsp->err == -ETIMEDOUT || rsp->err == -ESHUTDOWN)
+                                          ? RESPONSE_TIMEOUT_EVENT_BIT
+                                          : RESPONSE_ERROR_EVENT_BIT);
+        }
+        else
+        {
+            golioth_completion_signal(req->request_complete, RESPONSE_RECEIVED_EVENT_BIT);
         }
 
         err = rsp->err;
         goto free_req;
     }
 
-    switch (req->type)
+    if (req->type == GOLIOTH_COAP_REQUEST_EMPTY)
     {
-        case GOLIOTH_COAP_REQUEST_EMPTY:
-            goto free_req;
-        case GOLIOTH_COAP_REQUEST_GET:
-            if (req->get.callback)
-            {
-                req->get.callback(client, &response, req->path, rsp->data, rsp->len, req->get.arg);
-            }
-            break;
-        case GOLIOTH_COAP_REQUEST_GET_BLOCK:
-            if (req->get_block.callback)
-            {
-                req->get_block.callback(client,
-                                        &response,
-                                        req->path,
-                                        rsp->data,
-                                        rsp->len,
-                                        rsp->is_last,
-                                        req->get_block.arg);
-            }
-            break;
-        case GOLIOTH_COAP_REQUEST_POST:
-            if (req->post.callback)
-            {
-                req->post.callback(client, &response, req->path, req->post.arg);
-            }
-            break;
-        case GOLIOTH_COAP_REQUEST_DELETE:
-            if (req->delete.callback)
-            {
-                req->delete.callback(client, &response, req->path, req->delete.arg);
-            }
-            break;
-        case GOLIOTH_COAP_REQUEST_OBSERVE:
-            if (req->observe.callback)
-            {
-                req->observe
-                    .callback(client, &response, req->path, rsp->data, rsp->len, req->observe.arg);
-            }
-            /* There is no synchronous version of observe request */
-            return 0;
+        goto free_req;
     }
 
-    if (req->request_complete_event)
+    if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK && !req->post_block.is_last)
     {
-        golioth_event_group_set_bits(req->request_complete_event, RESPONSE_RECEIVED_EVENT_BIT);
+        /* 2.31 Continue, so send the next block */
+        golioth_coap_post_block_next(req, -1);
+        req->got_response = false;
+        req->sent_ms = golioth_sys_now_ms();
+        err = golioth_coap_post_block(req);
+        if (err)
+        {
+            /* golioth_coap_post_block() has called the callback */
+            golioth_completion_signal(req->request_complete, RESPONSE_ERROR_EVENT_BIT);
+            goto free_req;
+        }
+
+        return 0;
+    }
 
-        // Wait for user thread to receive the event.
-        golioth_sys_sem_take(req->request_complete_ack_sem, GOLIOTH_SYS_WAIT_FOREVER);
+    call_callback(client, req, &response, rsp->data, rsp->len, rsp->is_last);
 
-        // Now it's safe to delete the event and semaphore.
-        golioth_event_group_destroy(req->request_complete_event);
-        golioth_sys_sem_destroy(req->request_complete_ack_sem);
+    if (req->type == GOLIOTH_COAP_REQUEST_OBSERVE)
+    {
+        /* There is no synchronous version of observe request */
+        return 0;
     }
 
+    golioth_completion_signal(req->request_complete, RESPONSE_RECEIVED_EVENT_BIT);
+
 free_req:
     free(req);
 
@@ -317,6 +339,220 @@ free_req:
     return err;
 }
 
+/*
+ * Send the current block of a POST_BLOCK request. If the block can't be sent, the request
+ * callback is called with the reason, as there will be no response.
+ */
+static int golioth_coap_post_block(golioth_coap_request_msg_t *req)
+{
+    const uint8_t **pathv = PATHV(req->path_prefix, req->path);
+    size_t path_len = coap_pathv_estimate_alloc_len(pathv);
+    struct golioth_coap_req *coap_req = NULL;
+    struct golioth_client *client = req->client;
+    enum golioth_status status = GOLIOTH_OK;
+    size_t block_len = 0;
+    uint8_t *block;
+    int err;
+
+    block = golioth_payload_pool_alloc(req->post_block.block_size);
+    if (!block)
+    {
+        err = -ENOMEM;
+        goto report_err;
+    }
+
+    status = golioth_coap_post_block_read(req, block, &block_len);
+    if (status != GOLIOTH_OK)
+    {
+        err = -ECANCELED;
+        goto free_block;
+    }
+
+    err = golioth_coap_req_new(&coap_req,
+                               client,
+                               COAP_METHOD_POST,
+                               COAP_TYPE_CON,
+                               GOLIOTH_COAP_MAX_NON_PAYLOAD_LEN + path_len + block_len,
+                               golioth_coap_cb,
+                               req);
+    if (err)
+    {
+        goto free_block;
+    }
+
+    if (req->post_block.block_index == 0)
+    {
+        /* Save token for subsequent blocks */
+        req->token_len = coap_header_get_token(&coap_req->request, req->token);
+    }
+    else
+    {
+        /* All blocks of an upload share the token of the first block */
+        memcpy(&coap_req->request.data[4], req->token, req->token_len);
+    }
+
+    err = coap_packet_append_uri_path_from_pathv(&coap_req->request, pathv);
+    if (err)
+    {
+        LOG_ERR("Unable add uri path to packet");
+        goto free_coap_req;
+    }
+
+    err = coap_append_option_int(&coap_req->request,
+                                 COAP_OPTION_CONTENT_FORMAT,
+                                 golioth_content_type_to_coap_format(
+                                     req->post_block.content_type));
+    if (err)
+    {
+        LOG_ERR("Unable add content format to packet");
+        goto free_coap_req;
+    }
+
+    err = coap_append_option_int(&coap_req->request,
+                                 COAP_OPTION_BLOCK1,
+                                 golioth_coap_post_block_option(req));
+    if (err)
+    {
+        LOG_ERR("Unable to append block1: %d", err);
+        goto free_coap_req;
+    }
+
+    err = coap_packet_append_payload_marker(&coap_req->request);
+    if (!err)
+    {
+        err = coap_packet_append_payload(&coap_req->request, block, block_len);
+    }
+    if (err)
+    {
+        LOG_ERR("Unable add payload to packet");
+        goto free_coap_req;
+    }
+
+    err = golioth_coap_req_schedule(coap_req);
+    if (err)
+    {
+        LOG_ERR("Failed to schedule CoAP POST BLOCK: %d", err);
+        goto free_coap_req;
+    }
+
+    golioth_payload_pool_free(block);
+
+    return 0;
+
+free_coap_req:
+    golioth_coap_req_free(coap_req);
+
+free_block:
+    golioth_payload_pool_free(block);
+
+report_err:
+    if (req->post_block.callback)
+    {
+        struct golioth_response response = {
+            .status = (err == -ECANCELED) ? status : golioth_err_to_status(err),
+        };
+
+        call_callback(client, req, &response, NULL, 0, false);
+    }
+
+    return err;
+}
+
+/*
+ * Send a POST as a non-confirmable message. There is no response to wait for, so the
+ * request is not tracked, and the callback is called as soon as the message has been sent.
+ */
+static int golioth_coap_post_non(golioth_coap_request_msg_t *req)
+{
+    const uint8_t **pathv =
+        req->path_handle ? req->path_handle->segments : PATHV(req->path_prefix, req->path);
+    size_t packet_len = GOLIOTH_COAP_MAX_NON_PAYLOAD_LEN + coap_pathv_estimate_alloc_len(pathv)
+        + req->post.payload_size;
+    struct coap_packet packet;
+    uint8_t *buffer;
+    int err;
+
+    buffer = golioth_payload_pool_alloc(packet_len);
+    if (!buffer)
+    {
+        err = -ENOMEM;
+        goto report;
+    }
+
+    err = coap_packet_init(&packet,
+                           buffer,
+                           packet_len,
+                           COAP_VERSION_1,
+                           COAP_TYPE_NON_CON,
+                           COAP_TOKEN_MAX_LEN,
+                           coap_next_token(),
+                           COAP_METHOD_POST,
+                           coap_next_id());
+    if (err)
+    {
+        goto free_buffer;
+    }
+
+    err = coap_packet_append_uri_path_from_pathv(&packet, pathv);
+    if (err)
+    {
+        LOG_ERR("Unable add uri path to packet");
+        goto free_buffer;
+    }
+
+    err = coap_append_option_int(&packet,
+                                 COAP_OPTION_CONTENT_FORMAT,
+                                 golioth_content_type_to_coap_format(req->post.content_type));
+    if (err)
+    {
+        LOG_ERR("Unable add content format to packet");
+        goto free_buffer;
+    }
+
+    if (req->post.delivery_mode == GOLIOTH_DELIVERY_NO_RESPONSE)
+    {
+        err = coap_append_option_int(&packet,
+                                     GOLIOTH_COAP_OPTION_NO_RESPONSE,
+                                     GOLIOTH_COAP_NO_RESPONSE_SUPPRESS_ALL);
+        if (err)
+        {
+            LOG_ERR("Unable add no-response option to packet");
+            goto free_buffer;
+        }
+    }
+
+    if (req->post.payload_size > 0)
+    {
+        err = coap_packet_append_payload_marker(&packet);
+        if (!err)
+        {
+            err = coap_packet_append_payload(&packet, req->post.payload, req->post.payload_size);
+        }
+        if (err)
+        {
+            LOG_ERR("Unable add payload to packet");
+            goto free_buffer;
+        }
+    }
+
+    err = golioth_send(req->client, packet.data, packet.offset, 0);
+
+free_buffer:
+    golioth_payload_pool_free(buffer);
+
+report:
+    if (req->post.callback)
+    {
+        struct golioth_response response = {
+            .status = golioth_err_to_status(err),
+        };
+
+        call_callback(req->client, req, &response, NULL, 0, false);
+    }
+
+    return err;
+}
+
 static int golioth_coap_observe(golioth_coap_request_msg_t *req, struct golioth_client *client)
 {
     int err;
@@ -379,6 +615,7 @@ static enum golioth_status golioth_err_to_status(int err)
 static enum golioth_status coap_io_loop_once(struct golioth_client *client)
 {
     golioth_coap_request_msg_t *req;
+    bool got_request_msg = false;
     int err = 0;
 
     req = calloc(1, sizeof(*req));
@@ -389,8 +626,9 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
     }
 
     // Wait for request message, with timeout
-    bool got_request_msg =
-        golioth_mbox_recv(client->request_queue, req, CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
+    got_request_msg = golioth_coap_request_queue_recv(client->request_queue,
+                                                      req,
+                                                      CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
     if (!got_request_msg)
     {
         // No requests, so process other pending IO (e.g. observations)
@@ -404,21 +642,15 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
                 req->type,
                 (req->path ? req->path : "N/A"));
 
-        if (req->type == GOLIOTH_COAP_REQUEST_POST && req->post.payload_size > 0)
-        {
-            golioth_sys_free(req->post.payload);
-        }
-
-        if (req->request_complete_event)
-        {
-            golioth_event_group_destroy(req->request_complete_event);
-            golioth_sys_sem_destroy(req->request_complete_ack_sem);
-        }
+        client->stats.drops.ageout++;
+        golioth_coap_request_msg_release_payload(req);
+        golioth_completion_signal(req->request_complete, RESPONSE_TIMEOUT_EVENT_BIT);
 
         goto free_req;
     }
 
     req->client = client;
+    req->sent_ms = golioth_sys_now_ms();
 
     // Handle message and send request to server
     switch (req->type)
@@ -426,6 +658,12 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
         case GOLIOTH_COAP_REQUEST_EMPTY:
             LOG_DBG("Handle EMPTY");
             err = golioth_send_coap_empty(req->client);
+            if (!err)
+            {
+                golioth_client_stats_request_sent(&client->stats, req, req->sent_ms);
+                // Empty requests don't get a response, so they are done once sent
+                golioth_completion_signal(req->request_complete, RESPONSE_RECEIVED_EVENT_BIT);
+            }
             goto free_req;
         case GOLIOTH_COAP_REQUEST_GET:
             LOG_DBG("Handle GET %s", req->path);
@@ -444,17 +682,33 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
             err = golioth_coap_get_block(req);
             break;
         case GOLIOTH_COAP_REQUEST_POST:
-            LOG_DBG("Handle POST %s", req->path);
+            LOG_DBG("Handle POST %s", req->path_handle ? req->path_handle->str : req->path);
+            if (req->post.delivery_mode != GOLIOTH_DELIVERY_CONFIRMABLE)
+            {
+                err = golioth_coap_post_non(req);
+                golioth_coap_request_msg_release_payload(req);
+                if (!err)
+                {
+                    golioth_client_stats_request_sent(&client->stats, req, req->sent_ms);
+                    golioth_completion_signal(req->request_complete, RESPONSE_RECEIVED_EVENT_BIT);
+                }
+                goto free_req;
+            }
             err = golioth_coap_req_cb(req->client,
                                       COAP_METHOD_POST,
-                                      PATHV(req->path_prefix, req->path),
+                                      req->path_handle ? req->path_handle->segments
+                                                       : PATHV(req->path_prefix, req->path),
                                       golioth_content_type_to_coap_format(req->post.content_type),
                                       req->post.payload,
                                       req->post.payload_size,
                                       golioth_coap_cb,
                                       req,
                                       0);
-            golioth_sys_free(req->post.payload);
+            golioth_coap_request_msg_release_payload(req);
+            break;
+        case GOLIOTH_COAP_REQUEST_POST_BLOCK:
+            LOG_DBG("Handle POST_BLOCK %s", req->path);
+            err = golioth_coap_post_block(req);
             break;
         case GOLIOTH_COAP_REQUEST_DELETE:
             LOG_DBG("Handle DELETE %s", req->path);
@@ -483,9 +737,23 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
         goto free_req;
     }
 
+    golioth_client_stats_request_sent(&client->stats, req, req->sent_ms);
+
+    // The request has been encoded, so an inline payload is no longer needed
+    golioth_coap_request_queue_release(client->request_queue);
+
     return GOLIOTH_OK;
 
 free_req:
+    if (got_request_msg)
+    {
+        // Requests that were not sent will not get a response
+        if (err)
+        {
+            golioth_completion_signal(req->request_complete, RESPONSE_TIMEOUT_EVENT_BIT);
+        }
+        golioth_coap_request_queue_release(client->request_queue);
+    }
     free(req);
 
     return golioth_err_to_status(err);
@@ -662,9 +930,8 @@ close_sock:
 #define LOG_SOCKADDR(fmt, addr)
 #endif
 
-static int golioth_connect_host_port(struct golioth_client *client,
-                                     const char *host,
-                                     const char *port)
+/* Resolve host, storing all returned addresses in the client's DNS cache */
+static int golioth_dns_lookup(struct golioth_client *client, const char *host, const char *port)
 {
     struct zsock_addrinfo hints = {
         .ai_family = AF_UNSPEC,
@@ -672,8 +939,9 @@ static int golioth_connect_host_port(struct golioth_client *client,
         .ai_protocol = IPPROTO_UDP,
     };
     struct zsock_addrinfo *addrs, *addr;
+    struct golioth_dns_addr dns_addrs[GOLIOTH_DNS_CACHE_MAX_ADDRS * 2] = {};
+    size_t num_addrs = 0;
     int ret;
-    int err = -ENOENT;
 
     ret = zsock_getaddrinfo(host, port, &hints, &addrs);
     if (ret < 0)
@@ -682,19 +950,93 @@ static int golioth_connect_host_port(struct golioth_client *client,
         return -EAGAIN;
     }
 
-    for (addr = addrs; addr != NULL; addr = addr->ai_next)
+    for (addr = addrs; addr != NULL && num_addrs < ARRAY_SIZE(dns_addrs); addr = addr->ai_next)
+    {
+        struct golioth_dns_addr *dns_addr = &dns_addrs[num_addrs];
+
+        if (addr->ai_addr->sa_family == AF_INET6)
+        {
+            dns_addr->addr_len = sizeof(net_sin6(addr->ai_addr)->sin6_addr);
+            memcpy(dns_addr->addr, &net_sin6(addr->ai_addr)->sin6_addr, dns_addr->addr_len);
+            num_addrs++;
+        }
+        else if (addr->ai_addr->sa_family == AF_INET)
+        {
+            dns_addr->addr_len = sizeof(net_sin(addr->ai_addr)->sin_addr);
+            memcpy(dns_addr->addr, &net_sin(addr->ai_addr)->sin_addr, dns_addr->addr_len);
+            num_addrs++;
+        }
+    }
+
+    zsock_freeaddrinfo(addrs);
+
+    if (num_addrs == 0)
+    {
+        return -ENOENT;
+    }
+
+    golioth_dns_cache_store(&client->dns, dns_addrs, num_addrs, k_uptime_get());
+
+    return 0;
+}
+
+static int golioth_connect_host_port(struct golioth_client *client,
+                                     const char *host,
+                                     const char *port)
+{
+    struct sockaddr_storage storage;
+    struct sockaddr *addr = (struct sockaddr *) &storage;
+    uint16_t port_num = strtoul(port, NULL, 10);
+    int err = -ENOENT;
+
+    if (!golioth_dns_cache_is_fresh(&client->dns, k_uptime_get()))
     {
-        LOG_SOCKADDR("Trying addr '%s'", addr->ai_addr);
+        err = golioth_dns_lookup(client, host, port);
+        if (err)
+        {
+            if (!golioth_dns_cache_current(&client->dns))
+            {
+                return err;
+            }
 
-        err = golioth_connect_sockaddr(client, host, addr->ai_addr, addr->ai_addrlen);
+            LOG_WRN("Using previously resolved addresses");
+        }
+    }
+
+    for (size_t i = 0; i < client->dns.num_addrs; i++)
+    {
+        const struct golioth_dns_addr *dns_addr = golioth_dns_cache_current(&client->dns);
+        socklen_t addrlen;
+
+        memset(&storage, 0, sizeof(storage));
+
+        if (dns_addr->addr_len == sizeof(net_sin(addr)->sin_addr))
+        {
+            addr->sa_family = AF_INET;
+            memcpy(&net_sin(addr)->sin_addr, dns_addr->addr, dns_addr->addr_len);
+            net_sin(addr)->sin_port = htons(port_num);
+            addrlen = sizeof(struct sockaddr_in);
+        }
+        else
+        {
+            addr->sa_family = AF_INET6;
+            memcpy(&net_sin6(addr)->sin6_addr, dns_addr->addr, dns_addr->addr_len);
+            net_sin6(addr)->sin6_port = htons(port_num);
+            addrlen = sizeof(struct sockaddr_in6);
+        }
+
+        LOG_SOCKADDR("Trying addr '%s'", addr);
+
+        err = golioth_connect_sockaddr(client, host, addr, addrlen);
         if (!err)
         {
             /* Ready to go */
+            golioth_dns_cache_connected(&client->dns);
             break;
         }
-    }
 
-    zsock_freeaddrinfo(addrs);
+        golioth_dns_cache_failed(&client->dns);
+    }
 
     return err;
 }
@@ -731,6 +1073,10 @@ static int golioth_connect(struct golioth_client *client)
         return err;
     }
 
+    /* The DTLS handshake is done as part of connecting the socket */
+    client->stats.handshakes++;
+    client->num_sessions++;
+
     golioth_coap_reqs_on_connect(client);
 
     if (client->on_connect)
@@ -869,6 +1215,8 @@ static int golioth_recv(struct golioth_client *client, uint8_t *data, size_t len
         return -ENOTCONN;
     }
 
+    client->stats.bytes_in += rcvd;
+
     return rcvd;
 }
 
@@ -924,7 +1272,6 @@ static void golioth_coap_client_thread(void *arg)
     int err;
     int ret;
 
-    fds[POLLFD_MBOX].fd = golioth_sys_sem_get_fd(client->request_queue->fill_count_sem);
     fds[POLLFD_MBOX].events = ZSOCK_POLLIN;
 
     while (1)
@@ -933,6 +1280,7 @@ static void golioth_coap_client_thread(void *arg)
         client->session_connected = false;
 
         client->is_running = false;
+        golioth_sys_sem_give(client->stopped_sem);
         LOG_DBG("Waiting for the \"run\" signal");
         golioth_sys_sem_take(client->run_sem, GOLIOTH_SYS_WAIT_FOREVER);
         golioth_sys_sem_give(client->run_sem);
@@ -997,6 +1345,8 @@ static void golioth_coap_client_thread(void *arg)
 
             k_work_reschedule(&eventfd_timeout, K_MSEC(timeout));
 
+            fds[POLLFD_MBOX].fd = golioth_mbox_wait_fd(client->request_queue);
+
             ret = zsock_poll(fds, ARRAY_SIZE(fds), -1);
 
             if (ret < 0)
@@ -1070,9 +1420,19 @@ static void golioth_coap_client_thread(void *arg)
 
             if (fds[POLLFD_MBOX].revents)
             {
-                if (coap_io_loop_once(client) != GOLIOTH_OK)
+                // Send every request that is ready, not just the one that woke us up
+                for (int i = 0; i < CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS; i++)
                 {
-                    client->end_session = true;
+                    if (coap_io_loop_once(client) != GOLIOTH_OK)
+                    {
+                        client->end_session = true;
+                        break;
+                    }
+
+                    if (golioth_client_num_items_in_request_queue(client) == 0)
+                    {
+                        break;
+                    }
                 }
             }
         }
@@ -1175,6 +1535,13 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
 {
     if (!_initialized)
     {
+        golioth_payload_pool_init();
+        golioth_completion_pool_init();
+        golioth_coap_request_queue_init();
+#if CONFIG_GOLIOTH_CALLBACK_EXECUTOR
+        golioth_callback_executor_init();
+#endif
+
         _initialized = true;
     }
 
@@ -1187,6 +1554,9 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
     memset(new_client, 0, sizeof(struct golioth_client));
 
     new_client->config = *config;
+    golioth_rtt_estimator_init(&new_client->rtt, CONFIG_COAP_INIT_ACK_TIMEOUT_MS);
+    golioth_dns_cache_init(&new_client->dns);
+    golioth_coap_client_restore_warm_cache(new_client, config);
 
     credentials_set(&new_client->config);
 
@@ -1210,14 +1580,29 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
     }
     golioth_sys_sem_give(new_client->run_sem);
 
-    new_client->request_queue = golioth_mbox_create(CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS,
-                                                    sizeof(golioth_coap_request_msg_t));
+    new_client->stopped_sem = golioth_sys_sem_create(1, 0);
+    if (!new_client->stopped_sem)
+    {
+        LOG_ERR("Failed to create stopped semaphore");
+        goto error;
+    }
+
+    new_client->request_queue = golioth_coap_request_queue_create();
     if (!new_client->request_queue)
     {
         LOG_ERR("Failed to create request queue");
         goto error;
     }
 
+#if CONFIG_GOLIOTH_CALLBACK_EXECUTOR
+    new_client->callback_executor = golioth_callback_executor_get();
+    if (!new_client->callback_executor)
+    {
+        LOG_ERR("Failed to create callback executor");
+        goto error;
+    }
+#endif
+
     struct golioth_thread_config thread_cfg = {
         .name = "coap_client",
         .fn = golioth_coap_client_thread,
@@ -1265,3 +1650,4 @@ error:
     golioth_client_destroy(new_client);
     return NULL;
 }
+
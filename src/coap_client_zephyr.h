@@ -7,7 +7,9 @@
 
 #include "coap_client.h"
 #include <golioth/client.h>
+#include "dns_cache.h"
 #include "mbox.h"
+#include "rtt_estimator.h"
 #include <golioth/golioth_sys.h>
 
 #include <stddef.h>
@@ -16,6 +18,7 @@
 #include <zephyr/kernel.h>
 #include <zephyr/net/coap.h>
 #include <zephyr/net/tls_credentials.h>
+#include <zephyr/sys/rb.h>
 
 #define GOLIOTH_COAP_MAX_NON_PAYLOAD_LEN 128
 
@@ -68,7 +71,11 @@ struct golioth_client
 {
     golioth_mbox_t request_queue;
     golioth_sys_thread_t coap_thread_handle;
+    // Runs callbacks of asynchronous requests, NULL if they run on the CoAP thread
+    struct golioth_callback_executor *callback_executor;
     golioth_sys_sem_t run_sem;
+    // Given by the thread running the client each time it stops, for golioth_client_stop()
+    golioth_sys_sem_t stopped_sem;
     golioth_sys_timer_t keepalive_timer;
     bool is_running;
     bool end_session;
@@ -88,9 +95,26 @@ struct golioth_client
     int sock;
 
     sys_dlist_t coap_reqs;
+    /* Requests awaiting a response, ordered by the time of their next (re)transmission or
+     * timeout. Established observations are only in coap_reqs. */
+    struct rbtree coap_reqs_by_deadline;
     bool coap_reqs_connected;
     struct k_mutex coap_reqs_lock;
 
+    /* Round-trip time estimates, for retransmission timeouts */
+    struct golioth_rtt_estimator rtt;
+
+    /* Resolved server addresses */
+    struct golioth_dns_cache dns;
+
+    /* Runtime statistics, see golioth_client_get_stats() */
+    struct golioth_client_stats stats;
+    /* Request queue statistics, updated by the threads queueing requests */
+    atomic_uint_fast32_t num_queue_full;
+    atomic_uint_fast32_t queue_high_water_mark;
+    /* Number of sessions started, for counting reconnects */
+    uint32_t num_sessions;
+
     void (*on_connect)(struct golioth_client *client);
     void (*wakeup)(struct golioth_client *client);
 
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "completion.h"
+#include <stdbool.h>
+#include <string.h>
+#include <golioth/config.h>
+#include <golioth/golioth_sys.h>
+
+enum completion_state
+{
+    COMPLETION_FREE,
+    // Acquired, and not signaled yet
+    COMPLETION_PENDING,
+    // Signaled, the waiter will return it to the pool
+    COMPLETION_SIGNALED,
+    // The waiter timed out, the CoAP thread will return it to the pool
+    COMPLETION_ABANDONED,
+};
+
+struct golioth_completion
+{
+    // Given once when signaled. Always taken before the completion is reused.
+    golioth_sys_sem_t sem;
+    uint32_t bits;
+    enum completion_state state;
+    bool from_heap;
+    struct golioth_completion *next_free;
+};
+
+static struct golioth_completion _completions[CONFIG_GOLIOTH_COAP_SYNC_COMPLETION_POOL_SIZE];
+static struct golioth_completion *_free_list;
+
+// Protects the free list and the state of all completions.
+// NULL until golioth_completion_pool_init() is called.
+static golioth_sys_sem_t _pool_lock;
+
+// Must be called with _pool_lock held
+static void completion_free(struct golioth_completion *completion)
+{
+    completion->state = COMPLETION_FREE;
+
+    if (completion->from_heap)
+    {
+        golioth_sys_sem_destroy(completion->sem);
+        golioth_sys_free(completion);
+        return;
+    }
+
+    completion->next_free = _free_list;
+    _free_list = completion;
+}
+
+void golioth_completion_pool_init(void)
+{
+    if (_pool_lock)
+    {
+        return;
+    }
+
+    _free_list = NULL;
+    for (size_t n = CONFIG_GOLIOTH_COAP_SYNC_COMPLETION_POOL_SIZE; n > 0; n--)
+    {
+        struct golioth_completion *completion = &_completions[n - 1];
+
+        // Semaphores are created on first use
+        completion->next_free = _free_list;
+        _free_list = completion;
+    }
+
+    _pool_lock = golioth_sys_sem_create(1, 1);
+}
+
+struct golioth_completion *golioth_completion_acquire(void)
+{
+    if (!_pool_lock)
+    {
+        return NULL;
+    }
+
+    golioth_sys_sem_take(_pool_lock, GOLIOTH_SYS_WAIT_FOREVER);
+    struct golioth_completion *completion = _free_list;
+    if (completion)
+    {
+        _free_list = completion->next_free;
+    }
+    golioth_sys_sem_give(_pool_lock);
+
+    if (!completion)
+    {
+        completion = golioth_sys_malloc(sizeof(*completion));
+        if (!completion)
+        {
+            return NULL;
+        }
+        memset(completion, 0, sizeof(*completion));
+        completion->from_heap = true;
+    }
+
+    if (!completion->sem)
+    {
+        completion->sem = golioth_sys_sem_create(1, 0);
+        if (!completion->sem)
+        {
+            golioth_completion_release(completion);
+            return NULL;
+        }
+    }
+
+    completion->bits = 0;
+    completion->state = COMPLETION_PENDING;
+
+    return completion;
+}
+
+void golioth_completion_release(struct golioth_completion *completion)
+{
+    golioth_sys_sem_take(_pool_lock, GOLIOTH_SYS_WAIT_FOREVER);
+    completion_free(completion);
+    golioth_sys_sem_give(_pool_lock);
+}
+
+void golioth_completion_signal(struct golioth_completion *completion, uint32_t bits)
+{
+    if (!completion)
+    {
+        return;
+    }
+
+    golioth_sys_sem_take(_pool_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    if (completion->state == COMPLETION_ABANDONED)
+    {
+        completion_free(completion);
+    }
+    else
+    {
+        completion->bits = bits;
+        completion->state = COMPLETION_SIGNALED;
+
+        // Given with the lock held, so a waiter that sees COMPLETION_SIGNALED
+        // can always take the semaphore.
+        golioth_sys_sem_give(completion->sem);
+    }
+
+    golioth_sys_sem_give(_pool_lock);
+}
+
+uint32_t golioth_completion_wait(struct golioth_completion *completion, int32_t timeout_ms)
+{
+    bool taken = golioth_sys_sem_take(completion->sem, timeout_ms);
+    uint32_t bits = 0;
+
+    golioth_sys_sem_take(_pool_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    if (completion->state == COMPLETION_SIGNALED)
+    {
+        if (!taken)
+        {
+            // Signaled right after the wait timed out
+            golioth_sys_sem_take(completion->sem, 0);
+        }
+
+        bits = completion->bits;
+        completion_free(completion);
+    }
+    else
+    {
+        completion->state = COMPLETION_ABANDONED;
+    }
+
+    golioth_sys_sem_give(_pool_lock);
+
+    return bits;
+}
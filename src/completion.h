@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+/// Completion objects for synchronous requests.
+///
+/// A completion is acquired by the thread making a synchronous request, signaled
+/// once by the CoAP thread when the request is done, and waited on by the
+/// requesting thread. Completions are taken from a pool and reset when they are
+/// returned, so the semaphores behind them are created once and reused.
+///
+/// Neither side waits for the other: if the requesting thread times out before
+/// the completion is signaled, the completion is returned to the pool when the
+/// CoAP thread signals it.
+
+struct golioth_completion;
+
+/// Set up the completion pool. Safe to call more than once.
+void golioth_completion_pool_init(void);
+
+/// Get a completion from the pool, or from the heap if the pool is empty.
+///
+/// Returns NULL if out of memory, or if the pool has not been initialized.
+struct golioth_completion *golioth_completion_acquire(void);
+
+/// Return a completion that was never passed to the CoAP thread
+void golioth_completion_release(struct golioth_completion *completion);
+
+/// Signal a completion with the given result bits. Called once, from the CoAP thread.
+///
+/// Does nothing if completion is NULL.
+void golioth_completion_signal(struct golioth_completion *completion, uint32_t bits);
+
+/// Wait for a completion to be signaled, and return it to the pool.
+///
+/// Returns the bits passed to golioth_completion_signal(), or 0 on timeout.
+/// The completion must not be used after this call.
+uint32_t golioth_completion_wait(struct golioth_completion *completion, int32_t timeout_ms);
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "deadline_heap.h"
+#include <assert.h>
+#include <string.h>
+#include <golioth/golioth_sys.h>
+
+#define DEADLINE_HEAP_MIN_CAPACITY 8
+
+static void place(struct golioth_deadline_heap *heap,
+                  struct golioth_deadline_heap_entry *entry,
+                  size_t index)
+{
+    heap->entries[index] = entry;
+    entry->index = index;
+}
+
+static void sift_up(struct golioth_deadline_heap *heap, size_t index)
+{
+    struct golioth_deadline_heap_entry *entry = heap->entries[index];
+
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (heap->entries[parent]->deadline_ms <= entry->deadline_ms)
+        {
+            break;
+        }
+        place(heap, heap->entries[parent], index);
+        index = parent;
+    }
+
+    place(heap, entry, index);
+}
+
+static void sift_down(struct golioth_deadline_heap *heap, size_t index)
+{
+    struct golioth_deadline_heap_entry *entry = heap->entries[index];
+
+    while (true)
+    {
+        size_t child = 2 * index + 1;
+        if (child >= heap->count)
+        {
+            break;
+        }
+        if (child + 1 < heap->count
+            && heap->entries[child + 1]->deadline_ms < heap->entries[child]->deadline_ms)
+        {
+            child++;
+        }
+        if (entry->deadline_ms <= heap->entries[child]->deadline_ms)
+        {
+            break;
+        }
+        place(heap, heap->entries[child], index);
+        index = child;
+    }
+
+    place(heap, entry, index);
+}
+
+void golioth_deadline_heap_init(struct golioth_deadline_heap *heap)
+{
+    memset(heap, 0, sizeof(*heap));
+}
+
+void golioth_deadline_heap_deinit(struct golioth_deadline_heap *heap)
+{
+    golioth_sys_free(heap->entries);
+    memset(heap, 0, sizeof(*heap));
+}
+
+enum golioth_status golioth_deadline_heap_reserve(struct golioth_deadline_heap *heap,
+                                                  size_t num_entries)
+{
+    size_t new_capacity = (heap->capacity ? heap->capacity : DEADLINE_HEAP_MIN_CAPACITY);
+    while (new_capacity < num_entries)
+    {
+        new_capacity *= 2;
+    }
+
+    if (new_capacity == heap->capacity)
+    {
+        return GOLIOTH_OK;
+    }
+
+    struct golioth_deadline_heap_entry **new_entries =
+        golioth_sys_malloc(new_capacity * sizeof(struct golioth_deadline_heap_entry *));
+    if (!new_entries)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+
+    if (heap->count > 0)
+    {
+        memcpy(new_entries,
+               heap->entries,
+               heap->count * sizeof(struct golioth_deadline_heap_entry *));
+    }
+    golioth_sys_free(heap->entries);
+
+    heap->entries = new_entries;
+    heap->capacity = new_capacity;
+
+    return GOLIOTH_OK;
+}
+
+void golioth_deadline_heap_entry_init(struct golioth_deadline_heap_entry *entry)
+{
+    entry->deadline_ms = 0;
+    entry->index = GOLIOTH_DEADLINE_HEAP_NO_INDEX;
+}
+
+bool golioth_deadline_heap_contains(const struct golioth_deadline_heap_entry *entry)
+{
+    return (entry->index != GOLIOTH_DEADLINE_HEAP_NO_INDEX);
+}
+
+void golioth_deadline_heap_set(struct golioth_deadline_heap *heap,
+                               struct golioth_deadline_heap_entry *entry,
+                               uint64_t deadline_ms)
+{
+    if (!golioth_deadline_heap_contains(entry))
+    {
+        assert(heap->count < heap->capacity);
+
+        entry->deadline_ms = deadline_ms;
+        place(heap, entry, heap->count++);
+        sift_up(heap, entry->index);
+        return;
+    }
+
+    bool earlier = (deadline_ms < entry->deadline_ms);
+    entry->deadline_ms = deadline_ms;
+    if (earlier)
+    {
+        sift_up(heap, entry->index);
+    }
+    else
+    {
+        sift_down(heap, entry->index);
+    }
+}
+
+void golioth_deadline_heap_remove(struct golioth_deadline_heap *heap,
+                                  struct golioth_deadline_heap_entry *entry)
+{
+    if (!golioth_deadline_heap_contains(entry))
+    {
+        return;
+    }
+
+    size_t index = entry->index;
+    entry->index = GOLIOTH_DEADLINE_HEAP_NO_INDEX;
+
+    struct golioth_deadline_heap_entry *last = heap->entries[--heap->count];
+    if (last == entry)
+    {
+        return;
+    }
+
+    // Move the last entry into the hole, and restore the heap order in whichever direction
+    // it's broken
+    place(heap, last, index);
+    if (index > 0 && last->deadline_ms < heap->entries[(index - 1) / 2]->deadline_ms)
+    {
+        sift_up(heap, index);
+    }
+    else
+    {
+        sift_down(heap, index);
+    }
+}
+
+struct golioth_deadline_heap_entry *golioth_deadline_heap_peek(
+    const struct golioth_deadline_heap *heap)
+{
+    return (heap->count > 0) ? heap->entries[0] : NULL;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <golioth/golioth_status.h>
+
+/// A binary min-heap of deadlines, for finding the earliest of many deadlines without
+/// looking at all of them.
+///
+/// Entries are embedded in the objects that own them, and remember their position in the
+/// heap, so a deadline can be moved or removed in O(log n) time. The heap only stores
+/// pointers to the entries, and never allocates memory outside golioth_deadline_heap_reserve().
+///
+/// Not thread-safe.
+
+/// Index of an entry that is not in a heap
+#define GOLIOTH_DEADLINE_HEAP_NO_INDEX SIZE_MAX
+
+struct golioth_deadline_heap_entry
+{
+    /// Time (since boot) in milliseconds
+    uint64_t deadline_ms;
+    // Position in the heap, or GOLIOTH_DEADLINE_HEAP_NO_INDEX
+    size_t index;
+};
+
+struct golioth_deadline_heap
+{
+    struct golioth_deadline_heap_entry **entries;
+    size_t capacity;
+    // Number of entries in use
+    size_t count;
+};
+
+/// Initialize an empty heap, without allocating memory
+void golioth_deadline_heap_init(struct golioth_deadline_heap *heap);
+
+/// Free the storage of the heap. The entries are not touched.
+void golioth_deadline_heap_deinit(struct golioth_deadline_heap *heap);
+
+/// Make sure that num_entries entries can be in the heap without allocating memory
+enum golioth_status golioth_deadline_heap_reserve(struct golioth_deadline_heap *heap,
+                                                  size_t num_entries);
+
+/// Initialize an entry that is not in any heap
+void golioth_deadline_heap_entry_init(struct golioth_deadline_heap_entry *entry);
+
+/// Whether the entry is in a heap
+bool golioth_deadline_heap_contains(const struct golioth_deadline_heap_entry *entry);
+
+/// Add the entry to the heap with the given deadline, or move it if it's already in the
+/// heap. The heap must have room for the entry, see golioth_deadline_heap_reserve().
+void golioth_deadline_heap_set(struct golioth_deadline_heap *heap,
+                               struct golioth_deadline_heap_entry *entry,
+                               uint64_t deadline_ms);
+
+/// Remove the entry from the heap. Does nothing if it's not in the heap.
+void golioth_deadline_heap_remove(struct golioth_deadline_heap *heap,
+                                  struct golioth_deadline_heap_entry *entry);
+
+/// Returns the entry with the earliest deadline, or NULL if the heap is empty
+struct golioth_deadline_heap_entry *golioth_deadline_heap_peek(
+    const struct golioth_deadline_heap *heap);
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "dns_cache.h"
+#include <string.h>
+#include <golioth/config.h>
+
+static bool is_valid(const struct golioth_dns_addr *addr)
+{
+    return addr->addr_len == 4 || addr->addr_len == 16;
+}
+
+// Index of the next valid address at or after start with (or without) the given length,
+// or num_addrs if there is none
+static size_t next_addr(const struct golioth_dns_addr *addrs,
+                        size_t num_addrs,
+                        size_t start,
+                        uint8_t addr_len,
+                        bool same_family)
+{
+    for (size_t i = start; i < num_addrs; i++)
+    {
+        if (is_valid(&addrs[i]) && ((addrs[i].addr_len == addr_len) == same_family))
+        {
+            return i;
+        }
+    }
+
+    return num_addrs;
+}
+
+void golioth_dns_cache_init(struct golioth_dns_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+void golioth_dns_cache_store(struct golioth_dns_cache *cache,
+                             const struct golioth_dns_addr *addrs,
+                             size_t num_addrs,
+                             uint64_t now_ms)
+{
+    golioth_dns_cache_init(cache);
+
+    size_t first = next_addr(addrs, num_addrs, 0, 0, false);
+    if (first == num_addrs)
+    {
+        return;
+    }
+
+    // Interleave the families, starting with the one the resolver preferred
+    uint8_t preferred_len = addrs[first].addr_len;
+    size_t preferred = first;
+    size_t other = next_addr(addrs, num_addrs, 0, preferred_len, false);
+    bool take_preferred = true;
+
+    while (cache->num_addrs < GOLIOTH_DNS_CACHE_MAX_ADDRS
+           && (preferred < num_addrs || other < num_addrs))
+    {
+        if ((take_preferred && preferred < num_addrs) || other == num_addrs)
+        {
+            cache->addrs[cache->num_addrs++] = addrs[preferred];
+            preferred = next_addr(addrs, num_addrs, preferred + 1, preferred_len, true);
+        }
+        else
+        {
+            cache->addrs[cache->num_addrs++] = addrs[other];
+            other = next_addr(addrs, num_addrs, other + 1, preferred_len, false);
+        }
+
+        take_preferred = !take_preferred;
+    }
+
+    cache->expires_ms = now_ms + 1000 * (uint64_t) CONFIG_GOLIOTH_DNS_CACHE_TTL_S;
+}
+
+bool golioth_dns_cache_is_fresh(const struct golioth_dns_cache *cache, uint64_t now_ms)
+{
+    return cache->num_addrs > 0 && now_ms < cache->expires_ms;
+}
+
+const struct golioth_dns_addr *golioth_dns_cache_current(const struct golioth_dns_cache *cache)
+{
+    if (cache->num_addrs == 0)
+    {
+        return NULL;
+    }
+
+    return &cache->addrs[cache->current];
+}
+
+void golioth_dns_cache_connected(struct golioth_dns_cache *cache)
+{
+    cache->num_failed = 0;
+}
+
+void golioth_dns_cache_failed(struct golioth_dns_cache *cache)
+{
+    if (cache->num_addrs == 0)
+    {
+        return;
+    }
+
+    cache->current = (cache->current + 1) % cache->num_addrs;
+    cache->num_failed++;
+
+    // Every address has failed, so they may have changed. Keep them as a fallback in case
+    // resolving the server fails too.
+    if (cache->num_failed >= cache->num_addrs)
+    {
+        cache->num_failed = 0;
+        cache->expires_ms = 0;
+    }
+}
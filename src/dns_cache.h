@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Cache of the resolved addresses of the CoAP server.
+///
+/// New sessions connect to a cached address for CONFIG_GOLIOTH_DNS_CACHE_TTL_S after a
+/// lookup, without resolving the server again. Once that time has passed, the addresses are
+/// stale, and the client resolves the server again. How it does that is up to the port:
+///
+/// - libcoap on Linux: the resolver thread refreshes the addresses in the background, and new
+///   sessions connect to the stale addresses meanwhile (stale-while-revalidate).
+/// - Elsewhere: the CoAP thread of the client resolves the server before connecting, and
+///   only falls back to the stale addresses if resolving fails (stale-if-error).
+///
+/// The addresses are interleaved by address family, like RFC 8305 (Happy Eyeballs) orders
+/// them, so that if one family is broken on the current network, the next attempt uses the
+/// other one. The attempts are made one after the other, one per session: the families are
+/// not raced against each other. An address that fails to connect moves the next address to
+/// the front, and the cache is marked stale once all addresses have failed.
+///
+/// Not thread safe. Each client has one cache, which is only used by the CoAP thread.
+
+/// Maximum number of addresses kept from a lookup
+#define GOLIOTH_DNS_CACHE_MAX_ADDRS 4
+
+/// IP address, in network byte order
+struct golioth_dns_addr
+{
+    uint8_t addr[16];
+    /// 4 for IPv4, 16 for IPv6
+    uint8_t addr_len;
+};
+
+struct golioth_dns_cache
+{
+    struct golioth_dns_addr addrs[GOLIOTH_DNS_CACHE_MAX_ADDRS];
+    size_t num_addrs;
+    // Index of the address to connect to next
+    size_t current;
+    // Addresses that have failed to connect since the last lookup or successful connection
+    size_t num_failed;
+    // Time (since boot) in milliseconds when the addresses become stale
+    uint64_t expires_ms;
+};
+
+/// Empty the cache
+void golioth_dns_cache_init(struct golioth_dns_cache *cache);
+
+/// Replace the cached addresses with the results of a lookup, in the order they were
+/// returned by the resolver. Addresses that aren't 4 or 16 bytes long are skipped.
+void golioth_dns_cache_store(struct golioth_dns_cache *cache,
+                             const struct golioth_dns_addr *addrs,
+                             size_t num_addrs,
+                             uint64_t now_ms);
+
+/// Whether the cache holds addresses that are not stale, so no lookup is needed
+bool golioth_dns_cache_is_fresh(const struct golioth_dns_cache *cache, uint64_t now_ms);
+
+/// The address to connect to next, stale or not, or NULL if the cache is empty
+const struct golioth_dns_addr *golioth_dns_cache_current(const struct golioth_dns_cache *cache);
+
+/// Report that connecting to the current address succeeded
+void golioth_dns_cache_connected(struct golioth_dns_cache *cache);
+
+/// Report that connecting to the current address failed, and move on to the next one
+void golioth_dns_cache_failed(struct golioth_dns_cache *cache);
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include "payload_pool.h"
 
 static enum golioth_debug_log_level _level = CONFIG_GOLIOTH_DEBUG_DEFAULT_LOG_LEVEL;
 static struct golioth_client *_client = NULL;
@@ -127,7 +128,7 @@ void golioth_debug_printf(uint64_t tstamp_ms,
     }
 
     // Temporarily allocate a buffer to store the message
-    char *msg_buffer = golioth_sys_malloc(buffer_size);
+    char *msg_buffer = golioth_payload_pool_alloc(buffer_size);
     if (!msg_buffer)
     {
         return;
@@ -166,7 +167,7 @@ void golioth_debug_printf(uint64_t tstamp_ms,
 
     // It's safe to free the message buffer, since the async log above
     // makes a copy of the message.
-    golioth_sys_free(msg_buffer);
+    golioth_payload_pool_free(msg_buffer);
 }
 
 void golioth_debug_set_client(struct golioth_client *client)
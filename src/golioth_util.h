@@ -5,6 +5,8 @@
  */
 #pragma once
 
+#include <stddef.h>
+
 #ifndef min
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #endif
@@ -16,3 +18,7 @@
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
 #endif
+
+#ifndef CONTAINER_OF
+#define CONTAINER_OF(ptr, type, field) ((type *) (((char *) (ptr)) - offsetof(type, field)))
+#endif
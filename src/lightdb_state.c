@@ -6,6 +6,8 @@
 #include <assert.h>
 #include <string.h>
 #include "coap_client.h"
+#include "path_handle.h"
+#include "payload_pool.h"
 #include <golioth/lightdb_state.h>
 #include <golioth/payload_utils.h>
 #include "golioth_util.h"
@@ -38,24 +40,71 @@ typedef struct
     bool is_null;
 } lightdb_get_response_t;
 
-enum golioth_status golioth_lightdb_set_int_async(struct golioth_client *client,
-                                                  const char *path,
-                                                  int32_t value,
-                                                  golioth_set_cb_fn callback,
-                                                  void *callback_arg)
+static enum golioth_status lightdb_set_async(struct golioth_client *client,
+                                             const char *path,
+                                             enum golioth_content_type content_type,
+                                             const uint8_t *buf,
+                                             size_t buf_len,
+                                             golioth_set_cb_fn callback,
+                                             void *callback_arg)
 {
-    char buf[16] = {};
-    snprintf(buf, sizeof(buf), "%" PRId32, value);
+#if CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_MAX_PATHS > 0
+    // Coalesced payloads stay in the client until they are sent, so they need their own copy
+    uint8_t *copy = golioth_payload_pool_alloc(buf_len + 1);
+    if (!copy)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+    memcpy(copy, buf, buf_len);
+
+    enum golioth_status status =
+        golioth_coap_client_set_coalesced(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
+                                          path,
+                                          content_type,
+                                          copy,
+                                          buf_len,
+                                          golioth_payload_pool_release,
+                                          NULL,
+                                          callback,
+                                          callback_arg);
+    if (status != GOLIOTH_OK)
+    {
+        golioth_payload_pool_free(copy);
+    }
+
+    return status;
+#else
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                    path,
-                                   GOLIOTH_CONTENT_TYPE_JSON,
-                                   (const uint8_t *) buf,
-                                   strlen(buf),
+                                   content_type,
+                                   buf,
+                                   buf_len,
                                    callback,
                                    callback_arg,
                                    false,
                                    GOLIOTH_SYS_WAIT_FOREVER);
+#endif
+}
+
+enum golioth_status golioth_lightdb_set_int_async(struct golioth_client *client,
+                                                  const char *path,
+                                                  int32_t value,
+                                                  golioth_set_cb_fn callback,
+                                                  void *callback_arg)
+{
+    char buf[16] = {};
+    snprintf(buf, sizeof(buf), "%" PRId32, value);
+    return lightdb_set_async(client,
+                             path,
+                             GOLIOTH_CONTENT_TYPE_JSON,
+                             (const uint8_t *) buf,
+                             strlen(buf),
+                             callback,
+                             callback_arg);
 }
 
 enum golioth_status golioth_lightdb_set_bool_async(struct golioth_client *client,
@@ -65,16 +114,13 @@ enum golioth_status golioth_lightdb_set_bool_async(struct golioth_client *client
                                                    void *callback_arg)
 {
     const char *valuestr = (value ? "true" : "false");
-    return golioth_coap_client_set(client,
-                                   GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                   path,
-                                   GOLIOTH_CONTENT_TYPE_JSON,
-                                   (const uint8_t *) valuestr,
-                                   strlen(valuestr),
-                                   callback,
-                                   callback_arg,
-                                   false,
-                                   GOLIOTH_SYS_WAIT_FOREVER);
+    return lightdb_set_async(client,
+                             path,
+                             GOLIOTH_CONTENT_TYPE_JSON,
+                             (const uint8_t *) valuestr,
+                             strlen(valuestr),
+                             callback,
+                             callback_arg);
 }
 
 enum golioth_status golioth_lightdb_set_float_async(struct golioth_client *client,
@@ -85,16 +131,13 @@ enum golioth_status golioth_lightdb_set_float_async(struct golioth_client *clien
 {
     char buf[32] = {};
     snprintf(buf, sizeof(buf), "%f", (double) value);
-    return golioth_coap_client_set(client,
-                                   GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                   path,
-                                   GOLIOTH_CONTENT_TYPE_JSON,
-                                   (const uint8_t *) buf,
-                                   strlen(buf),
-                                   callback,
-                                   callback_arg,
-                                   false,
-                                   GOLIOTH_SYS_WAIT_FOREVER);
+    return lightdb_set_async(client,
+                             path,
+                             GOLIOTH_CONTENT_TYPE_JSON,
+                             (const uint8_t *) buf,
+                             strlen(buf),
+                             callback,
+                             callback_arg);
 }
 
 enum golioth_status golioth_lightdb_set_string_async(struct golioth_client *client,
@@ -107,7 +150,7 @@ enum golioth_status golioth_lightdb_set_string_async(struct golioth_client *clie
     // Server requires that non-JSON-formatted strings
     // be surrounded with literal ".
     size_t bufsize = str_len + 3;  // two " and a NULL
-    char *buf = golioth_sys_malloc(bufsize);
+    char *buf = golioth_payload_pool_alloc(bufsize);
     if (!buf)
     {
         return GOLIOTH_ERR_MEM_ALLOC;
@@ -115,18 +158,24 @@ enum golioth_status golioth_lightdb_set_string_async(struct golioth_client *clie
     memset(buf, 0, bufsize);
     snprintf(buf, bufsize, "\"%s\"", str);
 
-    enum golioth_status status = golioth_coap_client_set(client,
-                                                         GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                                         path,
-                                                         GOLIOTH_CONTENT_TYPE_JSON,
-                                                         (const uint8_t *) buf,
-                                                         bufsize - 1,  // excluding NULL
-                                                         callback,
-                                                         callback_arg,
-                                                         false,
-                                                         GOLIOTH_SYS_WAIT_FOREVER);
+    // The buffer is handed over to the client, which frees it after sending
+    enum golioth_status status =
+        golioth_coap_client_set_coalesced(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
+                                          path,
+                                          GOLIOTH_CONTENT_TYPE_JSON,
+                                          (const uint8_t *) buf,
+                                          bufsize - 1,  // excluding NULL
+                                          golioth_payload_pool_release,
+                                          NULL,
+                                          callback,
+                                          callback_arg);
+    if (status != GOLIOTH_OK)
+    {
+        golioth_payload_pool_free(buf);
+    }
 
-    golioth_sys_free(buf);
     return status;
 }
 
@@ -138,16 +187,13 @@ enum golioth_status golioth_lightdb_set_async(struct golioth_client *client,
                                               golioth_set_cb_fn callback,
                                               void *callback_arg)
 {
-    return golioth_coap_client_set(client,
-                                   GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                   path,
-                                   content_type,
-                                   buf,
-                                   buf_len,
-                                   callback,
-                                   callback_arg,
-                                   false,
-                                   GOLIOTH_SYS_WAIT_FOREVER);
+    return lightdb_set_async(client,
+                             path,
+                             content_type,
+                             buf,
+                             buf_len,
+                             callback,
+                             callback_arg);
 }
 
 enum golioth_status golioth_lightdb_get_async(struct golioth_client *client,
@@ -157,6 +203,7 @@ enum golioth_status golioth_lightdb_get_async(struct golioth_client *client,
                                               void *callback_arg)
 {
     return golioth_coap_client_get(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                    path,
                                    content_type,
@@ -172,6 +219,7 @@ enum golioth_status golioth_lightdb_delete_async(struct golioth_client *client,
                                                  void *callback_arg)
 {
     return golioth_coap_client_delete(client,
+                                      GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                       GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                       path,
                                       callback,
@@ -186,6 +234,7 @@ enum golioth_status golioth_lightdb_observe_async(struct golioth_client *client,
                                                   void *arg)
 {
     return golioth_coap_client_observe_async(client,
+                                             GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                              GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                              path,
                                              GOLIOTH_CONTENT_TYPE_JSON,
@@ -201,6 +250,7 @@ enum golioth_status golioth_lightdb_set_int_sync(struct golioth_client *client,
     char buf[16] = {};
     snprintf(buf, sizeof(buf), "%" PRId32, value);
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -219,6 +269,7 @@ enum golioth_status golioth_lightdb_set_bool_sync(struct golioth_client *client,
 {
     const char *valuestr = (value ? "true" : "false");
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -238,6 +289,7 @@ enum golioth_status golioth_lightdb_set_float_sync(struct golioth_client *client
     char buf[32] = {};
     snprintf(buf, sizeof(buf), "%f", (double) value);
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -258,7 +310,7 @@ enum golioth_status golioth_lightdb_set_string_sync(struct golioth_client *clien
     // Server requires that non-JSON-formatted strings
     // be surrounded with literal ".
     size_t bufsize = str_len + 3;  // two " and a NULL
-    char *buf = golioth_sys_malloc(bufsize);
+    char *buf = golioth_payload_pool_alloc(bufsize);
     if (!buf)
     {
         return GOLIOTH_ERR_MEM_ALLOC;
@@ -267,6 +319,7 @@ enum golioth_status golioth_lightdb_set_string_sync(struct golioth_client *clien
     snprintf(buf, bufsize, "\"%s\"", str);
 
     enum golioth_status status = golioth_coap_client_set(client,
+                                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                                          path,
                                                          GOLIOTH_CONTENT_TYPE_JSON,
@@ -277,7 +330,7 @@ enum golioth_status golioth_lightdb_set_string_sync(struct golioth_client *clien
                                                          true,
                                                          timeout_s);
 
-    golioth_sys_free(buf);
+    golioth_payload_pool_free(buf);
     return status;
 }
 
@@ -289,6 +342,7 @@ enum golioth_status golioth_lightdb_set_sync(struct golioth_client *client,
                                              int32_t timeout_s)
 {
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                    path,
                                    content_type,
@@ -300,6 +354,50 @@ enum golioth_status golioth_lightdb_set_sync(struct golioth_client *client,
                                    timeout_s);
 }
 
+struct golioth_path *golioth_lightdb_path_create(const char *path)
+{
+    return golioth_path_create(GOLIOTH_LIGHTDB_STATE_PATH_PREFIX, path);
+}
+
+enum golioth_status golioth_lightdb_set_handle_async(struct golioth_client *client,
+                                                     const struct golioth_path *path,
+                                                     enum golioth_content_type content_type,
+                                                     const uint8_t *buf,
+                                                     size_t buf_len,
+                                                     golioth_set_cb_fn callback,
+                                                     void *callback_arg)
+{
+    return golioth_coap_client_set_handle(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          path,
+                                          content_type,
+                                          buf,
+                                          buf_len,
+                                          callback,
+                                          callback_arg,
+                                          false,
+                                          GOLIOTH_SYS_WAIT_FOREVER);
+}
+
+enum golioth_status golioth_lightdb_set_handle_sync(struct golioth_client *client,
+                                                    const struct golioth_path *path,
+                                                    enum golioth_content_type content_type,
+                                                    const uint8_t *buf,
+                                                    size_t buf_len,
+                                                    int32_t timeout_s)
+{
+    return golioth_coap_client_set_handle(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          path,
+                                          content_type,
+                                          buf,
+                                          buf_len,
+                                          NULL,
+                                          NULL,
+                                          true,
+                                          timeout_s);
+}
+
 static void on_payload(struct golioth_client *client,
                        const struct golioth_response *response,
                        const char *path,
@@ -359,6 +457,7 @@ enum golioth_status golioth_lightdb_get_int_sync(struct golioth_client *client,
         .i = value,
     };
     enum golioth_status status = golioth_coap_client_get(client,
+                                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                                          path,
                                                          GOLIOTH_CONTENT_TYPE_JSON,
@@ -383,6 +482,7 @@ enum golioth_status golioth_lightdb_get_bool_sync(struct golioth_client *client,
         .b = value,
     };
     enum golioth_status status = golioth_coap_client_get(client,
+                                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                                          path,
                                                          GOLIOTH_CONTENT_TYPE_JSON,
@@ -407,6 +507,7 @@ enum golioth_status golioth_lightdb_get_float_sync(struct golioth_client *client
         .f = value,
     };
     enum golioth_status status = golioth_coap_client_get(client,
+                                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                                          path,
                                                          GOLIOTH_CONTENT_TYPE_JSON,
@@ -433,6 +534,7 @@ enum golioth_status golioth_lightdb_get_string_sync(struct golioth_client *clien
         .buf_size = strbuf_size,
     };
     enum golioth_status status = golioth_coap_client_get(client,
+                                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                                          path,
                                                          GOLIOTH_CONTENT_TYPE_JSON,
@@ -461,6 +563,7 @@ enum golioth_status golioth_lightdb_get_sync(struct golioth_client *client,
         .buf_size = *buf_size,
     };
     enum golioth_status status = golioth_coap_client_get(client,
+                                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                                          GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                                          path,
                                                          content_type,
@@ -481,6 +584,7 @@ enum golioth_status golioth_lightdb_delete_sync(struct golioth_client *client,
                                                 int32_t timeout_s)
 {
     return golioth_coap_client_delete(client,
+                                      GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                       GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                       path,
                                       NULL,
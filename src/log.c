@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <zcbor_encode.h>
 #include "coap_client.h"
+#include "payload_pool.h"
 #include <golioth/log.h>
 #include <golioth/golioth_debug.h>
 #include <golioth/zcbor_utils.h>
@@ -46,7 +47,7 @@ static enum golioth_status golioth_log_internal(struct golioth_client *client,
 {
     assert(level <= GOLIOTH_LOG_LEVEL_DEBUG);
 
-    uint8_t *cbor_buf = malloc(CBOR_LOG_MAX_LEN);
+    uint8_t *cbor_buf = golioth_payload_pool_alloc(CBOR_LOG_MAX_LEN);
     enum golioth_status status = GOLIOTH_ERR_SERIALIZE;
     bool ok;
 
@@ -79,6 +80,7 @@ static enum golioth_status golioth_log_internal(struct golioth_client *client,
     }
 
     status = golioth_coap_client_set(client,
+                                     GOLIOTH_COAP_REQUEST_CLASS_LOG,
                                      "",  // path-prefix unused
                                      "logs",
                                      GOLIOTH_CONTENT_TYPE_CBOR,
@@ -90,7 +92,7 @@ static enum golioth_status golioth_log_internal(struct golioth_client *client,
                                      timeout_s);
 
 cleanup:
-    free(cbor_buf);
+    golioth_payload_pool_free(cbor_buf);
     return status;
 }
 
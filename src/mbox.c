@@ -11,79 +11,383 @@
 
 LOG_TAG_DEFINE(golioth_mbox);
 
+// Deficit round-robin quantum of a lane with weight 1, in bytes
+#define MBOX_LANE_QUANTUM 128
+
 golioth_mbox_t golioth_mbox_create(size_t num_items, size_t item_size)
 {
+    assert(item_size > 0);
+
+    // Room for one more item than needed, for the space skipped when the ring wraps around,
+    // plus the bytes that are always kept free.
+    struct golioth_mbox_lane_config lane = {
+        .max_num_items = num_items,
+        .buffer_size = (num_items + 1) * MSG_RING_MSG_SIZE(item_size) + sizeof(uint32_t),
+        .weight = 1,
+    };
+
+    golioth_mbox_t new_mbox = golioth_mbox_create_varlen(num_items, &lane, 1);
+    new_mbox->item_size = item_size;
+
+    return new_mbox;
+}
+
+size_t golioth_mbox_num_messages(golioth_mbox_t mbox)
+{
+    assert(mbox);
+
+    size_t num_messages = 0;
+    for (size_t i = 0; i < mbox->num_lanes; i++)
+    {
+        num_messages += msg_ring_size(&mbox->lanes[i].msg_ring);
+    }
+    return num_messages;
+}
+
+bool golioth_mbox_try_send(golioth_mbox_t mbox, const void *item)
+{
+    assert(mbox);
+    assert(mbox->item_size > 0);
+
+    struct golioth_mbox_part part = {item, mbox->item_size};
+    return golioth_mbox_try_send_parts(mbox, 0, &part, 1);
+}
+
+bool golioth_mbox_recv(golioth_mbox_t mbox, void *item, int32_t timeout_ms)
+{
+    assert(mbox);
+    assert(mbox->item_size > 0);
+
+    size_t len;
+    const void *msg = golioth_mbox_peek(mbox, &len, timeout_ms);
+    if (!msg)
+    {
+        return false;
+    }
+
+    assert(len == mbox->item_size);
+    memcpy(item, msg, len);
+    golioth_mbox_release(mbox);
+
+    return true;
+}
+
+void golioth_mbox_destroy(golioth_mbox_t mbox)
+{
+    assert(mbox);
+    // free stuff in the mbox
+    for (size_t i = 0; i < mbox->num_lanes; i++)
+    {
+        golioth_sys_free(mbox->lanes[i].msg_ring.buffer);
+    }
+    golioth_sys_free(mbox->lanes);
+    golioth_sys_sem_destroy(mbox->fill_count_sem);
+    // free the mbox itself
+    golioth_sys_free(mbox);
+}
+
+golioth_mbox_t golioth_mbox_create_varlen(size_t max_num_items,
+                                          const struct golioth_mbox_lane_config *lanes,
+                                          size_t num_lanes)
+{
+    assert(num_lanes > 0);
+
     golioth_mbox_t new_mbox = (golioth_mbox_t) golioth_sys_malloc(sizeof(struct golioth_mbox));
     assert(new_mbox);
     memset(new_mbox, 0, sizeof(struct golioth_mbox));
 
-    // Allocate storage for the items in the ringbuffer
-    size_t bufsize = RINGBUF_BUFFER_SIZE(item_size, num_items);
-    new_mbox->ringbuf.buffer = (uint8_t *) golioth_sys_malloc(bufsize);
-    assert(new_mbox->ringbuf.buffer);
-    memset(new_mbox->ringbuf.buffer, 0, bufsize);
+    size_t lanes_size = num_lanes * sizeof(struct golioth_mbox_lane);
+    new_mbox->lanes = (struct golioth_mbox_lane *) golioth_sys_malloc(lanes_size);
+    assert(new_mbox->lanes);
+    memset(new_mbox->lanes, 0, lanes_size);
+
+    size_t total_buffer_size = 0;
+    for (size_t i = 0; i < num_lanes; i++)
+    {
+        struct golioth_mbox_lane *lane = &new_mbox->lanes[i];
+
+        // Message headers are 4-byte aligned
+        size_t buffer_size = lanes[i].buffer_size & ~((size_t) 3);
 
-    new_mbox->ringbuf.buffer_size = bufsize;
-    new_mbox->ringbuf.item_size = item_size;
-    new_mbox->fill_count_sem = golioth_sys_sem_create(num_items, 0);
-    new_mbox->ringbuf_mutex = golioth_sys_sem_create(1, 1);
+        uint8_t *buffer = (uint8_t *) golioth_sys_malloc(buffer_size);
+        assert(buffer);
 
-    assert(ringbuf_capacity(&new_mbox->ringbuf) == num_items);
-    assert(ringbuf_size(&new_mbox->ringbuf) == 0);
+        msg_ring_init(&lane->msg_ring, buffer, buffer_size);
+        lane->max_num_items = lanes[i].max_num_items;
+        lane->quantum = MBOX_LANE_QUANTUM * (lanes[i].weight > 0 ? lanes[i].weight : 1);
+        atomic_init(&lane->num_items, 0);
+        total_buffer_size += buffer_size;
+    }
+
+    new_mbox->num_lanes = num_lanes;
+    new_mbox->max_num_items = max_num_items;
+    atomic_init(&new_mbox->num_items, 0);
+    atomic_init(&new_mbox->waiting, false);
+    // Producers give the semaphore at most once per wait
+    new_mbox->fill_count_sem = golioth_sys_sem_create(1, 0);
 
     GLTH_LOGI(TAG,
-              "Mbox created, bufsize: %" PRIu32 ", num_items: %" PRIu32 ", item_size: %" PRIu32,
-              (uint32_t) bufsize,
-              (uint32_t) num_items,
-              (uint32_t) item_size);
+              "Mbox created, bufsize: %" PRIu32 ", max_num_items: %" PRIu32 ", lanes: %" PRIu32,
+              (uint32_t) total_buffer_size,
+              (uint32_t) max_num_items,
+              (uint32_t) num_lanes);
 
     return new_mbox;
 }
 
-size_t golioth_mbox_num_messages(golioth_mbox_t mbox)
+// Count one more item, unless there are max_num_items already
+static bool take_slot(atomic_size_t *num_items, size_t max_num_items)
 {
-    assert(mbox);
-    return ringbuf_size(&mbox->ringbuf);
+    size_t n = atomic_load_explicit(num_items, memory_order_relaxed);
+
+    do
+    {
+        if (n >= max_num_items)
+        {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(num_items,
+                                                    &n,
+                                                    n + 1,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed));
+
+    return true;
 }
 
-bool golioth_mbox_try_send(golioth_mbox_t mbox, const void *item)
+bool golioth_mbox_try_send_parts(golioth_mbox_t mbox,
+                                 size_t lane,
+                                 const struct golioth_mbox_part *parts,
+                                 size_t num_parts)
 {
     assert(mbox);
+    assert(lane < mbox->num_lanes);
 
-    bool ret = golioth_sys_sem_take(mbox->ringbuf_mutex, GOLIOTH_SYS_WAIT_FOREVER);
-    assert(ret);
-    bool sent = ringbuf_put(&mbox->ringbuf, item);
-    golioth_sys_sem_give(mbox->ringbuf_mutex);
+    struct golioth_mbox_lane *l = &mbox->lanes[lane];
+
+    size_t len = 0;
+    for (size_t i = 0; i < num_parts; i++)
+    {
+        len += parts[i].len;
+    }
+
+    if (!take_slot(&mbox->num_items, mbox->max_num_items))
+    {
+        return false;
+    }
+
+    if (!take_slot(&l->num_items, l->max_num_items))
+    {
+        atomic_fetch_sub_explicit(&mbox->num_items, 1, memory_order_relaxed);
+        return false;
+    }
+
+    uint8_t *msg = msg_ring_reserve(&l->msg_ring, len);
+    if (!msg)
+    {
+        atomic_fetch_sub_explicit(&l->num_items, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&mbox->num_items, 1, memory_order_relaxed);
+        return false;
+    }
+
+    uint8_t *dst = msg;
+    for (size_t i = 0; i < num_parts; i++)
+    {
+        if (parts[i].len > 0)
+        {
+            memcpy(dst, parts[i].data, parts[i].len);
+            dst += parts[i].len;
+        }
+    }
+    msg_ring_commit(&l->msg_ring, msg);
 
-    if (sent)
+    // Pairs with the fence in start_waiting(): either the consumer sees the message, or
+    // this sees that the consumer is waiting.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&mbox->waiting, memory_order_relaxed)
+        && atomic_exchange(&mbox->waiting, false))
     {
-        ret = golioth_sys_sem_give(mbox->fill_count_sem);
-        assert(ret);
+        golioth_sys_sem_give(mbox->fill_count_sem);
     }
 
-    return sent;
+    return true;
 }
 
-bool golioth_mbox_recv(golioth_mbox_t mbox, void *item, int32_t timeout_ms)
+// Whether a lane has a message for the consumer
+static bool has_message(golioth_mbox_t mbox)
+{
+    for (size_t i = 0; i < mbox->num_lanes; i++)
+    {
+        size_t len;
+        if (msg_ring_peek(&mbox->lanes[i].msg_ring, &len))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Ask producers to give fill_count_sem. Returns true if there is a message already.
+static bool start_waiting(golioth_mbox_t mbox)
+{
+    atomic_store(&mbox->waiting, true);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    return has_message(mbox);
+}
+
+// Stop waiting for fill_count_sem. If a producer cleared waiting, it gives the semaphore
+// (or is just about to), so take it to keep it from cutting short the next wait.
+static void stop_waiting(golioth_mbox_t mbox)
+{
+    if (!atomic_exchange(&mbox->waiting, false))
+    {
+        golioth_sys_sem_take(mbox->fill_count_sem, GOLIOTH_SYS_WAIT_FOREVER);
+    }
+}
+
+static bool wait_for_message(golioth_mbox_t mbox, int32_t timeout_ms)
+{
+    if (has_message(mbox))
+    {
+        return true;
+    }
+
+    if (timeout_ms == 0)
+    {
+        return false;
+    }
+
+    if (mbox->fd_armed)
+    {
+        mbox->fd_armed = false;
+        stop_waiting(mbox);
+    }
+
+    uint64_t deadline_ms = golioth_sys_now_ms() + (timeout_ms > 0 ? timeout_ms : 0);
+
+    while (!start_waiting(mbox))
+    {
+        int32_t wait_ms = GOLIOTH_SYS_WAIT_FOREVER;
+        if (timeout_ms > 0)
+        {
+            uint64_t now_ms = golioth_sys_now_ms();
+            wait_ms = (now_ms < deadline_ms) ? (int32_t) (deadline_ms - now_ms) : 0;
+        }
+
+        if (!golioth_sys_sem_take(mbox->fill_count_sem, wait_ms))
+        {
+            stop_waiting(mbox);
+            return has_message(mbox);
+        }
+
+        // A producer committed a message, though it may be queued behind one that is
+        // still being written
+        if (has_message(mbox))
+        {
+            return true;
+        }
+    }
+
+    stop_waiting(mbox);
+    return true;
+}
+
+const void *golioth_mbox_peek(golioth_mbox_t mbox, size_t *len, int32_t timeout_ms)
 {
     assert(mbox);
-    bool received = golioth_sys_sem_take(mbox->fill_count_sem, timeout_ms);
-    if (received)
+
+    if (!wait_for_message(mbox, timeout_ms))
     {
-        bool ret = ringbuf_get(&mbox->ringbuf, item);
-        (void) ret;
-        assert(ret);
+        return NULL;
+    }
+
+    // Deficit round-robin: each lane gets its quantum added to its deficit once per
+    // round, and serves messages while they fit in the deficit. At least one lane has a
+    // message, and its deficit grows every round.
+    while (true)
+    {
+        struct golioth_mbox_lane *lane = &mbox->lanes[mbox->current_lane];
+        const void *msg = msg_ring_peek(&lane->msg_ring, len);
+
+        if (!msg)
+        {
+            // Idle lanes don't save up deficit
+            lane->deficit = 0;
+        }
+        else
+        {
+            if (!mbox->current_lane_started)
+            {
+                lane->deficit += lane->quantum;
+                mbox->current_lane_started = true;
+            }
+
+            size_t msg_size = MSG_RING_MSG_SIZE(*len);
+            if (msg_size <= lane->deficit)
+            {
+                lane->deficit -= msg_size;
+                mbox->peeked_lane = mbox->current_lane;
+                return msg;
+            }
+        }
+
+        mbox->current_lane = (mbox->current_lane + 1) % mbox->num_lanes;
+        mbox->current_lane_started = false;
     }
-    return received;
 }
 
-void golioth_mbox_destroy(golioth_mbox_t mbox)
+void golioth_mbox_release(golioth_mbox_t mbox)
 {
     assert(mbox);
-    // free stuff in the mbox
-    golioth_sys_free(mbox->ringbuf.buffer);
-    golioth_sys_sem_destroy(mbox->fill_count_sem);
-    golioth_sys_sem_destroy(mbox->ringbuf_mutex);
-    // free the mbox itself
-    golioth_sys_free(mbox);
+
+    struct golioth_mbox_lane *lane = &mbox->lanes[mbox->peeked_lane];
+
+    bool ret = msg_ring_consume(&lane->msg_ring);
+    (void) ret;
+    assert(ret);
+
+    atomic_fetch_sub_explicit(&lane->num_items, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&mbox->num_items, 1, memory_order_relaxed);
+}
+
+size_t golioth_mbox_num_lane_messages(golioth_mbox_t mbox, size_t lane)
+{
+    assert(mbox);
+    assert(lane < mbox->num_lanes);
+
+    return msg_ring_size(&mbox->lanes[lane].msg_ring);
+}
+
+int golioth_mbox_wait_fd(golioth_mbox_t mbox)
+{
+    assert(mbox);
+
+    int fd = golioth_sys_sem_get_fd(mbox->fill_count_sem);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (mbox->fd_armed)
+    {
+        if (atomic_load(&mbox->waiting))
+        {
+            // Nothing was sent since the last call, still waiting
+            return fd;
+        }
+
+        // Clear the wakeup from the last wait
+        stop_waiting(mbox);
+    }
+
+    mbox->fd_armed = true;
+    if (start_waiting(mbox) && atomic_exchange(&mbox->waiting, false))
+    {
+        // Wake up right away
+        golioth_sys_sem_give(mbox->fill_count_sem);
+    }
+
+    return fd;
 }
@@ -5,26 +5,112 @@
  */
 #pragma once
 
+#include <stdatomic.h>
 #include <golioth/golioth_sys.h>
-#include "ringbuf.h"
+#include "msg_ring.h"
 
-/// A multi-producer, single-consumer queue.
+/// A lock-free multi-producer, single-consumer queue.
 ///
-/// This is basically a ringbuffer+semaphore+mutex. The semaphore is for
-/// signaling when queue has items, so the consumer can be efficiently notified.
-/// The mutex is for preventing multiple producers from accessing the ringbuffer
-/// at once.
+/// Producers never block: they claim space in a message ring and count
+/// messages with atomic operations. The semaphore is only for waking up the
+/// consumer, and is only given when the consumer is waiting for a message, so
+/// a producer sending to a busy consumer makes no system calls.
+///
+/// An mbox created with golioth_mbox_create_varlen() holds variable-length
+/// messages instead of fixed-size items, and is used with the
+/// golioth_mbox_try_send_parts(), golioth_mbox_peek() and golioth_mbox_release()
+/// functions. An mbox created with golioth_mbox_create() is a variable-length
+/// mbox with a single lane, where every message is item_size bytes.
+///
+/// A variable-length mbox is split into lanes, each with its own buffer and
+/// depth limit. Messages within a lane are received in order, and the consumer
+/// picks between lanes with deficit round-robin, so each busy lane gets a share
+/// of the consumer proportional to its weight.
+
+/// Configuration of one lane of a variable-length mbox
+struct golioth_mbox_lane_config
+{
+    size_t max_num_items;
+    size_t buffer_size;
+    uint32_t weight;
+};
+
+struct golioth_mbox_lane
+{
+    msg_ring_t msg_ring;
+    size_t max_num_items;
+    // Messages sent to the lane, including ones that are still being copied in
+    atomic_size_t num_items;
+    // Bytes added to the deficit each round
+    size_t quantum;
+    // Bytes the lane can still take this round
+    size_t deficit;
+};
 
 struct golioth_mbox
 {
-    ringbuf_t ringbuf;
+    struct golioth_mbox_lane *lanes;
+    size_t num_lanes;
+    // Lane being served by the round-robin, and whether it got its quantum yet
+    size_t current_lane;
+    bool current_lane_started;
+    // Lane of the message returned by golioth_mbox_peek()
+    size_t peeked_lane;
+    // Item size of an mbox from golioth_mbox_create(), 0 for variable-length mboxes
+    size_t item_size;
+    size_t max_num_items;
+    atomic_size_t num_items;
+    // Set by the consumer before it waits for fill_count_sem. The producer that clears it
+    // gives the semaphore, so there's a single wakeup, and only when it's needed.
+    atomic_bool waiting;
+    // Whether the consumer set waiting in golioth_mbox_wait_fd()
+    bool fd_armed;
     golioth_sys_sem_t fill_count_sem;
-    golioth_sys_sem_t ringbuf_mutex;
 };
 typedef struct golioth_mbox *golioth_mbox_t;
 
+/// Part of a variable-length message
+struct golioth_mbox_part
+{
+    const void *data;
+    size_t len;
+};
+
 golioth_mbox_t golioth_mbox_create(size_t num_items, size_t item_size);
 size_t golioth_mbox_num_messages(golioth_mbox_t mbox);
 bool golioth_mbox_try_send(golioth_mbox_t mbox, const void *item);
 bool golioth_mbox_recv(golioth_mbox_t mbox, void *item, int32_t timeout_ms);
 void golioth_mbox_destroy(golioth_mbox_t mbox);
+
+/// Create an mbox for variable-length messages, with one lane per entry in
+/// lanes. The mbox holds up to max_num_items messages across all lanes.
+golioth_mbox_t golioth_mbox_create_varlen(size_t max_num_items,
+                                          const struct golioth_mbox_lane_config *lanes,
+                                          size_t num_lanes);
+
+/// Send one message made up of num_parts parts, copied back to back, to the
+/// given lane. Fails if the mbox or the lane already holds as many messages as
+/// it can, or if there is not enough room in the lane buffer.
+bool golioth_mbox_try_send_parts(golioth_mbox_t mbox,
+                                 size_t lane,
+                                 const struct golioth_mbox_part *parts,
+                                 size_t num_parts);
+
+/// Wait for a message, and return a pointer to it without removing it from
+/// the mbox. The message stays valid until golioth_mbox_release() is called.
+/// Returns NULL on timeout.
+const void *golioth_mbox_peek(golioth_mbox_t mbox, size_t *len, int32_t timeout_ms);
+
+/// Remove the message returned by golioth_mbox_peek()
+void golioth_mbox_release(golioth_mbox_t mbox);
+
+/// Number of messages in one lane of a variable-length mbox
+size_t golioth_mbox_num_lane_messages(golioth_mbox_t mbox, size_t lane);
+
+/// For consumers that wait for other events at the same time: get ready to
+/// wait for a message by polling the returned file descriptor. The fd becomes
+/// readable once there is a message, right away if there already is one, and
+/// stays readable until the next call. Call before every wait.
+///
+/// Returns -1 if semaphores have no file descriptors on this platform.
+int golioth_mbox_wait_fd(golioth_mbox_t mbox);
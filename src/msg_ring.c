@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "msg_ring.h"
+#include <assert.h>
+#include <string.h>
+
+/// When the ring is empty, the write index == read_index. Producers never let
+/// the write index catch up with read_index, so at least 4 bytes are always unused.
+///
+/// Producers claim space by moving the write index with a compare-and-swap,
+/// then fill in the message and set MSG_RING_COMMITTED in its header. The
+/// consumer stops at a header without that bit. This relies on all bytes
+/// outside of claimed messages being zero: the buffer is cleared on init, and
+/// the consumer clears each message before handing its space back.
+
+#define MSG_RING_HEADER_SIZE sizeof(uint32_t)
+
+// Length stored in place of a message header, telling the consumer to continue at index 0
+#define MSG_RING_WRAP_MARKER UINT32_MAX
+
+// Set in the header once the message has been written
+#define MSG_RING_COMMITTED (1UL << 31)
+
+// The low bits of write_state are the write index. The rest count reservations, so that a
+// producer that was preempted while the ring went all the way around does not mistake the
+// current write index for the one it loaded.
+#define MSG_RING_INDEX_BITS 20
+#define MSG_RING_INDEX_MASK ((1UL << MSG_RING_INDEX_BITS) - 1)
+
+#define NO_SPACE SIZE_MAX
+
+static _Atomic uint32_t *header(const msg_ring_t *ring, size_t index)
+{
+    return (_Atomic uint32_t *) &ring->buffer[index];
+}
+
+void msg_ring_init(msg_ring_t *ring, uint8_t *buffer, size_t buffer_size)
+{
+    assert(buffer_size % MSG_RING_HEADER_SIZE == 0);
+    assert(buffer_size <= MSG_RING_MAX_BUFFER_SIZE);
+    assert((uintptr_t) buffer % MSG_RING_HEADER_SIZE == 0);
+
+    memset(ring, 0, sizeof(*ring));
+    memset(buffer, 0, buffer_size);
+    ring->buffer = buffer;
+    ring->buffer_size = buffer_size;
+}
+
+// Index to put a message of msg_size bytes at, or NO_SPACE if it does not fit
+static size_t find_space(const msg_ring_t *ring,
+                         size_t write_index,
+                         size_t read_index,
+                         size_t msg_size)
+{
+    if (write_index >= read_index)
+    {
+        size_t space_at_end = ring->buffer_size - write_index;
+
+        // Filling up the end exactly moves the write index to 0, which must not be read_index
+        if (msg_size < space_at_end || (msg_size == space_at_end && read_index != 0))
+        {
+            return write_index;
+        }
+        if (msg_size < read_index)
+        {
+            return 0;
+        }
+    }
+    else if (msg_size < read_index - write_index)
+    {
+        return write_index;
+    }
+
+    return NO_SPACE;
+}
+
+void *msg_ring_reserve(msg_ring_t *ring, size_t len)
+{
+    if (len >= ring->buffer_size)
+    {
+        return NULL;
+    }
+
+    size_t msg_size = MSG_RING_MSG_SIZE(len);
+    uint32_t state = atomic_load_explicit(&ring->write_state, memory_order_acquire);
+    size_t write_index;
+    size_t msg_index;
+    uint32_t next_state;
+
+    do
+    {
+        // Loaded after write_state, so if the write index is unchanged, the space is free
+        size_t read_index = atomic_load_explicit(&ring->read_index, memory_order_acquire);
+
+        write_index = state & MSG_RING_INDEX_MASK;
+        msg_index = find_space(ring, write_index, read_index, msg_size);
+        if (msg_index == NO_SPACE)
+        {
+            return NULL;
+        }
+
+        size_t next_write_index = msg_index + msg_size;
+        if (next_write_index == ring->buffer_size)
+        {
+            next_write_index = 0;
+        }
+
+        next_state = ((state & ~MSG_RING_INDEX_MASK) + (1UL << MSG_RING_INDEX_BITS))
+            | next_write_index;
+    } while (!atomic_compare_exchange_weak_explicit(&ring->write_state,
+                                                    &state,
+                                                    next_state,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+
+    if (msg_index != write_index)
+    {
+        // Message did not fit at the end, skip the rest of the buffer
+        atomic_store_explicit(header(ring, write_index),
+                              MSG_RING_WRAP_MARKER,
+                              memory_order_release);
+    }
+    atomic_store_explicit(header(ring, msg_index), len, memory_order_relaxed);
+
+    return &ring->buffer[msg_index + MSG_RING_HEADER_SIZE];
+}
+
+void msg_ring_commit(msg_ring_t *ring, void *msg)
+{
+    size_t index = (uint8_t *) msg - ring->buffer - MSG_RING_HEADER_SIZE;
+    _Atomic uint32_t *hdr = header(ring, index);
+    uint32_t len = atomic_load_explicit(hdr, memory_order_relaxed);
+
+    assert(index < ring->buffer_size);
+    assert(!(len & MSG_RING_COMMITTED));
+
+    // Count it first, so the consumer never sees more consumed than committed messages
+    atomic_fetch_add_explicit(&ring->num_committed, 1, memory_order_relaxed);
+    atomic_store_explicit(hdr, len | MSG_RING_COMMITTED, memory_order_release);
+}
+
+const void *msg_ring_peek(msg_ring_t *ring, size_t *len)
+{
+    size_t read_index = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+    uint32_t hdr = atomic_load_explicit(header(ring, read_index), memory_order_acquire);
+
+    if (hdr == MSG_RING_WRAP_MARKER)
+    {
+        // Producers only write a wrap marker after reserving a message at index 0
+        atomic_store_explicit(header(ring, read_index), 0, memory_order_relaxed);
+        read_index = 0;
+        atomic_store_explicit(&ring->read_index, 0, memory_order_release);
+        hdr = atomic_load_explicit(header(ring, 0), memory_order_acquire);
+    }
+
+    // Empty, or the oldest message is not committed yet
+    if (!(hdr & MSG_RING_COMMITTED))
+    {
+        return NULL;
+    }
+
+    *len = hdr & ~MSG_RING_COMMITTED;
+    return &ring->buffer[read_index + MSG_RING_HEADER_SIZE];
+}
+
+bool msg_ring_consume(msg_ring_t *ring)
+{
+    size_t len;
+    if (!msg_ring_peek(ring, &len))
+    {
+        return false;
+    }
+
+    size_t read_index = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+    size_t msg_size = MSG_RING_MSG_SIZE(len);
+
+    atomic_store_explicit(header(ring, read_index), 0, memory_order_relaxed);
+    memset(&ring->buffer[read_index + MSG_RING_HEADER_SIZE], 0, msg_size - MSG_RING_HEADER_SIZE);
+
+    size_t next_read_index = read_index + msg_size;
+    if (next_read_index == ring->buffer_size)
+    {
+        next_read_index = 0;
+    }
+
+    atomic_fetch_add_explicit(&ring->num_consumed, 1, memory_order_release);
+    atomic_store_explicit(&ring->read_index, next_read_index, memory_order_release);
+
+    return true;
+}
+
+size_t msg_ring_size(const msg_ring_t *ring)
+{
+    // Consumed first, since it can't get ahead of committed
+    uint32_t num_consumed = atomic_load_explicit(&ring->num_consumed, memory_order_acquire);
+    uint32_t num_committed = atomic_load_explicit(&ring->num_committed, memory_order_relaxed);
+
+    return (uint32_t) (num_committed - num_consumed);
+}
+
+bool msg_ring_is_empty(const msg_ring_t *ring)
+{
+    uint32_t write_state = atomic_load_explicit(&ring->write_state, memory_order_acquire);
+
+    return ((write_state & MSG_RING_INDEX_MASK)
+            == atomic_load_explicit(&ring->read_index, memory_order_acquire));
+}
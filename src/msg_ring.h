@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/// A ring buffer of variable-length messages.
+///
+/// Each message is stored as a 4-byte length followed by the message bytes,
+/// padded to a multiple of 4 bytes. Messages are always contiguous in the
+/// buffer: when a message does not fit in the space left at the end of the
+/// buffer, a wrap marker is written there and the message is placed at the
+/// start instead (like a bip buffer).
+///
+/// Messages are written in two steps: msg_ring_reserve() returns space for
+/// the message, which is published by msg_ring_commit(). Likewise, the
+/// oldest message can be read in place with msg_ring_peek(), and is freed by
+/// msg_ring_consume().
+///
+/// Lock-free, and safe for any number of producers and one consumer running
+/// concurrently. Messages are received in the order their space was reserved,
+/// so a message that is reserved but not yet committed holds back the ones
+/// reserved after it.
+
+/// Number of bytes a message of len bytes takes up in the buffer
+#define MSG_RING_MSG_SIZE(len) (sizeof(uint32_t) + (((len) + 3) & ~((size_t) 3)))
+
+typedef struct
+{
+    // Write index, and a count of reservations in the upper bits
+    _Atomic uint32_t write_state;
+    _Atomic uint32_t read_index;
+    // Number of messages committed and consumed, the difference is the number of messages
+    _Atomic uint32_t num_committed;
+    _Atomic uint32_t num_consumed;
+    uint8_t *buffer;
+    // Must be a multiple of 4
+    size_t buffer_size;
+} msg_ring_t;
+
+/// Maximum buffer size of a ring
+#define MSG_RING_MAX_BUFFER_SIZE (1UL << 20)
+
+/// Initialize the ring. The buffer must be 4-byte aligned, and is cleared.
+void msg_ring_init(msg_ring_t *ring, uint8_t *buffer, size_t buffer_size);
+
+/// Reserve space for a message of len bytes. Returns NULL if the message does not fit.
+///
+/// The message becomes visible to the consumer when msg_ring_commit() is called. Every
+/// message that is reserved must be committed, or the consumer gets stuck on it.
+void *msg_ring_reserve(msg_ring_t *ring, size_t len);
+
+/// Publish a message returned by msg_ring_reserve()
+void msg_ring_commit(msg_ring_t *ring, void *msg);
+
+/// Returns the oldest message and its length, or NULL if the ring is empty
+const void *msg_ring_peek(msg_ring_t *ring, size_t *len);
+
+/// Remove the oldest message. Pointers returned by msg_ring_peek() are no longer valid.
+bool msg_ring_consume(msg_ring_t *ring);
+
+/// Number of messages in the ring
+size_t msg_ring_size(const msg_ring_t *ring);
+
+bool msg_ring_is_empty(const msg_ring_t *ring);
@@ -87,6 +87,7 @@ enum golioth_status golioth_ota_observe_manifest_async(struct golioth_client *cl
                                                        void *arg)
 {
     return golioth_coap_client_observe_async(client,
+                                             GOLIOTH_COAP_REQUEST_CLASS_OTA,
                                              "",
                                              GOLIOTH_OTA_MANIFEST_PATH,
                                              GOLIOTH_CONTENT_TYPE_CBOR,
@@ -158,6 +159,7 @@ enum golioth_status golioth_ota_report_state_sync(struct golioth_client *client,
 
     _state = state;
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_OTA,
                                    GOLIOTH_OTA_COMPONENT_PATH_PREFIX,
                                    package,
                                    GOLIOTH_CONTENT_TYPE_CBOR,
@@ -352,6 +354,7 @@ enum golioth_status golioth_ota_get_block_sync(struct golioth_client *client,
 
     enum golioth_status status = GOLIOTH_OK;
     status = golioth_coap_client_get_block(client,
+                                           GOLIOTH_COAP_REQUEST_CLASS_OTA,
                                            GOLIOTH_OTA_COMPONENT_PATH_PREFIX,
                                            path,
                                            GOLIOTH_CONTENT_TYPE_JSON,
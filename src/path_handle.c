@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "path_handle.h"
+#include <stdbool.h>
+#include <string.h>
+#include <golioth/golioth_sys.h>
+
+// Longest value a URI-Path option can hold
+#define MAX_SEGMENT_LEN 255
+
+// Count the non-empty segments of str. cur_len carries the length of the
+// current segment, so that consecutive strings can be counted as one.
+static bool count_segments(const char *str, size_t *cur_len, size_t *num_segments)
+{
+    for (; *str; str++)
+    {
+        if (*str == '/')
+        {
+            if (*cur_len > 0)
+            {
+                (*num_segments)++;
+            }
+            *cur_len = 0;
+        }
+        else if (++(*cur_len) > MAX_SEGMENT_LEN)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct golioth_path *golioth_path_create(const char *path_prefix, const char *path)
+{
+    if (!path_prefix)
+    {
+        path_prefix = "";
+    }
+
+    if (!path)
+    {
+        return NULL;
+    }
+
+    size_t num_segments = 0;
+    size_t cur_len = 0;
+    if (!count_segments(path_prefix, &cur_len, &num_segments)
+        || !count_segments(path, &cur_len, &num_segments))
+    {
+        return NULL;
+    }
+    if (cur_len > 0)
+    {
+        num_segments++;
+    }
+
+    size_t prefix_len = strlen(path_prefix);
+    size_t str_len = prefix_len + strlen(path);
+
+    // Single allocation: the path struct, then the segment pointers and lengths,
+    // then the full path string and a copy of it which is split into segments.
+    size_t alloc_size = sizeof(struct golioth_path) + (num_segments + 1) * sizeof(uint8_t *)
+        + num_segments + 2 * (str_len + 1);
+
+    struct golioth_path *new_path = golioth_sys_malloc(alloc_size);
+    if (!new_path)
+    {
+        return NULL;
+    }
+
+    const uint8_t **segments = (const uint8_t **) (new_path + 1);
+    uint8_t *segment_lens = (uint8_t *) (segments + num_segments + 1);
+    char *str = (char *) (segment_lens + num_segments);
+    char *segment_str = str + str_len + 1;
+
+    memcpy(str, path_prefix, prefix_len);
+    strcpy(str + prefix_len, path);
+    memcpy(segment_str, str, str_len + 1);
+
+    size_t n = 0;
+    char *start = segment_str;
+    for (char *c = segment_str;; c++)
+    {
+        if (*c != '/' && *c != '\0')
+        {
+            continue;
+        }
+
+        bool is_end = (*c == '\0');
+        if (c > start)
+        {
+            *c = '\0';
+            segments[n] = (const uint8_t *) start;
+            segment_lens[n] = c - start;
+            n++;
+        }
+        start = c + 1;
+
+        if (is_end)
+        {
+            break;
+        }
+    }
+    segments[n] = NULL;
+
+    new_path->segments = segments;
+    new_path->segment_lens = segment_lens;
+    new_path->num_segments = num_segments;
+    new_path->str = str;
+    new_path->delivery_mode = GOLIOTH_DELIVERY_CONFIRMABLE;
+
+    return new_path;
+}
+
+void golioth_path_destroy(struct golioth_path *path)
+{
+    golioth_sys_free(path);
+}
+
+void golioth_path_set_delivery_mode(struct golioth_path *path, enum golioth_delivery_mode mode)
+{
+    if (path)
+    {
+        path->delivery_mode = mode;
+    }
+}
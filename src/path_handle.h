@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <golioth/client.h>
+
+/// A CoAP path, split into URI-Path segments ahead of time.
+///
+/// Created once with golioth_path_create(), and then used by any number of
+/// requests, so that the path doesn't need to be formatted and split for
+/// each request.
+struct golioth_path
+{
+    /// Segments as NUL-terminated strings, followed by a NULL sentinel. Can be
+    /// used as the pathv of the Zephyr CoAP request functions.
+    const uint8_t **segments;
+    /// Length of each segment, in bytes
+    const uint8_t *segment_lens;
+    size_t num_segments;
+    /// The full path, for logging
+    const char *str;
+    /// How sets to the path are delivered, see golioth_path_set_delivery_mode()
+    enum golioth_delivery_mode delivery_mode;
+};
+
+/// Create a path handle for path_prefix + path. Empty segments are skipped.
+///
+/// Returns NULL if out of memory, or if a segment is longer than a URI-Path
+/// option allows (255 bytes).
+struct golioth_path *golioth_path_create(const char *path_prefix, const char *path);
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "payload_pool.h"
+#include <string.h>
+#include <golioth/golioth_sys.h>
+#include "golioth_util.h"
+
+// Blocks are stored as arrays of pointers, so that a free block can hold the
+// link to the next free block.
+#define POOL_BLOCK_WORDS(block_size) ((max((block_size), 1) + sizeof(void *) - 1) / sizeof(void *))
+#define POOL_STORAGE_WORDS(block_size, num_blocks) \
+    (POOL_BLOCK_WORDS(block_size) * max((num_blocks), 1))
+
+struct pool_class
+{
+    void **storage;
+    size_t block_words;
+    size_t num_blocks;
+    // Singly linked list of free blocks, threaded through the blocks themselves
+    void *free_list;
+    struct golioth_payload_pool_class_stats stats;
+};
+
+static void *_small_storage[POOL_STORAGE_WORDS(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE,
+                                               CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS)];
+static void *_medium_storage[POOL_STORAGE_WORDS(CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE,
+                                                CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS)];
+static void *_large_storage[POOL_STORAGE_WORDS(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE,
+                                               CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS)];
+
+static struct pool_class _classes[GOLIOTH_PAYLOAD_POOL_NUM_CLASSES] = {
+    {
+        .storage = _small_storage,
+        .block_words = POOL_BLOCK_WORDS(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE),
+        .num_blocks = CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS,
+    },
+    {
+        .storage = _medium_storage,
+        .block_words = POOL_BLOCK_WORDS(CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE),
+        .num_blocks = CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS,
+    },
+    {
+        .storage = _large_storage,
+        .block_words = POOL_BLOCK_WORDS(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE),
+        .num_blocks = CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS,
+    },
+};
+
+static uint32_t _num_heap_allocs;
+
+// NULL until golioth_payload_pool_init() is called
+static golioth_sys_sem_t _pool_lock;
+
+static size_t block_size(const struct pool_class *c)
+{
+    return c->block_words * sizeof(void *);
+}
+
+static struct pool_class *class_of(const void *ptr)
+{
+    uintptr_t addr = (uintptr_t) ptr;
+
+    for (size_t i = 0; i < ARRAY_SIZE(_classes); i++)
+    {
+        struct pool_class *c = &_classes[i];
+        uintptr_t start = (uintptr_t) c->storage;
+        uintptr_t end = start + block_size(c) * c->num_blocks;
+
+        if (addr >= start && addr < end)
+        {
+            return c;
+        }
+    }
+
+    return NULL;
+}
+
+void golioth_payload_pool_init(void)
+{
+    if (_pool_lock)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(_classes); i++)
+    {
+        struct pool_class *c = &_classes[i];
+
+        c->free_list = NULL;
+        for (size_t n = c->num_blocks; n > 0; n--)
+        {
+            void **block = &c->storage[(n - 1) * c->block_words];
+            *block = c->free_list;
+            c->free_list = block;
+        }
+
+        memset(&c->stats, 0, sizeof(c->stats));
+        c->stats.block_size = block_size(c);
+        c->stats.num_blocks = c->num_blocks;
+    }
+
+    _pool_lock = golioth_sys_sem_create(1, 1);
+}
+
+void *golioth_payload_pool_alloc(size_t size)
+{
+    if (!_pool_lock)
+    {
+        return golioth_sys_malloc(size);
+    }
+
+    golioth_sys_sem_take(_pool_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    // Smallest class the size fits in, and smallest class with a free block
+    struct pool_class *fit = NULL;
+    struct pool_class *avail = NULL;
+
+    for (size_t i = 0; i < ARRAY_SIZE(_classes); i++)
+    {
+        struct pool_class *c = &_classes[i];
+
+        if (c->num_blocks == 0 || block_size(c) < size)
+        {
+            continue;
+        }
+
+        if (!fit || c->block_words < fit->block_words)
+        {
+            fit = c;
+        }
+
+        if (c->free_list && (!avail || c->block_words < avail->block_words))
+        {
+            avail = c;
+        }
+    }
+
+    if (fit && fit != avail)
+    {
+        fit->stats.num_spills++;
+    }
+
+    if (!avail)
+    {
+        _num_heap_allocs++;
+        golioth_sys_sem_give(_pool_lock);
+        return golioth_sys_malloc(size);
+    }
+
+    void **block = avail->free_list;
+    avail->free_list = *block;
+
+    avail->stats.num_allocs++;
+    avail->stats.in_use++;
+    avail->stats.max_in_use = max(avail->stats.max_in_use, avail->stats.in_use);
+
+    golioth_sys_sem_give(_pool_lock);
+
+    return block;
+}
+
+void golioth_payload_pool_free(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    struct pool_class *c = class_of(ptr);
+    if (!c)
+    {
+        golioth_sys_free(ptr);
+        return;
+    }
+
+    golioth_sys_sem_take(_pool_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    void **block = ptr;
+    *block = c->free_list;
+    c->free_list = block;
+    c->stats.in_use--;
+
+    golioth_sys_sem_give(_pool_lock);
+}
+
+void golioth_payload_pool_release(const uint8_t *payload, size_t payload_size, void *arg)
+{
+    golioth_payload_pool_free((void *) payload);
+}
+
+void golioth_payload_pool_get_stats(struct golioth_payload_pool_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (!_pool_lock)
+    {
+        return;
+    }
+
+    golioth_sys_sem_take(_pool_lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    for (size_t i = 0; i < ARRAY_SIZE(_classes); i++)
+    {
+        stats->classes[i] = _classes[i].stats;
+    }
+    stats->num_heap_allocs = _num_heap_allocs;
+
+    golioth_sys_sem_give(_pool_lock);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// Allocator for request payloads and other short-lived buffers.
+///
+/// Blocks come from a few statically allocated size classes (small, medium
+/// and large, see CONFIG_GOLIOTH_PAYLOAD_POOL_*), so the steady stream of
+/// payload allocations does not fragment the heap. An allocation is served
+/// from the smallest class it fits in, then from a larger class, and falls
+/// back to golioth_sys_malloc() when the pool has nothing left.
+///
+/// Thread-safe once golioth_payload_pool_init() has been called. Does not
+/// log, since it is used on the cloud logging path.
+
+#define GOLIOTH_PAYLOAD_POOL_NUM_CLASSES 3
+
+struct golioth_payload_pool_class_stats
+{
+    /// Size of each block, in bytes
+    size_t block_size;
+    /// Number of blocks in this class
+    size_t num_blocks;
+    /// Number of blocks currently allocated
+    size_t in_use;
+    /// Highest value of in_use seen so far
+    size_t max_in_use;
+    /// Number of allocations served by this class
+    uint32_t num_allocs;
+    /// Number of allocations that fit this class, but had to be served by a
+    /// larger class or the heap because this class was exhausted
+    uint32_t num_spills;
+};
+
+struct golioth_payload_pool_stats
+{
+    /// Size classes, in the order small, medium, large
+    struct golioth_payload_pool_class_stats classes[GOLIOTH_PAYLOAD_POOL_NUM_CLASSES];
+    /// Number of allocations served by the heap
+    uint32_t num_heap_allocs;
+};
+
+/// Set up the pool. Safe to call more than once, but the first call must not
+/// race with any other pool function. Allocations made before this is called
+/// are served by the heap.
+void golioth_payload_pool_init(void);
+
+/// Allocate a buffer of at least size bytes. Returns NULL if the pool and
+/// the heap are both exhausted.
+void *golioth_payload_pool_alloc(size_t size);
+
+/// Free a buffer returned by golioth_payload_pool_alloc(). ptr can be NULL.
+void golioth_payload_pool_free(void *ptr);
+
+/// Same as golioth_payload_pool_free(), with the signature of a
+/// golioth_payload_release_fn, for payloads handed to the CoAP client.
+void golioth_payload_pool_release(const uint8_t *payload, size_t payload_size, void *arg);
+
+/// Take a snapshot of the pool usage counters
+void golioth_payload_pool_get_stats(struct golioth_payload_pool_stats *stats);
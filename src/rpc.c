@@ -208,6 +208,7 @@ static void on_rpc(struct golioth_client *client,
     }
 
     golioth_coap_client_set(client,
+                            GOLIOTH_COAP_REQUEST_CLASS_RPC,
                             GOLIOTH_RPC_PATH_PREFIX,
                             "status",
                             GOLIOTH_CONTENT_TYPE_CBOR,
@@ -255,6 +256,7 @@ enum golioth_status golioth_rpc_register(struct golioth_rpc *grpc,
     if (grpc->num_rpcs == 1)
     {
         return golioth_coap_client_observe_async(grpc->client,
+                                                 GOLIOTH_COAP_REQUEST_CLASS_RPC,
                                                  GOLIOTH_RPC_PATH_PREFIX,
                                                  "",
                                                  GOLIOTH_CONTENT_TYPE_CBOR,
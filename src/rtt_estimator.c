@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "rtt_estimator.h"
+#include <string.h>
+
+// The strong estimator uses the RTO formula of RFC 6298 (K = 4), the weak one a smaller
+// variance weight, as its samples are less precise.
+#define STRONG_K 4
+#define WEAK_K 1
+
+// RTOs below and above these use a larger and a smaller backoff factor, respectively
+#define SHORT_RTO_MS 1000
+#define LONG_RTO_MS 3000
+
+static uint32_t clamp_rto(uint64_t rto_ms)
+{
+    if (rto_ms < GOLIOTH_RTT_MIN_RTO_MS)
+    {
+        return GOLIOTH_RTT_MIN_RTO_MS;
+    }
+    if (rto_ms > GOLIOTH_RTT_MAX_RTO_MS)
+    {
+        return GOLIOTH_RTT_MAX_RTO_MS;
+    }
+    return (uint32_t) rto_ms;
+}
+
+// RFC 6298 smoothing, with alpha = 1/8 and beta = 1/4. Returns the estimate for the RTO.
+static uint64_t smooth(uint32_t *srtt_ms,
+                       uint32_t *rttvar_ms,
+                       bool *has_samples,
+                       uint32_t rtt_ms,
+                       uint32_t k)
+{
+    if (!*has_samples)
+    {
+        *srtt_ms = rtt_ms;
+        *rttvar_ms = rtt_ms / 2;
+        *has_samples = true;
+    }
+    else
+    {
+        uint32_t delta = (*srtt_ms > rtt_ms) ? *srtt_ms - rtt_ms : rtt_ms - *srtt_ms;
+        *rttvar_ms = (uint32_t) (((uint64_t) *rttvar_ms * 3 + delta) / 4);
+        *srtt_ms = (uint32_t) (((uint64_t) *srtt_ms * 7 + rtt_ms) / 8);
+    }
+
+    return (uint64_t) *srtt_ms + (uint64_t) k * *rttvar_ms;
+}
+
+void golioth_rtt_estimator_init(struct golioth_rtt_estimator *est, uint32_t initial_rto_ms)
+{
+    memset(est, 0, sizeof(*est));
+    est->initial_rto_ms = clamp_rto(initial_rto_ms);
+    est->rto_ms = est->initial_rto_ms;
+}
+
+void golioth_rtt_estimator_update(struct golioth_rtt_estimator *est,
+                                  uint32_t rtt_ms,
+                                  bool retransmitted,
+                                  uint64_t now_ms)
+{
+    uint64_t rto_ms;
+
+    if (retransmitted)
+    {
+        uint64_t estimate =
+            smooth(&est->weak_srtt_ms, &est->weak_rttvar_ms, &est->has_weak, rtt_ms, WEAK_K);
+        rto_ms = (estimate + 3 * (uint64_t) est->rto_ms) / 4;
+    }
+    else
+    {
+        uint64_t estimate = smooth(&est->strong_srtt_ms,
+                                   &est->strong_rttvar_ms,
+                                   &est->has_strong,
+                                   rtt_ms,
+                                   STRONG_K);
+        rto_ms = (estimate + est->rto_ms) / 2;
+    }
+
+    est->rto_ms = clamp_rto(rto_ms);
+    est->last_update_ms = now_ms;
+    est->num_samples++;
+}
+
+uint32_t golioth_rtt_estimator_rto_ms(struct golioth_rtt_estimator *est, uint64_t now_ms)
+{
+    if (est->num_samples == 0)
+    {
+        return est->rto_ms;
+    }
+
+    // A short RTO that hasn't been confirmed for a while may no longer hold, so it is
+    // doubled. A long one is pulled back towards the initial RTO, so that a single slow
+    // period doesn't make the client sluggish for good.
+    if (est->rto_ms < SHORT_RTO_MS && now_ms - est->last_update_ms > 16 * (uint64_t) est->rto_ms)
+    {
+        est->rto_ms = clamp_rto(2 * (uint64_t) est->rto_ms);
+        est->last_update_ms = now_ms;
+    }
+    else if (est->rto_ms > LONG_RTO_MS
+             && now_ms - est->last_update_ms > 4 * (uint64_t) est->rto_ms)
+    {
+        est->rto_ms = clamp_rto(((uint64_t) est->rto_ms + est->initial_rto_ms) / 2);
+        est->last_update_ms = now_ms;
+    }
+
+    return est->rto_ms;
+}
+
+uint32_t golioth_rtt_estimator_backoff_ms(uint32_t initial_rto_ms, uint32_t timeout_ms)
+{
+    uint64_t next_ms;
+
+    if (initial_rto_ms < SHORT_RTO_MS)
+    {
+        next_ms = 3 * (uint64_t) timeout_ms;
+    }
+    else if (initial_rto_ms > LONG_RTO_MS)
+    {
+        next_ms = (3 * (uint64_t) timeout_ms) / 2;
+    }
+    else
+    {
+        next_ms = 2 * (uint64_t) timeout_ms;
+    }
+
+    return (uint32_t) ((next_ms < UINT32_MAX) ? next_ms : UINT32_MAX);
+}
+
+void golioth_rtt_estimator_get(const struct golioth_rtt_estimator *est,
+                               struct golioth_client_rtt *rtt)
+{
+    rtt->rto_ms = est->rto_ms;
+    rtt->num_samples = est->num_samples;
+
+    if (est->has_strong)
+    {
+        rtt->srtt_ms = est->strong_srtt_ms;
+        rtt->rttvar_ms = est->strong_rttvar_ms;
+    }
+    else
+    {
+        rtt->srtt_ms = est->weak_srtt_ms;
+        rtt->rttvar_ms = est->weak_rttvar_ms;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <golioth/client.h>
+
+/// Round-trip time estimator for CoAP retransmission and response timeouts.
+///
+/// Follows CoCoA (draft-ietf-core-cocoa): RTT samples from exchanges that were answered
+/// without retransmission feed a "strong" estimator, and samples from exchanges that needed
+/// retransmissions (measured from the first transmission) feed a "weak" estimator. Both are
+/// smoothed like RFC 6298 and blended into one retransmission timeout (RTO), which decays
+/// back towards the initial RTO when no samples arrive for a while.
+///
+/// Not thread safe. Each client has one estimator, which is only updated by the CoAP thread.
+
+/// RTO until the first RTT sample, as the CoAP ACK_TIMEOUT (RFC 7252), in milliseconds
+#define GOLIOTH_RTT_INITIAL_RTO_MS 2000
+
+/// Lower and upper bounds of the RTO, in milliseconds
+#define GOLIOTH_RTT_MIN_RTO_MS 250
+#define GOLIOTH_RTT_MAX_RTO_MS 60000
+
+struct golioth_rtt_estimator
+{
+    uint32_t initial_rto_ms;
+    uint32_t rto_ms;
+    uint32_t strong_srtt_ms;
+    uint32_t strong_rttvar_ms;
+    uint32_t weak_srtt_ms;
+    uint32_t weak_rttvar_ms;
+    bool has_strong;
+    bool has_weak;
+    uint32_t num_samples;
+    // When rto_ms was last changed by a sample or by aging
+    uint64_t last_update_ms;
+};
+
+/// Reset the estimator, with initial_rto_ms as the RTO until the first sample
+void golioth_rtt_estimator_init(struct golioth_rtt_estimator *est, uint32_t initial_rto_ms);
+
+/// Add the RTT of an exchange that has just been answered.
+///
+/// If the request was retransmitted, rtt_ms must be measured from the first transmission.
+void golioth_rtt_estimator_update(struct golioth_rtt_estimator *est,
+                                  uint32_t rtt_ms,
+                                  bool retransmitted,
+                                  uint64_t now_ms);
+
+/// Current RTO, i.e. how long to wait for the response to a first transmission before
+/// retransmitting. Ages the estimate first, if it hasn't been updated for a while.
+uint32_t golioth_rtt_estimator_rto_ms(struct golioth_rtt_estimator *est, uint64_t now_ms);
+
+/// Timeout of the next retransmission of an exchange that started with initial_rto_ms, after
+/// a transmission that timed out after timeout_ms. The backoff factor is larger for short
+/// RTOs and smaller for long ones, so a fast link retries quickly without flooding it, and a
+/// slow link doesn't wait several minutes for its last retransmission.
+uint32_t golioth_rtt_estimator_backoff_ms(uint32_t initial_rto_ms, uint32_t timeout_ms);
+
+/// Copy the current estimates to rtt
+void golioth_rtt_estimator_get(const struct golioth_rtt_estimator *est,
+                               struct golioth_client_rtt *rtt);
@@ -175,6 +175,7 @@ static int finalize_and_send_response(struct golioth_client *client,
                             GOLIOTH_DEBUG_LOG_LEVEL_DEBUG);
 
     golioth_coap_client_set(client,
+                            GOLIOTH_COAP_REQUEST_CLASS_RPC,
                             SETTINGS_PATH_PREFIX,
                             "status",
                             GOLIOTH_CONTENT_TYPE_CBOR,
@@ -424,6 +425,7 @@ static struct golioth_setting *alloc_setting(struct golioth_settings *settings)
 static enum golioth_status request_settings(struct golioth_settings *settings)
 {
     return golioth_coap_client_get(settings->client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_RPC,
                                    SETTINGS_PATH_PREFIX,
                                    "",
                                    GOLIOTH_CONTENT_TYPE_CBOR,
@@ -446,6 +448,7 @@ struct golioth_settings *golioth_settings_init(struct golioth_client *client)
     gsettings->num_settings = 0;
 
     enum golioth_status status = golioth_coap_client_observe_async(client,
+                                                                   GOLIOTH_COAP_REQUEST_CLASS_RPC,
                                                                    SETTINGS_PATH_PREFIX,
                                                                    "",
                                                                    GOLIOTH_CONTENT_TYPE_CBOR,
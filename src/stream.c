@@ -7,12 +7,17 @@
 #include <golioth/stream.h>
 #include <golioth/golioth_sys.h>
 #include "coap_client.h"
+#include "path_handle.h"
+#include "payload_pool.h"
 #include "golioth_util.h"
 
 #if defined(CONFIG_GOLIOTH_STREAM)
 
 #define GOLIOTH_STREAM_PATH_PREFIX ".s/"
 
+// Largest block size CoAP allows
+#define GOLIOTH_STREAM_BLOCK_SIZE 1024
+
 enum golioth_status golioth_stream_set_int_async(struct golioth_client *client,
                                                  const char *path,
                                                  int32_t value,
@@ -22,6 +27,7 @@ enum golioth_status golioth_stream_set_int_async(struct golioth_client *client,
     char buf[16] = {};
     snprintf(buf, sizeof(buf), "%" PRId32, value);
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -41,6 +47,7 @@ enum golioth_status golioth_stream_set_bool_async(struct golioth_client *client,
 {
     const char *valuestr = (value ? "true" : "false");
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -61,6 +68,7 @@ enum golioth_status golioth_stream_set_float_async(struct golioth_client *client
     char buf[32] = {};
     snprintf(buf, sizeof(buf), "%f", (double) value);
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -87,7 +95,7 @@ enum golioth_status golioth_stream_set_string_async(struct golioth_client *clien
     //
     // TODO - is there a better way to handle this?
     size_t bufsize = str_len + 3;  // two " and a NULL
-    char *buf = golioth_sys_malloc(bufsize);
+    char *buf = golioth_payload_pool_alloc(bufsize);
     if (!buf)
     {
         return GOLIOTH_ERR_MEM_ALLOC;
@@ -95,18 +103,26 @@ enum golioth_status golioth_stream_set_string_async(struct golioth_client *clien
     memset(buf, 0, bufsize);
     snprintf(buf, bufsize, "\"%s\"", str);
 
-    enum golioth_status status = golioth_coap_client_set(client,
-                                                         GOLIOTH_STREAM_PATH_PREFIX,
-                                                         path,
-                                                         GOLIOTH_CONTENT_TYPE_JSON,
-                                                         (const uint8_t *) buf,
-                                                         bufsize - 1,  // excluding NULL
-                                                         callback,
-                                                         callback_arg,
-                                                         false,
-                                                         GOLIOTH_SYS_WAIT_FOREVER);
+    // The buffer is handed over to the client, which frees it after sending
+    enum golioth_status status =
+        golioth_coap_client_set_borrowed(client,
+                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                         GOLIOTH_STREAM_PATH_PREFIX,
+                                         path,
+                                         GOLIOTH_CONTENT_TYPE_JSON,
+                                         (const uint8_t *) buf,
+                                         bufsize - 1,  // excluding NULL
+                                         golioth_payload_pool_release,
+                                         NULL,
+                                         callback,
+                                         callback_arg,
+                                         false,
+                                         GOLIOTH_SYS_WAIT_FOREVER);
+    if (status != GOLIOTH_OK)
+    {
+        golioth_payload_pool_free(buf);
+    }
 
-    golioth_sys_free(buf);
     return status;
 }
 
@@ -119,6 +135,7 @@ enum golioth_status golioth_stream_set_async(struct golioth_client *client,
                                              void *callback_arg)
 {
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    content_type,
@@ -130,6 +147,54 @@ enum golioth_status golioth_stream_set_async(struct golioth_client *client,
                                    GOLIOTH_SYS_WAIT_FOREVER);
 }
 
+enum golioth_status golioth_stream_set_delivery_async(struct golioth_client *client,
+                                                      const char *path,
+                                                      enum golioth_delivery_mode delivery_mode,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *buf,
+                                                      size_t buf_len,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg)
+{
+    return golioth_coap_client_set_delivery(client,
+                                            GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                            GOLIOTH_STREAM_PATH_PREFIX,
+                                            path,
+                                            delivery_mode,
+                                            content_type,
+                                            buf,
+                                            buf_len,
+                                            callback,
+                                            callback_arg,
+                                            false,
+                                            GOLIOTH_SYS_WAIT_FOREVER);
+}
+
+enum golioth_status golioth_stream_set_borrowed_async(struct golioth_client *client,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *buf,
+                                                      size_t buf_len,
+                                                      golioth_payload_release_fn release,
+                                                      void *release_arg,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg)
+{
+    return golioth_coap_client_set_borrowed(client,
+                                            GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                            GOLIOTH_STREAM_PATH_PREFIX,
+                                            path,
+                                            content_type,
+                                            buf,
+                                            buf_len,
+                                            release,
+                                            release_arg,
+                                            callback,
+                                            callback_arg,
+                                            false,
+                                            GOLIOTH_SYS_WAIT_FOREVER);
+}
+
 enum golioth_status golioth_stream_set_int_sync(struct golioth_client *client,
                                                 const char *path,
                                                 int32_t value,
@@ -138,6 +203,7 @@ enum golioth_status golioth_stream_set_int_sync(struct golioth_client *client,
     char buf[16] = {};
     snprintf(buf, sizeof(buf), "%" PRId32, value);
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -156,6 +222,7 @@ enum golioth_status golioth_stream_set_bool_sync(struct golioth_client *client,
 {
     const char *valuestr = (value ? "true" : "false");
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -175,6 +242,7 @@ enum golioth_status golioth_stream_set_float_sync(struct golioth_client *client,
     char buf[32] = {};
     snprintf(buf, sizeof(buf), "%f", (double) value);
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    GOLIOTH_CONTENT_TYPE_JSON,
@@ -195,7 +263,7 @@ enum golioth_status golioth_stream_set_string_sync(struct golioth_client *client
     // Server requires that non-JSON-formatted strings
     // be surrounded with literal ".
     size_t bufsize = str_len + 3;  // two " and a NULL
-    char *buf = golioth_sys_malloc(bufsize);
+    char *buf = golioth_payload_pool_alloc(bufsize);
     if (!buf)
     {
         return GOLIOTH_ERR_MEM_ALLOC;
@@ -204,6 +272,7 @@ enum golioth_status golioth_stream_set_string_sync(struct golioth_client *client
     snprintf(buf, bufsize, "\"%s\"", str);
 
     enum golioth_status status = golioth_coap_client_set(client,
+                                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                                          GOLIOTH_STREAM_PATH_PREFIX,
                                                          path,
                                                          GOLIOTH_CONTENT_TYPE_JSON,
@@ -214,7 +283,7 @@ enum golioth_status golioth_stream_set_string_sync(struct golioth_client *client
                                                          true,
                                                          timeout_s);
 
-    golioth_sys_free(buf);
+    golioth_payload_pool_free(buf);
     return status;
 }
 
@@ -226,6 +295,7 @@ enum golioth_status golioth_stream_set_sync(struct golioth_client *client,
                                             int32_t timeout_s)
 {
     return golioth_coap_client_set(client,
+                                   GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
                                    GOLIOTH_STREAM_PATH_PREFIX,
                                    path,
                                    content_type,
@@ -237,4 +307,91 @@ enum golioth_status golioth_stream_set_sync(struct golioth_client *client,
                                    timeout_s);
 }
 
+enum golioth_status golioth_stream_set_blockwise_async(struct golioth_client *client,
+                                                       const char *path,
+                                                       enum golioth_content_type content_type,
+                                                       golioth_read_block_cb_fn read_block,
+                                                       void *read_block_arg,
+                                                       golioth_set_cb_fn callback,
+                                                       void *callback_arg)
+{
+    return golioth_coap_client_post_block(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          GOLIOTH_STREAM_PATH_PREFIX,
+                                          path,
+                                          content_type,
+                                          GOLIOTH_STREAM_BLOCK_SIZE,
+                                          read_block,
+                                          read_block_arg,
+                                          callback,
+                                          callback_arg,
+                                          false,
+                                          GOLIOTH_SYS_WAIT_FOREVER);
+}
+
+enum golioth_status golioth_stream_set_blockwise_sync(struct golioth_client *client,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      golioth_read_block_cb_fn read_block,
+                                                      void *read_block_arg,
+                                                      int32_t timeout_s)
+{
+    return golioth_coap_client_post_block(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          GOLIOTH_STREAM_PATH_PREFIX,
+                                          path,
+                                          content_type,
+                                          GOLIOTH_STREAM_BLOCK_SIZE,
+                                          read_block,
+                                          read_block_arg,
+                                          NULL,
+                                          NULL,
+                                          true,
+                                          timeout_s);
+}
+
+struct golioth_path *golioth_stream_path_create(const char *path)
+{
+    return golioth_path_create(GOLIOTH_STREAM_PATH_PREFIX, path);
+}
+
+enum golioth_status golioth_stream_set_handle_async(struct golioth_client *client,
+                                                    const struct golioth_path *path,
+                                                    enum golioth_content_type content_type,
+                                                    const uint8_t *buf,
+                                                    size_t buf_len,
+                                                    golioth_set_cb_fn callback,
+                                                    void *callback_arg)
+{
+    return golioth_coap_client_set_handle(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          path,
+                                          content_type,
+                                          buf,
+                                          buf_len,
+                                          callback,
+                                          callback_arg,
+                                          false,
+                                          GOLIOTH_SYS_WAIT_FOREVER);
+}
+
+enum golioth_status golioth_stream_set_handle_sync(struct golioth_client *client,
+                                                   const struct golioth_path *path,
+                                                   enum golioth_content_type content_type,
+                                                   const uint8_t *buf,
+                                                   size_t buf_len,
+                                                   int32_t timeout_s)
+{
+    return golioth_coap_client_set_handle(client,
+                                          GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                          path,
+                                          content_type,
+                                          buf,
+                                          buf_len,
+                                          NULL,
+                                          NULL,
+                                          true,
+                                          timeout_s);
+}
+
 #endif  // CONFIG_GOLIOTH_STREAM
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+#include <zcbor_encode.h>
+#include <golioth/stream.h>
+#include <golioth/golioth_sys.h>
+#include <golioth/zcbor_utils.h>
+#include "coap_client.h"
+#include "payload_pool.h"
+
+#if defined(CONFIG_GOLIOTH_STREAM)
+
+#define GOLIOTH_STREAM_PATH_PREFIX ".s/"
+
+// Max number of segments in a record path, each of which is a nested map
+#define STREAM_BATCH_MAX_PATH_DEPTH 8
+
+// Records are items of an indefinite-length array, so a batch never has to be re-encoded
+// when a record is added. The break byte that ends the array is added when flushing.
+#define CBOR_INDEFINITE_ARRAY_START 0x9f
+#define CBOR_BREAK 0xff
+
+enum stream_batch_value_type
+{
+    STREAM_BATCH_VALUE_INT,
+    STREAM_BATCH_VALUE_BOOL,
+    STREAM_BATCH_VALUE_FLOAT,
+    STREAM_BATCH_VALUE_STRING,
+};
+
+struct stream_batch_value
+{
+    enum stream_batch_value_type type;
+    union
+    {
+        int32_t i;
+        bool b;
+        float f;
+        struct
+        {
+            const char *str;
+            size_t str_len;
+        };
+    };
+};
+
+struct golioth_stream_batch
+{
+    struct golioth_client *client;
+    struct golioth_stream_batch_config config;
+    golioth_sys_sem_t lock;
+    // Payload pool buffer with the encoded records, allocated when the first record is added
+    uint8_t *buf;
+    size_t len;
+    size_t num_records;
+    uint64_t first_record_ms;
+};
+
+// Number of non-empty segments in path, or 0 if there are none or too many
+static size_t path_depth(const char *path)
+{
+    size_t depth = 0;
+
+    for (const char *c = path; *c; c++)
+    {
+        if (*c != '/' && (c == path || c[-1] == '/'))
+        {
+            depth++;
+        }
+    }
+
+    return (depth <= STREAM_BATCH_MAX_PATH_DEPTH) ? depth : 0;
+}
+
+static bool encode_value(zcbor_state_t *zse, const struct stream_batch_value *value)
+{
+    switch (value->type)
+    {
+        case STREAM_BATCH_VALUE_INT:
+            return zcbor_int32_put(zse, value->i);
+        case STREAM_BATCH_VALUE_BOOL:
+            return zcbor_bool_put(zse, value->b);
+        case STREAM_BATCH_VALUE_FLOAT:
+            return zcbor_float32_put(zse, value->f);
+        case STREAM_BATCH_VALUE_STRING:
+            return zcbor_tstr_encode_ptr(zse, value->str, value->str_len);
+    }
+
+    return false;
+}
+
+// Encode a record as a map with the optional timestamp, and the value nested in one map per
+// path segment, i.e. {"ts": 1700000000000, "sensor": {"temp": 21.5}}
+static bool encode_record(zcbor_state_t *zse,
+                          const char *path,
+                          size_t depth,
+                          uint64_t timestamp_ms,
+                          const struct stream_batch_value *value)
+{
+    size_t num_entries = (timestamp_ms != GOLIOTH_STREAM_BATCH_NO_TIMESTAMP) ? 2 : 1;
+    bool ok = zcbor_map_start_encode(zse, num_entries);
+
+    if (ok && timestamp_ms != GOLIOTH_STREAM_BATCH_NO_TIMESTAMP)
+    {
+        ok = zcbor_tstr_put_lit(zse, "ts") && zcbor_uint64_put(zse, timestamp_ms);
+    }
+
+    const char *segment = path;
+    for (size_t i = 0; ok && i < depth; i++)
+    {
+        while (*segment == '/')
+        {
+            segment++;
+        }
+
+        size_t segment_len = strcspn(segment, "/");
+        ok = zcbor_tstr_encode_ptr(zse, segment, segment_len);
+        if (ok && i < depth - 1)
+        {
+            ok = zcbor_map_start_encode(zse, 1);
+        }
+
+        segment += segment_len;
+    }
+
+    ok = ok && encode_value(zse, value);
+
+    for (size_t i = 1; ok && i < depth; i++)
+    {
+        ok = zcbor_map_end_encode(zse, 1);
+    }
+
+    return ok && zcbor_map_end_encode(zse, num_entries);
+}
+
+static bool encode_record_in_batch(struct golioth_stream_batch *batch,
+                                   const char *path,
+                                   size_t depth,
+                                   uint64_t timestamp_ms,
+                                   const struct stream_batch_value *value)
+{
+    // Leave room for the break byte
+    size_t space = batch->config.max_size - batch->len - 1;
+
+    ZCBOR_STATE_E(zse, STREAM_BATCH_MAX_PATH_DEPTH, &batch->buf[batch->len], space, 1);
+
+    if (!encode_record(zse, path, depth, timestamp_ms, value))
+    {
+        return false;
+    }
+
+    batch->len = zse->payload - batch->buf;
+    return true;
+}
+
+// Hand the encoded records to the client. The batch is empty afterwards, even if the request
+// could not be queued.
+static enum golioth_status flush_locked(struct golioth_stream_batch *batch)
+{
+    if (batch->num_records == 0)
+    {
+        return GOLIOTH_OK;
+    }
+
+    batch->buf[batch->len++] = CBOR_BREAK;
+
+    enum golioth_status status =
+        golioth_coap_client_set_borrowed(batch->client,
+                                         GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                                         GOLIOTH_STREAM_PATH_PREFIX,
+                                         "",
+                                         GOLIOTH_CONTENT_TYPE_CBOR,
+                                         batch->buf,
+                                         batch->len,
+                                         golioth_payload_pool_release,
+                                         NULL,
+                                         batch->config.callback,
+                                         batch->config.callback_arg,
+                                         false,
+                                         GOLIOTH_SYS_WAIT_FOREVER);
+    if (status != GOLIOTH_OK)
+    {
+        golioth_payload_pool_free(batch->buf);
+    }
+
+    batch->buf = NULL;
+    batch->len = 0;
+    batch->num_records = 0;
+
+    return status;
+}
+
+static enum golioth_status stream_batch_add(struct golioth_stream_batch *batch,
+                                            const char *path,
+                                            uint64_t timestamp_ms,
+                                            const struct stream_batch_value *value)
+{
+    if (!batch || !path)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    size_t depth = path_depth(path);
+    if (depth == 0)
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    enum golioth_status status = GOLIOTH_OK;
+
+    golioth_sys_sem_take(batch->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    uint64_t now_ms = golioth_sys_now_ms();
+    if (batch->num_records > 0 && batch->config.max_age_ms > 0
+        && now_ms - batch->first_record_ms >= (uint64_t) batch->config.max_age_ms)
+    {
+        status = flush_locked(batch);
+        if (status != GOLIOTH_OK)
+        {
+            goto finish;
+        }
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (!batch->buf)
+        {
+            batch->buf = golioth_payload_pool_alloc(batch->config.max_size);
+            if (!batch->buf)
+            {
+                status = GOLIOTH_ERR_MEM_ALLOC;
+                goto finish;
+            }
+
+            batch->buf[0] = CBOR_INDEFINITE_ARRAY_START;
+            batch->len = 1;
+        }
+
+        if (encode_record_in_batch(batch, path, depth, timestamp_ms, value))
+        {
+            break;
+        }
+
+        if (batch->num_records == 0)
+        {
+            // The record doesn't fit in an empty batch
+            status = GOLIOTH_ERR_SERIALIZE;
+            goto finish;
+        }
+
+        // The batch is full, send it and retry in a new one
+        status = flush_locked(batch);
+        if (status != GOLIOTH_OK)
+        {
+            goto finish;
+        }
+    }
+
+    if (batch->num_records++ == 0)
+    {
+        batch->first_record_ms = now_ms;
+    }
+
+    if (batch->config.max_records > 0 && batch->num_records >= batch->config.max_records)
+    {
+        status = flush_locked(batch);
+    }
+
+finish:
+    golioth_sys_sem_give(batch->lock);
+    return status;
+}
+
+struct golioth_stream_batch *golioth_stream_batch_create(
+    struct golioth_client *client,
+    const struct golioth_stream_batch_config *config)
+{
+    // Room for the array start and break bytes and at least one record
+    if (!client || !config || config->max_size < 4)
+    {
+        return NULL;
+    }
+
+    struct golioth_stream_batch *batch = golioth_sys_malloc(sizeof(*batch));
+    if (!batch)
+    {
+        return NULL;
+    }
+
+    memset(batch, 0, sizeof(*batch));
+    batch->client = client;
+    batch->config = *config;
+
+    batch->lock = golioth_sys_sem_create(1, 1);
+    if (!batch->lock)
+    {
+        golioth_sys_free(batch);
+        return NULL;
+    }
+
+    return batch;
+}
+
+void golioth_stream_batch_destroy(struct golioth_stream_batch *batch)
+{
+    if (!batch)
+    {
+        return;
+    }
+
+    golioth_payload_pool_free(batch->buf);
+    golioth_sys_sem_destroy(batch->lock);
+    golioth_sys_free(batch);
+}
+
+enum golioth_status golioth_stream_batch_add_int(struct golioth_stream_batch *batch,
+                                                 const char *path,
+                                                 uint64_t timestamp_ms,
+                                                 int32_t value)
+{
+    struct stream_batch_value v = {
+        .type = STREAM_BATCH_VALUE_INT,
+        .i = value,
+    };
+
+    return stream_batch_add(batch, path, timestamp_ms, &v);
+}
+
+enum golioth_status golioth_stream_batch_add_bool(struct golioth_stream_batch *batch,
+                                                  const char *path,
+                                                  uint64_t timestamp_ms,
+                                                  bool value)
+{
+    struct stream_batch_value v = {
+        .type = STREAM_BATCH_VALUE_BOOL,
+        .b = value,
+    };
+
+    return stream_batch_add(batch, path, timestamp_ms, &v);
+}
+
+enum golioth_status golioth_stream_batch_add_float(struct golioth_stream_batch *batch,
+                                                   const char *path,
+                                                   uint64_t timestamp_ms,
+                                                   float value)
+{
+    struct stream_batch_value v = {
+        .type = STREAM_BATCH_VALUE_FLOAT,
+        .f = value,
+    };
+
+    return stream_batch_add(batch, path, timestamp_ms, &v);
+}
+
+enum golioth_status golioth_stream_batch_add_string(struct golioth_stream_batch *batch,
+                                                    const char *path,
+                                                    uint64_t timestamp_ms,
+                                                    const char *str,
+                                                    size_t str_len)
+{
+    if (!str)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    struct stream_batch_value v = {
+        .type = STREAM_BATCH_VALUE_STRING,
+        .str = str,
+        .str_len = str_len,
+    };
+
+    return stream_batch_add(batch, path, timestamp_ms, &v);
+}
+
+enum golioth_status golioth_stream_batch_flush(struct golioth_stream_batch *batch)
+{
+    if (!batch)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    golioth_sys_sem_take(batch->lock, GOLIOTH_SYS_WAIT_FOREVER);
+    enum golioth_status status = flush_locked(batch);
+    golioth_sys_sem_give(batch->lock);
+
+    return status;
+}
+
+size_t golioth_stream_batch_num_records(struct golioth_stream_batch *batch)
+{
+    if (!batch)
+    {
+        return 0;
+    }
+
+    golioth_sys_sem_take(batch->lock, GOLIOTH_SYS_WAIT_FOREVER);
+    size_t num_records = batch->num_records;
+    golioth_sys_sem_give(batch->lock);
+
+    return num_records;
+}
+
+#endif  // CONFIG_GOLIOTH_STREAM
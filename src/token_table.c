@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "token_table.h"
+#include <string.h>
+#include <golioth/golioth_sys.h>
+
+#define TOKEN_TABLE_MIN_CAPACITY 8
+
+// FNV-1a. Tokens are usually a counter, so all bytes need to affect the hash.
+static uint32_t token_hash(const uint8_t *token, size_t token_len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < token_len; i++)
+    {
+        hash ^= token[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool entry_matches(const struct golioth_token_table_entry *entry,
+                          const uint8_t *token,
+                          size_t token_len)
+{
+    return (entry->value && entry->token_len == token_len
+            && 0 == memcmp(entry->token, token, token_len));
+}
+
+static size_t find_slot(const struct golioth_token_table *table,
+                        const uint8_t *token,
+                        size_t token_len)
+{
+    size_t mask = table->capacity - 1;
+    size_t i = token_hash(token, token_len) & mask;
+
+    // Load factor is at most 3/4, so there is always an unused entry to stop at
+    while (table->entries[i].value && !entry_matches(&table->entries[i], token, token_len))
+    {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static bool fits(size_t capacity, size_t num_tokens)
+{
+    return (num_tokens * 4 <= capacity * 3);
+}
+
+static enum golioth_status resize(struct golioth_token_table *table, size_t new_capacity)
+{
+    struct golioth_token_table_entry *new_entries =
+        golioth_sys_malloc(new_capacity * sizeof(struct golioth_token_table_entry));
+    if (!new_entries)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+    memset(new_entries, 0, new_capacity * sizeof(struct golioth_token_table_entry));
+
+    struct golioth_token_table_entry *old_entries = table->entries;
+    size_t old_capacity = table->capacity;
+
+    table->entries = new_entries;
+    table->capacity = new_capacity;
+
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        const struct golioth_token_table_entry *entry = &old_entries[i];
+        if (entry->value)
+        {
+            table->entries[find_slot(table, entry->token, entry->token_len)] = *entry;
+        }
+    }
+
+    golioth_sys_free(old_entries);
+
+    return GOLIOTH_OK;
+}
+
+enum golioth_status golioth_token_table_init(struct golioth_token_table *table,
+                                             size_t min_capacity)
+{
+    memset(table, 0, sizeof(*table));
+    return golioth_token_table_reserve(table, min_capacity);
+}
+
+void golioth_token_table_deinit(struct golioth_token_table *table)
+{
+    golioth_sys_free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+enum golioth_status golioth_token_table_reserve(struct golioth_token_table *table,
+                                                size_t num_tokens)
+{
+    size_t new_capacity = (table->capacity ? table->capacity : TOKEN_TABLE_MIN_CAPACITY);
+    while (!fits(new_capacity, num_tokens))
+    {
+        new_capacity *= 2;
+    }
+
+    if (new_capacity == table->capacity)
+    {
+        return GOLIOTH_OK;
+    }
+
+    return resize(table, new_capacity);
+}
+
+enum golioth_status golioth_token_table_insert(struct golioth_token_table *table,
+                                               const uint8_t *token,
+                                               size_t token_len,
+                                               void *value)
+{
+    if (!value || token_len > GOLIOTH_TOKEN_TABLE_MAX_TOKEN_LEN)
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    GOLIOTH_STATUS_RETURN_IF_ERROR(golioth_token_table_reserve(table, table->count + 1));
+
+    struct golioth_token_table_entry *entry = &table->entries[find_slot(table, token, token_len)];
+    if (entry->value)
+    {
+        return GOLIOTH_ERR_INVALID_STATE;
+    }
+
+    memcpy(entry->token, token, token_len);
+    entry->token_len = token_len;
+    entry->value = value;
+    table->count++;
+
+    return GOLIOTH_OK;
+}
+
+void *golioth_token_table_find(const struct golioth_token_table *table,
+                               const uint8_t *token,
+                               size_t token_len)
+{
+    if (!table->entries || token_len > GOLIOTH_TOKEN_TABLE_MAX_TOKEN_LEN)
+    {
+        return NULL;
+    }
+
+    return table->entries[find_slot(table, token, token_len)].value;
+}
+
+void *golioth_token_table_remove(struct golioth_token_table *table,
+                                 const uint8_t *token,
+                                 size_t token_len)
+{
+    if (!table->entries || token_len > GOLIOTH_TOKEN_TABLE_MAX_TOKEN_LEN)
+    {
+        return NULL;
+    }
+
+    size_t mask = table->capacity - 1;
+    size_t i = find_slot(table, token, token_len);
+    void *value = table->entries[i].value;
+    if (!value)
+    {
+        return NULL;
+    }
+
+    // Backward shift deletion: move later entries of the same probe
+    // sequence into the hole, so lookups never need tombstones.
+    size_t hole = i;
+    size_t j = i;
+    while (true)
+    {
+        j = (j + 1) & mask;
+        struct golioth_token_table_entry *entry = &table->entries[j];
+        if (!entry->value)
+        {
+            break;
+        }
+
+        size_t home = token_hash(entry->token, entry->token_len) & mask;
+        // Entry can fill the hole if its home slot is not cyclically in (hole, j]
+        bool home_after_hole =
+            (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (!home_after_hole)
+        {
+            table->entries[hole] = *entry;
+            hole = j;
+        }
+    }
+
+    memset(&table->entries[hole], 0, sizeof(table->entries[hole]));
+    table->count--;
+
+    return value;
+}
+
+size_t golioth_token_table_count(const struct golioth_token_table *table)
+{
+    return table->count;
+}
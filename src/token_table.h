@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <golioth/golioth_status.h>
+
+/// Maximum length of a CoAP token, in bytes
+#define GOLIOTH_TOKEN_TABLE_MAX_TOKEN_LEN 8
+
+/// A hash table which maps CoAP tokens to pointers.
+///
+/// Uses open addressing with linear probing, so a lookup is a hash plus a
+/// short scan of neighbouring entries. The table grows (doubles) when it
+/// becomes more than 3/4 full, and never shrinks.
+///
+/// Not thread-safe.
+
+struct golioth_token_table_entry
+{
+    uint8_t token[GOLIOTH_TOKEN_TABLE_MAX_TOKEN_LEN];
+    uint8_t token_len;
+    // NULL if the entry is unused
+    void *value;
+};
+
+struct golioth_token_table
+{
+    struct golioth_token_table_entry *entries;
+    // Number of entries, always a power of two
+    size_t capacity;
+    // Number of entries in use
+    size_t count;
+};
+
+/// Allocate storage for at least min_capacity tokens
+enum golioth_status golioth_token_table_init(struct golioth_token_table *table,
+                                             size_t min_capacity);
+
+/// Free the storage of the table. The values are not touched.
+void golioth_token_table_deinit(struct golioth_token_table *table);
+
+/// Make sure that num_tokens tokens can be stored without allocating memory
+enum golioth_status golioth_token_table_reserve(struct golioth_token_table *table,
+                                                size_t num_tokens);
+
+/// Add value for token. Fails with GOLIOTH_ERR_INVALID_STATE if the token
+/// is already in the table.
+enum golioth_status golioth_token_table_insert(struct golioth_token_table *table,
+                                               const uint8_t *token,
+                                               size_t token_len,
+                                               void *value);
+
+/// Returns the value stored for token, or NULL if not found
+void *golioth_token_table_find(const struct golioth_token_table *table,
+                               const uint8_t *token,
+                               size_t token_len);
+
+/// Removes token from the table. Returns the value that was stored, or NULL if not found.
+void *golioth_token_table_remove(struct golioth_token_table *table,
+                                 const uint8_t *token,
+                                 size_t token_len);
+
+size_t golioth_token_table_count(const struct golioth_token_table *table);
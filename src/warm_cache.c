@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "warm_cache.h"
+#include <string.h>
+#include <golioth/config.h>
+
+// Serialized layout, multi-byte fields in little endian:
+//
+//   magic[2] version addr_len addr[16] host_hash[4]
+//   initial_rto[4] rto[4] strong_srtt[4] strong_rttvar[4] weak_srtt[4] weak_rttvar[4]
+//   flags num_samples[4]
+#define CACHE_MAGIC_0 'G'
+#define CACHE_MAGIC_1 'S'
+#define CACHE_VERSION 1
+#define CACHE_LEN 53
+
+#define FLAG_HAS_STRONG (1 << 0)
+#define FLAG_HAS_WEAK (1 << 1)
+
+// 32-bit FNV-1a
+static uint32_t host_hash(void)
+{
+    const char *uri = CONFIG_GOLIOTH_COAP_HOST_URI;
+    uint32_t hash = 2166136261u;
+
+    while (*uri)
+    {
+        hash ^= (uint8_t) *uri++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        p[i] = (value >> (8 * i)) & 0xFF;
+    }
+    return p + 4;
+}
+
+static const uint8_t *get_u32(const uint8_t *p, uint32_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        *value |= (uint32_t) p[i] << (8 * i);
+    }
+    return p + 4;
+}
+
+enum golioth_status golioth_warm_cache_encode(const struct golioth_warm_cache *cache,
+                                              uint8_t *buf,
+                                              size_t *len)
+{
+    if (!cache || !buf || !len)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    if (*len < GOLIOTH_CLIENT_WARM_CACHE_SIZE)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+
+    const struct golioth_rtt_estimator *rtt = &cache->rtt;
+    const struct golioth_dns_addr *addr = &cache->addr;
+    uint8_t addr_len = (addr->addr_len <= sizeof(addr->addr)) ? addr->addr_len : 0;
+    uint8_t *p = buf;
+
+    *p++ = CACHE_MAGIC_0;
+    *p++ = CACHE_MAGIC_1;
+    *p++ = CACHE_VERSION;
+    *p++ = addr_len;
+    memset(p, 0, sizeof(addr->addr));
+    memcpy(p, addr->addr, addr_len);
+    p += sizeof(addr->addr);
+    p = put_u32(p, host_hash());
+
+    p = put_u32(p, rtt->initial_rto_ms);
+    p = put_u32(p, rtt->rto_ms);
+    p = put_u32(p, rtt->strong_srtt_ms);
+    p = put_u32(p, rtt->strong_rttvar_ms);
+    p = put_u32(p, rtt->weak_srtt_ms);
+    p = put_u32(p, rtt->weak_rttvar_ms);
+    *p++ = (rtt->has_strong ? FLAG_HAS_STRONG : 0) | (rtt->has_weak ? FLAG_HAS_WEAK : 0);
+    p = put_u32(p, rtt->num_samples);
+
+    *len = p - buf;
+
+    return GOLIOTH_OK;
+}
+
+enum golioth_status golioth_warm_cache_decode(struct golioth_warm_cache *cache,
+                                              const uint8_t *buf,
+                                              size_t len,
+                                              uint64_t now_ms)
+{
+    if (!cache || !buf)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    if (len < CACHE_LEN || buf[0] != CACHE_MAGIC_0 || buf[1] != CACHE_MAGIC_1
+        || buf[2] != CACHE_VERSION)
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    uint8_t addr_len = buf[3];
+    if (addr_len != 0 && addr_len != 4 && addr_len != 16)
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    const uint8_t *p = &buf[4 + sizeof(cache->addr.addr)];
+    uint32_t hash;
+
+    p = get_u32(p, &hash);
+    if (hash != host_hash())
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    struct golioth_rtt_estimator rtt = {0};
+
+    p = get_u32(p, &rtt.initial_rto_ms);
+    p = get_u32(p, &rtt.rto_ms);
+    p = get_u32(p, &rtt.strong_srtt_ms);
+    p = get_u32(p, &rtt.strong_rttvar_ms);
+    p = get_u32(p, &rtt.weak_srtt_ms);
+    p = get_u32(p, &rtt.weak_rttvar_ms);
+    rtt.has_strong = (*p & FLAG_HAS_STRONG) != 0;
+    rtt.has_weak = (*p & FLAG_HAS_WEAK) != 0;
+    p++;
+    get_u32(p, &rtt.num_samples);
+
+    if (rtt.rto_ms < GOLIOTH_RTT_MIN_RTO_MS || rtt.rto_ms > GOLIOTH_RTT_MAX_RTO_MS
+        || rtt.initial_rto_ms < GOLIOTH_RTT_MIN_RTO_MS
+        || rtt.initial_rto_ms > GOLIOTH_RTT_MAX_RTO_MS)
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    // Let the estimate age from now, as if it had just been confirmed
+    rtt.last_update_ms = now_ms;
+
+    memset(cache, 0, sizeof(*cache));
+    cache->addr.addr_len = addr_len;
+    memcpy(cache->addr.addr, &buf[4], addr_len);
+    cache->rtt = rtt;
+
+    return GOLIOTH_OK;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <golioth/client.h>
+#include "dns_cache.h"
+#include "rtt_estimator.h"
+
+/// Server address and RTT estimates, kept across a client restart to warm up the next client,
+/// see golioth_client_save_warm_cache(). Not a DTLS session: the next client still does a full
+/// handshake.
+///
+/// The serialized form is versioned, and tied to CONFIG_GOLIOTH_COAP_HOST_URI, so that a
+/// cache saved by another firmware version or for another server is rejected instead of
+/// being misinterpreted.
+struct golioth_warm_cache
+{
+    /// Server address of the latest session. addr_len is 0 if the address is not known.
+    struct golioth_dns_addr addr;
+    /// Round-trip time estimates
+    struct golioth_rtt_estimator rtt;
+};
+
+/// Serialize cache into buf, which holds *len bytes. *len is set to the serialized length.
+///
+/// Returns GOLIOTH_ERR_MEM_ALLOC if buf is smaller than GOLIOTH_CLIENT_WARM_CACHE_SIZE.
+enum golioth_status golioth_warm_cache_encode(const struct golioth_warm_cache *cache,
+                                              uint8_t *buf,
+                                              size_t *len);
+
+/// Restore cache from a buffer written by golioth_warm_cache_encode().
+///
+/// The RTT estimator ages from now_ms. Returns GOLIOTH_ERR_INVALID_FORMAT if buf is not a
+/// cache of this version for the configured server.
+enum golioth_status golioth_warm_cache_decode(struct golioth_warm_cache *cache,
+                                              const uint8_t *buf,
+                                              size_t len,
+                                              uint64_t now_ms);
@@ -18,9 +18,42 @@ static const int64_t COAP_OBSERVE_TS_DIFF_NEWER = 128 * (int64_t) MSEC_PER_SEC;
 
 #define COAP_RESPONSE_CODE_CLASS(code) ((code) >> 5)
 
+static bool golioth_coap_req_deadline_lessthan(struct rbnode *a, struct rbnode *b)
+{
+    const struct golioth_coap_req *req_a = CONTAINER_OF(a, struct golioth_coap_req, deadline_node);
+    const struct golioth_coap_req *req_b = CONTAINER_OF(b, struct golioth_coap_req, deadline_node);
+
+    if (req_a->deadline != req_b->deadline)
+    {
+        return req_a->deadline < req_b->deadline;
+    }
+
+    /* The tree needs a strict order, so break ties by address */
+    return (uintptr_t) req_a < (uintptr_t) req_b;
+}
+
+static void golioth_coap_req_deadline_insert(struct golioth_coap_req *req, int64_t deadline)
+{
+    req->deadline = deadline;
+    rb_insert(&req->client->coap_reqs_by_deadline, &req->deadline_node);
+    req->in_deadline_tree = true;
+}
+
+static void golioth_coap_req_deadline_remove(struct golioth_coap_req *req)
+{
+    if (req->in_deadline_tree)
+    {
+        rb_remove(&req->client->coap_reqs_by_deadline, &req->deadline_node);
+        req->in_deadline_tree = false;
+    }
+}
+
 void golioth_coap_reqs_init(struct golioth_client *client)
 {
     sys_dlist_init(&client->coap_reqs);
+    client->coap_reqs_by_deadline = (struct rbtree){
+        .lessthan_fn = golioth_coap_req_deadline_lessthan,
+    };
     client->coap_reqs_connected = false;
     k_mutex_init(&client->coap_reqs_lock);
 }
@@ -35,6 +68,7 @@ static void golioth_coap_pending_init(struct golioth_coap_pending *pending, uint
     pending->t0 = k_uptime_get_32();
     pending->timeout = 0;
     pending->retries = retries;
+    pending->retransmitted = false;
 }
 
 static int __golioth_coap_req_submit(struct golioth_coap_req *req)
@@ -48,6 +82,9 @@ static int __golioth_coap_req_submit(struct golioth_coap_req *req)
 
     sys_dlist_append(&client->coap_reqs, &req->node);
 
+    /* Due for its first transmission right away */
+    golioth_coap_req_deadline_insert(req, k_uptime_get());
+
     return 0;
 }
 
@@ -66,6 +103,7 @@ static int golioth_coap_req_submit(struct golioth_coap_req *req)
 static void golioth_coap_req_cancel(struct golioth_coap_req *req)
 {
     sys_dlist_remove(&req->node);
+    golioth_coap_req_deadline_remove(req);
 }
 
 static void golioth_coap_req_cancel_and_free(struct golioth_coap_req *req)
@@ -146,6 +184,15 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
     int block2;
     int err;
 
+    if (!req->is_observe || req->is_pending)
+    {
+        /* Only the first response to a request is an answer to a transmission */
+        golioth_rtt_estimator_update(&req->client->rtt,
+                                     k_uptime_get_32() - req->pending.t_sent,
+                                     req->pending.retransmitted,
+                                     k_uptime_get());
+    }
+
     code = coap_header_get_code(response);
 
     LOG_DBG("CoAP response code: 0x%x (class %u detail %u)",
@@ -297,7 +344,9 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 cancel_and_free:
     if (req->is_observe && !err)
     {
+        /* Established, so there is nothing left to retransmit or time out */
         req->is_pending = false;
+        golioth_coap_req_deadline_remove(req);
     }
     else
     {
@@ -618,11 +667,12 @@ free_req:
     return err;
 }
 
-static uint32_t init_ack_timeout(void)
+/* ACK timeout of the first transmission, from the client's current RTO estimate */
+static uint32_t init_ack_timeout(uint32_t rto)
 {
 #if defined(CONFIG_COAP_RANDOMIZE_ACK_TIMEOUT)
-    const uint32_t max_ack = CONFIG_COAP_INIT_ACK_TIMEOUT_MS * CONFIG_COAP_ACK_RANDOM_PERCENT / 100;
-    const uint32_t min_ack = CONFIG_COAP_INIT_ACK_TIMEOUT_MS;
+    const uint32_t max_ack = rto * CONFIG_COAP_ACK_RANDOM_PERCENT / 100;
+    const uint32_t min_ack = rto;
 
     /* Randomly generated initial ACK timeout
      * ACK_TIMEOUT < INIT_ACK_TIMEOUT < ACK_TIMEOUT * ACK_RANDOM_FACTOR
@@ -630,16 +680,19 @@ static uint32_t init_ack_timeout(void)
      */
     return min_ack + (sys_rand32_get() % (max_ack - min_ack));
 #else
-    return CONFIG_COAP_INIT_ACK_TIMEOUT_MS;
+    return rto;
 #endif /* defined(CONFIG_COAP_RANDOMIZE_ACK_TIMEOUT) */
 }
 
-static bool golioth_coap_pending_cycle(struct golioth_coap_pending *pending)
+static bool golioth_coap_pending_cycle(struct golioth_coap_req *req)
 {
+    struct golioth_coap_pending *pending = &req->pending;
+
     if (pending->timeout == 0)
     {
         /* Initial transmission. */
-        pending->timeout = init_ack_timeout();
+        pending->rto = golioth_rtt_estimator_rto_ms(&req->client->rtt, k_uptime_get());
+        pending->timeout = init_ack_timeout(pending->rto);
 
         return true;
     }
@@ -650,7 +703,7 @@ static bool golioth_coap_pending_cycle(struct golioth_coap_pending *pending)
     }
 
     pending->t0 += pending->timeout;
-    pending->timeout = pending->timeout << 1;
+    pending->timeout = golioth_rtt_estimator_backoff_ms(pending->rto, pending->timeout);
     pending->retries--;
 
     return true;
@@ -673,7 +726,7 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
             break;
         }
 
-        send = golioth_coap_pending_cycle(&req->pending);
+        send = golioth_coap_pending_cycle(req);
         if (!send)
         {
             struct golioth_req_rsp rsp = {
@@ -699,6 +752,12 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
                     req,
                     &req->reply,
                     (int) req->pending.retries);
+            req->pending.retransmitted = true;
+            req->client->stats.retransmits++;
+        }
+        else
+        {
+            req->pending.t_sent = now;
         }
 
         err = golioth_coap_req_send(req);
@@ -713,22 +772,31 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
 
 static int64_t __golioth_coap_reqs_poll_prepare(struct golioth_client *client, int64_t now)
 {
-    struct golioth_coap_req *req, *next;
-    int64_t min_timeout = INT64_MAX;
+    struct rbnode *node;
 
-    SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&client->coap_reqs, req, next, node)
+    /* Only requests that are due are visited */
+    while ((node = rb_get_min(&client->coap_reqs_by_deadline)) != NULL)
     {
-        if (req->is_observe && !req->is_pending)
+        struct golioth_coap_req *req = CONTAINER_OF(node, struct golioth_coap_req, deadline_node);
+
+        if (req->deadline > now)
         {
-            continue;
+            return req->deadline - now;
         }
 
+        golioth_coap_req_deadline_remove(req);
+
         int64_t req_timeout = golioth_coap_req_poll_prepare(req, now);
+        if (req_timeout == INT64_MAX)
+        {
+            /* Timed out and freed */
+            continue;
+        }
 
-        min_timeout = MIN(min_timeout, req_timeout);
+        golioth_coap_req_deadline_insert(req, now + req_timeout);
     }
 
-    return min_timeout;
+    return INT64_MAX;
 }
 
 int64_t golioth_coap_reqs_poll_prepare(struct golioth_client *client, int64_t now)
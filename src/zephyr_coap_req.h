@@ -31,6 +31,11 @@ struct golioth_coap_pending
     uint32_t t0;
     uint32_t timeout;
     uint8_t retries;
+    /** RTO of the first transmission, which determines the backoff */
+    uint32_t rto;
+    /** Time of the first transmission, for measuring the round-trip time */
+    uint32_t t_sent;
+    bool retransmitted;
 };
 
 /**
@@ -50,6 +55,11 @@ struct golioth_coap_reply
 struct golioth_coap_req
 {
     sys_dnode_t node;
+    /** Node in the client's coap_reqs_by_deadline, while awaiting a response */
+    struct rbnode deadline_node;
+    /** Uptime of the next (re)transmission or timeout, in milliseconds */
+    int64_t deadline;
+    bool in_deadline_tree;
     struct coap_packet request;
     struct coap_packet request_wo_block2;
     struct coap_block_context block_ctx;
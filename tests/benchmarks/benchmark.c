@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Throughput and latency benchmark of the Linux port, against the mock server in
+// tests/mock_server. Runs one workload and prints the results as one line of JSON.
+// See README.md.
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <golioth/client.h>
+#include <golioth/golioth_debug.h>
+#include <golioth/lightdb_state.h>
+#include <golioth/ota.h>
+#include <golioth/stream.h>
+
+#define STREAM_PATH "bench"
+#define LIGHTDB_PATH "bench"
+#define OTA_PACKAGE "bench"
+#define OTA_VERSION "1.0.0"
+#define SYNC_TIMEOUT_S 10
+
+enum workload
+{
+    WORKLOAD_STREAM,
+    WORKLOAD_GET,
+    WORKLOAD_OTA,
+};
+
+static const char *const workload_names[] = {"stream", "get", "ota"};
+
+struct options
+{
+    enum workload workload;
+    bool sync;
+    size_t payload_size;
+    size_t queue_depth;
+    size_t num_requests;
+    size_t num_warmup;
+    size_t artifact_size;
+    // Loss and delay injected by the caller, only recorded in the results
+    double loss_percent;
+    uint32_t delay_ms;
+    const char *output;
+};
+
+struct request
+{
+    uint64_t start_us;
+    uint32_t latency_us;
+    size_t num_bytes;
+    enum golioth_status status;
+};
+
+static struct golioth_client *client;
+static struct options opts = {
+    .workload = WORKLOAD_STREAM,
+    .payload_size = 64,
+    .queue_depth = 1,
+    .num_requests = 1000,
+    .num_warmup = 10,
+    .artifact_size = 64 * 1024,
+};
+
+static struct request *requests;
+static uint8_t *payload;
+static atomic_size_t next_request;
+// Free slots in the window of asynchronous requests
+static sem_t window;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void finish_request(struct request *req, enum golioth_status status, size_t num_bytes)
+{
+    req->latency_us = now_us() - req->start_us;
+    req->status = status;
+    req->num_bytes = num_bytes;
+}
+
+static void on_set(struct golioth_client *cb_client,
+                   const struct golioth_response *response,
+                   const char *path,
+                   void *arg)
+{
+    struct request *req = arg;
+    finish_request(req, response->status, opts.payload_size);
+    sem_post(&window);
+}
+
+static void on_get(struct golioth_client *cb_client,
+                   const struct golioth_response *response,
+                   const char *path,
+                   const uint8_t *buf,
+                   size_t buf_size,
+                   void *arg)
+{
+    struct request *req = arg;
+    finish_request(req, response->status, buf_size);
+    sem_post(&window);
+}
+
+static enum golioth_status start_async(struct request *req)
+{
+    switch (opts.workload)
+    {
+        case WORKLOAD_STREAM:
+            return golioth_stream_set_async(client,
+                                            STREAM_PATH,
+                                            GOLIOTH_CONTENT_TYPE_JSON,
+                                            payload,
+                                            opts.payload_size,
+                                            on_set,
+                                            req);
+        case WORKLOAD_GET:
+            return golioth_lightdb_get_async(client,
+                                             LIGHTDB_PATH,
+                                             GOLIOTH_CONTENT_TYPE_JSON,
+                                             on_get,
+                                             req);
+        default:
+            return GOLIOTH_ERR_NOT_IMPLEMENTED;
+    }
+}
+
+static void run_sync(struct request *req, size_t index)
+{
+    enum golioth_status status;
+    size_t num_bytes = 0;
+
+    switch (opts.workload)
+    {
+        case WORKLOAD_STREAM:
+            status = golioth_stream_set_sync(client,
+                                             STREAM_PATH,
+                                             GOLIOTH_CONTENT_TYPE_JSON,
+                                             payload,
+                                             opts.payload_size,
+                                             SYNC_TIMEOUT_S);
+            num_bytes = opts.payload_size;
+            break;
+        case WORKLOAD_GET:
+        {
+            uint8_t buf[opts.payload_size + 1];
+            num_bytes = sizeof(buf);
+            status = golioth_lightdb_get_sync(client,
+                                              LIGHTDB_PATH,
+                                              GOLIOTH_CONTENT_TYPE_JSON,
+                                              buf,
+                                              &num_bytes,
+                                              SYNC_TIMEOUT_S);
+            break;
+        }
+        case WORKLOAD_OTA:
+        {
+            uint8_t buf[GOLIOTH_OTA_BLOCKSIZE];
+            bool is_last;
+            size_t num_blocks = golioth_ota_size_to_nblocks(opts.artifact_size);
+            status = golioth_ota_get_block_sync(client,
+                                                OTA_PACKAGE,
+                                                OTA_VERSION,
+                                                index % num_blocks,
+                                                buf,
+                                                &num_bytes,
+                                                &is_last,
+                                                SYNC_TIMEOUT_S);
+            break;
+        }
+        default:
+            status = GOLIOTH_ERR_NOT_IMPLEMENTED;
+            break;
+    }
+
+    finish_request(req, status, status == GOLIOTH_OK ? num_bytes : 0);
+}
+
+// Each thread runs one synchronous request at a time, so queue_depth threads keep up to
+// queue_depth requests in flight
+static void *sync_thread(void *arg)
+{
+    size_t total = opts.num_warmup + opts.num_requests;
+    size_t index;
+
+    while ((index = atomic_fetch_add(&next_request, 1)) < total)
+    {
+        struct request *req = &requests[index];
+        req->start_us = now_us();
+        run_sync(req, index);
+    }
+
+    return NULL;
+}
+
+static void run_all_sync(void)
+{
+    pthread_t threads[opts.queue_depth];
+
+    for (size_t i = 0; i < opts.queue_depth; i++)
+    {
+        pthread_create(&threads[i], NULL, sync_thread, NULL);
+    }
+
+    for (size_t i = 0; i < opts.queue_depth; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static void run_all_async(void)
+{
+    size_t total = opts.num_warmup + opts.num_requests;
+
+    for (size_t i = 0; i < total; i++)
+    {
+        struct request *req = &requests[i];
+
+        sem_wait(&window);
+        req->start_us = now_us();
+
+        enum golioth_status status = start_async(req);
+        if (status != GOLIOTH_OK)
+        {
+            finish_request(req, status, 0);
+            sem_post(&window);
+        }
+    }
+
+    // Wait for the requests still in flight
+    for (size_t i = 0; i < opts.queue_depth; i++)
+    {
+        sem_wait(&window);
+    }
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, unsigned int p)
+{
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    return sorted[(n - 1) * p / 100];
+}
+
+static void print_results(FILE *f, uint64_t duration_us)
+{
+    const struct request *measured = &requests[opts.num_warmup];
+    uint32_t *latencies = malloc(opts.num_requests * sizeof(uint32_t));
+    size_t num_ok = 0;
+    uint64_t num_bytes = 0;
+
+    for (size_t i = 0; i < opts.num_requests; i++)
+    {
+        if (measured[i].status == GOLIOTH_OK)
+        {
+            latencies[num_ok++] = measured[i].latency_us;
+            num_bytes += measured[i].num_bytes;
+        }
+    }
+
+    qsort(latencies, num_ok, sizeof(uint32_t), compare_u32);
+
+    double duration_s = duration_us / 1e6;
+
+    fprintf(f,
+            "{\"workload\":\"%s\",\"mode\":\"%s\",\"payload_size\":%zu,\"queue_depth\":%zu,"
+            "\"loss_percent\":%g,\"delay_ms\":%" PRIu32 ",\"requests\":%zu,\"ok\":%zu,"
+            "\"errors\":%zu,\"duration_s\":%.3f,\"ops_per_s\":%.1f,\"kb_per_s\":%.1f,"
+            "\"latency_us\":{\"p50\":%" PRIu32 ",\"p90\":%" PRIu32 ",\"p99\":%" PRIu32
+            ",\"max\":%" PRIu32 "}}\n",
+            workload_names[opts.workload],
+            opts.sync ? "sync" : "async",
+            opts.workload == WORKLOAD_OTA ? (size_t) GOLIOTH_OTA_BLOCKSIZE : opts.payload_size,
+            opts.queue_depth,
+            opts.loss_percent,
+            opts.delay_ms,
+            opts.num_requests,
+            num_ok,
+            opts.num_requests - num_ok,
+            duration_s,
+            num_ok / duration_s,
+            num_bytes / 1024.0 / duration_s,
+            percentile(latencies, num_ok, 50),
+            percentile(latencies, num_ok, 90),
+            percentile(latencies, num_ok, 99),
+            num_ok ? latencies[num_ok - 1] : 0);
+    fflush(f);
+
+    free(latencies);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "\n"
+            "  -w stream|get|ota  workload, default stream\n"
+            "  -S                 use synchronous calls, default asynchronous\n"
+            "  -s bytes           payload size, default 64\n"
+            "  -q depth           requests in flight, default 1\n"
+            "  -n count           measured requests, default 1000\n"
+            "  -W count           warmup requests, default 10\n"
+            "  -a bytes           OTA artifact size, default 65536\n"
+            "  -L percent         injected packet loss, recorded in the results\n"
+            "  -D ms              injected delay, recorded in the results\n"
+            "  -o file            append results to file, default stdout\n"
+            "\n"
+            "The PSK identity and PSK are read from GOLIOTH_SAMPLE_PSK_ID and\n"
+            "GOLIOTH_SAMPLE_PSK. The OTA workload is only run synchronously.\n",
+            argv0);
+}
+
+static bool parse_options(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "w:Ss:q:n:W:a:L:D:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'w':
+            {
+                bool found = false;
+                for (size_t i = 0; i < sizeof(workload_names) / sizeof(workload_names[0]); i++)
+                {
+                    if (strcmp(optarg, workload_names[i]) == 0)
+                    {
+                        opts.workload = i;
+                        found = true;
+                    }
+                }
+                if (!found)
+                {
+                    return false;
+                }
+                break;
+            }
+            case 'S':
+                opts.sync = true;
+                break;
+            case 's':
+                opts.payload_size = strtoul(optarg, NULL, 10);
+                break;
+            case 'q':
+                opts.queue_depth = strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                opts.num_requests = strtoul(optarg, NULL, 10);
+                break;
+            case 'W':
+                opts.num_warmup = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                opts.artifact_size = strtoul(optarg, NULL, 10);
+                break;
+            case 'L':
+                opts.loss_percent = strtod(optarg, NULL);
+                break;
+            case 'D':
+                opts.delay_ms = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                opts.output = optarg;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if (opts.workload == WORKLOAD_OTA)
+    {
+        opts.sync = true;
+    }
+
+    return (opts.queue_depth > 0 && opts.num_requests > 0 && opts.artifact_size > 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (!parse_options(argc, argv))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *psk_id = getenv("GOLIOTH_SAMPLE_PSK_ID");
+    const char *psk = getenv("GOLIOTH_SAMPLE_PSK");
+    if (!psk_id || !psk)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *output = stdout;
+    if (opts.output)
+    {
+        output = fopen(opts.output, "a");
+        if (!output)
+        {
+            perror(opts.output);
+            return 1;
+        }
+    }
+
+    // A JSON string of payload_size bytes, including the quotes
+    payload = malloc(opts.payload_size + 1);
+    memset(payload, 'x', opts.payload_size);
+    if (opts.payload_size >= 2)
+    {
+        payload[0] = '"';
+        payload[opts.payload_size - 1] = '"';
+    }
+
+    requests = calloc(opts.num_warmup + opts.num_requests, sizeof(struct request));
+    sem_init(&window, 0, opts.queue_depth);
+
+    golioth_debug_set_log_level(GOLIOTH_DEBUG_LOG_LEVEL_NONE);
+
+    struct golioth_client_config config = {
+        .credentials =
+            {
+                .auth_type = GOLIOTH_TLS_AUTH_TYPE_PSK,
+                .psk =
+                    {
+                        .psk_id = psk_id,
+                        .psk_id_len = strlen(psk_id),
+                        .psk = psk,
+                        .psk_len = strlen(psk),
+                    },
+            },
+    };
+
+    client = golioth_client_create(&config);
+    if (!client || !golioth_client_wait_for_connect(client, SYNC_TIMEOUT_S * 1000))
+    {
+        fprintf(stderr, "Failed to connect\n");
+        return 1;
+    }
+
+    uint64_t start_us = now_us();
+    if (opts.sync)
+    {
+        run_all_sync();
+    }
+    else
+    {
+        run_all_async();
+    }
+    uint64_t duration_us = now_us() - start_us;
+
+    // Warmup requests are not measured, so take their share of the time out
+    if (opts.num_warmup > 0)
+    {
+        uint64_t measured_start_us = requests[opts.num_warmup].start_us;
+        if (measured_start_us > start_us)
+        {
+            duration_us -= measured_start_us - start_us;
+        }
+    }
+
+    print_results(output, duration_us);
+
+    golioth_client_destroy(client);
+    sem_destroy(&window);
+    free(requests);
+    free(payload);
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+
+    return 0;
+}
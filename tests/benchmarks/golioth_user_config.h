@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+// The mock server in tests/mock_server, on the default port
+#define CONFIG_GOLIOTH_COAP_HOST_URI "coaps://localhost"
+
+// Room for the deepest queue the benchmarks sweep
+#define CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS 64
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS 64
+
+#define CONFIG_GOLIOTH_LIGHTDB_STATE
+#define CONFIG_GOLIOTH_STREAM
+#define CONFIG_GOLIOTH_FW_UPDATE
@@ -0,0 +1,119 @@
+#!/usr/bin/env bash
+
+# Build the benchmark and the mock server, and sweep the benchmark over workloads, modes,
+# payload sizes, queue depths and injected loss and delay. Results are appended to
+# build/results.jsonl, one JSON object per run. If MAX_ERRORS is set, fails when a run has
+# more failed requests than that. See README.md.
+
+set -Eeuo pipefail
+
+cd "$(dirname "$0")"
+
+WORKLOADS=${WORKLOADS:-"stream get ota"}
+MODES=${MODES:-"async sync"}
+PAYLOAD_SIZES=${PAYLOAD_SIZES:-"16 256 1024"}
+QUEUE_DEPTHS=${QUEUE_DEPTHS:-"1 8 32"}
+# Space-separated loss_percent:delay_ms pairs, applied with netem on the loopback device
+NETEM=${NETEM:-"0:0"}
+REQUESTS=${REQUESTS:-1000}
+ARTIFACT_SIZE=${ARTIFACT_SIZE:-65536}
+MAX_ERRORS=${MAX_ERRORS:-}
+
+PSK_ID=bench-id
+PSK=bench-psk
+
+# Build, unless ctest runs this from an existing build (see CMakeLists.txt)
+if [ -z "${BUILD_DIR:-}" ]; then
+    BUILD_DIR=build
+    cmake -S . -B "$BUILD_DIR"
+    cmake --build "$BUILD_DIR" -j8
+fi
+
+BUILD_DIR=$(cd "$BUILD_DIR" && pwd)
+results=$BUILD_DIR/results.jsonl
+artifact=$BUILD_DIR/artifact.bin
+head -c "$ARTIFACT_SIZE" /dev/urandom > "$artifact"
+
+coproc MOCK { "$BUILD_DIR"/mock_server/golioth_mock_server -i "$PSK_ID" -k "$PSK"; }
+
+mock_cmd() {
+    echo "$@" >&"${MOCK[1]}"
+}
+
+netem_clear() {
+    tc qdisc del dev lo root 2> /dev/null || true
+}
+
+cleanup() {
+    mock_cmd exit || true
+    if [ "$(id -u)" -eq 0 ]; then
+        netem_clear
+    fi
+}
+trap cleanup EXIT
+
+mock_cmd "set .u/c/bench@1.0.0 octet @$artifact"
+
+export GOLIOTH_SAMPLE_PSK_ID=$PSK_ID
+export GOLIOTH_SAMPLE_PSK=$PSK
+
+for netem in $NETEM; do
+    loss=${netem%%:*}
+    delay=${netem##*:}
+
+    if [ "$loss" != 0 ] || [ "$delay" != 0 ]; then
+        if [ "$(id -u)" -ne 0 ]; then
+            echo "Skipping loss $loss% and delay ${delay}ms, netem needs root" >&2
+            continue
+        fi
+        netem_clear
+        tc qdisc add dev lo root netem loss "${loss}%" delay "${delay}ms"
+    fi
+
+    for workload in $WORKLOADS; do
+        for mode in $MODES; do
+            # OTA blocks are only fetched synchronously
+            if [ "$workload" = ota ] && [ "$mode" = async ]; then
+                continue
+            fi
+
+            sizes=$PAYLOAD_SIZES
+            if [ "$workload" = ota ]; then
+                sizes=1024
+            fi
+
+            for size in $sizes; do
+                # A JSON string of size bytes, including the quotes
+                mock_cmd "set .d/bench json \"$(head -c $((size - 2)) /dev/zero | tr '\0' x)\""
+
+                for depth in $QUEUE_DEPTHS; do
+                    args=(-w "$workload" -s "$size" -q "$depth" -n "$REQUESTS"
+                          -a "$ARTIFACT_SIZE" -L "$loss" -D "$delay" -o "$results")
+                    if [ "$mode" = sync ]; then
+                        args+=(-S)
+                    fi
+
+                    echo "$workload $mode size=$size depth=$depth loss=$loss% delay=${delay}ms"
+                    "$BUILD_DIR"/golioth_benchmark "${args[@]}"
+
+                    errors=$(tail -n 1 "$results" | grep -o '"errors":[0-9]*' | cut -d: -f2)
+                    if [ -n "$MAX_ERRORS" ] && [ "$errors" -gt "$MAX_ERRORS" ]; then
+                        echo "FAIL: $errors requests failed, at most $MAX_ERRORS allowed" >&2
+                        exit 1
+                    fi
+                done
+            done
+        done
+    done
+
+    if [ "$(id -u)" -eq 0 ]; then
+        netem_clear
+    fi
+done
+
+# Server side view of the whole sweep
+mock_cmd stats
+read -r -u "${MOCK[0]}" stats
+echo "$stats" > "$BUILD_DIR"/mock_stats.json
+
+echo "Results: $results"
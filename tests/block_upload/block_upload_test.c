@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// End to end test of blockwise uploads to LightDB stream, against the mock server in
+// tests/mock_server, scripted by run.sh to reject uploads to one path with 4.00. Exits with 0
+// if all checks pass. See README.md.
+
+#include <errno.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <golioth/client.h>
+#include <golioth/golioth_debug.h>
+#include <golioth/stream.h>
+
+#define PATH_OK "upload_ok"
+#define PATH_REJECTED "upload_rejected"
+#define UPLOAD_SIZE (3 * 1024 + 100)
+#define TIMEOUT_S 10
+
+struct upload
+{
+    // Posted by the async callback
+    sem_t done;
+    size_t num_callbacks;
+    enum golioth_status status;
+};
+
+static bool failed;
+
+#define CHECK(cond, ...)                  \
+    do                                    \
+    {                                     \
+        if (!(cond))                      \
+        {                                 \
+            fprintf(stderr, "FAIL: ");    \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n");        \
+            failed = true;                \
+        }                                 \
+    } while (0)
+
+static enum golioth_status read_block(struct golioth_client *client,
+                                      size_t offset,
+                                      uint8_t *block_buffer,
+                                      size_t *block_size,
+                                      bool *is_last,
+                                      void *arg)
+{
+    size_t len = UPLOAD_SIZE - offset;
+    if (len > *block_size)
+    {
+        len = *block_size;
+    }
+
+    // One long JSON string
+    memset(block_buffer, 'a' + (offset / 1024) % 26, len);
+    *block_size = len;
+    *is_last = (offset + len == UPLOAD_SIZE);
+    if (offset == 0)
+    {
+        block_buffer[0] = '"';
+    }
+    if (*is_last)
+    {
+        block_buffer[len - 1] = '"';
+    }
+
+    return GOLIOTH_OK;
+}
+
+static void on_upload(struct golioth_client *client,
+                      const struct golioth_response *response,
+                      const char *path,
+                      void *arg)
+{
+    struct upload *upload = arg;
+
+    upload->num_callbacks++;
+    upload->status = response->status;
+    sem_post(&upload->done);
+}
+
+static void check_sync(struct golioth_client *client, const char *path, bool expect_ok)
+{
+    enum golioth_status status =
+        golioth_stream_set_blockwise_sync(client,
+                                          path,
+                                          GOLIOTH_CONTENT_TYPE_JSON,
+                                          read_block,
+                                          NULL,
+                                          TIMEOUT_S);
+    if (expect_ok)
+    {
+        CHECK(status == GOLIOTH_OK, "sync upload to %s failed: %d", path, status);
+    }
+    else
+    {
+        CHECK(status != GOLIOTH_OK, "sync upload to %s succeeded", path);
+    }
+}
+
+static void check_async(struct golioth_client *client, const char *path, bool expect_ok)
+{
+    struct upload upload = {};
+    sem_init(&upload.done, 0, 0);
+
+    enum golioth_status status =
+        golioth_stream_set_blockwise_async(client,
+                                           path,
+                                           GOLIOTH_CONTENT_TYPE_JSON,
+                                           read_block,
+                                           NULL,
+                                           on_upload,
+                                           &upload);
+    CHECK(status == GOLIOTH_OK, "async upload to %s not queued: %d", path, status);
+    if (status != GOLIOTH_OK)
+    {
+        sem_destroy(&upload.done);
+        return;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += TIMEOUT_S;
+
+    int err;
+    while ((err = sem_timedwait(&upload.done, &deadline)) < 0 && errno == EINTR)
+    {
+    }
+    CHECK(err == 0, "async upload to %s: callback not called", path);
+
+    // Give a second callback the chance to show up
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 1;
+    while (sem_timedwait(&upload.done, &deadline) < 0 && errno == EINTR)
+    {
+    }
+
+    if (err == 0)
+    {
+        CHECK(upload.num_callbacks == 1,
+              "async upload to %s: callback called %zu times",
+              path,
+              upload.num_callbacks);
+        if (expect_ok)
+        {
+            CHECK(upload.status == GOLIOTH_OK,
+                  "async upload to %s failed: %d",
+                  path,
+                  upload.status);
+        }
+        else
+        {
+            CHECK(upload.status != GOLIOTH_OK, "async upload to %s succeeded", path);
+        }
+    }
+
+    sem_destroy(&upload.done);
+}
+
+int main(int argc, char **argv)
+{
+    const char *psk_id = getenv("GOLIOTH_SAMPLE_PSK_ID");
+    const char *psk = getenv("GOLIOTH_SAMPLE_PSK");
+    if (!psk_id || !psk)
+    {
+        fprintf(stderr,
+                "Usage: %s\n"
+                "\n"
+                "The PSK identity and PSK are read from GOLIOTH_SAMPLE_PSK_ID and\n"
+                "GOLIOTH_SAMPLE_PSK.\n",
+                argv[0]);
+        return 1;
+    }
+
+    golioth_debug_set_log_level(GOLIOTH_DEBUG_LOG_LEVEL_WARN);
+
+    struct golioth_client_config config = {
+        .credentials =
+            {
+                .auth_type = GOLIOTH_TLS_AUTH_TYPE_PSK,
+                .psk =
+                    {
+                        .psk_id = psk_id,
+                        .psk_id_len = strlen(psk_id),
+                        .psk = psk,
+                        .psk_len = strlen(psk),
+                    },
+            },
+    };
+
+    struct golioth_client *client = golioth_client_create(&config);
+    CHECK(client, "client not created");
+    if (!client)
+    {
+        return 1;
+    }
+
+    CHECK(golioth_client_wait_for_connect(client, TIMEOUT_S * 1000), "not connected");
+    if (failed)
+    {
+        golioth_client_destroy(client);
+        return 1;
+    }
+
+    printf("Uploading to %s\n", PATH_OK);
+    check_sync(client, PATH_OK, true);
+    check_async(client, PATH_OK, true);
+
+    printf("Uploading to %s\n", PATH_REJECTED);
+    check_sync(client, PATH_REJECTED, false);
+    check_async(client, PATH_REJECTED, false);
+
+    // The client keeps working after a rejected upload
+    printf("Uploading to %s again\n", PATH_OK);
+    check_sync(client, PATH_OK, true);
+
+    golioth_client_destroy(client);
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+// The mock server in tests/mock_server, on the default port
+#define CONFIG_GOLIOTH_COAP_HOST_URI "coaps://localhost"
+
+#define CONFIG_GOLIOTH_STREAM
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+
+# Build the blockwise upload test and the mock server, and run the test against the server,
+# which rejects uploads to one path with 4.00. See README.md.
+
+set -Eeuo pipefail
+
+cd "$(dirname "$0")"
+
+PSK_ID=block-upload-id
+PSK=block-upload-psk
+
+# Build, unless ctest runs this from an existing build (see CMakeLists.txt)
+if [ -z "${BUILD_DIR:-}" ]; then
+    BUILD_DIR=build
+    cmake -S . -B "$BUILD_DIR"
+    cmake --build "$BUILD_DIR" -j8
+fi
+
+coproc MOCK { "$BUILD_DIR"/mock_server/golioth_mock_server -i "$PSK_ID" -k "$PSK"; }
+
+mock_cmd() {
+    echo "$@" >&"${MOCK[1]}"
+}
+
+cleanup() {
+    mock_cmd exit || true
+}
+trap cleanup EXIT
+
+mock_cmd respond POST .s/upload_rejected 400
+
+export GOLIOTH_SAMPLE_PSK_ID=$PSK_ID
+export GOLIOTH_SAMPLE_PSK=$PSK
+
+"$BUILD_DIR"/golioth_block_upload_test
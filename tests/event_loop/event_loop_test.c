@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// End to end test of CONFIG_GOLIOTH_SHARED_EVENT_LOOP, against the mock server in
+// tests/mock_server: many clients sending requests at the same time on the shared loops,
+// clients leaving while they have requests queued, new clients joining, and clients being
+// stopped and started. Exits with 0 if all checks pass. See README.md.
+
+#include <errno.h>
+#include <getopt.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <golioth/client.h>
+#include <golioth/golioth_debug.h>
+#include <golioth/stream.h>
+
+#define STREAM_PATH "event_loop"
+#define MAX_CLIENTS 64
+#define TIMEOUT_S 10
+
+struct device
+{
+    struct golioth_client *client;
+    // Left out of check_all() while set
+    bool stopped;
+    // Posted by each response callback
+    sem_t done;
+    atomic_size_t num_ok;
+    atomic_size_t num_errors;
+};
+
+static struct device devices[MAX_CLIENTS];
+static size_t num_clients = 8;
+static size_t num_requests = 32;
+static struct golioth_client_config config;
+static bool failed;
+
+#define CHECK(cond, ...)                  \
+    do                                    \
+    {                                     \
+        if (!(cond))                      \
+        {                                 \
+            fprintf(stderr, "FAIL: ");    \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n");        \
+            failed = true;                \
+        }                                 \
+    } while (0)
+
+static void on_set(struct golioth_client *client,
+                   const struct golioth_response *response,
+                   const char *path,
+                   void *arg)
+{
+    struct device *dev = arg;
+
+    if (response->status == GOLIOTH_OK)
+    {
+        atomic_fetch_add(&dev->num_ok, 1);
+    }
+    else
+    {
+        atomic_fetch_add(&dev->num_errors, 1);
+    }
+
+    sem_post(&dev->done);
+}
+
+static bool device_add(struct device *dev)
+{
+    sem_init(&dev->done, 0, 0);
+    atomic_store(&dev->num_ok, 0);
+    atomic_store(&dev->num_errors, 0);
+
+    dev->client = golioth_client_create(&config);
+    return (dev->client != NULL);
+}
+
+// Requests are only accepted once the client has started
+static void device_wait_for_connect(struct device *dev, size_t index)
+{
+    CHECK(dev->client && golioth_client_wait_for_connect(dev->client, TIMEOUT_S * 1000),
+          "client %zu: not connected",
+          index);
+}
+
+static void device_remove(struct device *dev)
+{
+    golioth_client_destroy(dev->client);
+    dev->client = NULL;
+    sem_destroy(&dev->done);
+}
+
+// Queue num_requests stream requests on the client, without waiting for them
+static void device_send(struct device *dev, size_t index)
+{
+    static const char payload[] = "\"x\"";
+
+    for (size_t i = 0; i < num_requests; i++)
+    {
+        enum golioth_status status = golioth_stream_set_async(dev->client,
+                                                              STREAM_PATH,
+                                                              GOLIOTH_CONTENT_TYPE_JSON,
+                                                              (const uint8_t *) payload,
+                                                              strlen(payload),
+                                                              on_set,
+                                                              dev);
+        CHECK(status == GOLIOTH_OK, "client %zu: request %zu not queued: %d", index, i, status);
+        if (status != GOLIOTH_OK)
+        {
+            return;
+        }
+    }
+}
+
+// Wait for the responses to the requests queued by device_send(), which must all succeed
+static void device_check(struct device *dev, size_t index)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += TIMEOUT_S;
+
+    for (size_t i = 0; i < num_requests; i++)
+    {
+        int err;
+        while ((err = sem_timedwait(&dev->done, &deadline)) < 0 && errno == EINTR)
+        {
+        }
+        if (err < 0)
+        {
+            CHECK(false, "client %zu: got %zu of %zu responses", index, i, num_requests);
+            return;
+        }
+    }
+
+    CHECK(atomic_load(&dev->num_errors) == 0,
+          "client %zu: %zu requests failed",
+          index,
+          atomic_load(&dev->num_errors));
+
+    atomic_store(&dev->num_ok, 0);
+    atomic_store(&dev->num_errors, 0);
+}
+
+// All clients that are there send requests at the same time, and get all their responses
+static void check_all(const char *step)
+{
+    printf("%s\n", step);
+
+    for (size_t i = 0; i < num_clients; i++)
+    {
+        if (devices[i].client && !devices[i].stopped)
+        {
+            device_send(&devices[i], i);
+        }
+    }
+
+    for (size_t i = 0; i < num_clients; i++)
+    {
+        if (devices[i].client && !devices[i].stopped)
+        {
+            device_check(&devices[i], i);
+        }
+    }
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "\n"
+            "  -c count  clients, default 8, at most %d\n"
+            "  -n count  requests per client and step, default 32\n"
+            "\n"
+            "The PSK identity and PSK are read from GOLIOTH_SAMPLE_PSK_ID and\n"
+            "GOLIOTH_SAMPLE_PSK.\n",
+            argv0,
+            MAX_CLIENTS);
+}
+
+static bool parse_options(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c':
+                num_clients = strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                num_requests = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return (num_clients >= 2 && num_clients <= MAX_CLIENTS && num_requests > 0
+            && num_requests <= CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS);
+}
+
+int main(int argc, char **argv)
+{
+    const char *psk_id = getenv("GOLIOTH_SAMPLE_PSK_ID");
+    const char *psk = getenv("GOLIOTH_SAMPLE_PSK");
+    if (!parse_options(argc, argv) || !psk_id || !psk)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    golioth_debug_set_log_level(GOLIOTH_DEBUG_LOG_LEVEL_WARN);
+
+    config = (struct golioth_client_config){
+        .credentials =
+            {
+                .auth_type = GOLIOTH_TLS_AUTH_TYPE_PSK,
+                .psk =
+                    {
+                        .psk_id = psk_id,
+                        .psk_id_len = strlen(psk_id),
+                        .psk = psk,
+                        .psk_len = strlen(psk),
+                    },
+            },
+    };
+
+    printf("Adding %zu clients\n", num_clients);
+    for (size_t i = 0; i < num_clients; i++)
+    {
+        CHECK(device_add(&devices[i]), "client %zu: not created", i);
+    }
+    for (size_t i = 0; i < num_clients; i++)
+    {
+        device_wait_for_connect(&devices[i], i);
+    }
+    if (failed)
+    {
+        return 1;
+    }
+
+    check_all("Sending on all clients");
+
+    // Every other client leaves with its requests still queued or in flight. Their callbacks
+    // may or may not be called, but the other clients must not notice.
+    printf("Removing every other client while busy\n");
+    for (size_t i = 0; i < num_clients; i += 2)
+    {
+        device_send(&devices[i], i);
+        device_remove(&devices[i]);
+    }
+
+    check_all("Sending on the remaining clients");
+
+    printf("Adding clients again\n");
+    for (size_t i = 0; i < num_clients; i += 2)
+    {
+        CHECK(device_add(&devices[i]), "client %zu: not created", i);
+    }
+    for (size_t i = 0; i < num_clients; i += 2)
+    {
+        device_wait_for_connect(&devices[i], i);
+    }
+
+    check_all("Sending on all clients again");
+
+    printf("Stopping a client\n");
+    golioth_client_stop(devices[1].client);
+    CHECK(!golioth_client_is_running(devices[1].client), "client 1: still running");
+    devices[1].stopped = true;
+
+    check_all("Sending on the other clients");
+
+    printf("Starting the client again\n");
+    golioth_client_start(devices[1].client);
+    devices[1].stopped = false;
+    device_wait_for_connect(&devices[1], 1);
+
+    check_all("Sending on all clients after restart");
+
+    printf("Removing all clients\n");
+    for (size_t i = 0; i < num_clients; i++)
+    {
+        device_remove(&devices[i]);
+    }
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    return failed ? 1 : 0;
+}
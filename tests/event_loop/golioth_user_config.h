@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+// The mock server in tests/mock_server, on the default port
+#define CONFIG_GOLIOTH_COAP_HOST_URI "coaps://localhost"
+
+// Two loops, so that clients are spread over more than one thread
+#define CONFIG_GOLIOTH_SHARED_EVENT_LOOP 1
+#define CONFIG_GOLIOTH_SHARED_EVENT_LOOP_NUM_THREADS 2
+
+// Room for all the requests the test queues on one client at once
+#define CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS 64
+#define CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS 4
+
+#define CONFIG_GOLIOTH_STREAM
@@ -0,0 +1,62 @@
+#!/usr/bin/env bash
+
+# Build the event loop test and the mock server, and run the test against the server.
+# Fails if the test fails, or if the server didn't see the sessions and requests the test
+# made. See README.md.
+
+set -Eeuo pipefail
+
+cd "$(dirname "$0")"
+
+CLIENTS=${CLIENTS:-8}
+REQUESTS=${REQUESTS:-32}
+
+PSK_ID=event-loop-id
+PSK=event-loop-psk
+
+# Build, unless ctest runs this from an existing build (see CMakeLists.txt)
+if [ -z "${BUILD_DIR:-}" ]; then
+    BUILD_DIR=build
+    cmake -S . -B "$BUILD_DIR"
+    cmake --build "$BUILD_DIR" -j8
+fi
+
+coproc MOCK { "$BUILD_DIR"/mock_server/golioth_mock_server -i "$PSK_ID" -k "$PSK"; }
+
+mock_cmd() {
+    echo "$@" >&"${MOCK[1]}"
+}
+
+cleanup() {
+    mock_cmd exit || true
+}
+trap cleanup EXIT
+
+export GOLIOTH_SAMPLE_PSK_ID=$PSK_ID
+export GOLIOTH_SAMPLE_PSK=$PSK
+
+"$BUILD_DIR"/golioth_event_loop_test -c "$CLIENTS" -n "$REQUESTS"
+
+mock_cmd stats
+read -r -u "${MOCK[0]}" stats
+echo "$stats" > "$BUILD_DIR"/mock_stats.json
+
+# Every client that was added, and the restarted one, made a session
+sessions=$(grep -o '"sessions":[0-9]*' <<< "$stats" | cut -d: -f2)
+expected_sessions=$((CLIENTS + (CLIENTS + 1) / 2 + 1))
+if [ "$sessions" -lt "$expected_sessions" ]; then
+    echo "FAIL: server saw $sessions sessions, expected at least $expected_sessions" >&2
+    exit 1
+fi
+
+# The checked steps send on all clients 3 times, on the clients that stayed once, and on
+# all clients but the stopped one once. The requests of the removed clients may or may
+# not have reached the server.
+posts=$(grep -o '"\.s":{[^}]*}' <<< "$stats" | grep -o '"POST":[0-9]*' | cut -d: -f2)
+expected_posts=$(((3 * CLIENTS + CLIENTS / 2 + CLIENTS - 1) * REQUESTS))
+if [ "$posts" -lt "$expected_posts" ]; then
+    echo "FAIL: server saw $posts stream requests, expected at least $expected_posts" >&2
+    exit 1
+fi
+
+echo "Server saw $sessions sessions and $posts stream requests"
@@ -0,0 +1,1080 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Local stand-in for the Golioth CoAP server, for running the SDK end to end without
+// the cloud. See README.md for the command language.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include <coap3/coap.h>
+
+#define MAX_LINE_LEN 4096
+#define MAX_OVERRIDES 32
+#define MAX_PATH_LEN 128
+
+enum method
+{
+    METHOD_GET,
+    METHOD_POST,
+    METHOD_DELETE,
+    NUM_METHODS,
+};
+
+static const char *const method_names[NUM_METHODS] = {"GET", "POST", "DELETE"};
+
+// Paths are counted by the service they belong to
+static const char *const prefixes[] = {".s", ".d", ".c", ".rpc", ".u", "logs"};
+#define NUM_PREFIXES (sizeof(prefixes) / sizeof(prefixes[0]))
+#define PREFIX_OTHER NUM_PREFIXES
+
+/// Resource value. Values are shared by the resource and the block-wise transfers that
+/// are still serving them, so that a value can be replaced in the middle of a transfer.
+struct value
+{
+    unsigned int refs;
+    uint16_t media_type;
+    size_t len;
+    uint8_t data[];
+};
+
+/// Scripted response, set with the respond command
+struct override
+{
+    enum method method;
+    char path[MAX_PATH_LEN];
+    // Match all paths that start with path
+    bool prefix;
+    // Response code as in COAP_RESPONSE_CODE(), or 0 to acknowledge and never respond
+    int code;
+    struct value *value;
+};
+
+static struct
+{
+    uint32_t requests[NUM_PREFIXES + 1][NUM_METHODS];
+    uint32_t overridden;
+    uint32_t notifications;
+    uint32_t sessions;
+    uint64_t bytes_received;
+} stats;
+
+static coap_context_t *ctx;
+static struct override overrides[MAX_OVERRIDES];
+static size_t num_overrides;
+static bool verbose;
+static volatile sig_atomic_t quit;
+
+static void log_msg(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void log_msg(const char *fmt, ...)
+{
+    if (!verbose)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "mock_server: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+static struct value *value_create(uint16_t media_type, const uint8_t *data, size_t len)
+{
+    struct value *value = malloc(sizeof(*value) + len);
+    if (!value)
+    {
+        return NULL;
+    }
+
+    value->refs = 1;
+    value->media_type = media_type;
+    value->len = len;
+    if (len > 0)
+    {
+        memcpy(value->data, data, len);
+    }
+
+    return value;
+}
+
+static void value_put(struct value *value)
+{
+    if (value && --value->refs == 0)
+    {
+        free(value);
+    }
+}
+
+static void release_large_data(coap_session_t *session, void *app_ptr)
+{
+    value_put(app_ptr);
+}
+
+static size_t prefix_index(const char *path)
+{
+    for (size_t i = 0; i < NUM_PREFIXES; i++)
+    {
+        size_t len = strlen(prefixes[i]);
+        if (strncmp(path, prefixes[i], len) == 0 && (path[len] == '\0' || path[len] == '/'))
+        {
+            return i;
+        }
+    }
+
+    return PREFIX_OTHER;
+}
+
+static bool method_from_pdu(const coap_pdu_t *request, enum method *method)
+{
+    switch (coap_pdu_get_code(request))
+    {
+        case COAP_REQUEST_CODE_GET:
+            *method = METHOD_GET;
+            return true;
+        case COAP_REQUEST_CODE_POST:
+        case COAP_REQUEST_CODE_PUT:
+            *method = METHOD_POST;
+            return true;
+        case COAP_REQUEST_CODE_DELETE:
+            *method = METHOD_DELETE;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool method_from_name(const char *name, enum method *method)
+{
+    for (size_t i = 0; i < NUM_METHODS; i++)
+    {
+        if (strcmp(name, method_names[i]) == 0)
+        {
+            *method = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void send_value(coap_resource_t *resource,
+                       coap_session_t *session,
+                       const coap_pdu_t *request,
+                       const coap_string_t *query,
+                       coap_pdu_t *response,
+                       struct value *value)
+{
+    // The reference is dropped by libcoap once the last block is sent
+    value->refs++;
+    coap_add_data_large_response(resource,
+                                 session,
+                                 request,
+                                 response,
+                                 query,
+                                 value->media_type,
+                                 -1,
+                                 0,
+                                 value->len,
+                                 value->data,
+                                 release_large_data,
+                                 value);
+}
+
+// Count the request, and answer it if there is a matching override. Returns true if the
+// request was answered.
+static bool handle_common(coap_resource_t *resource,
+                          coap_session_t *session,
+                          const coap_pdu_t *request,
+                          const coap_string_t *query,
+                          coap_pdu_t *response,
+                          const char *path)
+{
+    enum method method;
+    if (!method_from_pdu(request, &method))
+    {
+        return false;
+    }
+
+    size_t len = 0;
+    const uint8_t *data;
+    size_t offset;
+    size_t total;
+    if (coap_get_data_large(request, &len, &data, &offset, &total))
+    {
+        stats.bytes_received += len;
+    }
+
+    stats.requests[prefix_index(path)][method]++;
+    log_msg("%s %s (%zu bytes)", method_names[method], path, len);
+
+    for (size_t i = 0; i < num_overrides; i++)
+    {
+        const struct override *o = &overrides[i];
+        if (o->method != method)
+        {
+            continue;
+        }
+
+        bool match = o->prefix ? (strncmp(path, o->path, strlen(o->path)) == 0)
+                               : (strcmp(path, o->path) == 0);
+        if (!match)
+        {
+            continue;
+        }
+
+        stats.overridden++;
+
+        // A response code of 0 leaves libcoap to send an empty ACK, and nothing else
+        coap_pdu_set_code(response, o->code);
+        if (o->code != 0 && o->value)
+        {
+            send_value(resource, session, request, query, response, o->value);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static bool get_path(const coap_pdu_t *request, char *path, size_t path_size)
+{
+    coap_string_t *uri_path = coap_get_uri_path(request);
+    if (!uri_path)
+    {
+        path[0] = '\0';
+        return true;
+    }
+
+    bool fits = (uri_path->length < path_size);
+    if (fits)
+    {
+        memcpy(path, uri_path->s, uri_path->length);
+        path[uri_path->length] = '\0';
+    }
+    coap_delete_string(uri_path);
+
+    return fits;
+}
+
+static uint16_t request_media_type(const coap_pdu_t *request)
+{
+    coap_opt_iterator_t iter;
+    coap_opt_t *opt = coap_check_option(request, COAP_OPTION_CONTENT_FORMAT, &iter);
+    if (!opt)
+    {
+        return COAP_MEDIATYPE_TEXT_PLAIN;
+    }
+
+    return coap_decode_var_bytes(coap_opt_value(opt), coap_opt_length(opt));
+}
+
+static void set_resource_value(coap_resource_t *resource, struct value *value)
+{
+    value_put(coap_resource_get_userdata(resource));
+    coap_resource_set_userdata(resource, value);
+
+    if (coap_resource_notify_observers(resource, NULL))
+    {
+        stats.notifications++;
+    }
+}
+
+static void hnd_get(coap_resource_t *resource,
+                    coap_session_t *session,
+                    const coap_pdu_t *request,
+                    const coap_string_t *query,
+                    coap_pdu_t *response)
+{
+    char path[MAX_PATH_LEN];
+    if (!get_path(request, path, sizeof(path)))
+    {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_BAD_REQUEST);
+        return;
+    }
+
+    if (handle_common(resource, session, request, query, response, path))
+    {
+        return;
+    }
+
+    struct value *value = coap_resource_get_userdata(resource);
+    if (!value)
+    {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_NOT_FOUND);
+        return;
+    }
+
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    send_value(resource, session, request, query, response, value);
+}
+
+static void hnd_post(coap_resource_t *resource,
+                     coap_session_t *session,
+                     const coap_pdu_t *request,
+                     const coap_string_t *query,
+                     coap_pdu_t *response)
+{
+    char path[MAX_PATH_LEN];
+    if (!get_path(request, path, sizeof(path)))
+    {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_BAD_REQUEST);
+        return;
+    }
+
+    if (handle_common(resource, session, request, query, response, path))
+    {
+        return;
+    }
+
+    size_t len;
+    const uint8_t *data;
+    size_t offset;
+    size_t total;
+    if (!coap_get_data_large(request, &len, &data, &offset, &total))
+    {
+        len = 0;
+        data = NULL;
+    }
+
+    struct value *value = value_create(request_media_type(request), data, len);
+    if (!value)
+    {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_INTERNAL_ERROR);
+        return;
+    }
+
+    set_resource_value(resource, value);
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CHANGED);
+}
+
+static void hnd_delete(coap_resource_t *resource,
+                       coap_session_t *session,
+                       const coap_pdu_t *request,
+                       const coap_string_t *query,
+                       coap_pdu_t *response)
+{
+    char path[MAX_PATH_LEN];
+    if (!get_path(request, path, sizeof(path)))
+    {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_BAD_REQUEST);
+        return;
+    }
+
+    if (handle_common(resource, session, request, query, response, path))
+    {
+        return;
+    }
+
+    set_resource_value(resource, NULL);
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_DELETED);
+}
+
+static coap_resource_t *create_resource(const char *path)
+{
+    coap_str_const_t *uri_path = coap_new_str_const((const uint8_t *) path, strlen(path));
+    if (!uri_path)
+    {
+        return NULL;
+    }
+
+    coap_resource_t *resource = coap_resource_init(uri_path, COAP_RESOURCE_FLAGS_RELEASE_URI);
+    if (!resource)
+    {
+        coap_delete_str_const(uri_path);
+        return NULL;
+    }
+
+    coap_register_request_handler(resource, COAP_REQUEST_GET, hnd_get);
+    coap_register_request_handler(resource, COAP_REQUEST_POST, hnd_post);
+    coap_register_request_handler(resource, COAP_REQUEST_PUT, hnd_post);
+    coap_register_request_handler(resource, COAP_REQUEST_DELETE, hnd_delete);
+    coap_resource_set_get_observable(resource, 1);
+    coap_add_resource(ctx, resource);
+
+    return resource;
+}
+
+static coap_resource_t *find_resource(const char *path)
+{
+    coap_str_const_t uri_path = {
+        .length = strlen(path),
+        .s = (const uint8_t *) path,
+    };
+
+    return coap_get_resource_from_uri_path(ctx, &uri_path);
+}
+
+// Only LightDB State paths, and those set by the script, are stored and observable. Any
+// other upload (stream, logs, status reports) is acknowledged and dropped.
+static bool is_stored(const char *path)
+{
+    return strncmp(path, ".d/", 3) == 0;
+}
+
+static void hnd_unknown(coap_resource_t *resource,
+                        coap_session_t *session,
+                        const coap_pdu_t *request,
+                        const coap_string_t *query,
+                        coap_pdu_t *response)
+{
+    char path[MAX_PATH_LEN];
+    if (!get_path(request, path, sizeof(path)))
+    {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_BAD_REQUEST);
+        return;
+    }
+
+    enum method method;
+    if (!method_from_pdu(request, &method))
+    {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_NOT_ALLOWED);
+        return;
+    }
+
+    if (method == METHOD_POST && is_stored(path))
+    {
+        coap_resource_t *created = create_resource(path);
+        if (created)
+        {
+            hnd_post(created, session, request, query, response);
+            return;
+        }
+    }
+
+    if (handle_common(resource, session, request, query, response, path))
+    {
+        return;
+    }
+
+    switch (method)
+    {
+        case METHOD_GET:
+            coap_pdu_set_code(response, COAP_RESPONSE_CODE_NOT_FOUND);
+            break;
+        case METHOD_POST:
+            coap_pdu_set_code(response, COAP_RESPONSE_CODE_CHANGED);
+            break;
+        case METHOD_DELETE:
+            coap_pdu_set_code(response, COAP_RESPONSE_CODE_DELETED);
+            break;
+        default:
+            break;
+    }
+}
+
+static int event_handler(coap_session_t *session, const coap_event_t event)
+{
+    switch (event)
+    {
+        case COAP_EVENT_DTLS_CONNECTED:
+            stats.sessions++;
+            log_msg("DTLS session connected");
+            break;
+        case COAP_EVENT_DTLS_CLOSED:
+            log_msg("DTLS session closed");
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static const coap_bin_const_t *psk_key;
+static const char *psk_identity;
+
+static const coap_bin_const_t *validate_psk_identity(coap_bin_const_t *identity,
+                                                     coap_session_t *session,
+                                                     void *arg)
+{
+    if (identity->length != strlen(psk_identity)
+        || memcmp(identity->s, psk_identity, identity->length) != 0)
+    {
+        fprintf(stderr,
+                "mock_server: rejected PSK identity %.*s\n",
+                (int) identity->length,
+                (const char *) identity->s);
+        return NULL;
+    }
+
+    return psk_key;
+}
+
+static bool parse_media_type(const char *name, uint16_t *media_type)
+{
+    static const struct
+    {
+        const char *name;
+        uint16_t media_type;
+    } types[] = {
+        {"text", COAP_MEDIATYPE_TEXT_PLAIN},
+        {"json", COAP_MEDIATYPE_APPLICATION_JSON},
+        {"cbor", COAP_MEDIATYPE_APPLICATION_CBOR},
+        {"octet", COAP_MEDIATYPE_APPLICATION_OCTET_STREAM},
+    };
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        if (strcmp(name, types[i].name) == 0)
+        {
+            *media_type = types[i].media_type;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static struct value *read_file_value(uint16_t media_type, const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "mock_server: %s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct value *value = NULL;
+    if (fseek(f, 0, SEEK_END) == 0)
+    {
+        long size = ftell(f);
+        if (size >= 0 && fseek(f, 0, SEEK_SET) == 0)
+        {
+            value = value_create(media_type, NULL, size);
+            if (value && fread(value->data, 1, size, f) != (size_t) size)
+            {
+                fprintf(stderr, "mock_server: %s: short read\n", filename);
+                value_put(value);
+                value = NULL;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return value;
+}
+
+/// Parse a value given as <type> <data>, where data is a literal, hex:<bytes> or @<file>
+static struct value *parse_value(const char *type, const char *data)
+{
+    uint16_t media_type;
+    if (!type || !data || !parse_media_type(type, &media_type))
+    {
+        fprintf(stderr, "mock_server: expected <text|json|cbor|octet> <data>\n");
+        return NULL;
+    }
+
+    if (data[0] == '@')
+    {
+        return read_file_value(media_type, &data[1]);
+    }
+
+    if (strncmp(data, "hex:", 4) != 0)
+    {
+        return value_create(media_type, (const uint8_t *) data, strlen(data));
+    }
+
+    const char *hex = &data[4];
+    size_t hex_len = strlen(hex);
+    if (hex_len % 2 != 0)
+    {
+        fprintf(stderr, "mock_server: odd number of hex digits\n");
+        return NULL;
+    }
+
+    struct value *value = value_create(media_type, NULL, hex_len / 2);
+    if (!value)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < value->len; i++)
+    {
+        int hi = hex_digit(hex[2 * i]);
+        int lo = hex_digit(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+        {
+            fprintf(stderr, "mock_server: invalid hex digit\n");
+            value_put(value);
+            return NULL;
+        }
+        value->data[i] = (hi << 4) | lo;
+    }
+
+    return value;
+}
+
+static void clear_overrides(void)
+{
+    for (size_t i = 0; i < num_overrides; i++)
+    {
+        value_put(overrides[i].value);
+    }
+    num_overrides = 0;
+}
+
+static void print_stats(void)
+{
+    printf("{\"requests\":{");
+    for (size_t i = 0; i <= NUM_PREFIXES; i++)
+    {
+        printf("%s\"%s\":{", i ? "," : "", i < NUM_PREFIXES ? prefixes[i] : "other");
+        for (size_t m = 0; m < NUM_METHODS; m++)
+        {
+            printf("%s\"%s\":%" PRIu32, m ? "," : "", method_names[m], stats.requests[i][m]);
+        }
+        printf("}");
+    }
+    printf("},\"overridden\":%" PRIu32 ",\"notifications\":%" PRIu32 ",\"sessions\":%" PRIu32
+           ",\"bytes_received\":%" PRIu64 "}\n",
+           stats.overridden,
+           stats.notifications,
+           stats.sessions,
+           stats.bytes_received);
+    fflush(stdout);
+}
+
+static void wait_ms(uint32_t ms)
+{
+    coap_tick_t start;
+    coap_ticks(&start);
+
+    uint64_t elapsed_ms = 0;
+    while (!quit && elapsed_ms < ms)
+    {
+        coap_io_process(ctx, ms - elapsed_ms);
+
+        coap_tick_t now;
+        coap_ticks(&now);
+        elapsed_ms = (uint64_t) (now - start) * 1000 / COAP_TICKS_PER_SECOND;
+    }
+}
+
+static bool cmd_set(char *path, char *type, char *data)
+{
+    if (!path)
+    {
+        return false;
+    }
+
+    struct value *value = parse_value(type, data);
+    if (!value)
+    {
+        return false;
+    }
+
+    coap_resource_t *resource = find_resource(path);
+    if (!resource)
+    {
+        resource = create_resource(path);
+    }
+    if (!resource)
+    {
+        value_put(value);
+        return false;
+    }
+
+    set_resource_value(resource, value);
+
+    return true;
+}
+
+static bool cmd_delete(char *path)
+{
+    if (!path)
+    {
+        return false;
+    }
+
+    coap_resource_t *resource = find_resource(path);
+    if (resource)
+    {
+        set_resource_value(resource, NULL);
+    }
+
+    return true;
+}
+
+static bool cmd_respond(char *method_name, char *path, char *code, char *type, char *data)
+{
+    if (num_overrides == MAX_OVERRIDES)
+    {
+        fprintf(stderr, "mock_server: too many responses\n");
+        return false;
+    }
+
+    struct override o = {0};
+
+    if (!method_name || !method_from_name(method_name, &o.method) || !path || !code)
+    {
+        return false;
+    }
+
+    size_t path_len = strlen(path);
+    if (path_len > 0 && path[path_len - 1] == '*')
+    {
+        o.prefix = true;
+        path[--path_len] = '\0';
+    }
+    if (path_len >= sizeof(o.path))
+    {
+        return false;
+    }
+    strcpy(o.path, path);
+
+    if (strcmp(code, "none") != 0)
+    {
+        char *end;
+        long n = strtol(code, &end, 10);
+        if (*end != '\0' || n < 100 || n > 599)
+        {
+            fprintf(stderr, "mock_server: invalid response code %s\n", code);
+            return false;
+        }
+        o.code = COAP_RESPONSE_CODE(n);
+    }
+
+    if (type)
+    {
+        o.value = parse_value(type, data);
+        if (!o.value)
+        {
+            return false;
+        }
+    }
+
+    overrides[num_overrides++] = o;
+
+    return true;
+}
+
+/// Run a command. Returns false if the command is invalid.
+static bool run_command(char *line)
+{
+    char *saveptr;
+    char *cmd = strtok_r(line, " \t\r\n", &saveptr);
+    if (!cmd || cmd[0] == '#')
+    {
+        return true;
+    }
+
+    char *args[5];
+    for (size_t i = 0; i < 5; i++)
+    {
+        // The last argument of each command takes the rest of the line
+        bool last = (i == 4) || ((strcmp(cmd, "set") == 0) && i == 2);
+        args[i] = strtok_r(NULL, last ? "\r\n" : " \t\r\n", &saveptr);
+    }
+
+    if (strcmp(cmd, "set") == 0)
+    {
+        return cmd_set(args[0], args[1], args[2]);
+    }
+    if (strcmp(cmd, "delete") == 0)
+    {
+        return cmd_delete(args[0]);
+    }
+    if (strcmp(cmd, "respond") == 0)
+    {
+        return cmd_respond(args[0], args[1], args[2], args[3], args[4]);
+    }
+    if (strcmp(cmd, "reset") == 0)
+    {
+        clear_overrides();
+        memset(&stats, 0, sizeof(stats));
+        return true;
+    }
+    if (strcmp(cmd, "wait") == 0 && args[0])
+    {
+        wait_ms(strtoul(args[0], NULL, 10));
+        return true;
+    }
+    if (strcmp(cmd, "stats") == 0)
+    {
+        print_stats();
+        return true;
+    }
+    if (strcmp(cmd, "exit") == 0)
+    {
+        quit = 1;
+        return true;
+    }
+
+    return false;
+}
+
+static int run_script(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if (!f)
+    {
+        fprintf(stderr, "mock_server: %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    char line[MAX_LINE_LEN];
+    int line_num = 0;
+    int err = 0;
+    while (!quit && fgets(line, sizeof(line), f))
+    {
+        line_num++;
+        if (!run_command(line))
+        {
+            fprintf(stderr, "mock_server: %s:%d: invalid command\n", filename, line_num);
+            err = -1;
+            break;
+        }
+    }
+
+    fclose(f);
+
+    return err;
+}
+
+// Run the complete lines received on stdin. Returns false on end of file.
+static bool read_stdin(void)
+{
+    static char buf[MAX_LINE_LEN];
+    static size_t len;
+
+    ssize_t n = read(STDIN_FILENO, &buf[len], sizeof(buf) - len - 1);
+    if (n <= 0)
+    {
+        return (n < 0 && errno == EINTR);
+    }
+    len += n;
+    buf[len] = '\0';
+
+    char *line = buf;
+    char *newline;
+    while ((newline = strchr(line, '\n')))
+    {
+        *newline = '\0';
+        if (!run_command(line))
+        {
+            fprintf(stderr, "mock_server: invalid command\n");
+        }
+        line = newline + 1;
+    }
+
+    len -= line - buf;
+    memmove(buf, line, len);
+    if (len == sizeof(buf) - 1)
+    {
+        fprintf(stderr, "mock_server: command too long\n");
+        len = 0;
+    }
+
+    return true;
+}
+
+static void on_signal(int signum)
+{
+    quit = 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s -k psk [-i psk-id] [-p port] [-s script] [-v]\n"
+            "\n"
+            "  -k psk     pre-shared key the SDK is configured with\n"
+            "  -i psk-id  accept only this PSK identity, instead of any\n"
+            "  -p port    UDP port to listen on, default 5684\n"
+            "  -s script  file with commands to run before reading stdin\n"
+            "  -v         log requests and sessions to stderr\n",
+            argv0);
+}
+
+static void add_default_resources(void)
+{
+    // The SDK ignores "OK" as the first response to the RPC and settings observations
+    static const uint8_t cbor_ok[] = {0x62, 'O', 'K'};
+    static const uint8_t cbor_empty_map[] = {0xa0};
+
+    set_resource_value(create_resource(".rpc"),
+                       value_create(COAP_MEDIATYPE_APPLICATION_CBOR, cbor_ok, sizeof(cbor_ok)));
+    set_resource_value(create_resource(".c"),
+                       value_create(COAP_MEDIATYPE_APPLICATION_CBOR, cbor_ok, sizeof(cbor_ok)));
+    set_resource_value(create_resource(".u/desired"),
+                       value_create(COAP_MEDIATYPE_APPLICATION_CBOR,
+                                    cbor_empty_map,
+                                    sizeof(cbor_empty_map)));
+}
+
+int main(int argc, char **argv)
+{
+    const char *key = NULL;
+    const char *script = NULL;
+    uint16_t port = 5684;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "k:i:p:s:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'k':
+                key = optarg;
+                break;
+            case 'i':
+                psk_identity = optarg;
+                break;
+            case 'p':
+                port = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                script = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!key)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    coap_startup();
+    coap_set_log_level(verbose ? COAP_LOG_INFO : COAP_LOG_WARN);
+
+    if (!coap_dtls_is_supported())
+    {
+        fprintf(stderr, "mock_server: libcoap was built without DTLS\n");
+        return 1;
+    }
+
+    ctx = coap_new_context(NULL);
+    if (!ctx)
+    {
+        fprintf(stderr, "mock_server: failed to create CoAP context\n");
+        return 1;
+    }
+
+    // Let libcoap handle block-wise transfers, so OTA artifacts of any size can be set
+    coap_context_set_block_mode(ctx, COAP_BLOCK_USE_LIBCOAP | COAP_BLOCK_SINGLE_BODY);
+    coap_register_event_handler(ctx, event_handler);
+
+    coap_bin_const_t psk = {
+        .length = strlen(key),
+        .s = (const uint8_t *) key,
+    };
+    psk_key = &psk;
+
+    coap_dtls_spsk_t dtls_psk = {
+        .version = COAP_DTLS_SPSK_SETUP_VERSION,
+        .validate_id_call_back = psk_identity ? validate_psk_identity : NULL,
+        .psk_info.key = psk,
+    };
+    if (!coap_context_set_psk2(ctx, &dtls_psk))
+    {
+        fprintf(stderr, "mock_server: failed to set PSK\n");
+        return 1;
+    }
+
+    // IPv6 any address, which also accepts IPv4 clients
+    coap_address_t addr;
+    coap_address_init(&addr);
+    addr.addr.sin6.sin6_family = AF_INET6;
+    addr.addr.sin6.sin6_addr = in6addr_any;
+    addr.addr.sin6.sin6_port = htons(port);
+    addr.size = sizeof(addr.addr.sin6);
+
+    if (!coap_new_endpoint(ctx, &addr, COAP_PROTO_DTLS))
+    {
+        fprintf(stderr, "mock_server: failed to listen on port %" PRIu16 "\n", port);
+        return 1;
+    }
+
+    coap_resource_t *unknown = coap_resource_unknown_init2(hnd_unknown, 0);
+    coap_register_request_handler(unknown, COAP_REQUEST_GET, hnd_unknown);
+    coap_register_request_handler(unknown, COAP_REQUEST_POST, hnd_unknown);
+    coap_register_request_handler(unknown, COAP_REQUEST_DELETE, hnd_unknown);
+    coap_add_resource(ctx, unknown);
+
+    add_default_resources();
+
+    int err = 0;
+    if (script)
+    {
+        err = run_script(script);
+    }
+
+    bool stdin_open = true;
+    while (!err && !quit)
+    {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        if (stdin_open)
+        {
+            FD_SET(STDIN_FILENO, &readfds);
+        }
+
+        int result = coap_io_process_with_fds(ctx,
+                                              COAP_IO_WAIT,
+                                              stdin_open ? STDIN_FILENO + 1 : 0,
+                                              &readfds,
+                                              NULL,
+                                              NULL);
+        if (result < 0)
+        {
+            break;
+        }
+
+        if (stdin_open && FD_ISSET(STDIN_FILENO, &readfds))
+        {
+            stdin_open = read_stdin();
+        }
+    }
+
+    clear_overrides();
+    coap_free_context(ctx);
+    coap_cleanup();
+
+    return err ? 1 : 0;
+}
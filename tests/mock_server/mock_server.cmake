@@ -0,0 +1,12 @@
+# Included by the projects that test the SDK against the mock server. Builds the mock server
+# in ${CMAKE_BINARY_DIR}/mock_server, as an external project so that its libcoap build (with
+# server support) is kept apart from the one of the SDK.
+
+include(ExternalProject)
+
+ExternalProject_Add(golioth_mock_server
+    SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR}
+    BINARY_DIR ${CMAKE_BINARY_DIR}/mock_server
+    INSTALL_COMMAND ""
+    BUILD_ALWAYS ON
+)
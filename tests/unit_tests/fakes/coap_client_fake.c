@@ -4,6 +4,7 @@
 DEFINE_FAKE_VALUE_FUNC(enum golioth_status,
                        golioth_coap_client_observe_async,
                        struct golioth_client *,
+                       golioth_coap_request_class_t,
                        const char *,
                        const char *,
                        uint32_t,
@@ -12,6 +13,7 @@ DEFINE_FAKE_VALUE_FUNC(enum golioth_status,
 DEFINE_FAKE_VALUE_FUNC(enum golioth_status,
                        golioth_coap_client_set,
                        struct golioth_client *,
+                       golioth_coap_request_class_t,
                        const char *,
                        const char *,
                        uint32_t,
@@ -21,3 +23,18 @@ DEFINE_FAKE_VALUE_FUNC(enum golioth_status,
                        void *,
                        bool,
                        int32_t);
+DEFINE_FAKE_VALUE_FUNC(enum golioth_status,
+                       golioth_coap_client_set_borrowed,
+                       struct golioth_client *,
+                       golioth_coap_request_class_t,
+                       const char *,
+                       const char *,
+                       uint32_t,
+                       const uint8_t *,
+                       size_t,
+                       golioth_payload_release_fn,
+                       void *,
+                       golioth_set_cb_fn,
+                       void *,
+                       bool,
+                       int32_t);
@@ -5,6 +5,7 @@
 DECLARE_FAKE_VALUE_FUNC(enum golioth_status,
                         golioth_coap_client_observe_async,
                         struct golioth_client *,
+                        golioth_coap_request_class_t,
                         const char *,
                         const char *,
                         uint32_t,
@@ -13,6 +14,7 @@ DECLARE_FAKE_VALUE_FUNC(enum golioth_status,
 DECLARE_FAKE_VALUE_FUNC(enum golioth_status,
                         golioth_coap_client_set,
                         struct golioth_client *,
+                        golioth_coap_request_class_t,
                         const char *,
                         const char *,
                         uint32_t,
@@ -22,3 +24,18 @@ DECLARE_FAKE_VALUE_FUNC(enum golioth_status,
                         void *,
                         bool,
                         int32_t);
+DECLARE_FAKE_VALUE_FUNC(enum golioth_status,
+                        golioth_coap_client_set_borrowed,
+                        struct golioth_client *,
+                        golioth_coap_request_class_t,
+                        const char *,
+                        const char *,
+                        uint32_t,
+                        const uint8_t *,
+                        size_t,
+                        golioth_payload_release_fn,
+                        void *,
+                        golioth_set_cb_fn,
+                        void *,
+                        bool,
+                        int32_t);
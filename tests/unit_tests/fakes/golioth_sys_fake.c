@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include "golioth_sys_fake.h"
+
+size_t golioth_sys_fake_num_sems_created;
+size_t golioth_sys_fake_num_sems_destroyed;
+size_t golioth_sys_fake_num_failed_takes;
+size_t golioth_sys_fake_num_failed_gives;
+uint64_t golioth_sys_fake_now_ms;
+
+golioth_sys_sem_t golioth_sys_sem_create(uint32_t sem_max_count, uint32_t sem_initial_count)
+{
+    struct golioth_sys_fake_sem *sem = malloc(sizeof(struct golioth_sys_fake_sem));
+    sem->count = sem_initial_count;
+    sem->max_count = sem_max_count;
+    sem->num_gives = 0;
+    golioth_sys_fake_num_sems_created++;
+    return sem;
+}
+
+bool golioth_sys_sem_take(golioth_sys_sem_t sem, int32_t ms_to_wait)
+{
+    struct golioth_sys_fake_sem *fake = sem;
+    if (fake->count == 0)
+    {
+        golioth_sys_fake_num_failed_takes++;
+        return false;
+    }
+    fake->count--;
+    return true;
+}
+
+bool golioth_sys_sem_give(golioth_sys_sem_t sem)
+{
+    struct golioth_sys_fake_sem *fake = sem;
+    fake->num_gives++;
+    if (fake->count == fake->max_count)
+    {
+        golioth_sys_fake_num_failed_gives++;
+        return false;
+    }
+    fake->count++;
+    return true;
+}
+
+void golioth_sys_sem_destroy(golioth_sys_sem_t sem)
+{
+    golioth_sys_fake_num_sems_destroyed++;
+    free(sem);
+}
+
+int golioth_sys_sem_get_fd(golioth_sys_sem_t sem)
+{
+    return GOLIOTH_SYS_FAKE_SEM_FD;
+}
+
+uint64_t golioth_sys_now_ms(void)
+{
+    return golioth_sys_fake_now_ms;
+}
+
+void golioth_sys_msleep(uint32_t ms) {}
+
+// Threads are not started, tests that need one run its loop body instead
+static int fake_thread;
+
+golioth_sys_thread_t golioth_sys_thread_create(const struct golioth_thread_config *config)
+{
+    return &fake_thread;
+}
+
+void golioth_sys_thread_destroy(golioth_sys_thread_t thread) {}
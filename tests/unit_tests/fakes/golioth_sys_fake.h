@@ -0,0 +1,26 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include <golioth/golioth_sys.h>
+
+// The tests are single threaded, so semaphores only need to count. A take that
+// would block acts as a timeout.
+struct golioth_sys_fake_sem
+{
+    uint32_t count;
+    uint32_t max_count;
+    uint32_t num_gives;
+};
+
+extern size_t golioth_sys_fake_num_sems_created;
+extern size_t golioth_sys_fake_num_sems_destroyed;
+
+// Takes that would have blocked, and gives to a semaphore that was already at its max count
+extern size_t golioth_sys_fake_num_failed_takes;
+extern size_t golioth_sys_fake_num_failed_gives;
+
+// Returned by golioth_sys_now_ms()
+extern uint64_t golioth_sys_fake_now_ms;
+
+// Returned by golioth_sys_sem_get_fd()
+#define GOLIOTH_SYS_FAKE_SEM_FD 3
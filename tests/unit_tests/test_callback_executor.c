@@ -0,0 +1,388 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <golioth/golioth_sys.h>
+#include "callback_executor.h"
+#include "fakes/golioth_sys_fake.h"
+
+static size_t num_pool_buffers;
+static bool pool_exhausted;
+
+void *golioth_payload_pool_alloc(size_t size)
+{
+    if (pool_exhausted)
+    {
+        return NULL;
+    }
+    num_pool_buffers++;
+    return malloc(size);
+}
+
+void golioth_payload_pool_free(void *ptr)
+{
+    if (ptr)
+    {
+        num_pool_buffers--;
+    }
+    free(ptr);
+}
+
+static int fake_client;
+static struct golioth_client *const client = (struct golioth_client *) &fake_client;
+
+static struct golioth_callback_executor *executor;
+static golioth_coap_request_msg_t req;
+static struct golioth_completion *const sync_completion = (struct golioth_completion *) 1;
+
+static struct
+{
+    size_t num_calls;
+    struct golioth_response response;
+    char path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+    uint8_t payload[32];
+    size_t payload_size;
+    bool is_last;
+    void *arg;
+} calls;
+
+static void get_cb(struct golioth_client *cb_client,
+                   const struct golioth_response *response,
+                   const char *path,
+                   const uint8_t *payload,
+                   size_t payload_size,
+                   void *arg)
+{
+    TEST_ASSERT_EQUAL_PTR(client, cb_client);
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(calls.payload), payload_size);
+
+    calls.num_calls++;
+    calls.response = *response;
+    strcpy(calls.path, path);
+    if (payload_size > 0)
+    {
+        memcpy(calls.payload, payload, payload_size);
+    }
+    calls.payload_size = payload_size;
+    calls.arg = arg;
+}
+
+static void get_block_cb(struct golioth_client *cb_client,
+                         const struct golioth_response *response,
+                         const char *path,
+                         const uint8_t *payload,
+                         size_t payload_size,
+                         bool is_last,
+                         void *arg)
+{
+    get_cb(cb_client, response, path, payload, payload_size, arg);
+    calls.is_last = is_last;
+}
+
+static void set_cb(struct golioth_client *cb_client,
+                   const struct golioth_response *response,
+                   const char *path,
+                   void *arg)
+{
+    get_cb(cb_client, response, path, NULL, 0, arg);
+}
+
+static bool call(const char *payload)
+{
+    struct golioth_response response = {
+        .status = GOLIOTH_OK,
+        .status_class = 2,
+        .status_code = 5,
+    };
+
+    return golioth_callback_executor_call(executor,
+                                          client,
+                                          &req,
+                                          &response,
+                                          (const uint8_t *) payload,
+                                          payload ? strlen(payload) : 0,
+                                          true);
+}
+
+static struct golioth_callback_worker *worker(golioth_coap_request_class_t request_class)
+{
+    return &executor->workers[request_class % CONFIG_GOLIOTH_CALLBACK_EXECUTOR_NUM_THREADS];
+}
+
+void setUp(void)
+{
+    executor = golioth_callback_executor_create();
+    TEST_ASSERT_NOT_NULL(executor);
+
+    memset(&req, 0, sizeof(req));
+    memset(&calls, 0, sizeof(calls));
+    num_pool_buffers = 0;
+    pool_exhausted = false;
+
+    req.type = GOLIOTH_COAP_REQUEST_GET;
+    req.request_class = GOLIOTH_COAP_REQUEST_CLASS_RPC;
+    req.get.callback = get_cb;
+    req.get.arg = &calls;
+    strcpy(req.path, "settings");
+}
+
+void tearDown(void)
+{
+    golioth_callback_executor_destroy(executor);
+    executor = NULL;
+}
+
+void sync_requests_run_inline(void)
+{
+    req.request_complete = sync_completion;
+
+    call("abc");
+
+    TEST_ASSERT_EQUAL(1, calls.num_calls);
+    TEST_ASSERT_EQUAL(0, num_pool_buffers);
+    TEST_ASSERT_FALSE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+}
+
+void async_requests_are_queued_with_copies(void)
+{
+    char payload[] = "abc";
+
+    call(payload);
+
+    TEST_ASSERT_EQUAL(0, calls.num_calls);
+    TEST_ASSERT_EQUAL(1, num_pool_buffers);
+
+    // The request and payload belong to the CoAP thread, and are reused right away
+    strcpy(payload, "xyz");
+    strcpy(req.path, "other");
+
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+
+    TEST_ASSERT_EQUAL(1, calls.num_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, calls.response.status);
+    TEST_ASSERT_EQUAL(5, calls.response.status_code);
+    TEST_ASSERT_EQUAL_STRING("settings", calls.path);
+    TEST_ASSERT_EQUAL(3, calls.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY("abc", calls.payload, 3);
+    TEST_ASSERT_EQUAL_PTR(&calls, calls.arg);
+    TEST_ASSERT_EQUAL(0, num_pool_buffers);
+}
+
+void all_callback_types_are_queued(void)
+{
+    req.type = GOLIOTH_COAP_REQUEST_GET_BLOCK;
+    req.get_block.callback = get_block_cb;
+    req.get_block.arg = &calls;
+    call("block");
+
+    req.type = GOLIOTH_COAP_REQUEST_DELETE;
+    req.delete.callback = set_cb;
+    req.delete.arg = &req;
+    call(NULL);
+
+    TEST_ASSERT_EQUAL(0, calls.num_calls);
+
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL(1, calls.num_calls);
+    TEST_ASSERT_EQUAL_MEMORY("block", calls.payload, 5);
+    TEST_ASSERT_TRUE(calls.is_last);
+
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL(2, calls.num_calls);
+    TEST_ASSERT_EQUAL(0, calls.payload_size);
+    TEST_ASSERT_EQUAL_PTR(&req, calls.arg);
+}
+
+void requests_without_callback_are_skipped(void)
+{
+    req.get.callback = NULL;
+
+    call("abc");
+
+    TEST_ASSERT_EQUAL(0, num_pool_buffers);
+    TEST_ASSERT_FALSE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+}
+
+void control_requests_run_inline(void)
+{
+    TEST_ASSERT_FALSE(golioth_callback_executor_offloads(GOLIOTH_COAP_REQUEST_CLASS_CONTROL));
+
+    req.request_class = GOLIOTH_COAP_REQUEST_CLASS_CONTROL;
+    call("abc");
+
+    TEST_ASSERT_EQUAL(1, calls.num_calls);
+    TEST_ASSERT_EQUAL(0, num_pool_buffers);
+}
+
+static void fill_queue(void)
+{
+    for (int i = 0; i < CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE; i++)
+    {
+        TEST_ASSERT_TRUE(call("abc"));
+    }
+    TEST_ASSERT_EQUAL(0, calls.num_calls);
+}
+
+static size_t run_all(void)
+{
+    size_t num_run = 0;
+    while (golioth_callback_executor_run_one(worker(req.request_class), 0))
+    {
+        num_run++;
+    }
+
+    return num_run;
+}
+
+void full_queue_keeps_completions_in_order(void)
+{
+    fill_queue();
+
+    // Never called ahead of the queued callbacks, nor dropped
+    TEST_ASSERT_TRUE(call("late"));
+    TEST_ASSERT_TRUE(call("later"));
+    TEST_ASSERT_EQUAL(0, calls.num_calls);
+    TEST_ASSERT_EQUAL(2, atomic_load(&worker(req.request_class)->overflow_len));
+
+    for (int i = 0; i < CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE; i++)
+    {
+        TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+        TEST_ASSERT_EQUAL_MEMORY("abc", calls.payload, 3);
+    }
+
+    // Room in the queue, but the overflow list comes first
+    TEST_ASSERT_TRUE(call("last"));
+
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL(4, calls.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY("late", calls.payload, 4);
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL_MEMORY("later", calls.payload, 5);
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL_MEMORY("last", calls.payload, 4);
+
+    TEST_ASSERT_EQUAL(0, run_all());
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE + 3, calls.num_calls);
+    TEST_ASSERT_EQUAL(0, num_pool_buffers);
+}
+
+void full_queue_drops_notifications(void)
+{
+    req.type = GOLIOTH_COAP_REQUEST_OBSERVE;
+    req.observe.callback = get_cb;
+    req.observe.arg = &calls;
+
+    fill_queue();
+
+    TEST_ASSERT_FALSE(call("abc"));
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE, num_pool_buffers);
+
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE, run_all());
+    TEST_ASSERT_EQUAL(0, num_pool_buffers);
+}
+
+void notifications_wait_for_overflow_list(void)
+{
+    fill_queue();
+    TEST_ASSERT_TRUE(call("late"));
+
+    // Queueing the notification would overtake the completion in the overflow list
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    req.type = GOLIOTH_COAP_REQUEST_OBSERVE;
+    req.observe.callback = get_cb;
+    req.observe.arg = &calls;
+    TEST_ASSERT_FALSE(call("abc"));
+
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_CALLBACK_EXECUTOR_QUEUE_SIZE, run_all());
+    TEST_ASSERT_EQUAL_MEMORY("late", calls.payload, 4);
+
+    // Queued again once the overflow list is empty
+    TEST_ASSERT_TRUE(call("xyz"));
+    TEST_ASSERT_EQUAL(1, run_all());
+    TEST_ASSERT_EQUAL_MEMORY("xyz", calls.payload, 3);
+}
+
+void exhausted_pool_copies_completions_to_heap(void)
+{
+    pool_exhausted = true;
+
+    TEST_ASSERT_TRUE(call("abc"));
+    TEST_ASSERT_EQUAL(0, calls.num_calls);
+    TEST_ASSERT_EQUAL(0, num_pool_buffers);
+
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL(1, calls.num_calls);
+    TEST_ASSERT_EQUAL_MEMORY("abc", calls.payload, 3);
+}
+
+void exhausted_pool_drops_notifications(void)
+{
+    req.type = GOLIOTH_COAP_REQUEST_OBSERVE;
+    req.observe.callback = get_cb;
+    req.observe.arg = &calls;
+    pool_exhausted = true;
+
+    TEST_ASSERT_FALSE(call("abc"));
+
+    TEST_ASSERT_EQUAL(0, calls.num_calls);
+    TEST_ASSERT_FALSE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+}
+
+void flush_waits_for_queued_callbacks(void)
+{
+    call("abc");
+
+    golioth_callback_executor_flush(executor);
+
+    // The flush request is answered once the worker gets past the queued callback
+    struct golioth_sys_fake_sem *flushed = executor->flushed_sem;
+    TEST_ASSERT_EQUAL(0, flushed->count);
+    TEST_ASSERT_TRUE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL(1, calls.num_calls);
+    TEST_ASSERT_EQUAL(0, flushed->count);
+    TEST_ASSERT_FALSE(golioth_callback_executor_run_one(worker(req.request_class), 0));
+    TEST_ASSERT_EQUAL(1, flushed->count);
+}
+
+void shared_executor_lives_until_last_put(void)
+{
+    golioth_callback_executor_init();
+
+    struct golioth_callback_executor *first = golioth_callback_executor_get();
+    struct golioth_callback_executor *second = golioth_callback_executor_get();
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_EQUAL_PTR(first, second);
+
+    size_t destroyed = golioth_sys_fake_num_sems_destroyed;
+
+    golioth_callback_executor_put(first);
+    TEST_ASSERT_EQUAL(destroyed, golioth_sys_fake_num_sems_destroyed);
+
+    golioth_callback_executor_put(second);
+    TEST_ASSERT_GREATER_THAN(destroyed, golioth_sys_fake_num_sems_destroyed);
+
+    // A new executor is created for the next client
+    struct golioth_callback_executor *third = golioth_callback_executor_get();
+    TEST_ASSERT_NOT_NULL(third);
+    golioth_callback_executor_put(third);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(sync_requests_run_inline);
+    RUN_TEST(async_requests_are_queued_with_copies);
+    RUN_TEST(all_callback_types_are_queued);
+    RUN_TEST(requests_without_callback_are_skipped);
+    RUN_TEST(control_requests_run_inline);
+    RUN_TEST(full_queue_keeps_completions_in_order);
+    RUN_TEST(full_queue_drops_notifications);
+    RUN_TEST(notifications_wait_for_overflow_list);
+    RUN_TEST(exhausted_pool_copies_completions_to_heap);
+    RUN_TEST(exhausted_pool_drops_notifications);
+    RUN_TEST(flush_waits_for_queued_callbacks);
+    RUN_TEST(shared_executor_lives_until_last_put);
+    return UNITY_END();
+}
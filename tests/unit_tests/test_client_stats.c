@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "client_stats.h"
+
+static struct golioth_client_stats stats;
+static struct golioth_latency_histogram hist;
+
+void setUp(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    memset(&hist, 0, sizeof(hist));
+}
+
+void tearDown(void) {}
+
+void sub_millisecond_latency_goes_in_first_bucket(void)
+{
+    golioth_latency_histogram_add(&hist, 0);
+
+    TEST_ASSERT_EQUAL(1, hist.buckets[0]);
+    TEST_ASSERT_EQUAL(1, hist.count);
+    TEST_ASSERT_EQUAL(0, hist.sum_ms);
+    TEST_ASSERT_EQUAL(0, hist.max_ms);
+}
+
+void buckets_are_powers_of_two(void)
+{
+    // Bucket i holds [2^(i-1), 2^i)
+    golioth_latency_histogram_add(&hist, 1);
+    golioth_latency_histogram_add(&hist, 2);
+    golioth_latency_histogram_add(&hist, 3);
+    golioth_latency_histogram_add(&hist, 4);
+    golioth_latency_histogram_add(&hist, 1023);
+    golioth_latency_histogram_add(&hist, 1024);
+
+    TEST_ASSERT_EQUAL(0, hist.buckets[0]);
+    TEST_ASSERT_EQUAL(1, hist.buckets[1]);
+    TEST_ASSERT_EQUAL(2, hist.buckets[2]);
+    TEST_ASSERT_EQUAL(1, hist.buckets[3]);
+    TEST_ASSERT_EQUAL(1, hist.buckets[10]);
+    TEST_ASSERT_EQUAL(1, hist.buckets[11]);
+}
+
+void long_latencies_go_in_last_bucket(void)
+{
+    size_t last = GOLIOTH_LATENCY_HISTOGRAM_NUM_BUCKETS - 1;
+
+    golioth_latency_histogram_add(&hist, 1 << (last - 1));
+    golioth_latency_histogram_add(&hist, 1 << last);
+    golioth_latency_histogram_add(&hist, UINT64_MAX);
+
+    TEST_ASSERT_EQUAL(3, hist.buckets[last]);
+    TEST_ASSERT_EQUAL(UINT32_MAX, hist.max_ms);
+}
+
+void count_sum_and_max_are_tracked(void)
+{
+    golioth_latency_histogram_add(&hist, 10);
+    golioth_latency_histogram_add(&hist, 300);
+    golioth_latency_histogram_add(&hist, 20);
+
+    TEST_ASSERT_EQUAL(3, hist.count);
+    TEST_ASSERT_EQUAL(330, hist.sum_ms);
+    TEST_ASSERT_EQUAL(300, hist.max_ms);
+}
+
+void queue_latency_is_recorded_per_request_type(void)
+{
+    golioth_coap_request_msg_t req = {
+        .type = GOLIOTH_COAP_REQUEST_POST,
+        .enqueued_ms = 1000,
+    };
+
+    golioth_client_stats_request_sent(&stats, &req, 1005);
+
+    struct golioth_latency_histogram *queue_latency =
+        &stats.requests[GOLIOTH_CLIENT_STATS_REQUEST_POST].queue_latency;
+    TEST_ASSERT_EQUAL(1, queue_latency->count);
+    TEST_ASSERT_EQUAL(5, queue_latency->sum_ms);
+    TEST_ASSERT_EQUAL(0, stats.requests[GOLIOTH_CLIENT_STATS_REQUEST_POST].response_latency.count);
+    TEST_ASSERT_EQUAL(0, stats.requests[GOLIOTH_CLIENT_STATS_REQUEST_GET].queue_latency.count);
+}
+
+void response_latency_is_recorded_per_request_type(void)
+{
+    golioth_client_stats_response_received(&stats, GOLIOTH_COAP_REQUEST_GET_BLOCK, 2000, 2040);
+    golioth_client_stats_response_received(&stats, GOLIOTH_COAP_REQUEST_OBSERVE, 2000, 2100);
+
+    struct golioth_latency_histogram *get_block =
+        &stats.requests[GOLIOTH_CLIENT_STATS_REQUEST_GET_BLOCK].response_latency;
+    struct golioth_latency_histogram *observe =
+        &stats.requests[GOLIOTH_CLIENT_STATS_REQUEST_OBSERVE].response_latency;
+    TEST_ASSERT_EQUAL(1, get_block->count);
+    TEST_ASSERT_EQUAL(40, get_block->max_ms);
+    TEST_ASSERT_EQUAL(1, observe->count);
+    TEST_ASSERT_EQUAL(100, observe->max_ms);
+}
+
+void clock_going_backwards_is_ignored(void)
+{
+    golioth_coap_request_msg_t req = {
+        .type = GOLIOTH_COAP_REQUEST_DELETE,
+        .enqueued_ms = 1000,
+    };
+
+    golioth_client_stats_request_sent(&stats, &req, 999);
+    golioth_client_stats_response_received(&stats, GOLIOTH_COAP_REQUEST_DELETE, 1000, 999);
+
+    TEST_ASSERT_EQUAL(0, stats.requests[GOLIOTH_CLIENT_STATS_REQUEST_DELETE].queue_latency.count);
+    TEST_ASSERT_EQUAL(0,
+                      stats.requests[GOLIOTH_CLIENT_STATS_REQUEST_DELETE].response_latency.count);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(sub_millisecond_latency_goes_in_first_bucket);
+    RUN_TEST(buckets_are_powers_of_two);
+    RUN_TEST(long_latencies_go_in_last_bucket);
+    RUN_TEST(count_sum_and_max_are_tracked);
+    RUN_TEST(queue_latency_is_recorded_per_request_type);
+    RUN_TEST(response_latency_is_recorded_per_request_type);
+    RUN_TEST(clock_going_backwards_is_ignored);
+    return UNITY_END();
+}
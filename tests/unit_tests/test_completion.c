@@ -0,0 +1,107 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <golioth/golioth_sys.h>
+#include "completion.h"
+#include "fakes/golioth_sys_fake.h"
+
+#define RECEIVED_BIT (1 << 0)
+
+void setUp(void)
+{
+    golioth_completion_pool_init();
+}
+
+void tearDown(void) {}
+
+static void assert_sem_count(const struct golioth_completion *completion, uint32_t count)
+{
+    // The semaphore is the first member of the completion
+    const struct golioth_sys_fake_sem *sem = *(golioth_sys_sem_t *) completion;
+    TEST_ASSERT_EQUAL(count, sem->count);
+}
+
+void signaled_completion_returns_bits(void)
+{
+    struct golioth_completion *completion = golioth_completion_acquire();
+    TEST_ASSERT_NOT_NULL(completion);
+
+    golioth_completion_signal(completion, RECEIVED_BIT);
+    TEST_ASSERT_EQUAL(RECEIVED_BIT, golioth_completion_wait(completion, 1000));
+}
+
+void completions_are_reused(void)
+{
+    struct golioth_completion *first = golioth_completion_acquire();
+    golioth_completion_signal(first, RECEIVED_BIT);
+    golioth_completion_wait(first, 1000);
+
+    size_t created = golioth_sys_fake_num_sems_created;
+
+    struct golioth_completion *second = golioth_completion_acquire();
+    TEST_ASSERT_EQUAL_PTR(first, second);
+    TEST_ASSERT_EQUAL(created, golioth_sys_fake_num_sems_created);
+    assert_sem_count(second, 0);
+
+    golioth_completion_release(second);
+}
+
+void timed_out_completion_is_freed_by_signal(void)
+{
+    struct golioth_completion *completion = golioth_completion_acquire();
+    TEST_ASSERT_EQUAL(0, golioth_completion_wait(completion, 10));
+
+    // Not back in the pool until the CoAP thread is done with it
+    struct golioth_completion *other = golioth_completion_acquire();
+    TEST_ASSERT_NOT_EQUAL(completion, other);
+    golioth_completion_release(other);
+
+    golioth_completion_signal(completion, RECEIVED_BIT);
+
+    // The next acquire gets the same completion back, without a pending signal
+    struct golioth_completion *reused = golioth_completion_acquire();
+    TEST_ASSERT_EQUAL_PTR(completion, reused);
+    assert_sem_count(reused, 0);
+    TEST_ASSERT_EQUAL(0, golioth_completion_wait(reused, 10));
+    golioth_completion_signal(reused, RECEIVED_BIT);
+}
+
+void empty_pool_falls_back_to_heap(void)
+{
+    struct golioth_completion *completions[CONFIG_GOLIOTH_COAP_SYNC_COMPLETION_POOL_SIZE + 1];
+
+    for (size_t i = 0; i < CONFIG_GOLIOTH_COAP_SYNC_COMPLETION_POOL_SIZE + 1; i++)
+    {
+        completions[i] = golioth_completion_acquire();
+        TEST_ASSERT_NOT_NULL(completions[i]);
+    }
+
+    size_t destroyed = golioth_sys_fake_num_sems_destroyed;
+
+    for (size_t i = 0; i < CONFIG_GOLIOTH_COAP_SYNC_COMPLETION_POOL_SIZE + 1; i++)
+    {
+        golioth_completion_signal(completions[i], RECEIVED_BIT);
+        TEST_ASSERT_EQUAL(RECEIVED_BIT, golioth_completion_wait(completions[i], 1000));
+    }
+
+    // Only the heap allocated completion gives up its semaphore
+    TEST_ASSERT_EQUAL(destroyed + 1, golioth_sys_fake_num_sems_destroyed);
+}
+
+void signal_without_completion_does_nothing(void)
+{
+    golioth_completion_signal(NULL, RECEIVED_BIT);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(signaled_completion_returns_bits);
+    RUN_TEST(completions_are_reused);
+    RUN_TEST(timed_out_completion_is_freed_by_signal);
+    RUN_TEST(empty_pool_falls_back_to_heap);
+    RUN_TEST(signal_without_completion_does_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,140 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "deadline_heap.h"
+
+static struct golioth_deadline_heap heap;
+static struct golioth_deadline_heap_entry entries[64];
+
+void setUp(void)
+{
+    golioth_deadline_heap_init(&heap);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_deadline_heap_reserve(&heap, 4));
+
+    for (size_t i = 0; i < 64; i++)
+    {
+        golioth_deadline_heap_entry_init(&entries[i]);
+    }
+}
+
+void tearDown(void)
+{
+    golioth_deadline_heap_deinit(&heap);
+}
+
+static struct golioth_deadline_heap_entry *pop(void)
+{
+    struct golioth_deadline_heap_entry *entry = golioth_deadline_heap_peek(&heap);
+    TEST_ASSERT_NOT_NULL(entry);
+    golioth_deadline_heap_remove(&heap, entry);
+    return entry;
+}
+
+void peek_in_empty_heap_returns_null(void)
+{
+    TEST_ASSERT_NULL(golioth_deadline_heap_peek(&heap));
+    TEST_ASSERT_FALSE(golioth_deadline_heap_contains(&entries[0]));
+}
+
+void earliest_deadline_comes_first(void)
+{
+    golioth_deadline_heap_set(&heap, &entries[0], 300);
+    golioth_deadline_heap_set(&heap, &entries[1], 100);
+    golioth_deadline_heap_set(&heap, &entries[2], 200);
+
+    TEST_ASSERT_EQUAL_PTR(&entries[1], pop());
+    TEST_ASSERT_EQUAL_PTR(&entries[2], pop());
+    TEST_ASSERT_EQUAL_PTR(&entries[0], pop());
+    TEST_ASSERT_NULL(golioth_deadline_heap_peek(&heap));
+}
+
+void setting_an_entry_again_moves_it(void)
+{
+    golioth_deadline_heap_set(&heap, &entries[0], 100);
+    golioth_deadline_heap_set(&heap, &entries[1], 200);
+    golioth_deadline_heap_set(&heap, &entries[2], 300);
+
+    golioth_deadline_heap_set(&heap, &entries[0], 400);
+    TEST_ASSERT_EQUAL_PTR(&entries[1], golioth_deadline_heap_peek(&heap));
+
+    golioth_deadline_heap_set(&heap, &entries[2], 50);
+    TEST_ASSERT_EQUAL_PTR(&entries[2], golioth_deadline_heap_peek(&heap));
+    TEST_ASSERT_EQUAL(3, heap.count);
+}
+
+void removed_entry_is_not_in_heap(void)
+{
+    golioth_deadline_heap_set(&heap, &entries[0], 100);
+    golioth_deadline_heap_set(&heap, &entries[1], 200);
+    TEST_ASSERT_TRUE(golioth_deadline_heap_contains(&entries[0]));
+
+    golioth_deadline_heap_remove(&heap, &entries[0]);
+    TEST_ASSERT_FALSE(golioth_deadline_heap_contains(&entries[0]));
+    TEST_ASSERT_EQUAL_PTR(&entries[1], golioth_deadline_heap_peek(&heap));
+
+    // Removing again is a no-op
+    golioth_deadline_heap_remove(&heap, &entries[0]);
+    TEST_ASSERT_EQUAL(1, heap.count);
+}
+
+void reserve_keeps_entries(void)
+{
+    for (size_t i = 0; i < 4; i++)
+    {
+        golioth_deadline_heap_set(&heap, &entries[i], 40 - i);
+    }
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_deadline_heap_reserve(&heap, 64));
+    TEST_ASSERT_GREATER_OR_EQUAL(64, heap.capacity);
+
+    for (size_t i = 4; i < 64; i++)
+    {
+        golioth_deadline_heap_set(&heap, &entries[i], 1000 + i);
+    }
+
+    TEST_ASSERT_EQUAL_PTR(&entries[3], pop());
+    TEST_ASSERT_EQUAL_PTR(&entries[2], pop());
+}
+
+void random_operations_keep_heap_order(void)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_deadline_heap_reserve(&heap, 64));
+    srand(1);
+
+    for (size_t n = 0; n < 10000; n++)
+    {
+        struct golioth_deadline_heap_entry *entry = &entries[rand() % 64];
+        if (rand() % 4 == 0)
+        {
+            golioth_deadline_heap_remove(&heap, entry);
+        }
+        else
+        {
+            golioth_deadline_heap_set(&heap, entry, rand() % 1000);
+        }
+    }
+
+    size_t count = heap.count;
+    uint64_t last_deadline_ms = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        struct golioth_deadline_heap_entry *entry = pop();
+        TEST_ASSERT_GREATER_OR_EQUAL(last_deadline_ms, entry->deadline_ms);
+        last_deadline_ms = entry->deadline_ms;
+    }
+    TEST_ASSERT_NULL(golioth_deadline_heap_peek(&heap));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(peek_in_empty_heap_returns_null);
+    RUN_TEST(earliest_deadline_comes_first);
+    RUN_TEST(setting_an_entry_again_moves_it);
+    RUN_TEST(removed_entry_is_not_in_heap);
+    RUN_TEST(reserve_keeps_entries);
+    RUN_TEST(random_operations_keep_heap_order);
+    return UNITY_END();
+}
@@ -0,0 +1,134 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <golioth/config.h>
+#include "dns_cache.h"
+
+#define TTL_MS (1000 * (uint64_t) CONFIG_GOLIOTH_DNS_CACHE_TTL_S)
+
+static struct golioth_dns_cache cache;
+
+static struct golioth_dns_addr ipv4(uint8_t last)
+{
+    struct golioth_dns_addr addr = {.addr = {192, 0, 2, last}, .addr_len = 4};
+    return addr;
+}
+
+static struct golioth_dns_addr ipv6(uint8_t last)
+{
+    struct golioth_dns_addr addr = {.addr = {0x20, 0x01, 0x0d, 0xb8}, .addr_len = 16};
+    addr.addr[15] = last;
+    return addr;
+}
+
+static void assert_current(const struct golioth_dns_addr *expected)
+{
+    const struct golioth_dns_addr *addr = golioth_dns_cache_current(&cache);
+
+    TEST_ASSERT_NOT_NULL(addr);
+    TEST_ASSERT_EQUAL(expected->addr_len, addr->addr_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->addr, addr->addr, addr->addr_len);
+}
+
+void setUp(void)
+{
+    golioth_dns_cache_init(&cache);
+}
+
+void tearDown(void) {}
+
+void empty_cache_is_not_fresh(void)
+{
+    TEST_ASSERT_FALSE(golioth_dns_cache_is_fresh(&cache, 0));
+    TEST_ASSERT_NULL(golioth_dns_cache_current(&cache));
+
+    // Nothing to rotate
+    golioth_dns_cache_failed(&cache);
+    TEST_ASSERT_NULL(golioth_dns_cache_current(&cache));
+}
+
+void addresses_are_fresh_until_ttl(void)
+{
+    struct golioth_dns_addr addr = ipv4(1);
+
+    golioth_dns_cache_store(&cache, &addr, 1, 1000);
+
+    TEST_ASSERT_TRUE(golioth_dns_cache_is_fresh(&cache, 1000));
+    TEST_ASSERT_TRUE(golioth_dns_cache_is_fresh(&cache, 1000 + TTL_MS - 1));
+    TEST_ASSERT_FALSE(golioth_dns_cache_is_fresh(&cache, 1000 + TTL_MS));
+
+    // Stale addresses are still available as a fallback
+    assert_current(&addr);
+}
+
+void families_are_interleaved(void)
+{
+    struct golioth_dns_addr addrs[] = {ipv6(1), ipv6(2), ipv6(3), ipv4(1), ipv4(2)};
+
+    golioth_dns_cache_store(&cache, addrs, 5, 0);
+
+    TEST_ASSERT_EQUAL(GOLIOTH_DNS_CACHE_MAX_ADDRS, cache.num_addrs);
+    TEST_ASSERT_EQUAL_MEMORY(&addrs[0], &cache.addrs[0], sizeof(addrs[0]));
+    TEST_ASSERT_EQUAL_MEMORY(&addrs[3], &cache.addrs[1], sizeof(addrs[0]));
+    TEST_ASSERT_EQUAL_MEMORY(&addrs[1], &cache.addrs[2], sizeof(addrs[0]));
+    TEST_ASSERT_EQUAL_MEMORY(&addrs[4], &cache.addrs[3], sizeof(addrs[0]));
+}
+
+void invalid_addresses_are_skipped(void)
+{
+    struct golioth_dns_addr addrs[] = {ipv4(1), ipv4(2)};
+    addrs[0].addr_len = 7;
+
+    golioth_dns_cache_store(&cache, addrs, 2, 0);
+    TEST_ASSERT_EQUAL(1, cache.num_addrs);
+    assert_current(&addrs[1]);
+
+    addrs[1].addr_len = 0;
+    golioth_dns_cache_store(&cache, addrs, 2, 0);
+    TEST_ASSERT_FALSE(golioth_dns_cache_is_fresh(&cache, 0));
+    TEST_ASSERT_NULL(golioth_dns_cache_current(&cache));
+}
+
+void failed_address_moves_to_next(void)
+{
+    struct golioth_dns_addr addrs[] = {ipv4(1), ipv6(1)};
+
+    golioth_dns_cache_store(&cache, addrs, 2, 0);
+
+    golioth_dns_cache_failed(&cache);
+    assert_current(&addrs[1]);
+    TEST_ASSERT_TRUE(golioth_dns_cache_is_fresh(&cache, 0));
+
+    // A working address is kept, and resets the failure count
+    golioth_dns_cache_connected(&cache);
+    golioth_dns_cache_failed(&cache);
+    assert_current(&addrs[0]);
+    TEST_ASSERT_TRUE(golioth_dns_cache_is_fresh(&cache, 0));
+}
+
+void all_addresses_failing_makes_cache_stale(void)
+{
+    struct golioth_dns_addr addrs[] = {ipv4(1), ipv6(1)};
+
+    golioth_dns_cache_store(&cache, addrs, 2, 0);
+
+    golioth_dns_cache_failed(&cache);
+    golioth_dns_cache_failed(&cache);
+
+    TEST_ASSERT_FALSE(golioth_dns_cache_is_fresh(&cache, 0));
+    assert_current(&addrs[0]);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(empty_cache_is_not_fresh);
+    RUN_TEST(addresses_are_fresh_until_ttl);
+    RUN_TEST(families_are_interleaved);
+    RUN_TEST(invalid_addresses_are_skipped);
+    RUN_TEST(failed_address_moves_to_next);
+    RUN_TEST(all_addresses_failing_makes_cache_stale);
+    return UNITY_END();
+}
@@ -0,0 +1,235 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <golioth/golioth_sys.h>
+#include "mbox.h"
+#include "fakes/golioth_sys_fake.h"
+
+// Messages take up 32 bytes in the ring, so a lane with weight 1 gets 4 per round
+#define MSG_LEN 28
+
+static golioth_mbox_t mbox;
+
+void setUp(void) {}
+
+void tearDown(void)
+{
+    if (mbox)
+    {
+        golioth_mbox_destroy(mbox);
+        mbox = NULL;
+    }
+}
+
+static bool send(size_t lane, uint8_t seq)
+{
+    uint8_t msg[MSG_LEN] = {(uint8_t) lane, seq};
+    struct golioth_mbox_part part = {msg, sizeof(msg)};
+    return golioth_mbox_try_send_parts(mbox, lane, &part, 1);
+}
+
+// Receive a message, and return its lane. Checks that messages within a lane are in order.
+static size_t recv(uint8_t *next_seq)
+{
+    size_t len;
+    const uint8_t *msg = golioth_mbox_peek(mbox, &len, 0);
+    TEST_ASSERT_NOT_NULL(msg);
+    TEST_ASSERT_EQUAL(MSG_LEN, len);
+
+    size_t lane = msg[0];
+    TEST_ASSERT_EQUAL(next_seq[lane]++, msg[1]);
+
+    golioth_mbox_release(mbox);
+    return lane;
+}
+
+void lanes_keep_their_own_order(void)
+{
+    struct golioth_mbox_lane_config lanes[] = {
+        {.max_num_items = 4, .buffer_size = 256, .weight = 1},
+        {.max_num_items = 4, .buffer_size = 256, .weight = 1},
+    };
+    mbox = golioth_mbox_create_varlen(8, lanes, 2);
+
+    TEST_ASSERT_TRUE(send(1, 0));
+    TEST_ASSERT_TRUE(send(0, 0));
+    TEST_ASSERT_TRUE(send(1, 1));
+    TEST_ASSERT_TRUE(send(0, 1));
+    TEST_ASSERT_EQUAL(4, golioth_mbox_num_messages(mbox));
+    TEST_ASSERT_EQUAL(2, golioth_mbox_num_lane_messages(mbox, 1));
+
+    uint8_t next_seq[2] = {0};
+    for (int i = 0; i < 4; i++)
+    {
+        recv(next_seq);
+    }
+
+    TEST_ASSERT_EQUAL(0, golioth_mbox_num_messages(mbox));
+    size_t len;
+    TEST_ASSERT_NULL(golioth_mbox_peek(mbox, &len, 0));
+}
+
+void lane_and_total_depth_limits(void)
+{
+    struct golioth_mbox_lane_config lanes[] = {
+        {.max_num_items = 2, .buffer_size = 256, .weight = 1},
+        {.max_num_items = 4, .buffer_size = 256, .weight = 1},
+    };
+    mbox = golioth_mbox_create_varlen(5, lanes, 2);
+
+    TEST_ASSERT_TRUE(send(0, 0));
+    TEST_ASSERT_TRUE(send(0, 1));
+    TEST_ASSERT_FALSE(send(0, 2));
+
+    // A full lane does not block the other lanes
+    TEST_ASSERT_TRUE(send(1, 0));
+    TEST_ASSERT_TRUE(send(1, 1));
+    TEST_ASSERT_TRUE(send(1, 2));
+
+    // But the mbox as a whole is full
+    TEST_ASSERT_FALSE(send(1, 3));
+}
+
+void busy_lanes_share_by_weight(void)
+{
+    struct golioth_mbox_lane_config lanes[] = {
+        {.max_num_items = 16, .buffer_size = 1024, .weight = 3},
+        {.max_num_items = 16, .buffer_size = 1024, .weight = 1},
+    };
+    mbox = golioth_mbox_create_varlen(32, lanes, 2);
+
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        TEST_ASSERT_TRUE(send(0, i));
+        TEST_ASSERT_TRUE(send(1, i));
+    }
+
+    uint8_t next_seq[2] = {0};
+    size_t per_lane[2] = {0};
+    for (int i = 0; i < 16; i++)
+    {
+        per_lane[recv(next_seq)]++;
+    }
+    TEST_ASSERT_EQUAL(12, per_lane[0]);
+    TEST_ASSERT_EQUAL(4, per_lane[1]);
+
+    // The low weight lane still gets everything through
+    for (int i = 0; i < 16; i++)
+    {
+        recv(next_seq);
+    }
+    TEST_ASSERT_EQUAL(16, next_seq[0]);
+    TEST_ASSERT_EQUAL(16, next_seq[1]);
+}
+
+void idle_lane_does_not_save_up(void)
+{
+    struct golioth_mbox_lane_config lanes[] = {
+        {.max_num_items = 16, .buffer_size = 1024, .weight = 1},
+        {.max_num_items = 16, .buffer_size = 1024, .weight = 1},
+    };
+    mbox = golioth_mbox_create_varlen(32, lanes, 2);
+    uint8_t next_seq[2] = {0};
+
+    // Lane 1 is idle while lane 0 is served for a while
+    for (uint8_t i = 0; i < 12; i++)
+    {
+        TEST_ASSERT_TRUE(send(0, i));
+        TEST_ASSERT_EQUAL(0, recv(next_seq));
+    }
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_TRUE(send(0, 12 + i));
+        TEST_ASSERT_TRUE(send(1, i));
+    }
+
+    // Once both are busy, lane 1 gets no more than its share
+    size_t per_lane[2] = {0};
+    for (int i = 0; i < 8; i++)
+    {
+        per_lane[recv(next_seq)]++;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(4, per_lane[1]);
+}
+
+void fixed_size_items(void)
+{
+    mbox = golioth_mbox_create(3, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_TRUE(golioth_mbox_try_send(mbox, &i));
+    }
+    uint32_t item = 3;
+    TEST_ASSERT_FALSE(golioth_mbox_try_send(mbox, &item));
+    TEST_ASSERT_EQUAL(3, golioth_mbox_num_messages(mbox));
+
+    // Wrap around a few times
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_TRUE(golioth_mbox_recv(mbox, &item, 0));
+        TEST_ASSERT_EQUAL(i, item);
+        item = i + 3;
+        TEST_ASSERT_TRUE(golioth_mbox_try_send(mbox, &item));
+    }
+
+    for (uint32_t i = 10; i < 13; i++)
+    {
+        TEST_ASSERT_TRUE(golioth_mbox_recv(mbox, &item, 0));
+        TEST_ASSERT_EQUAL(i, item);
+    }
+    TEST_ASSERT_FALSE(golioth_mbox_recv(mbox, &item, 0));
+}
+
+void send_wakes_consumer_only_when_waiting(void)
+{
+    struct golioth_mbox_lane_config lanes[] = {
+        {.max_num_items = 8, .buffer_size = 512, .weight = 1},
+    };
+    mbox = golioth_mbox_create_varlen(8, lanes, 1);
+    struct golioth_sys_fake_sem *sem = mbox->fill_count_sem;
+    uint8_t next_seq[1] = {0};
+
+    // Consumer is not waiting
+    TEST_ASSERT_TRUE(send(0, 0));
+    TEST_ASSERT_EQUAL(0, sem->num_gives);
+
+    // A message is there already, so the fd is readable right away
+    TEST_ASSERT_EQUAL(GOLIOTH_SYS_FAKE_SEM_FD, golioth_mbox_wait_fd(mbox));
+    TEST_ASSERT_EQUAL(1, sem->count);
+    recv(next_seq);
+
+    // The next wait clears the wakeup, then only the first send wakes the consumer
+    golioth_mbox_wait_fd(mbox);
+    TEST_ASSERT_EQUAL(0, sem->count);
+    TEST_ASSERT_TRUE(send(0, 1));
+    TEST_ASSERT_TRUE(send(0, 2));
+    TEST_ASSERT_EQUAL(1, sem->count);
+    TEST_ASSERT_EQUAL(2, sem->num_gives);
+
+    recv(next_seq);
+    recv(next_seq);
+    golioth_mbox_wait_fd(mbox);
+    TEST_ASSERT_EQUAL(0, sem->count);
+
+    // Still waiting, so waiting again changes nothing
+    golioth_mbox_wait_fd(mbox);
+    TEST_ASSERT_EQUAL(0, sem->count);
+    TEST_ASSERT_EQUAL(2, sem->num_gives);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(lanes_keep_their_own_order);
+    RUN_TEST(lane_and_total_depth_limits);
+    RUN_TEST(busy_lanes_share_by_weight);
+    RUN_TEST(idle_lane_does_not_save_up);
+    RUN_TEST(fixed_size_items);
+    RUN_TEST(send_wakes_consumer_only_when_waiting);
+    return UNITY_END();
+}
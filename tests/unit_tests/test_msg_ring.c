@@ -0,0 +1,263 @@
+#include <unity.h>
+#include <fff.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "msg_ring.h"
+
+static _Alignas(uint32_t) uint8_t buffer[64];
+static msg_ring_t ring;
+
+void setUp(void)
+{
+    memset(buffer, 0, sizeof(buffer));
+    msg_ring_init(&ring, buffer, sizeof(buffer));
+}
+
+void tearDown(void) {}
+
+static bool put(const void *data, size_t len)
+{
+    void *msg = msg_ring_reserve(&ring, len);
+    if (!msg)
+    {
+        return false;
+    }
+    memcpy(msg, data, len);
+    msg_ring_commit(&ring, msg);
+    return true;
+}
+
+static void expect(const void *data, size_t len)
+{
+    size_t msg_len;
+    const void *msg = msg_ring_peek(&ring, &msg_len);
+    TEST_ASSERT_NOT_NULL(msg);
+    TEST_ASSERT_EQUAL(len, msg_len);
+    TEST_ASSERT_EQUAL_MEMORY(data, msg, len);
+    TEST_ASSERT_TRUE(msg_ring_consume(&ring));
+}
+
+void empty_ring_has_no_messages(void)
+{
+    size_t len;
+    TEST_ASSERT_TRUE(msg_ring_is_empty(&ring));
+    TEST_ASSERT_EQUAL(0, msg_ring_size(&ring));
+    TEST_ASSERT_NULL(msg_ring_peek(&ring, &len));
+    TEST_ASSERT_FALSE(msg_ring_consume(&ring));
+}
+
+void messages_come_out_in_order(void)
+{
+    TEST_ASSERT_TRUE(put("a", 1));
+    TEST_ASSERT_TRUE(put("hello", 5));
+    TEST_ASSERT_TRUE(put("", 0));
+    TEST_ASSERT_EQUAL(3, msg_ring_size(&ring));
+
+    expect("a", 1);
+    expect("hello", 5);
+    expect("", 0);
+    TEST_ASSERT_TRUE(msg_ring_is_empty(&ring));
+}
+
+void uncommitted_message_is_not_visible(void)
+{
+    size_t len;
+    TEST_ASSERT_NOT_NULL(msg_ring_reserve(&ring, 8));
+    TEST_ASSERT_NULL(msg_ring_peek(&ring, &len));
+    TEST_ASSERT_EQUAL(0, msg_ring_size(&ring));
+}
+
+void messages_keep_reserve_order(void)
+{
+    size_t len;
+    void *first = msg_ring_reserve(&ring, 1);
+    void *second = msg_ring_reserve(&ring, 1);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(second);
+    memcpy(first, "a", 1);
+    memcpy(second, "b", 1);
+
+    // The second message waits for the first one
+    msg_ring_commit(&ring, second);
+    TEST_ASSERT_NULL(msg_ring_peek(&ring, &len));
+
+    msg_ring_commit(&ring, first);
+    expect("a", 1);
+    expect("b", 1);
+    TEST_ASSERT_TRUE(msg_ring_is_empty(&ring));
+}
+
+void reserve_fails_when_full(void)
+{
+    uint8_t data[12] = {0};
+
+    // Each message takes 16 bytes, and 4 bytes are always kept free
+    TEST_ASSERT_TRUE(put(data, sizeof(data)));
+    TEST_ASSERT_TRUE(put(data, sizeof(data)));
+    TEST_ASSERT_TRUE(put(data, sizeof(data)));
+    TEST_ASSERT_FALSE(put(data, sizeof(data)));
+    TEST_ASSERT_TRUE(put(data, 8));
+    TEST_ASSERT_FALSE(put(data, 0));
+    TEST_ASSERT_EQUAL(4, msg_ring_size(&ring));
+
+    // Freeing the first message makes room for a smaller one at the start
+    expect(data, sizeof(data));
+    TEST_ASSERT_FALSE(put(data, sizeof(data)));
+    TEST_ASSERT_TRUE(put(data, 8));
+}
+
+void message_is_never_split(void)
+{
+    uint8_t data[40];
+    for (size_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = i;
+    }
+
+    TEST_ASSERT_TRUE(put(data, 20));
+    TEST_ASSERT_TRUE(put(data, 20));
+    expect(data, 20);
+
+    // 16 bytes left at the end of the buffer, so this goes in front
+    TEST_ASSERT_TRUE(put(data, 16));
+    expect(data, 20);
+
+    size_t len;
+    TEST_ASSERT_EQUAL_PTR(&buffer[4], msg_ring_peek(&ring, &len));
+    expect(data, 16);
+    TEST_ASSERT_TRUE(msg_ring_is_empty(&ring));
+}
+
+void wrapped_message_needs_room_before_reader(void)
+{
+    uint8_t data[40] = {0};
+
+    TEST_ASSERT_TRUE(put(data, 20));
+    TEST_ASSERT_TRUE(put(data, 20));
+    expect(data, 20);
+
+    // Only 24 bytes free before the reader, and 16 after the writer
+    TEST_ASSERT_FALSE(put(data, 20));
+    TEST_ASSERT_TRUE(put(data, 16));
+}
+
+void survives_many_wraps(void)
+{
+    uint8_t data[23];
+    uint8_t next = 0;
+    uint8_t expected = 0;
+
+    for (int round = 0; round < 500; round++)
+    {
+        size_t len = (round * 7) % sizeof(data);
+
+        while (true)
+        {
+            memset(data, next, len);
+            if (!put(data, len))
+            {
+                break;
+            }
+            next++;
+        }
+
+        size_t msg_len;
+        const uint8_t *msg = msg_ring_peek(&ring, &msg_len);
+        TEST_ASSERT_NOT_NULL(msg);
+        for (size_t i = 0; i < msg_len; i++)
+        {
+            TEST_ASSERT_EQUAL(expected, msg[i]);
+        }
+        TEST_ASSERT_TRUE(msg_ring_consume(&ring));
+        expected++;
+    }
+}
+
+#define NUM_PRODUCERS 4
+#define MSGS_PER_PRODUCER 5000
+
+static void *producer(void *arg)
+{
+    uint32_t msg[2] = {(uintptr_t) arg, 0};
+
+    while (msg[1] < MSGS_PER_PRODUCER)
+    {
+        // Vary the length, so messages wrap around at different places
+        size_t len = (msg[1] % 2) ? sizeof(msg) : sizeof(msg[0]) + 1;
+        uint8_t *dst = msg_ring_reserve(&ring, len);
+        if (!dst)
+        {
+            sched_yield();
+            continue;
+        }
+        memcpy(dst, msg, (len < sizeof(msg)) ? len : sizeof(msg));
+        msg_ring_commit(&ring, dst);
+        msg[1]++;
+    }
+
+    return NULL;
+}
+
+void concurrent_producers(void)
+{
+    pthread_t threads[NUM_PRODUCERS];
+    uint32_t next_seq[NUM_PRODUCERS] = {0};
+    uint32_t num_received = 0;
+
+    for (uintptr_t i = 0; i < NUM_PRODUCERS; i++)
+    {
+        TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, producer, (void *) i));
+    }
+
+    while (num_received < NUM_PRODUCERS * MSGS_PER_PRODUCER)
+    {
+        size_t len;
+        const uint8_t *msg = msg_ring_peek(&ring, &len);
+        if (!msg)
+        {
+            sched_yield();
+            continue;
+        }
+
+        // Each producer's messages come out in order, and only once
+        uint32_t id;
+        memcpy(&id, msg, sizeof(id));
+        TEST_ASSERT_LESS_THAN(NUM_PRODUCERS, id);
+        if (len == 2 * sizeof(uint32_t))
+        {
+            uint32_t seq;
+            memcpy(&seq, &msg[sizeof(id)], sizeof(seq));
+            TEST_ASSERT_EQUAL(next_seq[id], seq);
+        }
+        next_seq[id]++;
+        num_received++;
+
+        TEST_ASSERT_TRUE(msg_ring_consume(&ring));
+    }
+
+    for (int i = 0; i < NUM_PRODUCERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        TEST_ASSERT_EQUAL(MSGS_PER_PRODUCER, next_seq[i]);
+    }
+    TEST_ASSERT_TRUE(msg_ring_is_empty(&ring));
+    TEST_ASSERT_EQUAL(0, msg_ring_size(&ring));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(empty_ring_has_no_messages);
+    RUN_TEST(messages_come_out_in_order);
+    RUN_TEST(uncommitted_message_is_not_visible);
+    RUN_TEST(messages_keep_reserve_order);
+    RUN_TEST(reserve_fails_when_full);
+    RUN_TEST(message_is_never_split);
+    RUN_TEST(wrapped_message_needs_room_before_reader);
+    RUN_TEST(survives_many_wraps);
+    RUN_TEST(concurrent_producers);
+    return UNITY_END();
+}
@@ -0,0 +1,114 @@
+#include <unity.h>
+#include <fff.h>
+#include <string.h>
+
+#include "path_handle.h"
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void assert_segment(const struct golioth_path *path, size_t index, const char *expected)
+{
+    TEST_ASSERT_EQUAL(strlen(expected), path->segment_lens[index]);
+    TEST_ASSERT_EQUAL_STRING(expected, (const char *) path->segments[index]);
+}
+
+void prefix_and_path_are_split_into_segments(void)
+{
+    struct golioth_path *path = golioth_path_create(".s/", "sensors/temp");
+    TEST_ASSERT_NOT_NULL(path);
+
+    TEST_ASSERT_EQUAL(3, path->num_segments);
+    assert_segment(path, 0, ".s");
+    assert_segment(path, 1, "sensors");
+    assert_segment(path, 2, "temp");
+    TEST_ASSERT_NULL(path->segments[3]);
+    TEST_ASSERT_EQUAL_STRING(".s/sensors/temp", path->str);
+
+    golioth_path_destroy(path);
+}
+
+void empty_segments_are_skipped(void)
+{
+    struct golioth_path *path = golioth_path_create("/.d/", "/a//b/");
+    TEST_ASSERT_NOT_NULL(path);
+
+    TEST_ASSERT_EQUAL(3, path->num_segments);
+    assert_segment(path, 0, ".d");
+    assert_segment(path, 1, "a");
+    assert_segment(path, 2, "b");
+    TEST_ASSERT_NULL(path->segments[3]);
+
+    golioth_path_destroy(path);
+}
+
+void segment_can_span_prefix_and_path(void)
+{
+    struct golioth_path *path = golioth_path_create(".d", "x/y");
+    TEST_ASSERT_NOT_NULL(path);
+
+    TEST_ASSERT_EQUAL(2, path->num_segments);
+    assert_segment(path, 0, ".dx");
+    assert_segment(path, 1, "y");
+
+    golioth_path_destroy(path);
+}
+
+void empty_path_has_no_segments(void)
+{
+    struct golioth_path *path = golioth_path_create(NULL, "");
+    TEST_ASSERT_NOT_NULL(path);
+
+    TEST_ASSERT_EQUAL(0, path->num_segments);
+    TEST_ASSERT_NULL(path->segments[0]);
+    TEST_ASSERT_EQUAL_STRING("", path->str);
+
+    golioth_path_destroy(path);
+}
+
+void long_segment_is_rejected(void)
+{
+    char long_path[300];
+
+    memset(long_path, 'a', 255);
+    long_path[255] = '\0';
+    struct golioth_path *path = golioth_path_create(".s/", long_path);
+    TEST_ASSERT_NOT_NULL(path);
+    TEST_ASSERT_EQUAL(255, path->segment_lens[1]);
+    golioth_path_destroy(path);
+
+    memset(long_path, 'a', 256);
+    long_path[256] = '\0';
+    TEST_ASSERT_NULL(golioth_path_create(".s/", long_path));
+}
+
+void delivery_mode_defaults_to_confirmable(void)
+{
+    struct golioth_path *path = golioth_path_create(".s/", "sensors");
+    TEST_ASSERT_NOT_NULL(path);
+    TEST_ASSERT_EQUAL(GOLIOTH_DELIVERY_CONFIRMABLE, path->delivery_mode);
+
+    golioth_path_set_delivery_mode(path, GOLIOTH_DELIVERY_NO_RESPONSE);
+    TEST_ASSERT_EQUAL(GOLIOTH_DELIVERY_NO_RESPONSE, path->delivery_mode);
+
+    golioth_path_destroy(path);
+}
+
+void null_path_is_rejected(void)
+{
+    TEST_ASSERT_NULL(golioth_path_create(".s/", NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(prefix_and_path_are_split_into_segments);
+    RUN_TEST(empty_segments_are_skipped);
+    RUN_TEST(segment_can_span_prefix_and_path);
+    RUN_TEST(empty_path_has_no_segments);
+    RUN_TEST(long_segment_is_rejected);
+    RUN_TEST(delivery_mode_defaults_to_confirmable);
+    RUN_TEST(null_path_is_rejected);
+    return UNITY_END();
+}
@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <golioth/golioth_sys.h>
+#include "payload_pool.h"
+#include "fakes/golioth_sys_fake.h"
+
+#define SMALL 0
+#define MEDIUM 1
+#define LARGE 2
+
+static struct golioth_payload_pool_stats before;
+static size_t failed_takes_before;
+static size_t failed_gives_before;
+
+void setUp(void)
+{
+    golioth_payload_pool_init();
+    golioth_payload_pool_get_stats(&before);
+    failed_takes_before = golioth_sys_fake_num_failed_takes;
+    failed_gives_before = golioth_sys_fake_num_failed_gives;
+}
+
+void tearDown(void)
+{
+    // The pool lock is only taken when free, and only given back when taken
+    TEST_ASSERT_EQUAL(failed_takes_before, golioth_sys_fake_num_failed_takes);
+    TEST_ASSERT_EQUAL(failed_gives_before, golioth_sys_fake_num_failed_gives);
+
+    // Every test must give back all its blocks
+    struct golioth_payload_pool_stats stats;
+    golioth_payload_pool_get_stats(&stats);
+    for (size_t i = 0; i < GOLIOTH_PAYLOAD_POOL_NUM_CLASSES; i++)
+    {
+        TEST_ASSERT_EQUAL(0, stats.classes[i].in_use);
+    }
+}
+
+static uint32_t allocs_since_setup(size_t class_idx)
+{
+    struct golioth_payload_pool_stats stats;
+    golioth_payload_pool_get_stats(&stats);
+    return stats.classes[class_idx].num_allocs - before.classes[class_idx].num_allocs;
+}
+
+static uint32_t spills_since_setup(size_t class_idx)
+{
+    struct golioth_payload_pool_stats stats;
+    golioth_payload_pool_get_stats(&stats);
+    return stats.classes[class_idx].num_spills - before.classes[class_idx].num_spills;
+}
+
+static uint32_t heap_allocs_since_setup(void)
+{
+    struct golioth_payload_pool_stats stats;
+    golioth_payload_pool_get_stats(&stats);
+    return stats.num_heap_allocs - before.num_heap_allocs;
+}
+
+void classes_match_config(void)
+{
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE,
+                      before.classes[SMALL].block_size);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS,
+                      before.classes[SMALL].num_blocks);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE,
+                      before.classes[MEDIUM].block_size);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS,
+                      before.classes[MEDIUM].num_blocks);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE,
+                      before.classes[LARGE].block_size);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS,
+                      before.classes[LARGE].num_blocks);
+}
+
+void alloc_uses_smallest_fitting_class(void)
+{
+    void *small = golioth_payload_pool_alloc(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE);
+    void *medium = golioth_payload_pool_alloc(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE + 1);
+    void *large = golioth_payload_pool_alloc(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE);
+
+    TEST_ASSERT_NOT_NULL(small);
+    TEST_ASSERT_NOT_NULL(medium);
+    TEST_ASSERT_NOT_NULL(large);
+    TEST_ASSERT_EQUAL(1, allocs_since_setup(SMALL));
+    TEST_ASSERT_EQUAL(1, allocs_since_setup(MEDIUM));
+    TEST_ASSERT_EQUAL(1, allocs_since_setup(LARGE));
+    TEST_ASSERT_EQUAL(0, heap_allocs_since_setup());
+
+    // Blocks must be usable in full
+    memset(small, 0xAA, CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE);
+    memset(medium, 0xBB, CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE + 1);
+    memset(large, 0xCC, CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE);
+
+    golioth_payload_pool_free(small);
+    golioth_payload_pool_free(medium);
+    golioth_payload_pool_free(large);
+}
+
+void freed_block_is_reused(void)
+{
+    void *first = golioth_payload_pool_alloc(1);
+    golioth_payload_pool_free(first);
+
+    void *second = golioth_payload_pool_alloc(1);
+    TEST_ASSERT_EQUAL_PTR(first, second);
+    golioth_payload_pool_free(second);
+}
+
+void exhausted_class_spills_to_larger_class(void)
+{
+    void *blocks[CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS];
+
+    for (size_t i = 0; i < CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS; i++)
+    {
+        blocks[i] = golioth_payload_pool_alloc(1);
+        TEST_ASSERT_NOT_NULL(blocks[i]);
+    }
+    TEST_ASSERT_EQUAL(0, spills_since_setup(SMALL));
+
+    void *spilled = golioth_payload_pool_alloc(1);
+    TEST_ASSERT_NOT_NULL(spilled);
+    TEST_ASSERT_EQUAL(1, spills_since_setup(SMALL));
+    TEST_ASSERT_EQUAL(1, allocs_since_setup(MEDIUM));
+
+    struct golioth_payload_pool_stats stats;
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS,
+                      stats.classes[SMALL].in_use);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS,
+                      stats.classes[SMALL].max_in_use);
+
+    golioth_payload_pool_free(spilled);
+    for (size_t i = 0; i < CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS; i++)
+    {
+        golioth_payload_pool_free(blocks[i]);
+    }
+}
+
+void exhausted_pool_falls_back_to_heap(void)
+{
+    void *blocks[CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS];
+
+    for (size_t i = 0; i < CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS; i++)
+    {
+        blocks[i] = golioth_payload_pool_alloc(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE);
+    }
+
+    uint8_t *heap = golioth_payload_pool_alloc(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE);
+    TEST_ASSERT_NOT_NULL(heap);
+    TEST_ASSERT_EQUAL(1, heap_allocs_since_setup());
+    TEST_ASSERT_EQUAL(1, spills_since_setup(LARGE));
+    memset(heap, 0, CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE);
+
+    golioth_payload_pool_free(heap);
+    for (size_t i = 0; i < CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS; i++)
+    {
+        golioth_payload_pool_free(blocks[i]);
+    }
+}
+
+void oversized_alloc_uses_heap(void)
+{
+    void *heap = golioth_payload_pool_alloc(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE + 1);
+    TEST_ASSERT_NOT_NULL(heap);
+    TEST_ASSERT_EQUAL(1, heap_allocs_since_setup());
+    TEST_ASSERT_EQUAL(0, spills_since_setup(LARGE));
+    golioth_payload_pool_free(heap);
+}
+
+void release_returns_block_to_pool(void)
+{
+    uint8_t *payload = golioth_payload_pool_alloc(8);
+    golioth_payload_pool_release(payload, 8, NULL);
+
+    struct golioth_payload_pool_stats stats;
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.classes[SMALL].in_use);
+}
+
+void free_null_is_noop(void)
+{
+    golioth_payload_pool_free(NULL);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(classes_match_config);
+    RUN_TEST(alloc_uses_smallest_fitting_class);
+    RUN_TEST(freed_block_is_reused);
+    RUN_TEST(exhausted_class_spills_to_larger_class);
+    RUN_TEST(exhausted_pool_falls_back_to_heap);
+    RUN_TEST(oversized_alloc_uses_heap);
+    RUN_TEST(release_returns_block_to_pool);
+    RUN_TEST(free_null_is_noop);
+    return UNITY_END();
+}
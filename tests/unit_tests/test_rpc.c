@@ -31,6 +31,7 @@ uint8_t last_coap_payload[256];
 size_t last_coap_payload_size;
 
 enum golioth_status golioth_coap_client_set_custom_fake(struct golioth_client *client,
+                                                        golioth_coap_request_class_t request_class,
                                                         const char *path_prefix,
                                                         const char *path,
                                                         uint32_t content_type,
@@ -213,6 +214,7 @@ void test_rpc_call_not_registered(void)
 
     TEST_ASSERT_EQUAL_STRING("Method %.*s not registered", last_wrn_msg);
     TEST_ASSERT_EQUAL(1, golioth_coap_client_set_fake.call_count);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_REQUEST_CLASS_RPC, golioth_coap_client_set_fake.arg1_val);
 
     const uint8_t expected[] = {
         0xBF,                                                       /* map(*) */
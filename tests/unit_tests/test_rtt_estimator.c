@@ -0,0 +1,127 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+
+#include "rtt_estimator.h"
+
+static struct golioth_rtt_estimator est;
+
+void setUp(void)
+{
+    golioth_rtt_estimator_init(&est, GOLIOTH_RTT_INITIAL_RTO_MS);
+}
+
+void tearDown(void) {}
+
+void initial_rto_is_used_until_first_sample(void)
+{
+    struct golioth_client_rtt rtt;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_RTT_INITIAL_RTO_MS, golioth_rtt_estimator_rto_ms(&est, 100000));
+
+    golioth_rtt_estimator_get(&est, &rtt);
+    TEST_ASSERT_EQUAL(0, rtt.num_samples);
+    TEST_ASSERT_EQUAL(0, rtt.srtt_ms);
+    TEST_ASSERT_EQUAL(GOLIOTH_RTT_INITIAL_RTO_MS, rtt.rto_ms);
+}
+
+void first_strong_sample_sets_srtt_and_rttvar(void)
+{
+    struct golioth_client_rtt rtt;
+
+    golioth_rtt_estimator_update(&est, 400, false, 0);
+
+    // E_strong = 400 + 4 * 200 = 1200, RTO = (1200 + 2000) / 2
+    golioth_rtt_estimator_get(&est, &rtt);
+    TEST_ASSERT_EQUAL(400, rtt.srtt_ms);
+    TEST_ASSERT_EQUAL(200, rtt.rttvar_ms);
+    TEST_ASSERT_EQUAL(1600, rtt.rto_ms);
+    TEST_ASSERT_EQUAL(1, rtt.num_samples);
+}
+
+void rto_converges_on_stable_rtt(void)
+{
+    for (int i = 0; i < 50; i++)
+    {
+        golioth_rtt_estimator_update(&est, 80, false, i * 100);
+    }
+
+    // Close to the RTT, but never below the lower bound
+    TEST_ASSERT_EQUAL(GOLIOTH_RTT_MIN_RTO_MS, golioth_rtt_estimator_rto_ms(&est, 5000));
+}
+
+void rto_grows_on_slow_link(void)
+{
+    for (int i = 0; i < 50; i++)
+    {
+        golioth_rtt_estimator_update(&est, 4000, false, i * 10000);
+    }
+
+    uint32_t rto_ms = golioth_rtt_estimator_rto_ms(&est, 500000);
+    TEST_ASSERT_GREATER_OR_EQUAL(4000, rto_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(GOLIOTH_RTT_MAX_RTO_MS, rto_ms);
+}
+
+void weak_samples_weigh_less_than_strong_ones(void)
+{
+    struct golioth_rtt_estimator strong;
+    golioth_rtt_estimator_init(&strong, GOLIOTH_RTT_INITIAL_RTO_MS);
+
+    golioth_rtt_estimator_update(&strong, 8000, false, 0);
+    golioth_rtt_estimator_update(&est, 8000, true, 0);
+
+    uint32_t strong_rto = golioth_rtt_estimator_rto_ms(&strong, 0);
+    uint32_t weak_rto = golioth_rtt_estimator_rto_ms(&est, 0);
+    TEST_ASSERT_GREATER_THAN(GOLIOTH_RTT_INITIAL_RTO_MS, weak_rto);
+    TEST_ASSERT_LESS_THAN(strong_rto, weak_rto);
+
+    // Reported from the weak estimator when there are no strong samples
+    struct golioth_client_rtt rtt;
+    golioth_rtt_estimator_get(&est, &rtt);
+    TEST_ASSERT_EQUAL(8000, rtt.srtt_ms);
+}
+
+void short_rto_ages_up(void)
+{
+    for (int i = 0; i < 50; i++)
+    {
+        golioth_rtt_estimator_update(&est, 100, false, 0);
+    }
+    TEST_ASSERT_EQUAL(GOLIOTH_RTT_MIN_RTO_MS, golioth_rtt_estimator_rto_ms(&est, 0));
+
+    // Not aged before 16 * RTO without samples
+    TEST_ASSERT_EQUAL(GOLIOTH_RTT_MIN_RTO_MS, golioth_rtt_estimator_rto_ms(&est, 4000));
+    TEST_ASSERT_EQUAL(2 * GOLIOTH_RTT_MIN_RTO_MS, golioth_rtt_estimator_rto_ms(&est, 4001));
+}
+
+void long_rto_ages_towards_initial(void)
+{
+    golioth_rtt_estimator_update(&est, 10000, false, 0);
+    uint32_t rto_ms = golioth_rtt_estimator_rto_ms(&est, 0);
+    TEST_ASSERT_GREATER_THAN(3000, rto_ms);
+
+    uint32_t aged_ms = golioth_rtt_estimator_rto_ms(&est, 4 * rto_ms + 1);
+    TEST_ASSERT_EQUAL((rto_ms + GOLIOTH_RTT_INITIAL_RTO_MS) / 2, aged_ms);
+}
+
+void backoff_depends_on_initial_rto(void)
+{
+    TEST_ASSERT_EQUAL(1500, golioth_rtt_estimator_backoff_ms(500, 500));
+    TEST_ASSERT_EQUAL(4000, golioth_rtt_estimator_backoff_ms(2000, 2000));
+    TEST_ASSERT_EQUAL(6000, golioth_rtt_estimator_backoff_ms(4000, 4000));
+    TEST_ASSERT_EQUAL(9000, golioth_rtt_estimator_backoff_ms(4000, 6000));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(initial_rto_is_used_until_first_sample);
+    RUN_TEST(first_strong_sample_sets_srtt_and_rttvar);
+    RUN_TEST(rto_converges_on_stable_rtt);
+    RUN_TEST(rto_grows_on_slow_link);
+    RUN_TEST(weak_samples_weigh_less_than_strong_ones);
+    RUN_TEST(short_rto_ages_up);
+    RUN_TEST(long_rto_ages_towards_initial);
+    RUN_TEST(backoff_depends_on_initial_rto);
+    return UNITY_END();
+}
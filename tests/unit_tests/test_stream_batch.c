@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include <fff.h>
+
+DEFINE_FFF_GLOBALS;
+
+#define CONFIG_GOLIOTH_STREAM
+
+#include "fakes/coap_client_fake.h"
+#include "fakes/golioth_sys_fake.h"
+#include "../../src/stream_batch.c"
+
+#define NO_TS GOLIOTH_STREAM_BATCH_NO_TIMESTAMP
+
+static int num_allocated;
+
+void *golioth_payload_pool_alloc(size_t size)
+{
+    num_allocated++;
+    return malloc(size);
+}
+
+void golioth_payload_pool_free(void *ptr)
+{
+    if (ptr)
+    {
+        num_allocated--;
+    }
+    free(ptr);
+}
+
+void golioth_payload_pool_release(const uint8_t *payload, size_t payload_size, void *arg)
+{
+    golioth_payload_pool_free((void *) payload);
+}
+
+static struct golioth_client *client = (struct golioth_client *) 0x1234;
+static uint8_t last_payload[256];
+static size_t last_payload_size;
+
+static enum golioth_status set_borrowed_custom_fake(struct golioth_client *client,
+                                                    golioth_coap_request_class_t request_class,
+                                                    const char *path_prefix,
+                                                    const char *path,
+                                                    uint32_t content_type,
+                                                    const uint8_t *payload,
+                                                    size_t payload_size,
+                                                    golioth_payload_release_fn release,
+                                                    void *release_arg,
+                                                    golioth_set_cb_fn callback,
+                                                    void *callback_arg,
+                                                    bool is_synchronous,
+                                                    int32_t timeout_s)
+{
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(last_payload), payload_size);
+    memcpy(last_payload, payload, payload_size);
+    last_payload_size = payload_size;
+
+    release(payload, payload_size, release_arg);
+    return GOLIOTH_OK;
+}
+
+static void assert_last_payload(const uint8_t *expected, size_t expected_size)
+{
+    TEST_ASSERT_EQUAL(expected_size, last_payload_size);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, last_payload, expected_size);
+}
+
+void setUp(void)
+{
+    RESET_FAKE(golioth_coap_client_set_borrowed);
+    golioth_coap_client_set_borrowed_fake.custom_fake = set_borrowed_custom_fake;
+    golioth_sys_fake_now_ms = 1000;
+    last_payload_size = 0;
+}
+
+void tearDown(void)
+{
+    TEST_ASSERT_EQUAL(0, num_allocated);
+}
+
+void test_records_are_sent_in_one_array(void)
+{
+    struct golioth_stream_batch_config config = {
+        .max_size = 128,
+        .callback_arg = &config,
+    };
+    struct golioth_stream_batch *batch = golioth_stream_batch_create(client, &config);
+    TEST_ASSERT_NOT_NULL(batch);
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_stream_batch_add_int(batch, "a", NO_TS, 1));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_stream_batch_add_bool(batch, "s/on", 0x1234, true));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_stream_batch_add_string(batch, "/b//", NO_TS, "hi", 2));
+    TEST_ASSERT_EQUAL(3, golioth_stream_batch_num_records(batch));
+    TEST_ASSERT_EQUAL(0, golioth_coap_client_set_borrowed_fake.call_count);
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_stream_batch_flush(batch));
+    TEST_ASSERT_EQUAL(1, golioth_coap_client_set_borrowed_fake.call_count);
+    TEST_ASSERT_EQUAL(0, golioth_stream_batch_num_records(batch));
+
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_REQUEST_CLASS_TELEMETRY,
+                      golioth_coap_client_set_borrowed_fake.arg1_val);
+    TEST_ASSERT_EQUAL_STRING(".s/", golioth_coap_client_set_borrowed_fake.arg2_val);
+    TEST_ASSERT_EQUAL_STRING("", golioth_coap_client_set_borrowed_fake.arg3_val);
+    TEST_ASSERT_EQUAL(GOLIOTH_CONTENT_TYPE_CBOR, golioth_coap_client_set_borrowed_fake.arg4_val);
+    TEST_ASSERT_EQUAL_PTR(&config, golioth_coap_client_set_borrowed_fake.arg10_val);
+
+    // [{"a": 1}, {"ts": 0x1234, "s": {"on": true}}, {"b": "hi"}]
+    const uint8_t expected[] = {
+        0x9f,                                            // array start
+        0xbf, 0x61, 'a',  0x01, 0xff,                    // {"a": 1}
+        0xbf, 0x62, 't',  's',  0x19, 0x12, 0x34,        // {"ts": 0x1234,
+        0x61, 's',  0xbf, 0x62, 'o',  'n',  0xf5, 0xff,  //  "s": {"on": true}
+        0xff,                                            // }
+        0xbf, 0x61, 'b',  0x62, 'h',  'i',  0xff,        // {"b": "hi"}
+        0xff,                                            // array end
+    };
+    assert_last_payload(expected, sizeof(expected));
+
+    golioth_stream_batch_destroy(batch);
+}
+
+void test_empty_batch_is_not_sent(void)
+{
+    struct golioth_stream_batch_config config = {.max_size = 128};
+    struct golioth_stream_batch *batch = golioth_stream_batch_create(client, &config);
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_stream_batch_flush(batch));
+    TEST_ASSERT_EQUAL(0, golioth_coap_client_set_borrowed_fake.call_count);
+
+    golioth_stream_batch_destroy(batch);
+}
+
+void test_batch_is_sent_after_max_records(void)
+{
+    struct golioth_stream_batch_config config = {
+        .max_size = 128,
+        .max_records = 2,
+    };
+    struct golioth_stream_batch *batch = golioth_stream_batch_create(client, &config);
+
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 1);
+    TEST_ASSERT_EQUAL(0, golioth_coap_client_set_borrowed_fake.call_count);
+
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 2);
+    TEST_ASSERT_EQUAL(1, golioth_coap_client_set_borrowed_fake.call_count);
+    TEST_ASSERT_EQUAL(0, golioth_stream_batch_num_records(batch));
+
+    const uint8_t expected[] = {
+        0x9f, 0xbf, 0x61, 'a', 0x01, 0xff, 0xbf, 0x61, 'a', 0x02, 0xff, 0xff,
+    };
+    assert_last_payload(expected, sizeof(expected));
+
+    golioth_stream_batch_destroy(batch);
+}
+
+void test_full_batch_is_sent_before_adding(void)
+{
+    // Room for two {"a": 1} records
+    struct golioth_stream_batch_config config = {.max_size = 12};
+    struct golioth_stream_batch *batch = golioth_stream_batch_create(client, &config);
+
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 1);
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 2);
+    TEST_ASSERT_EQUAL(0, golioth_coap_client_set_borrowed_fake.call_count);
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_stream_batch_add_int(batch, "a", NO_TS, 3));
+    TEST_ASSERT_EQUAL(1, golioth_coap_client_set_borrowed_fake.call_count);
+    TEST_ASSERT_EQUAL(1, golioth_stream_batch_num_records(batch));
+
+    const uint8_t expected[] = {
+        0x9f, 0xbf, 0x61, 'a', 0x01, 0xff, 0xbf, 0x61, 'a', 0x02, 0xff, 0xff,
+    };
+    assert_last_payload(expected, sizeof(expected));
+
+    golioth_stream_batch_flush(batch);
+    const uint8_t expected_next[] = {0x9f, 0xbf, 0x61, 'a', 0x03, 0xff, 0xff};
+    assert_last_payload(expected_next, sizeof(expected_next));
+
+    golioth_stream_batch_destroy(batch);
+}
+
+void test_old_batch_is_sent_before_adding(void)
+{
+    struct golioth_stream_batch_config config = {
+        .max_size = 128,
+        .max_age_ms = 500,
+    };
+    struct golioth_stream_batch *batch = golioth_stream_batch_create(client, &config);
+
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 1);
+    golioth_sys_fake_now_ms += 499;
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 2);
+    TEST_ASSERT_EQUAL(0, golioth_coap_client_set_borrowed_fake.call_count);
+
+    golioth_sys_fake_now_ms += 1;
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 3);
+    TEST_ASSERT_EQUAL(1, golioth_coap_client_set_borrowed_fake.call_count);
+    TEST_ASSERT_EQUAL(1, golioth_stream_batch_num_records(batch));
+
+    // The age of the new batch starts with its first record
+    golioth_sys_fake_now_ms += 499;
+    golioth_stream_batch_add_int(batch, "a", NO_TS, 4);
+    TEST_ASSERT_EQUAL(1, golioth_coap_client_set_borrowed_fake.call_count);
+
+    golioth_stream_batch_destroy(batch);
+}
+
+void test_invalid_records_are_rejected(void)
+{
+    struct golioth_stream_batch_config config = {.max_size = 16};
+    struct golioth_stream_batch *batch = golioth_stream_batch_create(client, &config);
+
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_NULL, golioth_stream_batch_add_int(NULL, "a", NO_TS, 1));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_NULL, golioth_stream_batch_add_int(batch, NULL, NO_TS, 1));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_stream_batch_add_int(batch, "", NO_TS, 1));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_stream_batch_add_int(batch, "//", NO_TS, 1));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_stream_batch_add_int(batch, "a/b/c/d/e/f/g/h/i", NO_TS, 1));
+
+    // Too large for an empty batch
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_SERIALIZE,
+                      golioth_stream_batch_add_string(batch, "a", NO_TS, "0123456789", 10));
+    TEST_ASSERT_EQUAL(0, golioth_stream_batch_num_records(batch));
+    TEST_ASSERT_EQUAL(0, golioth_coap_client_set_borrowed_fake.call_count);
+
+    golioth_stream_batch_destroy(batch);
+}
+
+void test_batch_is_dropped_if_not_queued(void)
+{
+    struct golioth_stream_batch_config config = {.max_size = 128};
+    struct golioth_stream_batch *batch = golioth_stream_batch_create(client, &config);
+
+    golioth_coap_client_set_borrowed_fake.custom_fake = NULL;
+    golioth_coap_client_set_borrowed_fake.return_val = GOLIOTH_ERR_QUEUE_FULL;
+
+    golioth_stream_batch_add_float(batch, "a", NO_TS, 1.0f);
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_QUEUE_FULL, golioth_stream_batch_flush(batch));
+    TEST_ASSERT_EQUAL(0, golioth_stream_batch_num_records(batch));
+
+    golioth_stream_batch_destroy(batch);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_are_sent_in_one_array);
+    RUN_TEST(test_empty_batch_is_not_sent);
+    RUN_TEST(test_batch_is_sent_after_max_records);
+    RUN_TEST(test_full_batch_is_sent_before_adding);
+    RUN_TEST(test_old_batch_is_sent_before_adding);
+    RUN_TEST(test_invalid_records_are_rejected);
+    RUN_TEST(test_batch_is_dropped_if_not_queued);
+    return UNITY_END();
+}
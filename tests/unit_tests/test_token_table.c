@@ -0,0 +1,145 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+
+#include "token_table.h"
+
+static struct golioth_token_table table;
+static int values[64];
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_token_table_init(&table, 4));
+}
+
+void tearDown(void)
+{
+    golioth_token_table_deinit(&table);
+}
+
+static void make_token(uint8_t *token, uint32_t n)
+{
+    token[0] = n >> 24;
+    token[1] = n >> 16;
+    token[2] = n >> 8;
+    token[3] = n;
+}
+
+void find_in_empty_table_returns_null(void)
+{
+    uint8_t token[4] = {1, 2, 3, 4};
+    TEST_ASSERT_NULL(golioth_token_table_find(&table, token, sizeof(token)));
+    TEST_ASSERT_EQUAL(0, golioth_token_table_count(&table));
+}
+
+void can_find_inserted_value(void)
+{
+    uint8_t token[4] = {1, 2, 3, 4};
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_token_table_insert(&table, token, sizeof(token), &values[0]));
+    TEST_ASSERT_EQUAL_PTR(&values[0], golioth_token_table_find(&table, token, sizeof(token)));
+    TEST_ASSERT_EQUAL(1, golioth_token_table_count(&table));
+}
+
+void token_length_is_part_of_the_key(void)
+{
+    uint8_t token[4] = {1, 2, 3, 4};
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_token_table_insert(&table, token, 4, &values[0]));
+    TEST_ASSERT_NULL(golioth_token_table_find(&table, token, 3));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_token_table_insert(&table, token, 3, &values[1]));
+    TEST_ASSERT_EQUAL_PTR(&values[1], golioth_token_table_find(&table, token, 3));
+}
+
+void duplicate_insert_fails(void)
+{
+    uint8_t token[2] = {5, 6};
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_token_table_insert(&table, token, 2, &values[0]));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_STATE,
+                      golioth_token_table_insert(&table, token, 2, &values[1]));
+    TEST_ASSERT_EQUAL_PTR(&values[0], golioth_token_table_find(&table, token, 2));
+}
+
+void remove_returns_value(void)
+{
+    uint8_t token[2] = {5, 6};
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_token_table_insert(&table, token, 2, &values[0]));
+    TEST_ASSERT_EQUAL_PTR(&values[0], golioth_token_table_remove(&table, token, 2));
+    TEST_ASSERT_NULL(golioth_token_table_find(&table, token, 2));
+    TEST_ASSERT_NULL(golioth_token_table_remove(&table, token, 2));
+    TEST_ASSERT_EQUAL(0, golioth_token_table_count(&table));
+}
+
+void grows_beyond_initial_capacity(void)
+{
+    uint8_t token[4];
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        make_token(token, i);
+        TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                          golioth_token_table_insert(&table, token, sizeof(token), &values[i]));
+    }
+
+    TEST_ASSERT_EQUAL(64, golioth_token_table_count(&table));
+
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        make_token(token, i);
+        TEST_ASSERT_EQUAL_PTR(&values[i], golioth_token_table_find(&table, token, sizeof(token)));
+    }
+}
+
+void remaining_tokens_are_found_after_removal(void)
+{
+    uint8_t token[4];
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        make_token(token, i);
+        golioth_token_table_insert(&table, token, sizeof(token), &values[i]);
+    }
+
+    // Remove every other token, which punches holes in the probe sequences
+    for (uint32_t i = 0; i < 64; i += 2)
+    {
+        make_token(token, i);
+        TEST_ASSERT_EQUAL_PTR(&values[i], golioth_token_table_remove(&table, token, sizeof(token)));
+    }
+
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        make_token(token, i);
+        void *expected = (i % 2) ? &values[i] : NULL;
+        TEST_ASSERT_EQUAL_PTR(expected, golioth_token_table_find(&table, token, sizeof(token)));
+    }
+    TEST_ASSERT_EQUAL(32, golioth_token_table_count(&table));
+}
+
+void reserve_does_not_lose_entries(void)
+{
+    uint8_t token[2] = {7, 8};
+    golioth_token_table_insert(&table, token, 2, &values[3]);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_token_table_reserve(&table, 100));
+    TEST_ASSERT_TRUE(table.capacity * 3 >= 100 * 4);
+    TEST_ASSERT_EQUAL_PTR(&values[3], golioth_token_table_find(&table, token, 2));
+}
+
+void too_long_token_is_rejected(void)
+{
+    uint8_t token[GOLIOTH_TOKEN_TABLE_MAX_TOKEN_LEN + 1] = {};
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_token_table_insert(&table, token, sizeof(token), &values[0]));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(find_in_empty_table_returns_null);
+    RUN_TEST(can_find_inserted_value);
+    RUN_TEST(token_length_is_part_of_the_key);
+    RUN_TEST(duplicate_insert_fails);
+    RUN_TEST(remove_returns_value);
+    RUN_TEST(grows_beyond_initial_capacity);
+    RUN_TEST(remaining_tokens_are_found_after_removal);
+    RUN_TEST(reserve_does_not_lose_entries);
+    RUN_TEST(too_long_token_is_rejected);
+    return UNITY_END();
+}
@@ -0,0 +1,114 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "warm_cache.h"
+
+static struct golioth_warm_cache cache;
+static uint8_t buf[GOLIOTH_CLIENT_WARM_CACHE_SIZE];
+static size_t len;
+
+void setUp(void)
+{
+    static const uint8_t addr[] = {192, 0, 2, 17};
+
+    memset(&cache, 0, sizeof(cache));
+    memcpy(cache.addr.addr, addr, sizeof(addr));
+    cache.addr.addr_len = sizeof(addr);
+
+    golioth_rtt_estimator_init(&cache.rtt, GOLIOTH_RTT_INITIAL_RTO_MS);
+    golioth_rtt_estimator_update(&cache.rtt, 400, false, 1000);
+    golioth_rtt_estimator_update(&cache.rtt, 3000, true, 2000);
+
+    len = sizeof(buf);
+    memset(buf, 0, sizeof(buf));
+}
+
+void tearDown(void) {}
+
+void round_trip(void)
+{
+    struct golioth_warm_cache restored;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_warm_cache_encode(&cache, buf, &len));
+    TEST_ASSERT_LESS_OR_EQUAL(GOLIOTH_CLIENT_WARM_CACHE_SIZE, len);
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_warm_cache_decode(&restored, buf, len, 50000));
+    TEST_ASSERT_EQUAL(4, restored.addr.addr_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(cache.addr.addr, restored.addr.addr, 4);
+
+    TEST_ASSERT_EQUAL(cache.rtt.initial_rto_ms, restored.rtt.initial_rto_ms);
+    TEST_ASSERT_EQUAL(cache.rtt.rto_ms, restored.rtt.rto_ms);
+    TEST_ASSERT_EQUAL(cache.rtt.strong_srtt_ms, restored.rtt.strong_srtt_ms);
+    TEST_ASSERT_EQUAL(cache.rtt.strong_rttvar_ms, restored.rtt.strong_rttvar_ms);
+    TEST_ASSERT_EQUAL(cache.rtt.weak_srtt_ms, restored.rtt.weak_srtt_ms);
+    TEST_ASSERT_EQUAL(cache.rtt.weak_rttvar_ms, restored.rtt.weak_rttvar_ms);
+    TEST_ASSERT_TRUE(restored.rtt.has_strong);
+    TEST_ASSERT_TRUE(restored.rtt.has_weak);
+    TEST_ASSERT_EQUAL(2, restored.rtt.num_samples);
+
+    // Ages from the time of the restore, not from the time of the cache
+    TEST_ASSERT_EQUAL(50000, restored.rtt.last_update_ms);
+}
+
+void cache_without_address(void)
+{
+    struct golioth_warm_cache restored;
+
+    cache.addr.addr_len = 0;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_warm_cache_encode(&cache, buf, &len));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_warm_cache_decode(&restored, buf, len, 0));
+    TEST_ASSERT_EQUAL(0, restored.addr.addr_len);
+    TEST_ASSERT_EQUAL(cache.rtt.rto_ms, restored.rtt.rto_ms);
+}
+
+void encode_rejects_small_buffer(void)
+{
+    len = GOLIOTH_CLIENT_WARM_CACHE_SIZE - 1;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_MEM_ALLOC,
+                      golioth_warm_cache_encode(&cache, buf, &len));
+}
+
+void decode_rejects_corrupt_cache(void)
+{
+    struct golioth_warm_cache restored;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_warm_cache_encode(&cache, buf, &len));
+
+    // Truncated
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_warm_cache_decode(&restored, buf, len - 1, 0));
+
+    // Other version
+    buf[2]++;
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_warm_cache_decode(&restored, buf, len, 0));
+    buf[2]--;
+
+    // Invalid address length
+    buf[3] = 7;
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_warm_cache_decode(&restored, buf, len, 0));
+    buf[3] = 4;
+
+    // Snapshot for another server (host hash follows magic, version and address)
+    buf[20] ^= 0xFF;
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_warm_cache_decode(&restored, buf, len, 0));
+    buf[20] ^= 0xFF;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_warm_cache_decode(&restored, buf, len, 0));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(round_trip);
+    RUN_TEST(cache_without_address);
+    RUN_TEST(encode_rejects_small_buffer);
+    RUN_TEST(decode_rejects_corrupt_cache);
+    return UNITY_END();
+}